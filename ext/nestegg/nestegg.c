@@ -379,6 +379,7 @@ struct saved_state {
   int64_t stream_offset;
   uint64_t last_id;
   uint64_t last_size;
+  uint64_t last_header_length;
   int last_valid;
 };
 
@@ -393,6 +394,7 @@ struct frame_encryption {
 struct frame {
   unsigned char * data;
   size_t length;
+  int borrowed_data;
   struct frame_encryption * frame_encryption;
   struct frame * next;
 };
@@ -411,6 +413,7 @@ struct nestegg {
   struct pool_ctx * alloc_pool;
   uint64_t last_id;
   uint64_t last_size;
+  uint64_t last_header_length;
   int last_valid;
   struct list_node * ancestor;
   struct ebml ebml;
@@ -420,7 +423,15 @@ struct nestegg {
   /* Last read cluster. */
   uint64_t cluster_timecode;
   int read_cluster_timecode;
+  int64_t cluster_offset;
+  /* First cluster of the segment, where parsing was suspended by nestegg_init. */
+  int64_t first_cluster_offset;
   struct saved_state saved;
+  /* In-memory image of the stream packet data is read from, if any. */
+  unsigned char const * packet_data_source;
+  size_t packet_data_source_length;
+  /* Allocator used for packets, their frames and frame data. */
+  nestegg_packet_allocator packet_allocator;
 };
 
 struct nestegg_packet {
@@ -435,6 +446,7 @@ struct nestegg_packet {
   int64_t reference_block;
   int read_reference_block;
   uint8_t keyframe;
+  nestegg_packet_allocator allocator;
 };
 
 /* Element Descriptor */
@@ -1003,6 +1015,7 @@ ne_ctx_save(nestegg * ctx, struct saved_state * s)
     return -1;
   s->last_id = ctx->last_id;
   s->last_size = ctx->last_size;
+  s->last_header_length = ctx->last_header_length;
   s->last_valid = ctx->last_valid;
   return 0;
 }
@@ -1019,6 +1032,7 @@ ne_ctx_restore(nestegg * ctx, struct saved_state * s)
     return -1;
   ctx->last_id = s->last_id;
   ctx->last_size = s->last_size;
+  ctx->last_header_length = s->last_header_length;
   ctx->last_valid = s->last_valid;
   return 0;
 }
@@ -1027,6 +1041,7 @@ static int
 ne_peek_element(nestegg * ctx, uint64_t * id, uint64_t * size)
 {
   int r;
+  uint64_t id_length, size_length;
 
   if (ctx->last_valid) {
     if (id)
@@ -1036,14 +1051,16 @@ ne_peek_element(nestegg * ctx, uint64_t * id, uint64_t * size)
     return 1;
   }
 
-  r = ne_read_id(ctx->io, &ctx->last_id, NULL);
+  r = ne_read_id(ctx->io, &ctx->last_id, &id_length);
   if (r != 1)
     return r;
 
-  r = ne_read_vint(ctx->io, &ctx->last_size, NULL);
+  r = ne_read_vint(ctx->io, &ctx->last_size, &size_length);
   if (r != 1)
     return r;
 
+  ctx->last_header_length = id_length + size_length;
+
   if (id)
     *id = ctx->last_id;
   if (size)
@@ -1440,16 +1457,31 @@ ne_find_track_entry(nestegg * ctx, unsigned int track)
   return NULL;
 }
 
+static void *
+ne_default_packet_alloc(size_t size, void * userdata)
+{
+  (void) userdata;
+  return malloc(size);
+}
+
+static void
+ne_default_packet_free(void * ptr, void * userdata)
+{
+  (void) userdata;
+  free(ptr);
+}
+
 static struct frame *
-ne_alloc_frame(void)
+ne_alloc_frame(nestegg_packet_allocator const * allocator)
 {
-  struct frame * f = ne_alloc(sizeof(*f));
+  struct frame * f = allocator->alloc(sizeof(*f), allocator->userdata);
 
   if (!f)
     return NULL;
 
   f->data = NULL;
   f->length = 0;
+  f->borrowed_data = 0;
   f->frame_encryption = NULL;
   f->next = NULL;
 
@@ -1474,7 +1506,7 @@ ne_alloc_frame_encryption(void)
 }
 
 static void
-ne_free_frame(struct frame * f)
+ne_free_frame(struct frame * f, nestegg_packet_allocator const * allocator)
 {
   if (f->frame_encryption) {
     free(f->frame_encryption->iv);
@@ -1482,8 +1514,35 @@ ne_free_frame(struct frame * f)
   }
 
   free(f->frame_encryption);
-  free(f->data);
-  free(f);
+  if (!f->borrowed_data && f->data)
+    allocator->free(f->data, allocator->userdata);
+  allocator->free(f, allocator->userdata);
+}
+
+/* Point the frame data into the in-memory image of the stream, if one was
+   set and the frame is entirely inside it.  Returns 1 on success, 0 if the
+   data must be read the usual way and -1 on error. */
+static int
+ne_read_frame_data_in_place(nestegg * ctx, struct frame * f, uint64_t data_size)
+{
+  int64_t offset;
+
+  if (!ctx->packet_data_source || f->frame_encryption)
+    return 0;
+
+  offset = ne_io_tell(ctx->io);
+  if (offset < 0 || (uint64_t) offset > ctx->packet_data_source_length ||
+      data_size > ctx->packet_data_source_length - (uint64_t) offset)
+    return 0;
+
+  if (ne_io_seek(ctx->io, data_size, NESTEGG_SEEK_CUR) != 0)
+    return -1;
+
+  f->data = (unsigned char *) ctx->packet_data_source + offset;
+  f->length = data_size;
+  f->borrowed_data = 1;
+
+  return 1;
 }
 
 static int
@@ -1630,9 +1689,11 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
       abs_timecode = 0;
   }
 
-  pkt = ne_alloc(sizeof(*pkt));
+  pkt = ctx->packet_allocator.alloc(sizeof(*pkt), ctx->packet_allocator.userdata);
   if (!pkt)
     return -1;
+  memset(pkt, 0, sizeof(*pkt));
+  pkt->allocator = ctx->packet_allocator;
   pkt->track = track;
   pkt->timecode = abs_timecode * tc_scale * track_scale;
   pkt->keyframe = keyframe;
@@ -1646,7 +1707,7 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
       nestegg_free_packet(pkt);
       return -1;
     }
-    f = ne_alloc_frame();
+    f = ne_alloc_frame(&pkt->allocator);
     if (!f) {
       nestegg_free_packet(pkt);
       return -1;
@@ -1655,13 +1716,13 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
     if (encoding_type == NESTEGG_ENCODING_ENCRYPTION) {
       r = ne_io_read(ctx->io, &signal_byte, SIGNAL_BYTE_SIZE);
       if (r != 1) {
-        ne_free_frame(f);
+        ne_free_frame(f, &pkt->allocator);
         nestegg_free_packet(pkt);
         return r;
       }
       f->frame_encryption = ne_alloc_frame_encryption();
       if (!f->frame_encryption) {
-        ne_free_frame(f);
+        ne_free_frame(f, &pkt->allocator);
         nestegg_free_packet(pkt);
         return -1;
       }
@@ -1669,13 +1730,13 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
       if ((signal_byte & ENCRYPTED_BIT_MASK) == PACKET_ENCRYPTED) {
         f->frame_encryption->iv = ne_alloc(IV_SIZE);
         if (!f->frame_encryption->iv) {
-          ne_free_frame(f);
+          ne_free_frame(f, &pkt->allocator);
           nestegg_free_packet(pkt);
           return -1;
         }
         r = ne_io_read(ctx->io, f->frame_encryption->iv, IV_SIZE);
         if (r != 1) {
-          ne_free_frame(f);
+          ne_free_frame(f, &pkt->allocator);
           nestegg_free_packet(pkt);
           return r;
         }
@@ -1685,7 +1746,7 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
         if ((signal_byte & PARTITIONED_BIT_MASK) == PACKET_PARTITIONED) {
           r = ne_io_read(ctx->io, &f->frame_encryption->num_partitions, NUM_PACKETS_SIZE);
           if (r != 1) {
-            ne_free_frame(f);
+            ne_free_frame(f, &pkt->allocator);
             nestegg_free_packet(pkt);
             return r;
           }
@@ -1705,7 +1766,7 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
 
           /* If any of the partition offsets did not return 1, then fail. */
           if (j != f->frame_encryption->num_partitions) {
-            ne_free_frame(f);
+            ne_free_frame(f, &pkt->allocator);
             nestegg_free_packet(pkt);
             return r;
           }
@@ -1717,22 +1778,25 @@ ne_read_block(nestegg * ctx, uint64_t block_id, uint64_t block_size, nestegg_pac
       encryption_size = 0;
     }
     if (encryption_size > frame_sizes[i]) {
-      ne_free_frame(f);
+      ne_free_frame(f, &pkt->allocator);
       nestegg_free_packet(pkt);
       return -1;
     }
     data_size = frame_sizes[i] - encryption_size;
     /* Encryption parsed */
-    f->data = ne_alloc(data_size);
-    if (!f->data) {
-      ne_free_frame(f);
-      nestegg_free_packet(pkt);
-      return -1;
+    r = ne_read_frame_data_in_place(ctx, f, data_size);
+    if (r == 0) {
+      f->data = pkt->allocator.alloc(data_size, pkt->allocator.userdata);
+      if (!f->data) {
+        ne_free_frame(f, &pkt->allocator);
+        nestegg_free_packet(pkt);
+        return -1;
+      }
+      f->length = data_size;
+      r = ne_io_read(ctx->io, f->data, data_size);
     }
-    f->length = data_size;
-    r = ne_io_read(ctx->io, f->data, data_size);
     if (r != 1) {
-      ne_free_frame(f);
+      ne_free_frame(f, &pkt->allocator);
       nestegg_free_packet(pkt);
       return r;
     }
@@ -2108,6 +2172,13 @@ ne_context_new(nestegg ** context, nestegg_io io, nestegg_log callback)
   if (!ctx->log)
     ctx->log = ne_null_log_callback;
 
+  ctx->cluster_offset = -1;
+  ctx->first_cluster_offset = -1;
+
+  ctx->packet_allocator.alloc = ne_default_packet_alloc;
+  ctx->packet_allocator.free = ne_default_packet_free;
+  ctx->packet_allocator.userdata = NULL;
+
   *context = ctx;
   return 0;
 }
@@ -2233,6 +2304,10 @@ nestegg_init(nestegg ** context, nestegg_io io, nestegg_log callback, int64_t ma
     return -1;
   }
 
+  /* Parsing is suspended with the header of the first cluster peeked. */
+  if (ctx->last_valid && ctx->last_id == ID_CLUSTER)
+    ctx->first_cluster_offset = ne_io_tell(ctx->io) - ctx->last_header_length;
+
   track = ctx->segment.tracks.track_entry.head;
   ctx->track_count = 0;
 
@@ -2262,6 +2337,57 @@ nestegg_destroy(nestegg * ctx)
   free(ctx);
 }
 
+int
+nestegg_set_packet_data_source(nestegg * ctx, unsigned char const * data, size_t length)
+{
+  if (!ctx || (!data && length))
+    return -1;
+
+  ctx->packet_data_source = data;
+  ctx->packet_data_source_length = data ? length : 0;
+
+  return 0;
+}
+
+int
+nestegg_set_packet_allocator(nestegg * ctx, nestegg_packet_allocator const * allocator)
+{
+  if (!ctx || (allocator && (!allocator->alloc || !allocator->free)))
+    return -1;
+
+  if (allocator) {
+    ctx->packet_allocator = *allocator;
+  } else {
+    ctx->packet_allocator.alloc = ne_default_packet_alloc;
+    ctx->packet_allocator.free = ne_default_packet_free;
+    ctx->packet_allocator.userdata = NULL;
+  }
+
+  return 0;
+}
+
+int
+nestegg_cluster_offset(nestegg * ctx, int64_t * offset)
+{
+  if (!ctx || !offset || ctx->cluster_offset < 0)
+    return -1;
+
+  *offset = ctx->cluster_offset;
+
+  return 0;
+}
+
+int
+nestegg_first_cluster_offset(nestegg * ctx, int64_t * offset)
+{
+  if (!ctx || !offset || ctx->first_cluster_offset < 0)
+    return -1;
+
+  *offset = ctx->first_cluster_offset;
+
+  return 0;
+}
+
 int
 nestegg_duration(nestegg * ctx, uint64_t * duration)
 {
@@ -2386,6 +2512,7 @@ nestegg_offset_seek(nestegg * ctx, uint64_t offset)
   if (r != 0)
     return -1;
   ctx->last_valid = 0;
+  ctx->cluster_offset = -1;
 
   assert(ctx->ancestor == NULL);
 
@@ -2906,6 +3033,8 @@ nestegg_read_packet(nestegg * ctx, nestegg_packet ** pkt)
 
     switch (id) {
     case ID_CLUSTER: {
+      ctx->cluster_offset = ne_io_tell(ctx->io) - ctx->last_header_length;
+
       r = ne_read_element(ctx, &id, &size);
       if (r != 1)
         return r;
@@ -3103,17 +3232,18 @@ void
 nestegg_free_packet(nestegg_packet * pkt)
 {
   struct frame * frame;
+  nestegg_packet_allocator allocator = pkt->allocator;
 
   while (pkt->frame) {
     frame = pkt->frame;
     pkt->frame = frame->next;
 
-    ne_free_frame(frame);
+    ne_free_frame(frame, &allocator);
   }
 
   ne_free_block_additions(pkt->block_additional);
 
-  free(pkt);
+  allocator.free(pkt, allocator.userdata);
 }
 
 int
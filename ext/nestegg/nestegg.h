@@ -136,6 +136,25 @@ typedef struct {
   void * userdata;
 } nestegg_io;
 
+/** Memory allocator used for packets, see #nestegg_set_packet_allocator. */
+typedef struct {
+  /** User supplied allocation callback.  The returned memory does not need
+      to be zeroed.
+      @param size     Number of bytes to allocate.
+      @param userdata The #userdata supplied by the user.
+      @returns Pointer to the allocated memory.
+      @retval NULL Error. */
+  void * (* alloc)(size_t size, void * userdata);
+
+  /** User supplied free callback.
+      @param ptr      Pointer previously returned by #alloc.
+      @param userdata The #userdata supplied by the user. */
+  void (* free)(void * ptr, void * userdata);
+
+  /** User supplied pointer to be passed to the allocator callbacks. */
+  void * userdata;
+} nestegg_packet_allocator;
+
 /** Parameters specific to a video track. */
 typedef struct {
   unsigned int stereo_mode;    /**< Video mode.  One of #NESTEGG_VIDEO_MONO,
@@ -489,6 +508,33 @@ int nestegg_packet_offsets(nestegg_packet * packet,
 int nestegg_packet_reference_block(nestegg_packet * packet,
                                    int64_t * reference_block);
 
+/** Route the memory allocations of the packets read by #nestegg_read_packet
+    through a custom allocator.  This covers the packet, its frame list and
+    the frame data.  Each packet remembers the allocator it was created with,
+    which must stay usable until that packet has been freed.
+    @param context   Stream context initialized by #nestegg_init.
+    @param allocator The allocator to use, or NULL to go back to malloc/free.
+    @retval  0 Success.
+    @retval -1 Error. */
+int nestegg_set_packet_allocator(nestegg * context, nestegg_packet_allocator const * allocator);
+
+/** Query the offset of the Cluster the last packet returned by
+    #nestegg_read_packet belongs to.  The offset can later be passed to
+    #nestegg_offset_seek to resume reading from the start of that Cluster.
+    @param context Stream context initialized by #nestegg_init.
+    @param offset  Storage for the queried offset.
+    @retval  0 Success.
+    @retval -1 Error, or no Cluster has been read since the last seek. */
+int nestegg_cluster_offset(nestegg * context, int64_t * offset);
+
+/** Query the offset of the first Cluster of the Segment.  The offset can be
+    passed to #nestegg_offset_seek to read the stream again from its start.
+    @param context Stream context initialized by #nestegg_init.
+    @param offset  Storage for the queried offset.
+    @retval  0 Success.
+    @retval -1 Error, or the first Cluster wasn't reached by #nestegg_init. */
+int nestegg_first_cluster_offset(nestegg * context, int64_t * offset);
+
 /** Query the presence of cues.
     @param context  Stream context initialized by #nestegg_init.
     @retval 0 The media has no cues.
@@ -502,6 +548,20 @@ int nestegg_has_cues(nestegg * context);
     @retval 1 The file is a WebM file. */
 int nestegg_sniff(unsigned char const * buffer, size_t length);
 
+/** Read packet data in place from an in-memory image of the stream.  Once
+    set, the chunks returned by #nestegg_packet_data point directly into
+    @a data instead of into newly allocated buffers, so @a data must stay
+    valid until every packet read from @a context has been freed.  The
+    stream offsets reported by the IO tell callback must match offsets
+    into @a data.  Encrypted chunks are still copied.
+    @param context Stream context initialized by #nestegg_init.
+    @param data    Start of the in-memory image of the stream, or NULL to
+                   go back to copying packet data.
+    @param length  Size of @a data in bytes.
+    @retval  0 Success.
+    @retval -1 Error. */
+int nestegg_set_packet_data_source(nestegg * context, unsigned char const * data, size_t length);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -7,6 +7,7 @@
 #include "dav1d/dav1d.h"
 #include "minivorbis/minivorbis.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -33,16 +34,63 @@ typedef CONDITION_VARIABLE pthread_cond_t;
 
 #else
 #include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#ifndef __SWITCH__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define EASYAV1_HAS_MMAP
+#endif
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EASYAV1_HAS_AVX2
+#define EASYAV1_HAS_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EASYAV1_HAS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EASYAV1_HAS_NEON
 #endif
 
 #define AUDIO_BUFFER_SIZE 4096
+#define AUDIO_CONVERSION_BLOCK_SIZE 1024
 #define PACKET_QUEUE_BASE_CAPACITY 16
+#define PACKET_POOL_MIN_BLOCK_SHIFT 6
+#define PACKET_POOL_MAX_BLOCK_SHIFT 22
+#define PACKET_POOL_SIZE_CLASSES (PACKET_POOL_MAX_BLOCK_SHIFT - PACKET_POOL_MIN_BLOCK_SHIFT + 1)
+#define PACKET_POOL_UNPOOLED PACKET_POOL_SIZE_CLASSES
 #define VIDEO_FRAMES_TO_PREFETCH 10
-#define VIDEO_FRAME_QUEUE_SIZE (VIDEO_FRAMES_TO_PREFETCH + 1)
+#define VIDEO_DECODE_QUEUE_SIZE (EASYAV1_MAX_VIDEO_PREFETCH_FRAMES + 4)
+#define VIDEO_PICTURE_POOL_SIZE 16
+#define READ_AHEAD_CHUNK_SIZE (64 * 1024)
 
 #define VORBIS_HEADERS_COUNT 3
 
-#define DECODE_UNTIL_SKIP_MS 1000
+// The public limits are the ones settings are checked against, so they must stay within what dav1d accepts
+#if EASYAV1_MAX_VIDEO_DECODER_THREADS > DAV1D_MAX_THREADS
+#error "EASYAV1_MAX_VIDEO_DECODER_THREADS is larger than DAV1D_MAX_THREADS"
+#endif
+
+#if EASYAV1_MAX_VIDEO_FRAME_DELAY > DAV1D_MAX_FRAME_DELAY
+#error "EASYAV1_MAX_VIDEO_FRAME_DELAY is larger than DAV1D_MAX_FRAME_DELAY"
+#endif
+
+#define INDEX_MAGIC 0x58494145 // "EAIX", as stored in little-endian order
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 48
+#define INDEX_CUE_POINT_SIZE 16
+#define INDEX_KEYFRAME_SIZE 24
+#define INDEX_FLAG_SCAN_FINISHED 1
+
+#define PLAYBACK_MAX_WAIT_MS 100
 
 #define INVALID_TIMESTAMP ((easyav1_timestamp) -1)
 
@@ -53,9 +101,10 @@ typedef CONDITION_VARIABLE pthread_cond_t;
  * Stream types - used to determine how to read the data
  */
 typedef enum {
-    STREAM_TYPE_NONE = 0, // No stream type
-    STREAM_TYPE_FILE,     // Streaming from a file
-    STREAM_TYPE_MEMORY    // Streaming from memory
+    STREAM_TYPE_NONE = 0,   // No stream type
+    STREAM_TYPE_FILE,       // Streaming from a file
+    STREAM_TYPE_MEMORY,     // Streaming from memory
+    STREAM_TYPE_MAPPED_FILE // Streaming from a memory-mapped file
 } stream_type;
 
 
@@ -91,6 +140,20 @@ typedef enum {
 } easyav1_packet_type;
 
 
+/**
+ * Settings changes - the changes of new settings that restart a decoder, which is done by seeking to the current
+ * position. At most one audio change and one video change are reported, in the order of precedence listed here.
+ */
+typedef enum {
+    SETTINGS_CHANGE_NONE = 0,                // Nothing that restarts a decoder changed
+    SETTINGS_CHANGE_AUDIO_TRACK = 1 << 0,    // Audio was enabled, disabled or changed to another track
+    SETTINGS_CHANGE_AUDIO_BUFFER = 1 << 1,   // The audio buffer layout, format or size changed
+    SETTINGS_CHANGE_AUDIO_OFFSET = 1 << 2,   // The audio offset time changed
+    SETTINGS_CHANGE_VIDEO_TRACK = 1 << 3,    // Video was enabled, disabled or changed to another track
+    SETTINGS_CHANGE_VIDEO_DECODER = 1 << 4   // The settings of the active video decoder changed
+} settings_change;
+
+
 /**
  * Packet data structure - used to store the webm packet data and metadata
  */
@@ -101,20 +164,178 @@ typedef struct {
     easyav1_packet_type type;    // The type of the packet (video or audio)
     easyav1_bool decoded;        // Whether the packet has been decoded
     easyav1_bool is_seek_packet; // Whether the packet is a seek packet
+    easyav1_bool discardable;    // Whether the picture is never displayed, as a later packet covers the seek target
+    easyav1_bool droppable;      // Whether the packet may be dropped to keep up, if no other frame references it
+    easyav1_bool skipped;        // Whether the video decoder thread skipped the packet without decoding it
 } easyav1_packet;
 
 
+/**
+ * Bit reader - used to parse the few AV1 headers the video decoder thread needs to look at itself
+ */
+typedef struct {
+    const uint8_t *data;  // The data to read from
+    size_t size;          // The size of the data, in bytes
+    size_t position;      // The current position, in bits
+    easyav1_bool overrun; // Whether more bits were read than the data holds
+} easyav1_bit_reader;
+
+
 /**
  * Packet queue - used to store the packets in a queue, to be processed later
  */
 typedef struct {
-    easyav1_packet *items; // The packets in the queue
-    size_t count;          // The total number of items
-    size_t capacity;       // The memory capacity of the queue
-    size_t begin;          // The index of the first item in the queue
+    easyav1_packet **items;  // The packets in the queue, pointing into the chunks so packets never move in memory
+    easyav1_packet **chunks; // The memory chunks holding the packets
+    size_t chunk_count;      // The number of memory chunks
+    size_t count;            // The total number of items
+    size_t capacity;         // The memory capacity of the queue
+    size_t begin;            // The index of the first item in the queue
+    size_t handed_off;       // The number of items, starting from the first, handed to the video decoder thread
 } easyav1_packet_queue;
 
 
+/**
+ * Packet pool block - the header placed before each block of memory handed out by the packet pool
+ */
+typedef union easyav1_pool_block {
+    struct {
+        union easyav1_pool_block *next; // The next free block of the same size class, while the block is free
+        unsigned int size_class;        // The size class of the block, or `PACKET_POOL_UNPOOLED` if not pooled
+        size_t size;                    // The usable size of the block
+    } info;
+    long double alignment;              // Keeps the memory after the header aligned for any type
+    void *pointer_alignment;            // Keeps the memory after the header aligned for any pointer
+} easyav1_pool_block;
+
+
+/**
+ * Picture pool buffer - the header placed before each picture buffer handed out by the built-in picture allocator
+ */
+typedef struct easyav1_picture_pool_buffer {
+    struct easyav1_picture_pool_buffer *next; // The next released buffer, while the buffer is free
+    size_t size;                              // The usable size of the buffer
+    uint8_t *data;                            // The start of the buffer, aligned for the video decoder
+} easyav1_picture_pool_buffer;
+
+
+/**
+ * Held video frame - a video frame the application keeps valid until it releases it
+ *
+ * The frame must be the first member, as the application only gets a pointer to it back.
+ */
+typedef struct {
+    easyav1_video_frame frame;  // The frame handed to the application
+    Dav1dPicture picture;       // The picture, taken over once it's no longer the one being displayed
+    uint8_t *rgb;               // The RGB conversion of the frame, if there is one
+    uint8_t *planes;            // The converted planes of the frame, if there are any
+    volatile size_t references; // The references to the frame, including the one kept while it's being displayed
+    easyav1_t *easyav1;         // The easyav1 instance the frame was held from
+} easyav1_held_frame;
+
+
+/**
+ * Cue point - used to store a seekable position in the webm file
+ */
+typedef struct {
+    easyav1_timestamp timestamp; // The timestamp of the cue point, in milliseconds
+    int64_t offset;              // The byte offset of the cluster the cue point refers to
+} easyav1_cue_point;
+
+
+/**
+ * Keyframe index entry - used to store a video keyframe that decoding can start from after seeking
+ */
+typedef struct {
+    easyav1_timestamp timestamp;     // The timestamp of the keyframe, in milliseconds
+    easyav1_timestamp covered_until; // The timestamp until which it's known that there is no later keyframe
+    int64_t offset;                  // The byte offset of the cluster that contains the keyframe
+} easyav1_keyframe;
+
+
+/**
+ * Keyframe index cursor - used to track the last keyframe indexed while reading the stream sequentially
+ */
+typedef struct {
+    easyav1_bool has_keyframe;  // Whether a keyframe was indexed since the stream was last seeked
+    easyav1_timestamp keyframe; // The timestamp of the last indexed keyframe
+} easyav1_keyframe_cursor;
+
+
+/**
+ * RGB conversion buffer - used to store a video frame converted to RGB by the video decoder thread
+ */
+typedef struct {
+    uint8_t *data;       // The converted pixels
+    size_t size;         // The memory capacity of the buffer
+    size_t stride;       // The number of bytes per row of pixels
+    easyav1_bool filled; // Whether the buffer holds the conversion of the picture it goes with
+} easyav1_rgb_buffer;
+
+
+/**
+ * Plane conversion buffer - used to store the YUV planes of a video frame converted by the video decoder thread
+ */
+typedef struct {
+    uint8_t *data;               // The converted planes
+    size_t size;                 // The memory capacity of the buffer
+    size_t offset[3];            // Where each plane starts in the buffer
+    size_t stride[3];            // The number of bytes per row of each plane, or 0 if the plane isn't used
+    easyav1_plane_format format; // The format the planes were converted to
+    easyav1_bool filled;         // Whether the buffer holds the conversion of the picture it goes with
+} easyav1_plane_buffer;
+
+
+/**
+ * YUV to RGB conversion matrix - fixed point coefficients for one color matrix, range and bit depth
+ *
+ * The samples have their offsets removed and are shifted left by `shift`, so they use most of 16 bits regardless
+ * of the bit depth. The coefficients are scaled by 4096, so that multiplying both and keeping the high 16 bits
+ * results in 8-bit color values times 8.
+ */
+typedef struct {
+    int16_t y_offset;  // The luma value of black
+    int16_t c_offset;  // The chroma value of zero
+    int16_t shift;     // The number of bits to shift the samples left by
+    int16_t y;         // The luma coefficient
+    int16_t r_v;       // The red coefficient for V
+    int16_t g_u;       // The green coefficient for U, subtracted
+    int16_t g_v;       // The green coefficient for V, subtracted
+    int16_t b_u;       // The blue coefficient for U
+} easyav1_yuv_matrix;
+
+
+/**
+ * YUV image - used to describe the planes of a frame to convert to RGB
+ */
+typedef struct {
+    const void *planes[3];         // The Y, U and V planes
+    ptrdiff_t strides[3];          // The number of bytes per row of each plane
+    unsigned int width;            // The width of the image, in pixels
+    unsigned int height;           // The height of the image, in pixels
+    easyav1_pixel_layout layout;   // The chroma subsampling
+    easyav1_bool high_bit_depth;   // Whether the samples are 16-bit instead of 8-bit
+} easyav1_yuv_image;
+
+
+/**
+ * Decoder pool - shares a video decoder thread budget between the easyav1 instances that joined it
+ */
+struct easyav1_pool {
+    pthread_mutex_t mutex;          // The pool mutex - used to lock all other variables
+    pthread_cond_t slot_released;   // Signaled when a decode slot is released or the next ticket can be served
+
+    unsigned int threads;           // The total number of video decoder threads of all the instances in the pool
+    unsigned int max_decoders;      // The maximum number of instances that may decode a packet at the same time
+
+    unsigned int members;           // The number of instances that joined the pool
+    unsigned int active_decoders;   // The number of instances currently decoding a packet
+
+    size_t next_ticket;             // The ticket handed to the next instance that asks for a decode slot
+    size_t serving_ticket;          // The ticket of the instance that gets the next free decode slot
+};
+
+
 /**
  * The main easyav1 structure - used to store all the data and metadata for the easyav1 library
  */
@@ -128,6 +349,14 @@ struct easyav1_t {
         unsigned int num_tracks;    // The total number of tracks in the webm file
         unsigned int video_tracks;  // The number of video tracks in the webm file
         unsigned int audio_tracks;  // The number of audio tracks in the webm file
+
+        /**
+         * The cue index - a copy of the webm cue points, sorted by timestamp, for fast lookups
+         */
+        struct {
+            easyav1_cue_point *points; // The cue points
+            unsigned int count;        // The number of cue points
+        } cues;
     } webm;
 
 
@@ -141,6 +370,9 @@ struct easyav1_t {
         Dav1dSequenceHeader *sqhdr; // The current sequence header for the video decoder
 
         Dav1dPicture picture;       // The current picture being displayed
+        easyav1_held_frame *held;   // The held frame for the picture being displayed, if it was acquired
+
+        volatile size_t held_frames; // The number of held frames that were not released yet
 
         easyav1_bool active;        // Whether the video decoder is active
         unsigned int track;         // The track number of the video in the webm container
@@ -150,20 +382,65 @@ struct easyav1_t {
 
         unsigned int fps;           // The frames per second of the video
 
-        uint64_t processed_frames;  // The number of frames processed by the decoder
+        volatile uint64_t processed_frames; // The number of frames processed by the decoder
 
         easyav1_video_frame frame; // The current video frame data and metadata
 
+        easyav1_pool *pool;        // The decoder pool the video decoder joined, if any
+
+        easyav1_picture_allocator picture_allocator; // The picture allocator the video decoder was opened with
+
+        /**
+         * The picture buffers released by the video decoder, kept to be reused when no picture allocator is set
+         */
+        struct {
+            easyav1_picture_pool_buffer *free_buffers; // The released buffers, most recently released first
+            size_t free_count;                         // The number of released buffers
+            pthread_mutex_t mutex;                     // Locks the pool, as pictures come and go on any thread
+        } picture_pool;
+
+        /**
+         * The settings actually applied to the video decoder, which differ from the requested ones when automatic
+         */
+        struct {
+            unsigned int threads;         // The number of threads used by the decoder
+            unsigned int max_frame_delay; // The maximum frame delay used by the decoder
+            unsigned int prefetch_frames; // The number of frames decoded ahead of the current position
+            easyav1_bool prefetch_sized_from_sequence_header; // Whether the prefetch depth uses the real frame size
+            easyav1_rgb_format rgb_format; // The format the decoder thread converts the frames to
+            easyav1_plane_format plane_format; // The layout the decoder thread converts the YUV planes to
+            easyav1_video_quality quality; // The quality the decoder decodes at, which is lower when degraded
+        } decoder_settings;
+
         /**
          * The video frame queue - used to store the video frames in a queue, to be processed later
          */
         struct {
-            Dav1dPicture frames[VIDEO_FRAME_QUEUE_SIZE]; // The video frames in the queue
+            Dav1dPicture *frames;         // The video frames in the queue
+            easyav1_rgb_buffer *rgb;      // The RGB conversions of the video frames in the queue
+            easyav1_plane_buffer *planes; // The plane conversions of the video frames in the queue
 
-            size_t count;        // The total number of items in the queue
-            size_t begin;        // The index of the first item in the queue
+            size_t count;                 // The total number of items in the queue
+            size_t capacity;              // The maximum number of items in the queue
+            size_t begin;                 // The index of the first item in the queue
         } frame_queue;
 
+        /**
+         * The RGB conversion buffers that are not in the frame queue
+         */
+        struct {
+            easyav1_rgb_buffer spare;     // The buffer the decoder thread converts the next frame into
+            easyav1_rgb_buffer displayed; // The buffer holding the conversion of the frame being displayed
+        } rgb;
+
+        /**
+         * The plane conversion buffers that are not in the frame queue
+         */
+        struct {
+            easyav1_plane_buffer spare;     // The buffer the decoder thread converts the next frame into
+            easyav1_plane_buffer displayed; // The buffer holding the conversion of the frame being displayed
+        } planes;
+
 
         /**
          * The video decoder thread - used to store the video decoder thread data and metadata
@@ -172,12 +449,14 @@ struct easyav1_t {
 
             /**
              * Structure holding the video decoder thread mutexts
+             *
+             * The position, status, processed frame count and thread commands are shared with the atomic functions
+             * instead, so reading them never waits for a frame to be decoded.
              */
             struct {
                 pthread_mutex_t io;      // The input and output mutex for the decoder thread - used to lock the packets and the video frame display queue
                 pthread_mutex_t decoder; // The decoder mutex for the decoder thread - used to lock the video decoder context
-                pthread_mutex_t info;    // The info mutex for the decoder thread - used to lock all other variables that are accessed by both threads
-                pthread_mutex_t status;  // The status mutex for the decoder thread - used to lock the video decoder status
+                pthread_mutex_t status;  // The status mutex for the decoder thread - used to pause the decoder thread
             } mutexes;
 
             /**
@@ -190,8 +469,51 @@ struct easyav1_t {
                 pthread_cond_t has_changed_status;        // Used to signal when the decoder status has changed
             } conditions;
 
+            /**
+             * The video packets handed to the decoder thread - a lock-free single producer, single consumer ring
+             *
+             * Only the main thread writes packets and only the decoder thread reads them. The mutex is only used
+             * when the decoder thread has run out of packets and must sleep until new ones arrive.
+             */
+            struct {
+                easyav1_packet *packets[VIDEO_DECODE_QUEUE_SIZE]; // The packets waiting to be decoded
+                volatile size_t written;                          // The number of packets written by the main thread
+                volatile size_t read;                             // The number of packets read by the decoder thread
+                volatile size_t consumer_waiting;                 // Whether the decoder thread is waiting for packets
+                easyav1_bool wake_requested;                      // Whether the decoder thread was asked to wake up
+                pthread_mutex_t mutex;                            // Used to sleep while there are no packets to decode
+            } decode_queue;
+
+            /**
+             * The video packets sent to the decoder whose frames haven't been added to the frame queue yet
+             *
+             * The decoder works on several frames at once, so their pictures come out some packets later. They are
+             * matched back to the packets by timestamp and added to the frame queue in order. Only the decoder thread
+             * uses them, except when it's paused.
+             */
+            struct {
+                struct {
+                    easyav1_packet *packet;                       // The packet sent to the decoder
+                    Dav1dPicture picture;                         // The picture decoded from the packet, if any
+                    easyav1_bool done;                            // Whether the decoder is done with the packet
+                } items[VIDEO_DECODE_QUEUE_SIZE];
+                size_t begin;                                     // The index of the oldest packet in flight
+                size_t count;                                     // The number of packets in flight
+            } in_flight;
+
+            /**
+             * The last sequence header found in a keyframe handed to the decoder thread, used to tell whether the
+             * frames the seek doesn't need are referenced by other frames
+             */
+            struct {
+                Dav1dSequenceHeader header;                       // The sequence header
+                easyav1_bool found;                               // Whether a sequence header was found yet
+            } sequence_header;
+
             pthread_t decoder;      // The video decoder thread handle
-            thread_command command; // The current command to give to the video decoder thread
+            volatile size_t command; // The current command to give to the video decoder thread
+            easyav1_bool running;   // Whether the video decoder thread was started
+            easyav1_bool exited;    // Whether the video decoder thread exited, locked by the status mutex
 
         } decoder_thread;
 
@@ -212,15 +534,31 @@ struct easyav1_t {
             vorbis_dsp_state dsp; // DSP data
         } vorbis;
 
+        /**
+         * A copy of the vorbis headers the decoder was set up with, to tell whether another stream can reuse it
+         */
+        struct {
+            uint8_t *data;                      // The headers, one after the other
+            size_t sizes[VORBIS_HEADERS_COUNT]; // The size of each header
+        } headers;
+
         easyav1_bool active;                // Whether the audio decoder is active
         unsigned int track;                 // The track number of the audio in the webm container
 
         unsigned int channels;              // The number of channels in the audio
         unsigned int sample_rate;           // The sample rate of the audio
 
-        float *buffer;                      // The decoded audio buffer
+        void *buffer;                       // The decoded audio ring buffer
+        unsigned int capacity;              // The number of samples per channel the buffer holds
+        unsigned int begin;                 // The position of the oldest sample in the buffer
+        unsigned int queued;                // The number of samples per channel waiting in the buffer
         easyav1_bool has_samples_in_buffer; // Whether the audio buffer has samples in it
 
+        struct {
+            size_t overruns;        // The number of times the samples didn't fit in the buffer
+            size_t dropped_samples; // The number of samples per channel dropped by the overruns
+        } overrun;
+
         easyav1_audio_frame frame;          // The current audio frame data and metadata
 
     } audio;
@@ -239,6 +577,20 @@ struct easyav1_t {
 
         int64_t audio_offset;             // The offset of the audio time in the webm container, in ms
 
+        /**
+         * The packet memory pool - used to reuse the memory of released packets instead of going to the heap
+         */
+        struct {
+            easyav1_pool_block *free_blocks[PACKET_POOL_SIZE_CLASSES]; // The free blocks of each size class
+
+            pthread_mutex_t mutex;     // The pool mutex - used to lock the pool, as packets may be released anywhere
+
+            size_t bytes_in_use;       // The number of bytes currently handed out
+            size_t high_water_bytes;   // The largest number of bytes handed out at the same time
+            size_t bytes_reserved;     // The number of bytes allocated by the pool, including free blocks
+            uint64_t heap_allocations; // The number of allocations that had to go to the heap
+        } pool;
+
     } packets;
 
 
@@ -248,15 +600,151 @@ struct easyav1_t {
     struct {
         void *data;       // Internal data handle
         stream_type type; // The type of stram in use
+        easyav1_bool seekable; // Whether the stream can be seeked, or only read forward
+
+        /**
+         * The forward-only stream - keeps track of the position of a stream that has no seek or tell function
+         */
+        struct {
+            easyav1_stream source; // The stream being read
+            int64_t position;      // The number of bytes read from the stream so far
+        } forward;
+
+        /**
+         * The read-ahead stage - reads the stream in a separate thread, ahead of the demuxer
+         */
+        struct {
+            easyav1_bool active;       // Whether the stream is read through the read-ahead stage
+            easyav1_stream source;     // The stream being read ahead
+
+            uint8_t *buffer;           // The ring buffer holding the data read ahead
+            size_t capacity;           // The size of the ring buffer
+            size_t begin;              // The index of the first byte that wasn't consumed yet
+            size_t filled;             // The number of bytes read ahead that weren't consumed yet
+
+            int64_t position;          // The stream position of the first byte that wasn't consumed yet
+            int64_t size;              // The size of the stream
+
+            int64_t seek_position;     // The position the read-ahead thread must continue reading from
+            easyav1_bool seek_requested; // Whether the read-ahead thread must discard its data and seek
+            easyav1_bool error;        // Whether reading the stream failed after the position
+            easyav1_bool stop;         // Whether the read-ahead thread must exit
+
+            size_t starvations;        // The number of reads that had to wait for the read-ahead thread
+
+            pthread_mutex_t mutex;     // The read-ahead mutex - used to lock all other variables
+            pthread_cond_t has_data;   // Signaled when the read-ahead thread adds data or fails to
+            pthread_cond_t has_space;  // Signaled when data is consumed, or when a seek or a stop is requested
+            pthread_t thread;          // The read-ahead thread handle
+        } read_ahead;
     } stream;
 
 
+    /**
+     * Performance counters - read by `easyav1_get_stats` without taking any lock
+     */
+    struct {
+        size_t packets_read;            // The number of packets read from the stream
+        size_t bytes_read;              // The number of bytes of packet data read from the stream
+        size_t video_queue_depth;       // The number of packets in the video packet queue
+        size_t video_queue_high_water;  // The largest number of packets that were in the video packet queue
+        size_t audio_queue_depth;       // The number of packets in the audio packet queue
+        size_t audio_queue_high_water;  // The largest number of packets that were in the audio packet queue
+
+        size_t dropped_frames;          // The number of decoded frames discarded before being displayed
+        size_t decoded_packets;         // The number of video packets decoded by the video decoder thread
+        size_t decode_us;               // The time spent decoding those packets
+        size_t max_decode_us;           // The longest time spent decoding one of those packets
+        size_t blocked_waits;           // The number of times the decoding thread waited for a video frame
+        size_t blocked_us;              // The time the decoding thread spent waiting for video frames
+
+        size_t seeks;                   // The number of seeks that completed
+        size_t seek_us;                 // The time spent in those seeks
+        size_t max_seek_us;             // The longest time spent in one of those seeks
+        size_t keyframe_search_us;      // The time spent in the seek pass that looks for the keyframe
+        size_t decode_to_target_us;     // The time spent in the seek pass that decodes until the requested timestamp
+        size_t seek_skipped_frames;     // The number of unreferenced frames before a seek target that weren't decoded
+
+        struct {
+            size_t io;                  // The number of times the io mutex was already locked
+            size_t decoder;             // The number of times the decoder mutex was already locked
+        } contentions;
+
+        struct {
+            size_t level;               // The current degradation level
+            size_t lag_ms;              // The last lag measured
+            size_t max_lag_ms;          // The largest lag measured
+            size_t dropped_frames;      // The number of frames dropped without decoding them
+            size_t quality_switches;    // The number of times the video decoder switched quality
+            size_t skips;               // The number of times decoding skipped ahead to a keyframe
+        } degradation;
+
+        struct {
+            uint64_t begin;             // When the instance started initializing, in microseconds
+            easyav1_bool initialized;   // Whether the instance is initialized, so the phases are no longer timed
+            easyav1_bool packet_read;   // Whether the first packet was read
+            easyav1_bool frame_decoded; // Whether the first picture was decoded, only used by the decoder thread
+            easyav1_bool decoded;       // Whether the first call to easyav1_decode_next was timed
+
+            size_t init_us;             // The time spent initializing the instance
+            size_t demuxer_us;          // The time spent reading the webm headers with nestegg_init
+            size_t tracks_us;           // The time spent setting up the tracks, including the decoders
+            size_t audio_headers_us;    // The time spent parsing the Vorbis headers
+            size_t video_decoder_us;    // The time spent opening the AV1 decoder
+            size_t threads_us;          // The time spent creating the read-ahead and video decoder threads
+            size_t cues_us;             // The time spent reading the cues
+            size_t first_packet_us;     // The time spent reading the first packet
+            size_t first_decode_us;     // The time spent in the first call to easyav1_decode_next
+            size_t first_frame_us;      // The time from the start of the initialization to the first picture
+        } startup;
+    } counters;
+
+
+    /**
+     * The degradation state - used to keep up with the requested timestamps when the video decoder is too slow
+     */
+    struct {
+        easyav1_degradation_level level; // The current degradation level
+        easyav1_bool recovering;         // Whether the lag is under the threshold of the current level
+        uint64_t recovering_since;       // When the lag went under the threshold of the current level, in ticks
+        easyav1_bool measured;           // Whether the lag was measured before
+        uint64_t last_measure;           // When the lag was last measured, in ticks
+    } degradation;
+
+
     /**
      * The seeking structure - used to handle seeking in the stream
      */
     struct {
         seeking_mode mode;           // The current seeking mode
         easyav1_timestamp timestamp; // The timestamp to seek to, in ms
+        easyav1_bool position_lost;  // Whether the stream was read elsewhere, so seeking to the position is needed
+
+        /**
+         * The keyframe index - filled in as packets are read, so seeking to indexed parts only reads the data once
+         */
+        struct {
+            easyav1_keyframe *items;        // The indexed keyframes, sorted by timestamp
+            unsigned int count;             // The number of indexed keyframes
+            unsigned int capacity;          // The memory capacity of the index
+
+            easyav1_keyframe_cursor cursor; // The indexing cursor for the packets read for decoding
+
+            pthread_mutex_t mutex;          // The index mutex - used to lock the index and the scan thread state
+
+            /**
+             * The background scan thread, which indexes the whole file using its own reader
+             */
+            struct {
+                pthread_t thread;      // The scan thread handle
+                easyav1_bool running;  // Whether the scan thread was started
+                easyav1_bool stop;     // Signals the scan thread to stop
+                easyav1_bool finished; // Whether the whole file was indexed
+                char *filename;        // The filename to read the file from, if not reading from memory
+                const uint8_t *data;   // The memory buffer to read the file from, if reading from memory
+                size_t size;           // The size of the memory buffer
+            } scan;
+        } index;
     } seek;
 
 
@@ -268,25 +756,37 @@ struct easyav1_t {
         easyav1_bool do_pause; // Signals the playback thread to pause
 
         pthread_mutex_t mutex; // The playback mutex - used to lock the playback state
+        pthread_cond_t wake;   // Wakes the playback thread up early, when a seek or a stop is requested
         pthread_t thread;      // The playback thread handle
 
+        /**
+         * Playback timing, measured by the playback thread and read through `easyav1_get_stats`
+         */
+        struct {
+            size_t wakeups;          // The number of times the playback thread woke up
+            size_t deadlines;        // The number of packet deadlines the playback thread slept until
+            size_t total_jitter_us;  // The sum of how late the playback thread woke up for each deadline
+            size_t max_jitter_us;    // The latest the playback thread woke up for a deadline
+        } timing;
+
         /**
          * Seeking during playback state
          * This is used to request a seek during playback, which will be processed in the playback thread
          */
         struct {
-            easyav1_bool requested;      // Whether a seek is requested
-            easyav1_timestamp timestamp; // The timestamp to seek to, in ms
+            volatile size_t requested;            // Whether a seek is requested
+            volatile easyav1_timestamp timestamp; // The timestamp to seek to, in ms
         } seek;
     } playback;
 
-    easyav1_status status;        // The current status of the easyav1 library
+    volatile easyav1_status status;      // The current status of the easyav1 library
 
-    easyav1_settings settings;    // The easyav1 settings data
+    easyav1_settings settings;           // The easyav1 settings data
 
-    easyav1_timestamp position;   // The current position of the stream, in ms
-    easyav1_timestamp duration;   // The total duration of the stream, in ms
-    easyav1_timestamp time_scale; // The time scale conversion from the internal packet timestamp to ms
+    volatile easyav1_timestamp position; // The current position of the stream, in ms
+    volatile easyav1_timestamp duration; // The total duration of the stream, in ms
+    easyav1_bool duration_is_provisional; // Whether the duration grows with the packets read, as it isn't known
+    easyav1_timestamp time_scale;        // The time scale conversion from the internal packet timestamp to ms
 
 };
 
@@ -301,6 +801,56 @@ typedef struct {
 } easyav1_memory;
 
 
+/**
+ * Video segment - a part of the file starting at a keyframe, decoded on its own by `easyav1_decode_segments`
+ */
+typedef struct {
+    int64_t offset;          // The offset of the cluster the segment starts at, or -1 for the start of the file
+    easyav1_timestamp start; // The timestamp the segment starts at
+    easyav1_timestamp end;   // The timestamp the next segment starts at, or `INVALID_TIMESTAMP` for the last one
+} easyav1_segment;
+
+/**
+ * Segment decoding job - the state shared by the threads of `easyav1_decode_segments`
+ */
+typedef struct {
+    easyav1_t *easyav1;                      // The easyav1 instance the segments are decoded for
+    const easyav1_segment *segments;         // The segments of the file
+    size_t count;                            // The number of segments
+    size_t next;                             // The next segment to be decoded
+    size_t delivering;                       // When the frames are ordered, the segment whose frames are delivered
+    easyav1_bool ordered;                    // Whether the frames are delivered one at a time in timestamp order
+    easyav1_bool failed;                     // Whether a segment failed to decode, which stops the job
+    easyav1_segment_frame_callback callback; // The function to call with each decoded frame
+    void *userdata;                          // The userdata for the callback
+    pthread_mutex_t mutex;                   // Protects the segment counters and the failed flag
+    pthread_cond_t turn_changed;             // Signaled when the segment being delivered changes or the job fails
+} easyav1_segment_job;
+
+/**
+ * Segment decoder - a thread of `easyav1_decode_segments`, with its own webm reader and AV1 decoder
+ */
+typedef struct {
+    easyav1_segment_job *job;    // The job the decoder belongs to
+    pthread_t thread;            // The decoder thread
+    easyav1_memory memory;       // The memory reader state, when the stream is in memory
+    FILE *file;                  // The file the webm reader reads from, when the stream is a file
+    nestegg *webm;               // The webm reader
+    Dav1dContext *decoder;       // The AV1 decoder
+    struct {
+        Dav1dPicture *pictures; // The decoded pictures waiting to be delivered
+        size_t count;           // The number of pictures waiting to be delivered
+        size_t capacity;        // The capacity of the pictures array
+    } pending;                   // The pictures kept until it's the turn of the segment to be delivered
+    easyav1_rgb_buffer rgb;      // The RGB conversion of the frame being delivered
+    easyav1_plane_buffer planes; // The plane conversion of the frame being delivered
+    easyav1_video_frame frame;   // The frame given to the callback
+    uint64_t processed_frames;   // The number of frames the AV1 decoder gave out
+    easyav1_status error;        // Why the decoder stopped, or `EASYAV1_STATUS_OK` if it didn't fail
+    size_t failed_segment;       // The segment the decoder failed on
+} easyav1_segment_decoder;
+
+
 /**
  * Default settings for the easyav1 library - used to set the default values for the easyav1 settings
  */
@@ -319,7 +869,37 @@ static const easyav1_settings DEFAULT_SETTINGS = {
     .audio_track = 0,
     .use_fast_seeking = EASYAV1_FALSE,
     .audio_offset_time = 0,
-    .log_level = EASYAV1_LOG_LEVEL_WARNING
+    .log_level = EASYAV1_LOG_LEVEL_WARNING,
+    .audio_format = EASYAV1_AUDIO_FORMAT_FLOAT,
+    .audio_buffer_samples = 0,
+    .read_ahead_bytes = 0,
+    .index_keyframes_in_background = EASYAV1_FALSE,
+    .video_decoder = {
+        .threads = 0,
+        .max_frame_delay = 0,
+        .prefetch_frames = 0,
+        .prefetch_memory_budget = 0,
+        .rgb_format = EASYAV1_RGB_FORMAT_NONE,
+        .plane_format = EASYAV1_PLANE_FORMAT_NATIVE,
+        .pool = NULL,
+        .picture_allocator = {
+            .allocate = NULL,
+            .release = NULL,
+            .userdata = NULL
+        },
+        .quality = EASYAV1_VIDEO_QUALITY_FULL,
+        .operating_point = 0
+    },
+    .degradation = {
+        .drop_frames_ms = 100,
+        .lower_quality_ms = 300,
+        .skip_ms = 1000,
+        .recover_ms = 2000
+    },
+    .trace = {
+        .callback = NULL,
+        .userdata = NULL
+    }
 };
 
 /**
@@ -460,7 +1040,7 @@ static void log_from_dav1d(void *userdata, const char *format, va_list args)
 #define LOG_AND_SET_ERROR(error_type, message, ...) \
     log(EASYAV1_LOG_LEVEL_ERROR, message, ##__VA_ARGS__); \
     if (easyav1) { \
-        easyav1->status = error_type; \
+        atomic_store_status(&easyav1->status, error_type); \
     } \
 
 
@@ -573,6 +1153,18 @@ static inline int pthread_mutex_lock(pthread_mutex_t *const mutex)
     return 0;
 }
 
+/**
+ * @brief Locks a mutex variable if it isn't locked already.
+ *
+ * @param mutex The mutex to lock.
+ *
+ * @return `0` if the mutex was locked, `1` if it was already locked.
+ */
+static inline int pthread_mutex_trylock(pthread_mutex_t *const mutex)
+{
+    return TryAcquireSRWLockExclusive(mutex) ? 0 : 1;
+}
+
 /**
  * @brief Unlocks a mutex variable.
  *
@@ -637,6 +1229,19 @@ static inline int pthread_cond_signal(pthread_cond_t *const cond)
     return 0;
 }
 
+/**
+ * @brief Signals all the threads waiting on a condition variable.
+ *
+ * @param cond The condition variable to signal.
+ *
+ * @return `0` on success, `1` on error.
+ */
+static inline int pthread_cond_broadcast(pthread_cond_t *const cond)
+{
+    WakeAllConditionVariable(cond);
+    return 0;
+}
+
 #endif // _WIN32
 
 
@@ -655,2608 +1260,9126 @@ long sysconf(int value)
 
 
 /*
- * Time management functions
+ * Atomic functions
+ *
+ * Sequentially consistent loads and stores, used to share values between threads without taking a mutex.
  */
 
-/**
- * @brief Sleeps for a specified number of milliseconds.
- * 
- * @param ms The number of milliseconds to sleep.
- */
-static inline void easyav1_sleep(unsigned int ms)
+#if defined(_MSC_VER) && !defined(__clang__)
+
+static inline size_t atomic_load_size(volatile size_t *value)
 {
-#ifdef _WIN32
-    Sleep(ms);
+#ifdef _WIN64
+    return (size_t) InterlockedCompareExchange64((volatile LONG64 *) value, 0, 0);
 #else
-    struct timespec ts = { 0 };
-    ts.tv_sec = ms / 1000;
-    ts.tv_nsec = (ms % 1000) * 1000000;
-    nanosleep(&ts, NULL);
+    return (size_t) InterlockedCompareExchange((volatile LONG *) value, 0, 0);
 #endif
 }
 
-
-/**
- * @brief Returns the number of milliseconds since this function was first called.
- * 
- * @return The number of milliseconds since this function was first called (`0`on the first call).
- */
-static easyav1_timestamp easyav1_get_ticks(void)
+static inline void atomic_store_size(volatile size_t *value, size_t new_value)
 {
-#ifdef _WIN32
-    static easyav1_timestamp start;
-    if (!start) {
-        start = GetTickCount64();
-    }
-    return GetTickCount64() - start;
+#ifdef _WIN64
+    InterlockedExchange64((volatile LONG64 *) value, (LONG64) new_value);
 #else
-    static struct timespec start;
-    struct timespec now;
-    if (start.tv_sec == 0 && start.tv_nsec == 0) {
-        clock_gettime(CLOCK_MONOTONIC, &start);
-    }
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    InterlockedExchange((volatile LONG *) value, (LONG) new_value);
 #endif
 }
 
+static inline void atomic_add_size(volatile size_t *value, size_t amount)
+{
+#ifdef _WIN64
+    InterlockedExchangeAdd64((volatile LONG64 *) value, (LONG64) amount);
+#else
+    InterlockedExchangeAdd((volatile LONG *) value, (LONG) amount);
+#endif
+}
 
-/*
- * I/O functions
- */
+static inline size_t atomic_exchange_size(volatile size_t *value, size_t new_value)
+{
+#ifdef _WIN64
+    return (size_t) InterlockedExchange64((volatile LONG64 *) value, (LONG64) new_value);
+#else
+    return (size_t) InterlockedExchange((volatile LONG *) value, (LONG) new_value);
+#endif
+}
 
-/**
- * File read function - used to read data from a file
- *
- * @param buf The buffer to read the data into.
- * @param size The size of the data to read.
- * @param userdata The user data to pass to the read function.
- *
- * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
- */
-static int file_read(void *buf, size_t size, void *userdata)
+static inline size_t atomic_decrement_size(volatile size_t *value)
 {
-    FILE *f = (FILE *) userdata;
-    if (!f) {
-        return -1;
-    }
-    size_t r = fread(buf, 1, size, f);
-    if (feof(f)) {
-        return 0;
-    }
-    return r == size ? 1 : -1;
+#ifdef _WIN64
+    return (size_t) InterlockedDecrement64((volatile LONG64 *) value);
+#else
+    return (size_t) InterlockedDecrement((volatile LONG *) value);
+#endif
 }
 
+static inline uint64_t atomic_load_u64(volatile uint64_t *value)
+{
+    return (uint64_t) InterlockedCompareExchange64((volatile LONG64 *) value, 0, 0);
+}
+
+static inline void atomic_store_u64(volatile uint64_t *value, uint64_t new_value)
+{
+    InterlockedExchange64((volatile LONG64 *) value, (LONG64) new_value);
+}
+
+static inline void atomic_add_u64(volatile uint64_t *value, uint64_t amount)
+{
+    InterlockedExchangeAdd64((volatile LONG64 *) value, (LONG64) amount);
+}
+
+static inline easyav1_status atomic_load_status(volatile easyav1_status *value)
+{
+    return (easyav1_status) InterlockedCompareExchange((volatile LONG *) value, 0, 0);
+}
+
+static inline void atomic_store_status(volatile easyav1_status *value, easyav1_status new_value)
+{
+    InterlockedExchange((volatile LONG *) value, (LONG) new_value);
+}
+
+#else
+
+#define atomic_load_size(value) __atomic_load_n(value, __ATOMIC_SEQ_CST)
+#define atomic_store_size(value, new_value) __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST)
+#define atomic_add_size(value, amount) ((void) __atomic_fetch_add(value, amount, __ATOMIC_SEQ_CST))
+#define atomic_exchange_size(value, new_value) __atomic_exchange_n(value, new_value, __ATOMIC_SEQ_CST)
+#define atomic_decrement_size(value) __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST)
+
+#define atomic_load_u64(value) __atomic_load_n(value, __ATOMIC_SEQ_CST)
+#define atomic_store_u64(value, new_value) __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST)
+#define atomic_add_u64(value, amount) ((void) __atomic_fetch_add(value, amount, __ATOMIC_SEQ_CST))
+
+#define atomic_load_status(value) __atomic_load_n(value, __ATOMIC_SEQ_CST)
+#define atomic_store_status(value, new_value) __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST)
+
+#endif
 
 /**
- * File seek function - used to seek to a specific position in a file
- *
- * @param offset The offset to seek to.
- * @param origin The origin to seek from.
- * @param userdata The user data to pass to the seek function.
+ * @brief Raises a value that's only written by one thread to at least the given value.
  *
- * @return 0 on success, -1 on error.
+ * @param value The value to raise.
+ * @param candidate The value it should be at least.
  */
-static int file_seek(int64_t offset, int origin, void *userdata)
+static inline void atomic_store_size_max(volatile size_t *value, size_t candidate)
 {
-    FILE *f = (FILE *) userdata;
-    if (!f) {
-        return -1;
+    if (candidate > atomic_load_size(value)) {
+        atomic_store_size(value, candidate);
     }
-#ifdef _WIN32
-    return _fseeki64(f, offset, origin);
-#else
-    return fseek(f, offset, origin);
-#endif
 }
 
 
+/*
+ * Time management functions
+ */
+
 /**
- * File tell function - used to get the current position in a file
+ * @brief Initializes a condition variable for `easyav1_cond_wait_for`.
  *
- * @param userdata The user data to pass to the tell function.
+ * The timed waits follow the monotonic clock, so changing the wall clock neither stalls them nor ends them early.
  *
- * @return The current position in the file or -1 on error.
+ * @param cond The condition variable to initialize.
+ *
+ * @return `0` on success, an error number otherwise.
  */
-static int64_t file_tell(void *userdata)
+static int easyav1_cond_init_monotonic(pthread_cond_t *cond)
 {
-    FILE *f = (FILE *) userdata;
-    if (!f) {
-        return -1;
-    }
-#ifdef _WIN32
-    return _ftelli64(f);
+#if defined(_WIN32) || defined(__APPLE__)
+    // The timed waits of these systems take a relative time, which doesn't depend on the wall clock
+    return pthread_cond_init(cond, NULL);
 #else
-    return ftell(f);
+    pthread_condattr_t attributes;
+    int result = pthread_condattr_init(&attributes);
+
+    if (result) {
+        return result;
+    }
+
+    result = pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+
+    if (!result) {
+        result = pthread_cond_init(cond, &attributes);
+    }
+
+    pthread_condattr_destroy(&attributes);
+
+    return result;
 #endif
 }
 
-
 /**
- * Memory read function - used to read data from a memory buffer
+ * @brief Waits for a condition variable to be signaled, for at most the given time.
  *
- * @param buf The buffer to read the data into.
- * @param size The size of the data to read.
- * @param userdata The user data to pass to the read function.
+ * Like with `pthread_cond_wait`, the mutex must be locked, and the wait may end early without a signal. The condition
+ * variable must have been initialized with `easyav1_cond_init_monotonic`.
  *
- * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
+ * @param cond The condition variable to wait on.
+ * @param mutex The mutex protecting the condition.
+ * @param us The maximum number of microseconds to wait for.
  */
-static int memory_read(void *buf, size_t size, void *userdata)
+static void easyav1_cond_wait_for(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t us)
 {
-    easyav1_memory *mem = (easyav1_memory *) userdata;
-    if (!mem || !mem->data) {
-        return -1;
-    }
-    int has_more_bytes = 1;
-    size_t max = mem->size - mem->offset;
-    if (size > max) {
-        size = max;
-        has_more_bytes = 0;
-    }
-    if (!size) {
-        return has_more_bytes;
+#if defined(_WIN32)
+    SleepConditionVariableSRW(cond, mutex, (DWORD) ((us + 999) / 1000), 0);
+#elif defined(__APPLE__)
+    struct timespec timeout = { .tv_sec = (time_t) (us / 1000000), .tv_nsec = (long) (us % 1000000) * 1000 };
+
+    pthread_cond_timedwait_relative_np(cond, mutex, &timeout);
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_sec += (time_t) (us / 1000000);
+    deadline.tv_nsec += (long) (us % 1000000) * 1000;
+
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
     }
-    memcpy(buf, mem->data + mem->offset, size);
-    mem->offset += size;
-    return has_more_bytes;
+
+    pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
 }
 
 
 /**
- * Memory seek function - used to seek to a specific position in a memory buffer
+ * @brief Returns the time of a monotonic clock in microseconds, counted from an unspecified starting point.
  *
- * @param offset The offset to seek to.
- * @param origin The origin to seek from.
- * @param userdata The user data to pass to the seek function.
+ * This keeps no state, so it can be called from any thread.
  *
- * @return 0 on success, -1 on error.
+ * @return The current time of the monotonic clock in microseconds.
  */
-static int memory_seek(int64_t offset, int origin, void *userdata)
+static uint64_t easyav1_get_microseconds(void)
 {
-    easyav1_memory *mem = (easyav1_memory *) userdata;
-    if (!mem || !mem->data) {
-        return -1;
-    }
-    if (origin == SEEK_SET) {
-        mem->offset = offset;
-    } else if (origin == SEEK_CUR) {
-        mem->offset += offset;
-    } else if (origin == SEEK_END) {
-        mem->offset = mem->size - offset;
-    }
-    if (mem->offset > mem->size) {
-        mem->offset = mem->size;
-    }
-    return 0;
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    uint64_t counter = (uint64_t) now.QuadPart;
+    return counter / frequency.QuadPart * 1000000 + counter % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+#endif
 }
 
 
 /**
- * Memory tell function - used to get the current position in a memory buffer
+ * @brief Adds the time elapsed since a startup phase began to the counter of that phase.
  *
- * @param userdata The user data to pass to the tell function.
+ * Nothing is added once the instance is initialized, so phases that run again later, such as opening the video
+ * decoder when the settings change, only count while starting up.
  *
- * @return The current position in the memory buffer or -1 on error.
+ * @param easyav1 The easyav1 instance.
+ * @param counter The startup counter of the phase.
+ * @param start When the phase began, from `easyav1_get_microseconds`.
  */
-static int64_t memory_tell(void *userdata)
+static void add_startup_time(easyav1_t *easyav1, size_t *counter, uint64_t start)
 {
-    easyav1_memory *mem = (easyav1_memory *) userdata;
-    if (!mem || !mem->data) {
-        return -1;
+    if (easyav1->counters.startup.initialized == EASYAV1_FALSE) {
+        atomic_add_size(counter, (size_t) (easyav1_get_microseconds() - start));
     }
-    return mem->offset;
 }
 
 
-/*********************************************************************************
- * EasyAV1 decoder functions
- *********************************************************************************/
-
 /**
- * @brief Initializes the requested video and audio tracks.
- *
- * @param easyav1 The easyav1 context to initialize the tracks for.
+ * @brief Returns the time of a monotonic clock in milliseconds, counted from an unspecified starting point.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return The current time of the monotonic clock in milliseconds.
  */
-static easyav1_status init_webm_tracks(easyav1_t *easyav1);
+static easyav1_timestamp easyav1_get_ticks(void)
+{
+    return easyav1_get_microseconds() / 1000;
+}
 
-/**
- * @brief Initializes the requested video track.
- *
- * @param easyav1 The easyav1 context to initialize the video track for.
- * @param track The track number of the video in the webm container.
- *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
- */
-static easyav1_status init_video(easyav1_t *easyav1, unsigned int track);
 
-/**
- * @brief Initializes the requested audio track.
- *
- * @param easyav1 The easyav1 context to initialize the audio track for.
- * @param track The track number of the audio in the webm container.
- *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+/*
+ * System functions
  */
-static easyav1_status init_audio(easyav1_t *easyav1, unsigned int track);
 
 /**
- * @brief Initializes the video decoder thread.
+ * @brief Returns the number of logical processors available, the same way the video decoder counts them.
  *
- * @param easyav1 The easyav1 context to initialize the video decoder thread for.
- *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return The number of logical processors, clamped between `1` and `EASYAV1_MAX_VIDEO_DECODER_THREADS`.
  */
-static easyav1_status init_video_decoder_thread(easyav1_t *easyav1);
+static unsigned int get_logical_processor_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = (long) info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
 
-/**
- * @brief Sets up memory for the audio buffer, taking into account the number of channels and interlacing.
- *
- * @param easyav1 The easyav1 context to prepare the audio buffer for.
- *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
- */
-static easyav1_status prepare_audio_buffer(easyav1_t *easyav1);
+    if (count < 1) {
+        return 1;
+    }
 
-/**
- * @brief Increases the memory capacity of the packet queue to accommodate more packets.
- *
- * @param easyav1 The easyav1 context to increase the packet queue capacity for.
- * @param queue The packet queue to increase the capacity for.
- *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
- */
-static easyav1_status increase_packet_queue_capacity(easyav1_t *easyav1, easyav1_packet_queue *queue);
+    return count > EASYAV1_MAX_VIDEO_DECODER_THREADS ? EASYAV1_MAX_VIDEO_DECODER_THREADS : (unsigned int) count;
+}
 
-/**
- * @brief Provides a new queue slot for a packet.
- *
- * @param easyav1 The easyav1 context to create the packet for.
- * @param queue The packet queue to add the packet to.
- *
- * @return A pointer to the new packet's queue slot or `NULL` on error.
- */
-static easyav1_packet *queue_new_packet(easyav1_t *easyav1, easyav1_packet_queue *queue);
 
 /**
- * @brief Gets the oldest video packet in the queue that hasn't been decoded yet.
- *
- * The packet is not removed from the queue.
- *
- * @param easyav1 The easyav1 context to get the packet from.
- * @param queue The video packet queue.
- *
- * @return A pointer to the oldest video packet in the queue or `NULL` if there are no packets to decode.
+ * Tracing functions
  */
-static easyav1_packet *get_video_packet_to_decode(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+#ifndef EASYAV1_DISABLE_TRACING
+static const char *TRACE_EVENT_NAMES[] = {
+    "packet_read",
+    "video_packet_push",
+    "video_packet_pop",
+    "audio_packet_push",
+    "audio_packet_pop",
+    "decoder_send",
+    "decoder_get",
+    "frame_enqueue",
+    "frame_dequeue",
+    "seek",
+    "seek_keyframe_search",
+    "seek_decode_to_target",
+    "playback_tick",
+    "mutex_wait"
+};
 
 /**
- * @brief Gets the oldest packet from the queue.
- *
- * The packet is not removed from the queue.
- *
- * @param easyav1 The easyav1 context to get the packet from.
- * @param queue The packet queue to get the packet from.
+ * @brief Returns the system identifier of the calling thread, as profilers show it.
  *
- * @return A pointer to the oldest packet in the queue or `NULL` if there are no packets.
+ * @return The identifier of the calling thread.
  */
-static easyav1_packet *retrieve_first_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+static uint64_t get_thread_id(void)
+{
+#if defined(_WIN32)
+    return (uint64_t) GetCurrentThreadId();
+#elif defined(__linux__)
+    return (uint64_t) syscall(SYS_gettid);
+#elif defined(__APPLE__)
+    uint64_t id = 0;
+    pthread_threadid_np(NULL, &id);
+    return id;
+#else
+    return (uint64_t) (uintptr_t) pthread_self();
+#endif
+}
+#endif
 
 /**
- * @brief Gets the most recent packet from the queue.
- *
- * The packet is not removed from the queue.
+ * Reports a trace event to the trace callback of the settings, if there is one.
  *
- * @param easyav1 The easyav1 context to get the packet from.
- * @param queue The packet queue to get the packet from.
+ * Building with `EASYAV1_DISABLE_TRACING` removes every event, including the check for the callback.
  *
- * @return A pointer to the most recent packet in the queue or `NULL` if there are no packets.
+ * @param event The `easyav1_trace_event` to report.
+ * @param phase The `easyav1_trace_phase` of the event.
+ * @param timestamp The stream timestamp the event relates to, in ms.
+ * @param value The value of the event.
  */
-static easyav1_packet *retrieve_last_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+#ifdef EASYAV1_DISABLE_TRACING
+#define trace(event, phase, timestamp, value) \
+((void) sizeof(event), (void) sizeof(phase), (void) sizeof(timestamp), (void) sizeof(value))
+#else
+#define trace(event, phase, timestamp, value) \
+if (easyav1->settings.trace.callback) { \
+    trace_internal(easyav1, event, phase, timestamp, value); \
+}
+#endif
 
+#ifndef EASYAV1_DISABLE_TRACING
 /**
- * @brief Removes the oldest packet from the queue.
+ * Builds a trace record and passes it to the trace callback of the settings.
  *
- * @param easyav1 The easyav1 context to remove the packet from.
- * @param queue The packet queue to remove the packet from.
+ * @param easyav1 The easyav1 instance.
+ * @param event The event to report.
+ * @param phase The phase of the event.
+ * @param timestamp The stream timestamp the event relates to, in ms.
+ * @param value The value of the event.
  */
-static void release_packet_from_queue(easyav1_t *easyav1, easyav1_packet *packet);
+static void trace_internal(const easyav1_t *easyav1, easyav1_trace_event event, easyav1_trace_phase phase,
+    easyav1_timestamp timestamp, int64_t value)
+{
+    easyav1_trace_record record = {
+        .event = event,
+        .phase = phase,
+        .name = TRACE_EVENT_NAMES[event],
+        .time_us = easyav1_get_microseconds(),
+        .thread_id = get_thread_id(),
+        .timestamp = timestamp,
+        .value = value
+    };
+
+    easyav1->settings.trace.callback(&record, easyav1->settings.trace.userdata);
+}
+#endif
 
 /**
- * @brief Removes all packets from the queue.
+ * @brief Locks a mutex, counting and tracing the waits when it was held by another thread at the time.
  *
- * @param easyav1 The easyav1 context to remove the packets from.
- * @param queue The packet queue to remove the packets from.
+ * @param easyav1 The easyav1 instance.
+ * @param mutex The mutex to lock.
+ * @param contentions The number of times the mutex was already locked.
  */
-static void release_packets_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+static inline void lock_mutex(const easyav1_t *easyav1, pthread_mutex_t *mutex, volatile size_t *contentions)
+{
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return;
+    }
+
+    atomic_add_size(contentions, 1);
+
+    trace(EASYAV1_TRACE_MUTEX_WAIT, EASYAV1_TRACE_PHASE_BEGIN, 0,
+        contentions == &easyav1->counters.contentions.io ? 0 : 1);
+
+    pthread_mutex_lock(mutex);
+
+    trace(EASYAV1_TRACE_MUTEX_WAIT, EASYAV1_TRACE_PHASE_END, 0,
+        contentions == &easyav1->counters.contentions.io ? 0 : 1);
+}
+
 
 /**
- * @brief Destroys the packet queue and frees the memory used by it.
- *
- * @param easyav1 The easyav1 context to destroy the packet queue for.
- * @param queue The packet queue to destroy.
+ * Decoder pool functions
  */
-static void destroy_packet_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
 
-/**
- * @brief Fetches a new WebM packet, allocates memory for it, sets its properties and adds it to the respective queue.
- *
- * @param easyav1 The easyav1 context to fetch the packet for.
- *
- * @return A pointer to the new packet or `NULL` on error.
- */
-static easyav1_packet *prepare_new_packet(easyav1_t *easyav1);
+easyav1_pool_settings easyav1_default_pool_settings(void)
+{
+    easyav1_pool_settings settings = {
+        .threads = 0,
+        .max_decoders = 0
+    };
 
-/**
- * @brief Syncs the video and audio packets, feeding the video packet queue for the decoder thread and fetching audio packets
- * to respect the `audio_offset_time` setting.
- *
- * @param easyav1 The easyav1 context to sync the packet queues for.
- *
- * @return `EASYAV1_STATUS_OK` on success `EASYAV1_STATUS_FINISHED` if there are no more pending packets or
- * `EASYAV1_STATUS_ERROR` on error.
- */
-static easyav1_status sync_packet_queues(easyav1_t *easyav1);
+    return settings;
+}
 
-/**
- * @brief Gets the next packet from the video or audio queue, depending on the timestamp of the packet.
- *
- * @param easyav1 The easyav1 context to get the packet from.
- *
- * @return A pointer to the next packet to decode or `NULL` on error or if there are no more packets to fetch.
- */
-static easyav1_packet *get_next_packet(easyav1_t *easyav1);
+easyav1_pool *easyav1_pool_create(const easyav1_pool_settings *settings)
+{
+    easyav1_t *easyav1 = NULL;
 
-/**
- * @brief Adds a decoded video frame to the queue for display.
- *
- * If the queue is full, the oldest decoded frame is removed.
- *
- * @param easyav1 The easyav1 context to add the video frame to.
- * @param pic The decoded video frame to add to the queue.
- */
-static void enqueue_video_frame(easyav1_t *easyav1, Dav1dPicture *pic);
+    easyav1_pool_settings pool_settings = settings ? *settings : easyav1_default_pool_settings();
+
+    if (pool_settings.threads > EASYAV1_MAX_VIDEO_DECODER_THREADS) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested %u pool threads, the maximum is %u.", pool_settings.threads,
+            EASYAV1_MAX_VIDEO_DECODER_THREADS);
+        return NULL;
+    }
+
+    easyav1_pool *pool = calloc(1, sizeof(easyav1_pool));
+
+    if (!pool) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the decoder pool.");
+        return NULL;
+    }
+
+    pool->threads = pool_settings.threads ? pool_settings.threads : get_logical_processor_count();
+    pool->max_decoders = pool_settings.max_decoders ? pool_settings.max_decoders : pool->threads;
+
+    if (pool->max_decoders > pool->threads) {
+        pool->max_decoders = pool->threads;
+    }
+
+    if (pthread_mutex_init(&pool->mutex, NULL)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize decoder pool mutex.");
+        free(pool);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&pool->slot_released, NULL)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize decoder pool condition.");
+        pthread_mutex_destroy(&pool->mutex);
+        free(pool);
+        return NULL;
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Decoder pool created with %u threads for up to %u simultaneous decoders.",
+        pool->threads, pool->max_decoders);
+
+    return pool;
+}
+
+void easyav1_pool_destroy(easyav1_pool **handle)
+{
+    easyav1_t *easyav1 = NULL;
+
+    if (!handle || !*handle) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Pool handle is NULL");
+        return;
+    }
+
+    easyav1_pool *pool = *handle;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    unsigned int members = pool->members;
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    // Freeing the pool would leave the instances that joined it decoding through freed memory
+    if (members > 0) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Can't destroy a decoder pool that %u instances still use.", members);
+        return;
+    }
+
+    pthread_cond_destroy(&pool->slot_released);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool);
+
+    *handle = NULL;
+}
 
 /**
- * @brief Grabs the oldest video frame from the queue.
+ * @brief Makes the video decoder of an instance join a decoder pool.
  *
- * The frame is not removed from the queue.
+ * Each decoder gets an equal share of the pool threads, so that the pool threads are never exceeded while the maximum
+ * number of decoders is decoding.
  *
- * @param easyav1 The easyav1 context to get the video frame from.
+ * @param easyav1 The easyav1 instance.
+ * @param pool The pool to join, or `NULL` to not use a pool.
+ * @param threads The number of threads requested for the video decoder, or `0` for automatic.
  *
- * @return A pointer to the oldest video frame in the queue or `NULL` if there are no frames to display.
+ * @return The number of threads the video decoder should use, or `0` for automatic.
  */
-static Dav1dPicture *get_oldest_video_frame_from_queue(easyav1_t *easyav1);
+static unsigned int join_decoder_pool(easyav1_t *easyav1, easyav1_pool *pool, unsigned int threads)
+{
+    easyav1->video.pool = pool;
 
-/**
- * @brief Removes a video frame from the queue.
- *
- * @param easyav1 The easyav1 context to remove the video frame from.
- */
-static void dequeue_video_frame(easyav1_t *easyav1);
+    if (!pool) {
+        return threads;
+    }
 
-/**
- * @brief Removes all video frames that have been displayed from the queue.
- *
- * @param easyav1 The easyav1 context to remove the video frames from.
- */
-static void dequeue_used_video_frames(easyav1_t *easyav1);
+    pthread_mutex_lock(&pool->mutex);
 
-/**
- * @brief Removes all video frames from the queue.
- *
- * @param easyav1 The easyav1 context to remove the video frames from.
- */
-static void dequeue_all_video_frames(easyav1_t *easyav1);
+    pool->members++;
 
+    pthread_mutex_unlock(&pool->mutex);
+
+    unsigned int share = pool->threads / pool->max_decoders;
+
+    return threads && threads < share ? threads : share;
+}
 
 /**
- * @brief Updates the frame picture type.
+ * @brief Makes the video decoder of an instance leave its decoder pool, if it joined one.
  *
  * @param easyav1 The easyav1 instance.
- * @param frame The video frame to update.
- * @param sqhdr The sequence header to use.
- *
- * @return `EASYAV1_TRUE` if the frame picture type is valid, `EASYAV1_FALSE` otherwise.
  */
-static easyav1_bool update_frame_picture_type(easyav1_t *easyav1, easyav1_video_frame *frame, Dav1dSequenceHeader *sqhdr);
+static void leave_decoder_pool(easyav1_t *easyav1)
+{
+    easyav1_pool *pool = easyav1->video.pool;
+
+    if (!pool) {
+        return;
+    }
 
+    pthread_mutex_lock(&pool->mutex);
 
-/**
- * @brief Calls the video callback function with the decoded video frame data.
- *
- * @param easyav1 The easyav1 context to call the video callback for.
- */
-static void callback_video(easyav1_t *easyav1);
+    pool->members--;
 
-/**
- * @brief Calls the audio callback function with the decoded audio frame data.
- *
- * @param easyav1 The easyav1 context to call the audio callback for.
- */
-static void callback_audio(easyav1_t *easyav1);
+    pthread_mutex_unlock(&pool->mutex);
+
+    easyav1->video.pool = NULL;
+}
 
 /**
- * @brief Video decoder thread function.
+ * @brief Waits until the pool lets one more decoder decode a packet.
  *
- * Processes all video packets in the queue and decodes them.
- * If the queue is empty, it waits for new packets to be added.
- *
- * @param arg The easyav1 context to decode the video packets for.
+ * Slots are handed out in the order they were asked for, so an instance never starves while others keep decoding.
  *
- * @return Always `0`.
+ * @param pool The pool of the video decoder, or `NULL` if there's none.
  */
-static void *video_decoder_thread(void *arg);
+static void acquire_decoder_pool_slot(easyav1_pool *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    size_t ticket = pool->next_ticket++;
+
+    while (ticket != pool->serving_ticket || pool->active_decoders == pool->max_decoders) {
+        pthread_cond_wait(&pool->slot_released, &pool->mutex);
+    }
+
+    pool->serving_ticket++;
+    pool->active_decoders++;
+
+    // The next ticket may get a slot as well
+    pthread_cond_broadcast(&pool->slot_released);
+
+    pthread_mutex_unlock(&pool->mutex);
+}
 
 /**
- * @brief Pauses the video decoder thread.
- *
- * The video decoder thread is guaranteed to pause before processing a new packet from the queue.
+ * @brief Gives back the decode slot taken by `acquire_decoder_pool_slot`.
  *
- * This function blocks until the decoder thread is paused.
- *
- * @param easyav1 The easyav1 context to pause the video decoder for.
+ * @param pool The pool of the video decoder, or `NULL` if there's none.
  */
-static void pause_video_decoder_thread(easyav1_t *easyav1);
+static void release_decoder_pool_slot(easyav1_pool *pool)
+{
+    if (!pool) {
+        return;
+    }
 
-/**
- * @brief Resumes the video decoder thread.
- *
- * @param easyav1 The easyav1 context to resume the video decoder for.
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->active_decoders--;
+    pthread_cond_broadcast(&pool->slot_released);
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+
+/*
+ * I/O functions
  */
-static void resume_video_decoder_thread(easyav1_t *easyav1);
 
 /**
- * @brief Stops the video decoder thread.
- *
- * This function blocks until the decoder thread is stopped (i.e. `video_decoder_thread` returns).
+ * File read function - used to read data from a file
  *
- * @note This function expects the decoder thread to be paused before calling it.
- * Not doing so will result in undefined behavior.
+ * @param buf The buffer to read the data into.
+ * @param size The size of the data to read.
+ * @param userdata The user data to pass to the read function.
  *
- * @param easyav1 The easyav1 context to stop the video decoder for.
+ * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
  */
-static void stop_video_decoder_thread(easyav1_t *easyav1);
+static int file_read(void *buf, size_t size, void *userdata)
+{
+    FILE *f = (FILE *) userdata;
+    if (!f) {
+        return -1;
+    }
+    size_t r = fread(buf, 1, size, f);
+    if (feof(f)) {
+        return 0;
+    }
+    return r == size ? 1 : -1;
+}
+
 
 /**
- * @brief Handles a command sent to the video decoder thread.
+ * File seek function - used to seek to a specific position in a file
  *
- * The command is set by locking the `status` mutex and setting the `command` variable.
- * It is then processed by the decoder thread at the convenient time.
- * The command is reset to `THREAD_COMMAND_NONE` after processing a pause.
+ * @param offset The offset to seek to.
+ * @param origin The origin to seek from.
+ * @param userdata The user data to pass to the seek function.
  *
- * @param easyav1 The easyav1 context to handle the command for.
+ * @return 0 on success, -1 on error.
  */
-static thread_command handle_video_decoder_thread_command(easyav1_t *easyav1);
+static int file_seek(int64_t offset, int origin, void *userdata)
+{
+    FILE *f = (FILE *) userdata;
+    if (!f) {
+        return -1;
+    }
+#ifdef _WIN32
+    return _fseeki64(f, offset, origin);
+#else
+    return fseek(f, offset, origin);
+#endif
+}
+
 
 /**
- * @brief Callback function that seeks for a sequence header.
- *
- * This function is only called when the decoder is seeking for a sequence header and it runs from the main thread.
- * If a sequence header is found, the decoder is set to the `SEEKING_FOR_KEYFRAME` state.
+ * File tell function - used to get the current position in a file
  *
- * @param easyav1 The easyav1 context to seek for the sequence header for.
- * @param packet The packet to seek for the sequence header in.
- * @param data The packet data to seek for the sequence header in.
- * @param size The size of the data to seek for the sequence header in.
+ * @param userdata The user data to pass to the tell function.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return The current position in the file or -1 on error.
  */
-static easyav1_status seek_sequence_header(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size);
+static int64_t file_tell(void *userdata)
+{
+    FILE *f = (FILE *) userdata;
+    if (!f) {
+        return -1;
+    }
+#ifdef _WIN32
+    return _ftelli64(f);
+#else
+    return ftell(f);
+#endif
+}
+
 
 /**
- * @brief Video decoder function.
- *
- * Decodes the video packet data and adds it to the video frame queue.
- * This function always runs on the video decoder thread.
+ * Memory read function - used to read data from a memory buffer
  *
- * @param easyav1 The easyav1 context to decode the video packet for.
- * @param packet The packet to decode.
- * @param pic The `Dav1dPicture` to decode the video packet into.
+ * @param buf The buffer to read the data into.
+ * @param size The size of the data to read.
+ * @param userdata The user data to pass to the read function.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
  */
-static easyav1_status decode_video(easyav1_t *easyav1, easyav1_packet *packet, Dav1dPicture *pic);
-
-/**
- * @brief Audio decoder function.
- *
- * Decodes the audio packet data and adds it to audio buffer.
+static int memory_read(void *buf, size_t size, void *userdata)
+{
+    easyav1_memory *mem = (easyav1_memory *) userdata;
+    if (!mem || !mem->data) {
+        return -1;
+    }
+    int has_more_bytes = 1;
+    size_t max = mem->size - mem->offset;
+    if (size > max) {
+        size = max;
+        has_more_bytes = 0;
+    }
+    if (!size) {
+        return has_more_bytes;
+    }
+    memcpy(buf, mem->data + mem->offset, size);
+    mem->offset += size;
+    return has_more_bytes;
+}
+
+
+/**
+ * Memory seek function - used to seek to a specific position in a memory buffer
  *
- * @param easyav1 The easyav1 context to decode the audio packet for.
- * @param packet The packet to decode.
- * @param data The packet data to decode.
- * @param size The size of the data to decode.
+ * @param offset The offset to seek to.
+ * @param origin The origin to seek from.
+ * @param userdata The user data to pass to the seek function.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return 0 on success, -1 on error.
  */
-static easyav1_status decode_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size);
+static int memory_seek(int64_t offset, int origin, void *userdata)
+{
+    easyav1_memory *mem = (easyav1_memory *) userdata;
+    if (!mem || !mem->data) {
+        return -1;
+    }
+    if (origin == SEEK_SET) {
+        mem->offset = offset;
+    } else if (origin == SEEK_CUR) {
+        mem->offset += offset;
+    } else if (origin == SEEK_END) {
+        mem->offset = mem->size - offset;
+    }
+    if (mem->offset > mem->size) {
+        mem->offset = mem->size;
+    }
+    return 0;
+}
+
 
 /**
- * @brief Prepares the audio to store the new decoded samples.
- *
- * If the amount of decoded samples is larger than the free buffer space, existing samples are "shifted left" in the
- * buffer, with the oldest samples being removed.
+ * Memory tell function - used to get the current position in a memory buffer
  *
- * @param easyav1 The easyav1 context to prepare the audio buffer for.
- * @param decoded_samples The number of decoded samples that will be added to the buffer.
+ * @param userdata The user data to pass to the tell function.
  *
- * @return The first offset in the decoded audio samples which can be added to the buffer.
+ * @return The current position in the memory buffer or -1 on error.
  */
-static unsigned int prepare_audio_buffer_for_new_samples(easyav1_t *easyav1, int decoded_samples);
+static int64_t memory_tell(void *userdata)
+{
+    easyav1_memory *mem = (easyav1_memory *) userdata;
+    if (!mem || !mem->data) {
+        return -1;
+    }
+    return mem->offset;
+}
+
 
 /**
- * @brief Sends the packet data to the decoder function.
+ * Forward read function - used to read from a stream that can only be read forward, keeping track of its position
  *
- * This function gets the actual data from the WebM container and decodes it.
- *
- * @param easyav1 The easyav1 context to send the packet data to.
- * @param packet The packet to send the data from.
- * @param decode The decoder callback to send the data to.
+ * @param buf The buffer to read the data into.
+ * @param size The size of the data to read.
+ * @param userdata The easyav1 instance.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
  */
-static easyav1_status send_packet_data_to_decoder(easyav1_t *easyav1, easyav1_packet *packet, decoder_function decode);
+static int forward_read(void *buf, size_t size, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+    const easyav1_stream *source = &easyav1->stream.forward.source;
+
+    int result = source->read_func(buf, size, source->userdata);
+
+    if (result == 1) {
+        easyav1->stream.forward.position += size;
+    }
+
+    return result;
+}
+
 
 /**
- * @brief Requests the decoding of a single packet.
+ * Forward seek function - used to skip ahead in a stream that can only be read forward
  *
- * For audio packets, the packet data is passed to the vorbis decoder and decoded immediately.
- * For video packets, if not seeking or seeking for the correct timestamp, the function checks if the decoder thread has
- * already decoded the packet. If not, the function waits for the packet to be decoded. If seeking for a sequence header
- * or a keyframe, the function does the checks on the main thread.
+ * Skipping is done by reading and discarding the data, so seeking backward or from the end of the stream fails.
  *
- * @param easyav1 The easyav1 context to decode the packet for.
- * @param packet The packet to decode.
+ * @param offset The offset to seek to.
+ * @param origin The origin to seek from.
+ * @param userdata The easyav1 instance.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return 0 on success, -1 on error.
  */
-static easyav1_status decode_packet(easyav1_t *easyav1, easyav1_packet *packet);
+static int forward_seek(int64_t offset, int origin, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    if (origin == SEEK_SET) {
+        offset -= easyav1->stream.forward.position;
+    } else if (origin != SEEK_CUR) {
+        return -1;
+    }
+
+    if (offset < 0) {
+        return -1;
+    }
+
+    uint8_t discarded[4096];
+
+    while (offset > 0) {
+        size_t size = offset > (int64_t) sizeof(discarded) ? sizeof(discarded) : (size_t) offset;
+
+        if (forward_read(discarded, size, easyav1) != 1) {
+            return -1;
+        }
+
+        offset -= size;
+    }
+
+    return 0;
+}
 
-/**
- * @brief Decodes packets until the given timestamp is reached.
- *
- * @param easyav1 The easyav1 context to decode packets for.
- * @param timestamp The timestamp to decode packets until.
- * @return easyav1_status `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
- */
-static easyav1_status do_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp);
 
 /**
- * @brief Gets the closest cue point before the given timestamp.
+ * Forward tell function - used to get the current position in a stream that can only be read forward
  *
- * @param easyav1 The easyav1 context to get the cue point for.
- * @param timestamp The timestamp to get the cue point for.
+ * @param userdata The easyav1 instance.
  *
- * @return The closest cue point to the given timestamp. If there are no cue points, `0` is returned.
+ * @return The number of bytes read from the stream so far.
  */
-static easyav1_timestamp get_closest_cue_point(const easyav1_t *easyav1, easyav1_timestamp timestamp);
+static int64_t forward_tell(void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    return easyav1->stream.forward.position;
+}
+
 
 /**
- * @brief Seeks to the given timestamp in the WebM file.
- *
- * This function seeks to the closest cue point before the given timestamp and then seeks to the exact timestamp.
- * If the timestamp is before the first cue point, it seeks to the beginning of the file.
+ * Maps a file to memory as read-only
  *
- * @param easyav1 The easyav1 context to seek in.
- * @param timestamp The timestamp to seek to.
+ * @param filename The name of the file to map.
+ * @param size Pointer that receives the size of the mapped file.
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @return A pointer to the mapped file data or `NULL` on error or if memory mapping is not supported.
  */
-static easyav1_status do_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp);
+static void *map_file(const char *filename, size_t *size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 || (uint64_t) file_size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    // The mapping keeps its own reference to the file, and the view keeps its own reference to the mapping
+    CloseHandle(file);
+
+    if (!mapping) {
+        return NULL;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    CloseHandle(mapping);
+
+    if (!data) {
+        return NULL;
+    }
+
+    *size = (size_t) file_size.QuadPart;
+
+    return data;
+#elif defined(EASYAV1_HAS_MMAP)
+    int fd = open(filename, O_RDONLY);
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat file_info;
+
+    if (fstat(fd, &file_info) || file_info.st_size <= 0 || (uint64_t) file_info.st_size > SIZE_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, (size_t) file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping remains valid after closing the file descriptor
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+#ifdef POSIX_MADV_SEQUENTIAL
+    posix_madvise(data, (size_t) file_info.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    *size = (size_t) file_info.st_size;
+
+    return data;
+#else
+    return NULL;
+#endif
+}
+
 
 /**
- * @brief Changes the current video or audio track to the given track ID.
- *
- * @param easyav1 The easyav1 context to change the track for.
- * @param type The type of the track to change to (video or audio).
- * @param track_id The ID of the track to change to.
+ * Unmaps a file previously mapped with `map_file`
  *
- * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ * @param data The mapped file data.
+ * @param size The size of the mapped file.
  */
-static easyav1_status change_track(easyav1_t *easyav1, easyav1_packet_type type, unsigned int track_id);
+static void unmap_file(void *data, size_t size)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#elif defined(EASYAV1_HAS_MMAP)
+    munmap(data, size);
+#endif
+}
 
-/**
- * @brief Destroys the video decoder context and thread and frees the memory used by it.
- *
- * @param easyav1 The easyav1 context to destroy the video decoder for.
+
+/*
+ * Read-ahead functions
  */
-static void destroy_video(easyav1_t *easyav1);
 
 /**
- * @brief Destroys the audio decoder context and frees the memory used by it.
+ * @brief The thread function that reads the stream ahead of the demuxer.
  *
- * @param easyav1 The easyav1 context to destroy the audio decoder for.
+ * The source stream is only accessed by this thread while the read-ahead stage is active.
+ *
+ * @param arg The easyav1 instance.
+ *
+ * @return Always `0`.
  */
-static void destroy_audio(easyav1_t *easyav1);
+static void *read_ahead_thread(void *arg)
+{
+    easyav1_t *easyav1 = (easyav1_t *) arg;
 
+    int64_t read_position = easyav1->stream.read_ahead.position;
 
-/**
- * Initialization functions
- */
+    pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
 
-static easyav1_status init_webm_tracks(easyav1_t *easyav1)
-{
-    if (nestegg_track_count(easyav1->webm.context, &easyav1->webm.num_tracks)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track count");
-        return EASYAV1_STATUS_ERROR;
-    }
+    while (easyav1->stream.read_ahead.stop == EASYAV1_FALSE) {
 
-    easyav1->webm.video_tracks = 0;
-    easyav1->webm.audio_tracks = 0;
+        if (easyav1->stream.read_ahead.seek_requested == EASYAV1_TRUE) {
+            easyav1->stream.read_ahead.seek_requested = EASYAV1_FALSE;
+            read_position = easyav1->stream.read_ahead.seek_position;
 
-    easyav1_bool has_video_track = EASYAV1_FALSE;
-    easyav1_bool has_audio_track = EASYAV1_FALSE;
+            pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
 
-    unsigned int video_track;
-    unsigned int audio_track;
+            int result = easyav1->stream.read_ahead.source.seek_func(read_position, SEEK_SET,
+                easyav1->stream.read_ahead.source.userdata);
 
-    for (unsigned int track = 0; track < easyav1->webm.num_tracks; track++) {
+            pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
 
-        int type = nestegg_track_type(easyav1->webm.context, track);
+            if (result) {
+                easyav1->stream.read_ahead.error = EASYAV1_TRUE;
+                pthread_cond_signal(&easyav1->stream.read_ahead.has_data);
+            }
 
-        if (type == -1) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track type.");
-            return EASYAV1_STATUS_ERROR;
+            continue;
         }
 
-        if (type == NESTEGG_TRACK_UNKNOWN) {
-            log(EASYAV1_LOG_LEVEL_WARNING, "Unknown track type found, ignoring.");
+        size_t capacity = easyav1->stream.read_ahead.capacity;
+        size_t space = capacity - easyav1->stream.read_ahead.filled;
+        size_t remaining = (size_t) (easyav1->stream.read_ahead.size - read_position);
+        size_t wanted = READ_AHEAD_CHUNK_SIZE < capacity / 4 ? READ_AHEAD_CHUNK_SIZE : capacity / 4;
+
+        if (wanted > remaining) {
+            wanted = remaining;
+        }
+
+        // Wait until there's a worthwhile amount of space, so that the stream isn't read in tiny pieces
+        if (easyav1->stream.read_ahead.error == EASYAV1_TRUE || remaining == 0 || space == 0 || space < wanted) {
+            pthread_cond_wait(&easyav1->stream.read_ahead.has_space, &easyav1->stream.read_ahead.mutex);
             continue;
         }
 
-        int codec = nestegg_track_codec_id(easyav1->webm.context, track);
+        size_t write_index = (easyav1->stream.read_ahead.begin + easyav1->stream.read_ahead.filled) % capacity;
+        size_t size = capacity - write_index < space ? capacity - write_index : space;
 
-        if (codec == -1) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get codec for track %u.", track);
-            return EASYAV1_STATUS_ERROR;
+        if (size > READ_AHEAD_CHUNK_SIZE) {
+            size = READ_AHEAD_CHUNK_SIZE;
         }
 
-        if (type == NESTEGG_TRACK_VIDEO) {
+        if (size > remaining) {
+            size = remaining;
+        }
 
-            // Video already found or disabled - skip
-            if (easyav1->settings.enable_video == EASYAV1_FALSE || has_video_track == EASYAV1_TRUE ||
-                easyav1->webm.video_tracks != easyav1->settings.video_track) {
-                easyav1->webm.video_tracks++;
-                continue;
-            }
+        // The consumer never touches the bytes past the filled ones, so they can be written without the lock
+        pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
 
-            log(EASYAV1_LOG_LEVEL_INFO, "Found requested video track %u at webm track %u.",
-                easyav1->webm.video_tracks, track);
+        int result = easyav1->stream.read_ahead.source.read_func(easyav1->stream.read_ahead.buffer + write_index, size,
+            easyav1->stream.read_ahead.source.userdata);
 
-            easyav1->webm.video_tracks++;
+        pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
 
-            if (codec != NESTEGG_CODEC_AV1) {
-                log(EASYAV1_LOG_LEVEL_WARNING,
-                    "Unsupported video codec found. Only AV1 codec is supported. Not displaying video.");
-                continue;
-            }
+        // The data is stale if the consumer seeked away while it was being read
+        if (easyav1->stream.read_ahead.seek_requested == EASYAV1_TRUE) {
+            continue;
+        }
+
+        // The size of the stream is known, so reaching its end while reading the last bytes is fine too
+        if (result == 1 || (result == 0 && size == remaining)) {
+            easyav1->stream.read_ahead.filled += size;
+            read_position += (int64_t) size;
+        } else {
+            easyav1->stream.read_ahead.error = EASYAV1_TRUE;
+        }
+
+        pthread_cond_signal(&easyav1->stream.read_ahead.has_data);
+    }
+
+    pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+
+    return 0;
+}
+
+/**
+ * @brief Read function for the demuxer when the read-ahead stage is active.
+ *
+ * @param buf The buffer to read the data into.
+ * @param size The size of the data to read.
+ * @param userdata The easyav1 instance.
+ *
+ * @return 1 if read was successful, 0 if the end of file was reached or -1 on error.
+ */
+static int read_ahead_read(void *buf, size_t size, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+    uint8_t *destination = buf;
+    easyav1_bool starved = EASYAV1_FALSE;
+    int result = 1;
+
+    pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
+
+    while (size > 0) {
+        size_t filled = easyav1->stream.read_ahead.filled;
+
+        if (filled == 0) {
+            if (easyav1->stream.read_ahead.position >= easyav1->stream.read_ahead.size) {
+                result = 0;
+                break;
+            }
+
+            if (easyav1->stream.read_ahead.error == EASYAV1_TRUE) {
+                result = -1;
+                break;
+            }
+
+            if (starved == EASYAV1_FALSE) {
+                starved = EASYAV1_TRUE;
+                atomic_store_size(&easyav1->stream.read_ahead.starvations,
+                    easyav1->stream.read_ahead.starvations + 1);
+            }
+
+            pthread_cond_wait(&easyav1->stream.read_ahead.has_data, &easyav1->stream.read_ahead.mutex);
+            continue;
+        }
+
+        size_t begin = easyav1->stream.read_ahead.begin;
+        size_t contiguous = easyav1->stream.read_ahead.capacity - begin;
+        size_t count = size < filled ? size : filled;
+
+        if (count > contiguous) {
+            count = contiguous;
+        }
+
+        memcpy(destination, easyav1->stream.read_ahead.buffer + begin, count);
+
+        easyav1->stream.read_ahead.begin = (begin + count) % easyav1->stream.read_ahead.capacity;
+        easyav1->stream.read_ahead.filled = filled - count;
+        easyav1->stream.read_ahead.position += (int64_t) count;
+
+        destination += count;
+        size -= count;
+    }
+
+    pthread_cond_signal(&easyav1->stream.read_ahead.has_space);
+
+    pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+
+    return result;
+}
+
+/**
+ * @brief Seek function for the demuxer when the read-ahead stage is active.
+ *
+ * Seeking forward within the data read ahead just skips it, anything else makes the read-ahead thread start over.
+ *
+ * @param offset The offset to seek to.
+ * @param origin The origin to seek from.
+ * @param userdata The easyav1 instance.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int read_ahead_seek(int64_t offset, int origin, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
+
+    int64_t position = easyav1->stream.read_ahead.position;
+    int64_t target = offset;
+
+    if (origin == SEEK_CUR) {
+        target = position + offset;
+    } else if (origin == SEEK_END) {
+        target = easyav1->stream.read_ahead.size + offset;
+    }
+
+    if (target < 0 || target > easyav1->stream.read_ahead.size) {
+        pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+        return -1;
+    }
+
+    if (target >= position && target - position <= (int64_t) easyav1->stream.read_ahead.filled) {
+        size_t skipped = (size_t) (target - position);
+
+        easyav1->stream.read_ahead.begin = (easyav1->stream.read_ahead.begin + skipped) %
+            easyav1->stream.read_ahead.capacity;
+        easyav1->stream.read_ahead.filled -= skipped;
+    } else {
+        easyav1->stream.read_ahead.begin = 0;
+        easyav1->stream.read_ahead.filled = 0;
+        easyav1->stream.read_ahead.error = EASYAV1_FALSE;
+        easyav1->stream.read_ahead.seek_position = target;
+        easyav1->stream.read_ahead.seek_requested = EASYAV1_TRUE;
+    }
+
+    easyav1->stream.read_ahead.position = target;
+
+    pthread_cond_signal(&easyav1->stream.read_ahead.has_space);
+
+    pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+
+    return 0;
+}
+
+/**
+ * @brief Tell function for the demuxer when the read-ahead stage is active.
+ *
+ * @param userdata The easyav1 instance.
+ *
+ * @return The position of the demuxer in the stream.
+ */
+static int64_t read_ahead_tell(void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
+
+    int64_t position = easyav1->stream.read_ahead.position;
+
+    pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+
+    return position;
+}
+
+/**
+ * @brief Starts reading a stream ahead of the demuxer in a separate thread.
+ *
+ * The stream must report its size through its seek and tell functions, otherwise it's read directly.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param source The stream to read ahead.
+ *
+ * @return `EASYAV1_STATUS_OK` if the read-ahead stage started or isn't supported by the stream,
+ *         `EASYAV1_STATUS_ERROR` otherwise.
+ */
+static easyav1_status start_read_ahead(easyav1_t *easyav1, const easyav1_stream *source)
+{
+    int64_t position = source->tell_func(source->userdata);
+    int64_t size = -1;
+
+    if (position >= 0 && source->seek_func(0, SEEK_END, source->userdata) == 0) {
+        size = source->tell_func(source->userdata);
+
+        if (source->seek_func(position, SEEK_SET, source->userdata)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_IO_ERROR, "Failed to seek back to the start of the stream.");
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    if (size < position) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The size of the stream is unknown, reading it without read-ahead.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    easyav1->stream.read_ahead.buffer = malloc(easyav1->settings.read_ahead_bytes);
+
+    if (!easyav1->stream.read_ahead.buffer) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the read-ahead buffer.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->stream.read_ahead.source = *source;
+    easyav1->stream.read_ahead.capacity = easyav1->settings.read_ahead_bytes;
+    easyav1->stream.read_ahead.begin = 0;
+    easyav1->stream.read_ahead.filled = 0;
+    easyav1->stream.read_ahead.position = position;
+    easyav1->stream.read_ahead.size = size;
+
+    // The instance may have read another stream ahead before being reopened
+    easyav1->stream.read_ahead.seek_requested = EASYAV1_FALSE;
+    easyav1->stream.read_ahead.error = EASYAV1_FALSE;
+    easyav1->stream.read_ahead.stop = EASYAV1_FALSE;
+
+    if (pthread_mutex_init(&easyav1->stream.read_ahead.mutex, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to create the read-ahead mutex.");
+        free(easyav1->stream.read_ahead.buffer);
+        easyav1->stream.read_ahead.buffer = NULL;
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (pthread_cond_init(&easyav1->stream.read_ahead.has_data, NULL) ||
+        pthread_cond_init(&easyav1->stream.read_ahead.has_space, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to create the read-ahead conditions.");
+        pthread_mutex_destroy(&easyav1->stream.read_ahead.mutex);
+        free(easyav1->stream.read_ahead.buffer);
+        easyav1->stream.read_ahead.buffer = NULL;
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    uint64_t thread_start = easyav1_get_microseconds();
+
+    if (pthread_create(&easyav1->stream.read_ahead.thread, NULL, read_ahead_thread, easyav1)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to create the read-ahead thread.");
+        pthread_cond_destroy(&easyav1->stream.read_ahead.has_space);
+        pthread_cond_destroy(&easyav1->stream.read_ahead.has_data);
+        pthread_mutex_destroy(&easyav1->stream.read_ahead.mutex);
+        free(easyav1->stream.read_ahead.buffer);
+        easyav1->stream.read_ahead.buffer = NULL;
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.threads_us, thread_start);
+
+    easyav1->stream.read_ahead.active = EASYAV1_TRUE;
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Reading the stream up to %zu bytes ahead.", easyav1->stream.read_ahead.capacity);
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * @brief Stops the read-ahead thread and releases its buffer, if the read-ahead stage is active.
+ *
+ * @param easyav1 The easyav1 instance.
+ */
+static void stop_read_ahead(easyav1_t *easyav1)
+{
+    if (easyav1->stream.read_ahead.active == EASYAV1_FALSE) {
+        return;
+    }
+
+    pthread_mutex_lock(&easyav1->stream.read_ahead.mutex);
+
+    easyav1->stream.read_ahead.stop = EASYAV1_TRUE;
+    pthread_cond_signal(&easyav1->stream.read_ahead.has_space);
+
+    pthread_mutex_unlock(&easyav1->stream.read_ahead.mutex);
+
+    pthread_join(easyav1->stream.read_ahead.thread, NULL);
+
+    pthread_cond_destroy(&easyav1->stream.read_ahead.has_space);
+    pthread_cond_destroy(&easyav1->stream.read_ahead.has_data);
+    pthread_mutex_destroy(&easyav1->stream.read_ahead.mutex);
+
+    free(easyav1->stream.read_ahead.buffer);
+    easyav1->stream.read_ahead.buffer = NULL;
+
+    easyav1->stream.read_ahead.active = EASYAV1_FALSE;
+}
+
+
+/*********************************************************************************
+ * EasyAV1 decoder functions
+ *********************************************************************************/
+
+/**
+ * @brief Checks whether the provided settings are valid.
+ *
+ * @param easyav1 The easyav1 context the settings are meant for. Only used for logging.
+ * @param settings The settings to validate.
+ *
+ * @return `EASYAV1_TRUE` if the settings are valid, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool validate_settings(const easyav1_t *easyav1, const easyav1_settings *settings);
+
+/**
+ * @brief Initializes the requested video and audio tracks.
+ *
+ * @param easyav1 The easyav1 context to initialize the tracks for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status init_webm_tracks(easyav1_t *easyav1);
+
+/**
+ * @brief Finds the requested video and audio tracks that easyav1 can decode.
+ *
+ * @param easyav1 The easyav1 context to find the tracks for.
+ * @param has_video_track Pointer that receives whether a video track was found.
+ * @param video_track Pointer that receives the track number of the video in the webm container, if found.
+ * @param has_audio_track Pointer that receives whether an audio track was found.
+ * @param audio_track Pointer that receives the track number of the audio in the webm container, if found.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status find_webm_tracks(easyav1_t *easyav1, easyav1_bool *has_video_track, unsigned int *video_track,
+    easyav1_bool *has_audio_track, unsigned int *audio_track);
+
+/**
+ * @brief Sets up the requested video and audio tracks of a new stream, reusing the decoders already initialized.
+ *
+ * The video decoder is reused as is, while the audio decoder is only reused if the vorbis headers are the same.
+ *
+ * @param easyav1 The easyav1 context to set up the tracks for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status reopen_webm_tracks(easyav1_t *easyav1);
+
+/**
+ * @brief Initializes the requested video track.
+ *
+ * @param easyav1 The easyav1 context to initialize the video track for.
+ * @param track The track number of the video in the webm container.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status init_video(easyav1_t *easyav1, unsigned int track);
+
+/**
+ * @brief Reads the size and frame rate of a video track and sizes the video prefetch depth for it.
+ *
+ * @param easyav1 The easyav1 context to set the video track for.
+ * @param track The track number of the video in the webm container.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status set_video_track(easyav1_t *easyav1, unsigned int track);
+
+/**
+ * @brief Opens the AV1 decoder of the video track, at the quality the degradation level allows.
+ *
+ * @param easyav1 The easyav1 context to open the video decoder for.
+ * @param threads The number of threads for the decoder, or `0` for one per logical processor.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status open_video_decoder(easyav1_t *easyav1, int threads);
+
+/**
+ * @brief Sets the quality and operating point options of an AV1 decoder.
+ *
+ * @param easyav1 The easyav1 context, for the operating point.
+ * @param quality The quality to decode at.
+ * @param dav1d_settings The AV1 decoder settings to update.
+ */
+static void set_decoder_quality(const easyav1_t *easyav1, easyav1_video_quality quality,
+    Dav1dSettings *dav1d_settings);
+
+/**
+ * @brief Sets the number of video frames to decode ahead of the current position.
+ *
+ * The depth is the requested `prefetch_frames`, lowered if needed so that the decoded frames held by easyav1 fit in
+ * the `prefetch_memory_budget`. It is never lower than one frame.
+ *
+ * @param easyav1 The easyav1 context to set the prefetch depth for.
+ * @param frame_size The size in bytes of a decoded video frame.
+ */
+static void update_video_prefetch_depth(easyav1_t *easyav1, size_t frame_size);
+
+/**
+ * @brief Updates the video prefetch depth from the real frame size, once the first sequence header is found.
+ *
+ * This is only needed when a prefetch memory budget is set.
+ *
+ * @param easyav1 The easyav1 context to update the prefetch depth for.
+ * @param packet The video keyframe packet that may hold the sequence header.
+ */
+static void size_video_prefetch_from_packet(easyav1_t *easyav1, nestegg_packet *packet);
+
+/**
+ * @brief Initializes the requested audio track.
+ *
+ * @param easyav1 The easyav1 context to initialize the audio track for.
+ * @param track The track number of the audio in the webm container.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status init_audio(easyav1_t *easyav1, unsigned int track);
+
+/**
+ * @brief Checks whether the vorbis headers of an audio track are the ones the audio decoder was set up with.
+ *
+ * @param easyav1 The easyav1 context with the audio decoder.
+ * @param track The track number of the audio in the webm container.
+ *
+ * @return `EASYAV1_TRUE` if the headers are the same, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool audio_headers_match(easyav1_t *easyav1, unsigned int track);
+
+/**
+ * @brief Initializes the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context to initialize the video decoder thread for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status init_video_decoder_thread(easyav1_t *easyav1);
+
+/**
+ * @brief Sets up memory for the audio buffer, taking into account the number of channels and interlacing.
+ *
+ * @param easyav1 The easyav1 context to prepare the audio buffer for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status prepare_audio_buffer(easyav1_t *easyav1);
+
+/**
+ * @brief Gets the size of each audio sample in the audio buffer, which depends on the audio format.
+ *
+ * @param easyav1 The easyav1 context.
+ *
+ * @return The size of an audio sample, in bytes.
+ */
+static size_t audio_sample_size(const easyav1_t *easyav1);
+
+
+/**
+ * @brief Increases the memory capacity of the packet queue to accommodate more packets.
+ *
+ * @param easyav1 The easyav1 context to increase the packet queue capacity for.
+ * @param queue The packet queue to increase the capacity for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status increase_packet_queue_capacity(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Provides a new queue slot for a packet.
+ *
+ * @param easyav1 The easyav1 context to create the packet for.
+ * @param queue The packet queue to add the packet to.
+ *
+ * @return A pointer to the new packet's queue slot or `NULL` on error.
+ */
+static easyav1_packet *queue_new_packet(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Hands the video packets that should be decoded next to the video decoder thread.
+ *
+ * Packets are handed off in queue order, as long as less than the prefetch depth of packets ahead of the current
+ * position were already handed off and there's room in the decode queue.
+ *
+ * @param easyav1 The easyav1 context to hand the video packets off for.
+ */
+static void hand_off_video_packets(easyav1_t *easyav1);
+
+/**
+ * @brief Gets the oldest packet from the queue.
+ *
+ * The packet is not removed from the queue.
+ *
+ * @param easyav1 The easyav1 context to get the packet from.
+ * @param queue The packet queue to get the packet from.
+ *
+ * @return A pointer to the oldest packet in the queue or `NULL` if there are no packets.
+ */
+static easyav1_packet *retrieve_first_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Gets the most recent packet from the queue.
+ *
+ * The packet is not removed from the queue.
+ *
+ * @param easyav1 The easyav1 context to get the packet from.
+ * @param queue The packet queue to get the packet from.
+ *
+ * @return A pointer to the most recent packet in the queue or `NULL` if there are no packets.
+ */
+static easyav1_packet *retrieve_last_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Removes the oldest packet from the queue.
+ *
+ * @param easyav1 The easyav1 context to remove the packet from.
+ * @param queue The packet queue to remove the packet from.
+ */
+static void release_packet_from_queue(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Removes all packets from the queue.
+ *
+ * @param easyav1 The easyav1 context to remove the packets from.
+ * @param queue The packet queue to remove the packets from.
+ */
+static void release_packets_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Destroys the packet queue and frees the memory used by it.
+ *
+ * @param easyav1 The easyav1 context to destroy the packet queue for.
+ * @param queue The packet queue to destroy.
+ */
+static void destroy_packet_queue(easyav1_t *easyav1, easyav1_packet_queue *queue);
+
+/**
+ * @brief Allocates memory for webm packet data from the packet pool.
+ *
+ * Blocks are rounded up to a power of two size class. Released blocks are kept to be reused by later packets, so once
+ * the pool has grown to the working set of the stream, reading packets no longer allocates heap memory.
+ *
+ * @param size The number of bytes to allocate.
+ * @param userdata The easyav1 context.
+ *
+ * @return A pointer to the allocated memory or `NULL` on error.
+ */
+static void *packet_pool_alloc(size_t size, void *userdata);
+
+/**
+ * @brief Returns memory allocated with `packet_pool_alloc` to the packet pool.
+ *
+ * @param ptr The memory to release.
+ * @param userdata The easyav1 context.
+ */
+static void packet_pool_free(void *ptr, void *userdata);
+
+/**
+ * @brief Frees all the memory held by the packet pool.
+ *
+ * @param easyav1 The easyav1 context to destroy the packet pool of.
+ */
+static void destroy_packet_pool(easyav1_t *easyav1);
+
+/**
+ * @brief Sets the format and the plane layout of a picture buffer, following the requirements of the video decoder.
+ *
+ * @param buffer The picture buffer to set the layout of.
+ * @param params The parameters of the picture to allocate.
+ */
+static void set_picture_buffer_layout(easyav1_picture_buffer *buffer, const Dav1dPictureParameters *params);
+
+/**
+ * @brief Allocates the buffer of a picture for the video decoder.
+ *
+ * The buffer comes from the picture allocator in the settings or, if there is none, from the picture pool.
+ * This may run on any of the video decoder threads.
+ *
+ * @param pic The picture to allocate the buffer for.
+ * @param cookie The easyav1 context.
+ *
+ * @return `0` on success, a negative `DAV1D_ERR` value on error.
+ */
+static int allocate_picture(Dav1dPicture *pic, void *cookie);
+
+/**
+ * @brief Releases the buffer of a picture that was allocated with `allocate_picture`.
+ *
+ * @param pic The picture to release the buffer of.
+ * @param cookie The easyav1 context.
+ */
+static void release_picture(Dav1dPicture *pic, void *cookie);
+
+/**
+ * @brief Frees all the buffers held by the picture pool.
+ *
+ * @note The video decoder must be closed, so that no picture is using the pool.
+ *
+ * @param easyav1 The easyav1 context to destroy the picture pool of.
+ */
+static void destroy_picture_pool(easyav1_t *easyav1);
+
+/**
+ * @brief Fetches a new WebM packet, allocates memory for it, sets its properties and adds it to the respective queue.
+ *
+ * @param easyav1 The easyav1 context to fetch the packet for.
+ *
+ * @return A pointer to the new packet or `NULL` on error.
+ */
+static easyav1_packet *prepare_new_packet(easyav1_t *easyav1);
+
+/**
+ * @brief Syncs the video and audio packets, feeding the video packet queue for the decoder thread and fetching audio packets
+ * to respect the `audio_offset_time` setting.
+ *
+ * @param easyav1 The easyav1 context to sync the packet queues for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success `EASYAV1_STATUS_FINISHED` if there are no more pending packets or
+ * `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status sync_packet_queues(easyav1_t *easyav1);
+
+/**
+ * @brief Gets the next packet from the video or audio queue, depending on the timestamp of the packet.
+ *
+ * @param easyav1 The easyav1 context to get the packet from.
+ *
+ * @return A pointer to the next packet to decode or `NULL` on error or if there are no more packets to fetch.
+ */
+static easyav1_packet *get_next_packet(easyav1_t *easyav1);
+
+/**
+ * @brief Adds a decoded video frame to the queue for display.
+ *
+ * If the queue is full, the oldest decoded frame is removed.
+ *
+ * @param easyav1 The easyav1 context to add the video frame to.
+ * @param pic The decoded video frame to add to the queue.
+ */
+static void enqueue_video_frame(easyav1_t *easyav1, Dav1dPicture *pic);
+
+/**
+ * @brief Grabs the oldest video frame from the queue.
+ *
+ * The frame is not removed from the queue.
+ *
+ * @param easyav1 The easyav1 context to get the video frame from.
+ *
+ * @return A pointer to the oldest video frame in the queue or `NULL` if there are no frames to display.
+ */
+static Dav1dPicture *get_oldest_video_frame_from_queue(easyav1_t *easyav1);
+
+/**
+ * @brief Removes a video frame from the queue.
+ *
+ * @param easyav1 The easyav1 context to remove the video frame from.
+ */
+static void dequeue_video_frame(easyav1_t *easyav1);
+
+/**
+ * @brief Removes all video frames that have been displayed from the queue.
+ *
+ * @param easyav1 The easyav1 context to remove the video frames from.
+ */
+static void dequeue_used_video_frames(easyav1_t *easyav1);
+
+/**
+ * @brief Removes all video frames from the queue.
+ *
+ * @param easyav1 The easyav1 context to remove the video frames from.
+ */
+static void dequeue_all_video_frames(easyav1_t *easyav1);
+
+
+/**
+ * @brief Fills the output video frame from the picture being displayed.
+ *
+ * @param easyav1 The easyav1 context to prepare the video frame for.
+ *
+ * @return The video frame, or `NULL` if the picture format is not supported.
+ */
+static const easyav1_video_frame *prepare_video_frame(easyav1_t *easyav1);
+
+/**
+ * @brief Stops displaying the current picture.
+ *
+ * If the picture was acquired by the application, the held frame takes it over instead of it being released.
+ *
+ * @param easyav1 The easyav1 context.
+ */
+static void release_displayed_picture(easyav1_t *easyav1);
+
+/**
+ * @brief Drops a reference to a held frame, releasing its picture and RGB conversion when it was the last one.
+ *
+ * @param held The held frame.
+ */
+static void release_held_frame(easyav1_held_frame *held);
+
+/**
+ * @brief Converts a decoded picture to RGB into the given buffer, growing the buffer if needed.
+ *
+ * This runs on the video decoder thread, so it only uses the picture and its sequence header.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param pic The picture to convert.
+ * @param buffer The buffer to convert the picture into.
+ */
+static void convert_picture_to_rgb_buffer(easyav1_t *easyav1, const Dav1dPicture *pic, easyav1_rgb_buffer *buffer);
+
+/**
+ * @brief Converts the YUV planes of a picture to the plane format of the video decoder.
+ *
+ * This runs on the video decoder thread, so it only uses the picture. The buffer is left unfilled when the picture
+ * can be given as it is, which is the case for 8-bit pictures when dithering.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param pic The picture to convert.
+ * @param buffer The buffer to convert the picture into.
+ */
+static void convert_picture_to_plane_buffer(easyav1_t *easyav1, const Dav1dPicture *pic,
+    easyav1_plane_buffer *buffer);
+
+
+/**
+ * @brief Sets the plane pointers, strides, size, buffer and timestamp of a video frame from a picture.
+ *
+ * @param easyav1 The easyav1 context the picture was decoded by.
+ * @param frame The video frame to fill.
+ * @param pic The picture to use.
+ */
+static void set_frame_picture_data(const easyav1_t *easyav1, easyav1_video_frame *frame, const Dav1dPicture *pic);
+
+/**
+ * @brief Points the planes of a video frame to their conversion, or to the picture if they weren't converted.
+ *
+ * This is called after `set_frame_picture_data`, and also sets the properties that depend on the plane format.
+ *
+ * @param frame The video frame to update.
+ * @param pic The picture of the frame.
+ * @param buffer The plane conversion of the picture, or NULL if there is none.
+ */
+static void set_frame_plane_data(easyav1_video_frame *frame, const Dav1dPicture *pic,
+    const easyav1_plane_buffer *buffer);
+
+/**
+ * @brief Updates the frame picture type.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param frame The video frame to update.
+ * @param sqhdr The sequence header to use.
+ *
+ * @return `EASYAV1_TRUE` if the frame picture type is valid, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool update_frame_picture_type(easyav1_t *easyav1, easyav1_video_frame *frame, Dav1dSequenceHeader *sqhdr);
+
+/**
+ * @brief Sets the frame picture type from a sequence header.
+ *
+ * Unlike `update_frame_picture_type`, this doesn't cache the sequence header, so it can be used from any thread.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param frame The video frame to update.
+ * @param sqhdr The sequence header to use.
+ *
+ * @return `EASYAV1_TRUE` if the frame picture type is valid, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool set_frame_picture_type(const easyav1_t *easyav1, easyav1_video_frame *frame,
+    const Dav1dSequenceHeader *sqhdr);
+
+
+/**
+ * @brief Calls the video callback function with the decoded video frame data.
+ *
+ * @param easyav1 The easyav1 context to call the video callback for.
+ */
+static void callback_video(easyav1_t *easyav1);
+
+/**
+ * @brief Calls the audio callback function with the decoded audio frame data.
+ *
+ * @param easyav1 The easyav1 context to call the audio callback for.
+ */
+static void callback_audio(easyav1_t *easyav1);
+
+/**
+ * @brief Video decoder thread function.
+ *
+ * Processes all video packets in the queue and decodes them.
+ * If the queue is empty, it waits for new packets to be added.
+ *
+ * @param arg The easyav1 context to decode the video packets for.
+ *
+ * @return Always `0`.
+ */
+static void *video_decoder_thread(void *arg);
+
+/**
+ * @brief Pauses the video decoder thread.
+ *
+ * The video decoder thread is guaranteed to pause before processing a new packet from the queue.
+ *
+ * This function blocks until the decoder thread is paused.
+ *
+ * @param easyav1 The easyav1 context to pause the video decoder for.
+ */
+static void pause_video_decoder_thread(easyav1_t *easyav1);
+
+/**
+ * @brief Resumes the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context to resume the video decoder for.
+ */
+static void resume_video_decoder_thread(easyav1_t *easyav1);
+
+/**
+ * @brief Stops the video decoder thread.
+ *
+ * This function blocks until the decoder thread is stopped (i.e. `video_decoder_thread` returns).
+ *
+ * @note This function expects the decoder thread to be paused before calling it.
+ * Not doing so will result in undefined behavior.
+ *
+ * @param easyav1 The easyav1 context to stop the video decoder for.
+ */
+static void stop_video_decoder_thread(easyav1_t *easyav1);
+
+/**
+ * @brief Handles a command sent to the video decoder thread.
+ *
+ * The command is set by locking the `status` mutex and setting the `command` variable.
+ * It is then processed by the decoder thread at the convenient time.
+ * The command is reset to `THREAD_COMMAND_NONE` after processing a pause.
+ *
+ * @param easyav1 The easyav1 context to handle the command for.
+ */
+static thread_command handle_video_decoder_thread_command(easyav1_t *easyav1);
+
+/**
+ * @brief Adds a video packet to the decode queue of the video decoder thread.
+ *
+ * This is only called from the main thread and doesn't lock any mutex, unless the decoder thread is sleeping and
+ * needs to be woken up.
+ *
+ * @param easyav1 The easyav1 context to add the packet for.
+ * @param packet The video packet to decode.
+ *
+ * @return `EASYAV1_TRUE` if the packet was added, `EASYAV1_FALSE` if the decode queue is full.
+ */
+static easyav1_bool push_video_packet_to_decoder(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Takes the next video packet from the decode queue.
+ *
+ * This is only called from the video decoder thread and doesn't lock any mutex.
+ *
+ * @param easyav1 The easyav1 context to take the packet from.
+ *
+ * @return The next video packet to decode or `NULL` if the decode queue is empty.
+ */
+static easyav1_packet *pop_video_packet_to_decode(easyav1_t *easyav1);
+
+/**
+ * @brief Makes the video decoder thread sleep until there are packets to decode or it is asked to wake up.
+ *
+ * @param easyav1 The easyav1 context to wait for packets for.
+ */
+static void wait_for_video_packets(easyav1_t *easyav1);
+
+/**
+ * @brief Wakes up the video decoder thread if it is waiting for packets, so that it checks its command.
+ *
+ * @param easyav1 The easyav1 context to wake the video decoder thread for.
+ */
+static void wake_video_decoder_thread(easyav1_t *easyav1);
+
+/**
+ * @brief Empties the decode queue of the video decoder thread.
+ *
+ * @note The video decoder thread must be paused or stopped when calling this function.
+ *
+ * @param easyav1 The easyav1 context to empty the decode queue for.
+ */
+static void reset_video_decode_queue(easyav1_t *easyav1);
+
+/**
+ * @brief Callback function that seeks for a sequence header.
+ *
+ * This function is only called when the decoder is seeking for a sequence header and it runs from the main thread.
+ * If a sequence header is found, the decoder is set to the `SEEKING_FOR_KEYFRAME` state.
+ *
+ * @param easyav1 The easyav1 context to seek for the sequence header for.
+ * @param packet The packet to seek for the sequence header in.
+ * @param data The packet data to seek for the sequence header in.
+ * @param size The size of the data to seek for the sequence header in.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status seek_sequence_header(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size);
+
+/**
+ * @brief Video decoder function.
+ *
+ * Decodes the video packet data with the given AV1 decoder and waits for its picture. The state of the instance is
+ * left alone, so the callers decide what an error and the decoded frames count for.
+ *
+ * @param easyav1 The easyav1 context to decode the video packet for.
+ * @param context The AV1 decoder to use, which is `video.context` unless decoding segments in parallel.
+ * @param packet The packet to decode.
+ * @param pic The `Dav1dPicture` to decode the video packet into.
+ * @param processed_frames The counter to add the pictures the decoder gave out to.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status decode_video(easyav1_t *easyav1, Dav1dContext *context, easyav1_packet *packet,
+    Dav1dPicture *pic, uint64_t *processed_frames);
+
+/**
+ * @brief Sends a video packet to the decoder without waiting for its picture.
+ *
+ * The packet is added to the packets in flight, and any pictures the decoder finished in the meantime are collected.
+ * This function always runs on the video decoder thread, with the decoder mutex locked.
+ *
+ * @param easyav1 The easyav1 context to decode the video packet for.
+ * @param packet The packet to send to the decoder.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status send_video_packet_to_decoder(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Collects a finished picture from the video decoder and matches it to its packet in flight.
+ *
+ * @param easyav1 The easyav1 context to collect the picture for.
+ * @param drain Whether to wait for the oldest frame in flight if no picture is ready. When there are no more frames
+ *        to wait for, all the packets in flight are done.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status collect_video_picture(easyav1_t *easyav1, easyav1_bool drain);
+
+/**
+ * @brief Reads up to 32 bits from a bit reader, most significant bit first.
+ *
+ * Reading past the end of the data returns zero bits and sets the `overrun` flag.
+ *
+ * @param reader The bit reader to read from.
+ * @param bits The number of bits to read.
+ *
+ * @return The value of the bits read.
+ */
+static uint32_t read_bits(easyav1_bit_reader *reader, unsigned int bits);
+
+/**
+ * @brief Reads an unsigned variable length LEB128 value, as used by the AV1 OBU sizes.
+ *
+ * @param reader The bit reader to read from, which must be at a byte boundary.
+ *
+ * @return The value read.
+ */
+static uint64_t read_leb128(easyav1_bit_reader *reader);
+
+/**
+ * @brief Indicates whether an AV1 frame header belongs to a frame that no other frame references.
+ *
+ * The frame header is only parsed up to its `refresh_frame_flags`, following the AV1 specification.
+ *
+ * @param sequence_header The sequence header the frame header depends on.
+ * @param reader The bit reader, at the start of the frame header.
+ * @param temporal_id The temporal layer of the frame, from the OBU extension header.
+ * @param spatial_id The spatial layer of the frame, from the OBU extension header.
+ *
+ * @return `EASYAV1_TRUE` if the frame doesn't refresh any reference frame, `EASYAV1_FALSE` if it does or if this can't
+ *         be told.
+ */
+static easyav1_bool is_unreferenced_frame_header(const Dav1dSequenceHeader *sequence_header,
+    easyav1_bit_reader *reader, unsigned int temporal_id, unsigned int spatial_id);
+
+/**
+ * @brief Indicates whether skipping a video packet doesn't change how any other packet decodes.
+ *
+ * Every frame header in the packet is checked against the last sequence header found by the video decoder thread.
+ * When in doubt, such as for packets with a sequence header, packets that can't be parsed or frames shown again from
+ * the reference frames, the packet is assumed to be referenced. This always runs on the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param packet The video packet to check.
+ *
+ * @return `EASYAV1_TRUE` if no other frame references the frames in the packet, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool is_unreferenced_video_packet(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Keeps a copy of the sequence header of a keyframe packet for `is_unreferenced_video_packet`.
+ *
+ * This always runs on the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param packet The keyframe packet about to be sent to the decoder.
+ */
+static void update_decoder_thread_sequence_header(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Sets a video packet as done without sending it to the decoder, as its picture is never needed.
+ *
+ * The packet still goes through the packets in flight, so the packets are set as decoded in order.
+ * This always runs on the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param packet The packet to skip.
+ */
+static void skip_video_packet(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Adds the frames of the oldest packets in flight that the decoder is done with to the video frame queue.
+ *
+ * @param easyav1 The easyav1 context to add the frames for.
+ */
+static void queue_decoded_video_frames(easyav1_t *easyav1);
+
+/**
+ * @brief Audio decoder function.
+ *
+ * Decodes the audio packet data and adds it to audio buffer.
+ *
+ * @param easyav1 The easyav1 context to decode the audio packet for.
+ * @param packet The packet to decode.
+ * @param data The packet data to decode.
+ * @param size The size of the data to decode.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status decode_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size);
+
+/**
+ * @brief Passes audio data to the vorbis decoder, leaving the decoded samples in the decoder to be read out.
+ *
+ * @param easyav1 The easyav1 context to decode the audio for.
+ * @param packet The packet the data belongs to, whose timestamp is logged if the data can't be decoded.
+ * @param data The audio data.
+ * @param size The size of the audio data.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status synthesize_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size);
+
+/**
+ * @brief Moves the samples waiting in the audio ring buffer to a buffer given by the application.
+ *
+ * @param easyav1 The easyav1 context to read the samples from.
+ * @param output The buffer to move the samples to.
+ * @param capacity The number of samples per channel the buffer holds.
+ *
+ * @return The number of samples per channel moved.
+ */
+static size_t read_queued_audio_samples(easyav1_t *easyav1, void *output, size_t capacity);
+
+/**
+ * @brief Adds decoded audio samples to the audio ring buffer.
+ *
+ * @param easyav1 The easyav1 context to add the samples to.
+ * @param pcm The decoded samples of each channel.
+ * @param decoded_samples The number of decoded samples per channel.
+ */
+static void queue_audio_samples(easyav1_t *easyav1, float **pcm, unsigned int decoded_samples);
+
+/**
+ * @brief Prepares the audio ring buffer to store the new decoded samples.
+ *
+ * If the amount of decoded samples is larger than the free buffer space, the oldest samples are dropped and the
+ * overrun is counted in the statistics.
+ *
+ * @param easyav1 The easyav1 context to prepare the audio buffer for.
+ * @param decoded_samples The number of decoded samples that will be added to the buffer.
+ *
+ * @return The first offset in the decoded audio samples which can be added to the buffer.
+ */
+static unsigned int prepare_audio_buffer_for_new_samples(easyav1_t *easyav1, int decoded_samples);
+
+/**
+ * @brief Sends the packet data to the decoder function.
+ *
+ * This function gets the actual data from the WebM container and decodes it.
+ *
+ * @param easyav1 The easyav1 context to send the packet data to.
+ * @param packet The packet to send the data from.
+ * @param decode The decoder callback to send the data to.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status send_packet_data_to_decoder(easyav1_t *easyav1, easyav1_packet *packet, decoder_function decode);
+
+/**
+ * @brief Requests the decoding of a single packet.
+ *
+ * For audio packets, the packet data is passed to the vorbis decoder and decoded immediately.
+ * For video packets, if not seeking or seeking for the correct timestamp, the function checks if the decoder thread has
+ * already decoded the packet. If not, the function waits for the packet to be decoded. If seeking for a sequence header
+ * or a keyframe, the function does the checks on the main thread.
+ *
+ * @param easyav1 The easyav1 context to decode the packet for.
+ * @param packet The packet to decode.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status decode_packet(easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Gets the quality the video decoder should decode at, given the current degradation level.
+ *
+ * @param easyav1 The easyav1 context.
+ *
+ * @return `EASYAV1_VIDEO_QUALITY_PREVIEW` when the degradation level lowers the quality, the requested quality
+ *         otherwise.
+ */
+static easyav1_video_quality get_degraded_video_quality(const easyav1_t *easyav1);
+
+/**
+ * @brief Updates the degradation level from the lag measured when decoding until a timestamp.
+ *
+ * The lag never counts more than the real time since it was last measured, so that a caller jumping ahead doesn't
+ * look like a decoder falling behind. The level goes up as soon as the lag goes over the threshold of a higher level,
+ * and goes down one level at a time once the lag stays under the threshold of the current level for `recover_ms`.
+ *
+ * @param easyav1 The easyav1 context to update the degradation level for.
+ * @param lag How late the oldest packet still to be decoded is, in milliseconds.
+ */
+static void update_degradation_level(easyav1_t *easyav1, easyav1_timestamp lag);
+
+/**
+ * @brief Indicates whether the video decoder should switch quality when it gets to the given packet.
+ *
+ * The quality can only be switched at a keyframe with a sequence header, as the decoder is opened again from
+ * scratch. The packets before it are held back from the decoder thread until then.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param packet The video packet that would be handed to the video decoder thread next.
+ *
+ * @return `EASYAV1_TRUE` if the quality should be switched before decoding the packet, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool must_switch_video_decoder_quality(const easyav1_t *easyav1, easyav1_packet *packet);
+
+/**
+ * @brief Opens the video decoder again at the quality the degradation level allows.
+ *
+ * This must only be called when no video packet is handed to the video decoder thread.
+ *
+ * @param easyav1 The easyav1 context to switch the video decoder quality for.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status switch_video_decoder_quality(easyav1_t *easyav1);
+
+/**
+ * @brief Decodes packets until the given timestamp is reached.
+ *
+ * @param easyav1 The easyav1 context to decode packets for.
+ * @param timestamp The timestamp to decode packets until.
+ * @return easyav1_status `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status do_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp);
+
+/**
+ * @brief Gets the closest cue point before the given timestamp.
+ *
+ * @param easyav1 The easyav1 context to get the cue point for.
+ * @param timestamp The timestamp to get the cue point for.
+ *
+ * @return The closest cue point to the given timestamp. If there are no cue points, `0` is returned.
+ */
+static easyav1_timestamp get_closest_cue_point(const easyav1_t *easyav1, easyav1_timestamp timestamp);
+
+/**
+ * @brief Builds the cue index from the cue points in the WebM file.
+ *
+ * If the file has no cues or they can't be read, the index is left empty and seeking starts from the beginning.
+ *
+ * @param easyav1 The easyav1 context to build the cue index for.
+ */
+static void init_cue_index(easyav1_t *easyav1);
+
+/**
+ * @brief Loads the cue index and the keyframe index from an index saved by `easyav1_save_index`.
+ *
+ * Nothing is loaded unless the index is valid and was saved for a stream with the same duration, time scale and
+ * tracks.
+ *
+ * @param easyav1 The easyav1 context to load the index for.
+ * @param data The saved index.
+ * @param size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the index was loaded, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+static easyav1_status load_index(easyav1_t *easyav1, const uint8_t *data, size_t size);
+
+/**
+ * @brief Adds a keyframe from a packet to the keyframe index, if decoding can start from it.
+ *
+ * Only keyframes that carry a sequence header are indexed, as those are the only ones the decoder can start from.
+ *
+ * @param easyav1 The easyav1 context to index the keyframe for.
+ * @param context The webm context the packet was read from.
+ * @param packet The keyframe packet.
+ * @param timestamp The timestamp of the packet, in ms.
+ * @param cursor The cursor of the sequential read the packet belongs to.
+ */
+static void index_keyframe(easyav1_t *easyav1, nestegg *context, nestegg_packet *packet, easyav1_timestamp timestamp,
+    easyav1_keyframe_cursor *cursor);
+
+/**
+ * @brief Marks the last keyframe of a sequential read as the last keyframe of the stream.
+ *
+ * @param easyav1 The easyav1 context to update the keyframe index of.
+ * @param cursor The cursor of the sequential read that reached the end of the stream.
+ */
+static void finish_keyframe_index(easyav1_t *easyav1, const easyav1_keyframe_cursor *cursor);
+
+/**
+ * @brief Starts the background keyframe scan thread, if enabled and supported by the stream.
+ *
+ * @param easyav1 The easyav1 context to start the keyframe scan for.
+ */
+static void start_keyframe_scan(easyav1_t *easyav1);
+
+/**
+ * @brief Stops the background keyframe scan thread, if running.
+ *
+ * @param easyav1 The easyav1 context to stop the keyframe scan for.
+ */
+static void stop_keyframe_scan(easyav1_t *easyav1);
+
+/**
+ * @brief Stops the background keyframe scan and clears the keyframe index.
+ *
+ * @param easyav1 The easyav1 context to reset the keyframe index of.
+ */
+static void reset_keyframe_index(easyav1_t *easyav1);
+
+/**
+ * @brief Seeks to the given timestamp in the WebM file.
+ *
+ * This function seeks to the closest cue point before the given timestamp and then seeks to the exact timestamp.
+ * If the timestamp is before the first cue point, it seeks to the beginning of the file.
+ *
+ * @param easyav1 The easyav1 context to seek in.
+ * @param timestamp The timestamp to seek to.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status do_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp);
+
+/**
+ * @brief Changes the current video or audio track to the given track ID.
+ *
+ * @param easyav1 The easyav1 context to change the track for.
+ * @param type The type of the track to change to (video or audio).
+ * @param track_id The ID of the track to change to.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status change_track(easyav1_t *easyav1, easyav1_packet_type type, unsigned int track_id);
+
+/**
+ * @brief Destroys the video decoder context and thread and frees the memory used by it.
+ *
+ * @param easyav1 The easyav1 context to destroy the video decoder for.
+ */
+static void destroy_video(easyav1_t *easyav1);
+
+/**
+ * @brief Destroys the audio decoder context and frees the memory used by it.
+ *
+ * @param easyav1 The easyav1 context to destroy the audio decoder for.
+ */
+static void destroy_audio(easyav1_t *easyav1);
+
+/**
+ * @brief Closes the webm context of the current stream, along with the stream itself if the instance owns it.
+ *
+ * The cue index and the stream information used by the keyframe scan are released as well.
+ *
+ * @param easyav1 The easyav1 context to close the stream of.
+ */
+static void close_webm_stream(easyav1_t *easyav1);
+
+
+/**
+ * Initialization functions
+ */
+
+static easyav1_status find_webm_tracks(easyav1_t *easyav1, easyav1_bool *has_video_track, unsigned int *video_track,
+    easyav1_bool *has_audio_track, unsigned int *audio_track)
+{
+    if (nestegg_track_count(easyav1->webm.context, &easyav1->webm.num_tracks)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track count");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->webm.video_tracks = 0;
+    easyav1->webm.audio_tracks = 0;
+
+    *has_video_track = EASYAV1_FALSE;
+    *has_audio_track = EASYAV1_FALSE;
+
+    for (unsigned int track = 0; track < easyav1->webm.num_tracks; track++) {
+
+        int type = nestegg_track_type(easyav1->webm.context, track);
+
+        if (type == -1) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track type.");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (type == NESTEGG_TRACK_UNKNOWN) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Unknown track type found, ignoring.");
+            continue;
+        }
+
+        int codec = nestegg_track_codec_id(easyav1->webm.context, track);
+
+        if (codec == -1) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get codec for track %u.", track);
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (type == NESTEGG_TRACK_VIDEO) {
+
+            // Video already found or disabled - skip
+            if (easyav1->settings.enable_video == EASYAV1_FALSE || *has_video_track == EASYAV1_TRUE ||
+                easyav1->webm.video_tracks != easyav1->settings.video_track) {
+                easyav1->webm.video_tracks++;
+                continue;
+            }
+
+            log(EASYAV1_LOG_LEVEL_INFO, "Found requested video track %u at webm track %u.",
+                easyav1->webm.video_tracks, track);
+
+            easyav1->webm.video_tracks++;
+
+            if (codec != NESTEGG_CODEC_AV1) {
+                log(EASYAV1_LOG_LEVEL_WARNING,
+                    "Unsupported video codec found. Only AV1 codec is supported. Not displaying video.");
+                continue;
+            }
+
+            *has_video_track = EASYAV1_TRUE;
+            *video_track = track;
+        }
+
+        if (type == NESTEGG_TRACK_AUDIO) {
+
+            // Audio already found or disabled - skip
+            if (easyav1->settings.enable_audio == EASYAV1_FALSE || *has_audio_track == EASYAV1_TRUE ||
+                easyav1->webm.audio_tracks != easyav1->settings.audio_track) {
+                easyav1->webm.audio_tracks++;
+                continue;
+            }
+
+            log(EASYAV1_LOG_LEVEL_INFO, "Found requested audio track %u at webm track %u.",
+                easyav1->webm.audio_tracks, track);
+
+            easyav1->webm.audio_tracks++;
+
+            if (codec != NESTEGG_CODEC_VORBIS) {
+                log(EASYAV1_LOG_LEVEL_WARNING,
+                    "Unsupported audio codec found. Only vorbis codec is supported. Not playing audio.");
+                continue;
+            }
+
+            *has_audio_track = EASYAV1_TRUE;
+            *audio_track = track;
+        }
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Total video tracks: %u", easyav1->webm.video_tracks);
+    log(EASYAV1_LOG_LEVEL_INFO, "Total audio tracks: %u", easyav1->webm.audio_tracks);
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status init_webm_tracks(easyav1_t *easyav1)
+{
+    easyav1_bool has_video_track;
+    easyav1_bool has_audio_track;
+
+    unsigned int video_track;
+    unsigned int audio_track;
+
+    if (find_webm_tracks(easyav1, &has_video_track, &video_track, &has_audio_track, &audio_track) ==
+        EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (has_video_track == EASYAV1_TRUE) {
+        if (init_video(easyav1, video_track) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    if (has_audio_track == EASYAV1_TRUE) {
+        if (init_audio(easyav1, audio_track) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status reopen_webm_tracks(easyav1_t *easyav1)
+{
+    easyav1_bool has_video_track;
+    easyav1_bool has_audio_track;
+
+    unsigned int video_track;
+    unsigned int audio_track;
+
+    if (find_webm_tracks(easyav1, &has_video_track, &video_track, &has_audio_track, &audio_track) ==
+        EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->video.active == EASYAV1_TRUE && has_video_track == EASYAV1_FALSE) {
+        destroy_video(easyav1);
+        easyav1->video.active = EASYAV1_FALSE;
+    } else if (easyav1->video.active == EASYAV1_TRUE) {
+
+        // The decoder was flushed, and the first keyframe of the new stream brings its own sequence header
+        if (set_video_track(easyav1, video_track) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        log(EASYAV1_LOG_LEVEL_INFO, "Video decoder reused. Size: %ux%u, %u FPS.", easyav1->video.width,
+            easyav1->video.height, easyav1->video.fps);
+    } else if (has_video_track == EASYAV1_TRUE) {
+        if (init_video(easyav1, video_track) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    if (easyav1->audio.active == EASYAV1_TRUE && has_audio_track == EASYAV1_TRUE &&
+        audio_headers_match(easyav1, audio_track) == EASYAV1_TRUE) {
+
+        nestegg_audio_params params;
+
+        if (nestegg_track_audio_params(easyav1->webm.context, audio_track, &params)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio track parameters.");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        vorbis_synthesis_restart(&easyav1->audio.vorbis.dsp);
+
+        easyav1->audio.track = audio_track;
+        easyav1->packets.audio_offset = easyav1->settings.audio_offset_time +
+            internal_timestamp_to_ms(easyav1, params.codec_delay);
+
+        log(EASYAV1_LOG_LEVEL_INFO, "Audio decoder reused. Channels: %u, sample rate: %uhz.",
+            easyav1->audio.channels, easyav1->audio.sample_rate);
+
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (easyav1->audio.active == EASYAV1_TRUE) {
+        destroy_audio(easyav1);
+        easyav1->audio.active = EASYAV1_FALSE;
+    }
+
+    if (has_audio_track == EASYAV1_TRUE) {
+        if (init_audio(easyav1, audio_track) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status init_video(easyav1_t *easyav1, unsigned int track)
+{
+    if (set_video_track(easyav1, track) == EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // The decoder threads use the allocator, so they get a copy that doesn't change along with the settings
+    easyav1->video.picture_allocator = easyav1->settings.video_decoder.picture_allocator;
+
+    if (open_video_decoder(easyav1, (int) join_decoder_pool(easyav1, easyav1->settings.video_decoder.pool,
+        easyav1->settings.video_decoder.threads)) != EASYAV1_STATUS_OK) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->video.active = EASYAV1_TRUE;
+
+    // The frame queue holds the prefetched frames plus the one being displayed
+    easyav1->video.frame_queue.capacity = (easyav1->settings.video_decoder.prefetch_frames ?
+        easyav1->settings.video_decoder.prefetch_frames : VIDEO_FRAMES_TO_PREFETCH) + 1;
+    easyav1->video.frame_queue.frames = calloc(easyav1->video.frame_queue.capacity, sizeof(Dav1dPicture));
+    easyav1->video.frame_queue.count = 0;
+    easyav1->video.frame_queue.begin = 0;
+
+    if (!easyav1->video.frame_queue.frames) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the video frame queue.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->video.decoder_settings.rgb_format = easyav1->settings.video_decoder.rgb_format;
+
+    if (easyav1->video.decoder_settings.rgb_format != EASYAV1_RGB_FORMAT_NONE) {
+        easyav1->video.frame_queue.rgb = calloc(easyav1->video.frame_queue.capacity, sizeof(easyav1_rgb_buffer));
+
+        if (!easyav1->video.frame_queue.rgb) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the RGB frame queue.");
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    easyav1->video.decoder_settings.plane_format = easyav1->settings.video_decoder.plane_format;
+
+    if (easyav1->video.decoder_settings.plane_format != EASYAV1_PLANE_FORMAT_NATIVE) {
+        easyav1->video.frame_queue.planes = calloc(easyav1->video.frame_queue.capacity, sizeof(easyav1_plane_buffer));
+
+        if (!easyav1->video.frame_queue.planes) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the plane frame queue.");
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    if (init_video_decoder_thread(easyav1) == EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Video initialized. Size: %ux%u, %u FPS.", easyav1->video.width, easyav1->video.height,
+        easyav1->video.fps);
+    log(EASYAV1_LOG_LEVEL_INFO, "Video decoder using %u threads with a maximum frame delay of %u.",
+        easyav1->video.decoder_settings.threads, easyav1->video.decoder_settings.max_frame_delay);
+    log(EASYAV1_LOG_LEVEL_INFO, "Prefetching up to %u video frames.", easyav1->video.decoder_settings.prefetch_frames);
+
+    if (easyav1->video.decoder_settings.quality == EASYAV1_VIDEO_QUALITY_PREVIEW) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Video decoder using preview quality.");
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status set_video_track(easyav1_t *easyav1, unsigned int track)
+{
+    nestegg_video_params params;
+
+    if (nestegg_track_video_params(easyav1->webm.context, track, &params)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get video track parameters.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_timestamp frame_duration;
+
+    if (nestegg_track_default_duration(easyav1->webm.context, track, &frame_duration)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get video track frame duration.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->video.fps = ms_to_internal_timestmap(easyav1, 1000) / frame_duration;
+
+    easyav1->video.track = track;
+
+    easyav1->video.width = params.width;
+    easyav1->video.height = params.height;
+
+    easyav1->video.sqhdr = NULL;
+
+    // Until a sequence header is found, assume the frames are 8-bit 4:2:0
+    easyav1->video.decoder_settings.prefetch_sized_from_sequence_header = EASYAV1_FALSE;
+    update_video_prefetch_depth(easyav1, (size_t) params.width * params.height * 3 / 2);
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status open_video_decoder(easyav1_t *easyav1, int threads)
+{
+    Dav1dSettings dav1d_settings;
+    dav1d_default_settings(&dav1d_settings);
+    dav1d_settings.logger = (Dav1dLogger) { .cookie = 0, .callback = log_from_dav1d };
+    dav1d_settings.n_threads = threads;
+    dav1d_settings.max_frame_delay = (int) easyav1->settings.video_decoder.max_frame_delay;
+
+    easyav1_video_quality quality = get_degraded_video_quality(easyav1);
+    set_decoder_quality(easyav1, quality, &dav1d_settings);
+
+    dav1d_settings.allocator = (Dav1dPicAllocator) {
+        .cookie = easyav1,
+        .alloc_picture_callback = allocate_picture,
+        .release_picture_callback = release_picture
+    };
+
+    uint64_t open_start = easyav1_get_microseconds();
+
+    if (dav1d_open(&easyav1->video.context, &dav1d_settings) < 0) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize AV1 decoder.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.video_decoder_us, open_start);
+
+    int frame_delay = dav1d_get_frame_delay(&dav1d_settings);
+
+    easyav1->video.decoder_settings.threads = dav1d_settings.n_threads ?
+        (unsigned int) dav1d_settings.n_threads : get_logical_processor_count();
+    easyav1->video.decoder_settings.max_frame_delay = frame_delay > 0 ? (unsigned int) frame_delay : 0;
+    easyav1->video.decoder_settings.quality = quality;
+
+    return EASYAV1_STATUS_OK;
+}
+
+static void set_decoder_quality(const easyav1_t *easyav1, easyav1_video_quality quality,
+    Dav1dSettings *dav1d_settings)
+{
+    dav1d_settings->operating_point = (int) easyav1->settings.video_decoder.operating_point;
+
+    if (quality == EASYAV1_VIDEO_QUALITY_PREVIEW) {
+        dav1d_settings->apply_grain = 0;
+        dav1d_settings->inloop_filters = DAV1D_INLOOPFILTER_DEBLOCK;
+        dav1d_settings->all_layers = 0;
+    }
+}
+
+static void update_video_prefetch_depth(easyav1_t *easyav1, size_t frame_size)
+{
+    unsigned int prefetch_frames = easyav1->settings.video_decoder.prefetch_frames ?
+        easyav1->settings.video_decoder.prefetch_frames : VIDEO_FRAMES_TO_PREFETCH;
+    size_t budget = easyav1->settings.video_decoder.prefetch_memory_budget;
+
+    if (budget && frame_size) {
+        // One more frame than the prefetched ones is held, the one being displayed
+        size_t frames_in_budget = budget / frame_size;
+        size_t max_prefetch_frames = frames_in_budget > 1 ? frames_in_budget - 1 : 1;
+
+        if (prefetch_frames > max_prefetch_frames) {
+            prefetch_frames = (unsigned int) max_prefetch_frames;
+        }
+    }
+
+    easyav1->video.decoder_settings.prefetch_frames = prefetch_frames;
+}
+
+static void size_video_prefetch_from_packet(easyav1_t *easyav1, nestegg_packet *packet)
+{
+    unsigned char *data;
+    size_t size;
+    Dav1dSequenceHeader sequence_header;
+
+    if (nestegg_packet_data(packet, 0, &data, &size) || dav1d_parse_sequence_header(&sequence_header, data, size)) {
+        return;
+    }
+
+    size_t width = easyav1->video.width;
+    size_t height = easyav1->video.height;
+    size_t bytes_per_sample = sequence_header.hbd ? 2 : 1;
+    size_t chroma_samples;
+
+    switch (sequence_header.layout) {
+        case DAV1D_PIXEL_LAYOUT_I400:
+            chroma_samples = 0;
+            break;
+        case DAV1D_PIXEL_LAYOUT_I420:
+            chroma_samples = 2 * ((width + 1) / 2) * ((height + 1) / 2);
+            break;
+        case DAV1D_PIXEL_LAYOUT_I422:
+            chroma_samples = 2 * ((width + 1) / 2) * height;
+            break;
+        default:
+            chroma_samples = 2 * width * height;
+            break;
+    }
+
+    update_video_prefetch_depth(easyav1, (width * height + chroma_samples) * bytes_per_sample);
+
+    easyav1->video.decoder_settings.prefetch_sized_from_sequence_header = EASYAV1_TRUE;
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Prefetching up to %u video frames within the memory budget.",
+        easyav1->video.decoder_settings.prefetch_frames);
+}
+
+static easyav1_status init_audio(easyav1_t *easyav1, unsigned int track)
+{
+    unsigned int headers;
+
+    if (nestegg_track_codec_data_count(easyav1->webm.context, track, &headers)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio codec header count.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // Vorbis data should always have 3 headers
+    if (headers != VORBIS_HEADERS_COUNT) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Vorbis data should always have 3 headers.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    vorbis_comment comment;
+
+    uint64_t headers_start = easyav1_get_microseconds();
+
+    vorbis_info_init(&easyav1->audio.vorbis.info);
+    vorbis_comment_init(&comment);
+
+    for (int header = 0; header < VORBIS_HEADERS_COUNT; header++) {
+        unsigned char *header_data;
+        size_t header_size;
+
+        if (nestegg_track_codec_data(easyav1->webm.context, track, header, &header_data, &header_size)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio codec header data for header %u.",
+                header);
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        ogg_packet packet;
+        packet.packet = header_data;
+        packet.bytes = header_size;
+        packet.b_o_s = header == 0;
+        packet.e_o_s = header == VORBIS_HEADERS_COUNT - 1;
+        packet.granulepos = 0;
+        packet.packetno = header;
+
+        if (vorbis_synthesis_headerin(&easyav1->audio.vorbis.info, &comment, &packet)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio codec header %u.", header);
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        // The headers are kept so that reopening a stream with the same ones doesn't have to process them again
+        size_t offset = 0;
+
+        for (int previous = 0; previous < header; previous++) {
+            offset += easyav1->audio.headers.sizes[previous];
+        }
+
+        uint8_t *headers = realloc(easyav1->audio.headers.data, offset + header_size);
+
+        if (!headers) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the audio codec headers.");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        memcpy(headers + offset, header_data, header_size);
+
+        easyav1->audio.headers.data = headers;
+        easyav1->audio.headers.sizes[header] = header_size;
+    }
+
+    vorbis_comment_clear(&comment);
+
+    if (vorbis_synthesis_init(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.info)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize vorbis synthesis.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (vorbis_block_init(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize vorbis block.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.audio_headers_us, headers_start);
+
+    nestegg_audio_params params;
+    if (nestegg_track_audio_params(easyav1->webm.context, track, &params)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio track parameters.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->audio.active = EASYAV1_TRUE;
+    easyav1->audio.track = track;
+
+    easyav1->audio.channels = params.channels;
+    easyav1->audio.sample_rate = params.rate;
+    easyav1->packets.audio_offset = easyav1->settings.audio_offset_time +
+        internal_timestamp_to_ms(easyav1, params.codec_delay);
+
+    if (prepare_audio_buffer(easyav1) == EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Audio initialized. Channels: %u, sample rate: %uhz.",
+        easyav1->audio.channels, easyav1->audio.sample_rate);
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_bool audio_headers_match(easyav1_t *easyav1, unsigned int track)
+{
+    unsigned int headers;
+
+    if (!easyav1->audio.headers.data || nestegg_track_codec_data_count(easyav1->webm.context, track, &headers) ||
+        headers != VORBIS_HEADERS_COUNT) {
+        return EASYAV1_FALSE;
+    }
+
+    size_t offset = 0;
+
+    for (unsigned int header = 0; header < VORBIS_HEADERS_COUNT; header++) {
+        unsigned char *header_data;
+        size_t header_size;
+
+        if (nestegg_track_codec_data(easyav1->webm.context, track, header, &header_data, &header_size) ||
+            header_size != easyav1->audio.headers.sizes[header] ||
+            memcmp(header_data, easyav1->audio.headers.data + offset, header_size)) {
+            return EASYAV1_FALSE;
+        }
+
+        offset += header_size;
+    }
+
+    return EASYAV1_TRUE;
+}
+
+static easyav1_status init_video_decoder_thread(easyav1_t *easyav1)
+{
+    if (atomic_load_size(&easyav1->video.decoder_thread.command) != THREAD_COMMAND_NONE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.io, NULL) ||
+        pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.decoder, NULL) ||
+        pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.status, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread mutexes.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_packets, NULL) ||
+        pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_frames_to_display, NULL) ||
+        pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_changed_status, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread condition variable.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (pthread_mutex_init(&easyav1->video.decoder_thread.decode_queue.mutex, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread decode queue mutex.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    reset_video_decode_queue(easyav1);
+    easyav1->video.decoder_thread.decode_queue.wake_requested = EASYAV1_FALSE;
+    easyav1->video.decoder_thread.exited = EASYAV1_FALSE;
+
+    uint64_t thread_start = easyav1_get_microseconds();
+
+    if (pthread_create(&easyav1->video.decoder_thread.decoder, NULL, video_decoder_thread, easyav1)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.threads_us, thread_start);
+
+    easyav1->video.decoder_thread.running = EASYAV1_TRUE;
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status prepare_audio_buffer(easyav1_t *easyav1)
+{
+    easyav1->audio.capacity = easyav1->settings.audio_buffer_samples ? easyav1->settings.audio_buffer_samples :
+        AUDIO_BUFFER_SIZE;
+    easyav1->audio.begin = 0;
+    easyav1->audio.queued = 0;
+
+    size_t max_samples = (size_t) easyav1->audio.capacity * easyav1->audio.channels;
+
+    easyav1->audio.buffer = calloc(max_samples, audio_sample_size(easyav1));
+
+    if (!easyav1->audio.buffer) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate audio buffer.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->audio.frame.channels = easyav1->audio.channels;
+    easyav1->audio.frame.format = easyav1->settings.audio_format;
+
+    if (easyav1->settings.interlace_audio) {
+        easyav1->audio.frame.pcm.interlaced = easyav1->audio.buffer;
+        easyav1->audio.frame.wrapped_pcm.interlaced = easyav1->audio.buffer;
+        return EASYAV1_STATUS_OK;
+    }
+
+    // The channel pointers of both spans of the frame are kept in the same allocation
+    easyav1->audio.frame.pcm.deinterlaced = malloc(easyav1->audio.channels * 2 * sizeof(float *));
+    if (!easyav1->audio.frame.pcm.deinterlaced) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate deinterlaced audio buffer.");
+        return EASYAV1_STATUS_ERROR;
+    }
+    easyav1->audio.frame.wrapped_pcm.deinterlaced = easyav1->audio.frame.pcm.deinterlaced + easyav1->audio.channels;
+
+    for (unsigned int i = 0; i < easyav1->audio.channels; i++) {
+        easyav1->audio.frame.wrapped_pcm.deinterlaced[i] = (const float *) ((const uint8_t *) easyav1->audio.buffer +
+            (size_t) i * easyav1->audio.capacity * audio_sample_size(easyav1));
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * @brief Opens the webm context of a stream and reads its duration and time scale.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param stream The stream to read from.
+ * @param packet_data If not `NULL`, the in-memory image of the stream, from which packet data is used in place.
+ * @param packet_data_size The size of the `packet_data` buffer.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status open_webm_stream(easyav1_t *easyav1, const easyav1_stream *stream, const uint8_t *packet_data,
+    size_t packet_data_size)
+{
+    nestegg_io io = {
+        .read = stream->read_func,
+        .seek = stream->seek_func,
+        .tell = stream->tell_func,
+        .userdata = stream->userdata
+    };
+
+    easyav1->stream.seekable = stream->seek_func ? EASYAV1_TRUE : EASYAV1_FALSE;
+
+    if (easyav1->stream.seekable == EASYAV1_FALSE) {
+        // The read-ahead stage needs to know the size of the stream, so forward-only streams are read directly
+        log(EASYAV1_LOG_LEVEL_INFO, "Stream can't be seeked, reading it forward only.");
+
+        easyav1->stream.forward.source = *stream;
+        easyav1->stream.forward.position = 0;
+
+        io = (nestegg_io) {
+            .read = forward_read,
+            .seek = forward_seek,
+            .tell = forward_tell,
+            .userdata = easyav1
+        };
+    } else if (!packet_data && easyav1->settings.read_ahead_bytes > 0) {
+        // Streams that are already in memory don't benefit from being read ahead
+        if (start_read_ahead(easyav1, stream) != EASYAV1_STATUS_OK) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (easyav1->stream.read_ahead.active == EASYAV1_TRUE) {
+            io = (nestegg_io) {
+                .read = read_ahead_read,
+                .seek = read_ahead_seek,
+                .tell = read_ahead_tell,
+                .userdata = easyav1
+            };
+        }
+    }
+
+    uint64_t demuxer_start = easyav1_get_microseconds();
+
+    if (nestegg_init(&easyav1->webm.context, io, log_from_nestegg, -1)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to initialize webm context");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.demuxer_us, demuxer_start);
+
+    nestegg_packet_allocator packet_allocator = {
+        .alloc = packet_pool_alloc,
+        .free = packet_pool_free,
+        .userdata = easyav1
+    };
+
+    if (nestegg_set_packet_allocator(easyav1->webm.context, &packet_allocator)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to set the packet allocator");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // Packet data is handed to the decoders straight from memory, without being copied
+    if (packet_data && nestegg_set_packet_data_source(easyav1->webm.context, packet_data, packet_data_size)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to set the packet data source");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_timestamp duration;
+
+    // Without a duration in the header, the duration is only known once the whole file has been read
+    if (nestegg_duration(easyav1->webm.context, &duration)) {
+        log(EASYAV1_LOG_LEVEL_INFO, "File has no duration, using the timestamps of the packets read instead.");
+        duration = 0;
+        easyav1->duration_is_provisional = EASYAV1_TRUE;
+    } else {
+        easyav1->duration_is_provisional = easyav1->stream.seekable == EASYAV1_TRUE ? EASYAV1_FALSE : EASYAV1_TRUE;
+    }
+
+    if (nestegg_tstamp_scale(easyav1->webm.context, &easyav1->time_scale)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get time scale.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->time_scale == 0) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Time scale is 0.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->duration = internal_timestamp_to_ms(easyav1, duration);
+
+    log(EASYAV1_LOG_LEVEL_INFO, "File duration: %llu minutes and %llu seconds%s.",
+        easyav1->duration / 60000, (easyav1->duration / 1000) % 60,
+        easyav1->duration_is_provisional == EASYAV1_TRUE ? " (provisional)" : "");
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * @brief Initializes an easyav1 instance from a stream.
+ *
+ * @param stream The stream to read from.
+ * @param settings The settings to use for the easyav1 instance. If this is `NULL`, the default settings will be used.
+ * @param packet_data If not `NULL`, the in-memory image of the stream, from which packet data is used in place.
+ * @param packet_data_size The size of the `packet_data` buffer.
+ *
+ * @return The `easyav1` instance, or `NULL` if an error occurred.
+ */
+static easyav1_t *init_from_stream(const easyav1_stream *stream, const easyav1_settings *settings,
+    const uint8_t *packet_data, size_t packet_data_size)
+{
+    uint64_t init_start = easyav1_get_microseconds();
+
+    easyav1_t *easyav1 = NULL;
+
+    // The seek and tell functions can only be left out together, for streams that are read forward only
+    if (!stream || !stream->read_func || !stream->seek_func != !stream->tell_func) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_ARGUMENT,
+            "Stream is NULL, missing its read function, or has only one of its seek and tell functions");
+        return NULL;
+    }
+
+    easyav1 = malloc(sizeof(easyav1_t));
+
+    if (!easyav1) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the easyav1 handle");
+        return NULL;
+    }
+
+    memset(easyav1, 0, sizeof(easyav1_t));
+
+    atomic_store_status(&easyav1->status, EASYAV1_STATUS_OK);
+
+    easyav1->counters.startup.begin = init_start;
+
+    if (settings) {
+        easyav1->settings = *settings;
+    } else {
+        easyav1->settings = DEFAULT_SETTINGS;
+        log(EASYAV1_LOG_LEVEL_INFO, "No settings provided, using default settings.");
+    }
+
+    if (validate_settings(easyav1, &easyav1->settings) == EASYAV1_FALSE) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_ARGUMENT, "Invalid settings provided.");
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&easyav1->seek.index.mutex, NULL) || pthread_mutex_init(&easyav1->packets.pool.mutex, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to create keyframe index and packet pool mutexes.");
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&easyav1->video.picture_pool.mutex, NULL)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to create picture pool mutex.");
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    if (open_webm_stream(easyav1, stream, packet_data, packet_data_size) == EASYAV1_STATUS_ERROR) {
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    uint64_t phase_start = easyav1_get_microseconds();
+
+    if (init_webm_tracks(easyav1) == EASYAV1_STATUS_ERROR) {
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.tracks_us, phase_start);
+
+    phase_start = easyav1_get_microseconds();
+
+    init_cue_index(easyav1);
+
+    add_startup_time(easyav1, &easyav1->counters.startup.cues_us, phase_start);
+
+    if (sync_packet_queues(easyav1) != EASYAV1_STATUS_OK) {
+        easyav1_destroy(&easyav1);
+        return NULL;
+    }
+
+    add_startup_time(easyav1, &easyav1->counters.startup.init_us, init_start);
+    easyav1->counters.startup.initialized = EASYAV1_TRUE;
+
+    return easyav1;
+}
+
+easyav1_t *easyav1_init_from_custom_stream(const easyav1_stream *stream, const easyav1_settings *settings)
+{
+    return init_from_stream(stream, settings, NULL, 0);
+}
+
+/**
+ * @brief Initializes an easyav1 instance from a memory buffer, using the packet data in place.
+ *
+ * @param data The buffer to read from.
+ * @param size The size of the buffer.
+ * @param settings The settings to use for the easyav1 instance. If this is `NULL`, the default settings will be used.
+ * @param type The stream type to set on the instance, which determines how the buffer is released on destroy.
+ *
+ * @return The `easyav1` instance, or `NULL` if an error occurred.
+ */
+static easyav1_t *init_from_memory_buffer(const void *data, size_t size, const easyav1_settings *settings,
+    stream_type type)
+{
+    easyav1_t *easyav1 = NULL;
+
+    easyav1_memory *mem = malloc(sizeof(easyav1_memory));
+
+    if (!mem) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for memory stream");
+        return NULL;
+    }
+
+    mem->data = (uint8_t *) data;
+    mem->size = size;
+    mem->offset = 0;
+
+    easyav1_stream memory_stream = {
+        .read_func = memory_read,
+        .seek_func = memory_seek,
+        .tell_func = memory_tell,
+        .userdata = mem
+    };
+
+    easyav1 = init_from_stream(&memory_stream, settings, mem->data, mem->size);
+
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 handle from memory stream");
+        free(mem);
+        return NULL;
+    }
+
+    easyav1->stream.type = type;
+    easyav1->stream.data = mem;
+
+    easyav1->seek.index.scan.data = mem->data;
+    easyav1->seek.index.scan.size = mem->size;
+
+    start_keyframe_scan(easyav1);
+
+    return easyav1;
+}
+
+easyav1_t *easyav1_init_from_memory(const void *data, size_t size, const easyav1_settings *settings)
+{
+    easyav1_t *easyav1 = NULL;
+
+    if (!data || !size) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Data is NULL or size is 0");
+        return NULL;
+    }
+
+    return init_from_memory_buffer(data, size, settings, STREAM_TYPE_MEMORY);
+}
+
+easyav1_t *easyav1_init_from_mapped_file(const char *filename, const easyav1_settings *settings)
+{
+    easyav1_t *easyav1 = NULL;
+
+    if (!filename) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Filename is NULL");
+        return NULL;
+    }
+
+    size_t size = 0;
+    void *data = map_file(filename, &size);
+
+    if (!data) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to map file %s to memory", filename);
+        return NULL;
+    }
+
+    easyav1 = init_from_memory_buffer(data, size, settings, STREAM_TYPE_MAPPED_FILE);
+
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 structure from mapped file %s", filename);
+        unmap_file(data, size);
+        return NULL;
+    }
+
+    return easyav1;
+}
+
+easyav1_t *easyav1_init_from_file(FILE *f, const easyav1_settings *settings)
+{
+    easyav1_t *easyav1 = NULL;
+
+    if (!f) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "File handle is NULL");
+        return NULL;
+    }
+
+    easyav1_stream file_stream = {
+        .read_func = file_read,
+        .seek_func = file_seek,
+        .tell_func = file_tell,
+        .userdata = f
+    };
+
+    easyav1 = easyav1_init_from_custom_stream(&file_stream, settings);
+
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 structure from file handle");
+        if ((settings && settings->close_handle_on_destroy) || (!settings && DEFAULT_SETTINGS.close_handle_on_destroy)) {
+            fclose(f);
+        }
+        return NULL;
+    }
+
+    if (easyav1->settings.close_handle_on_destroy) {
+        easyav1->stream.type = STREAM_TYPE_FILE;
+        easyav1->stream.data = f;
+    }
+
+    return easyav1;
+}
+
+easyav1_t *easyav1_init_from_filename(const char *filename, const easyav1_settings *settings)
+{
+    easyav1_t *easyav1 = NULL;
+
+    if (!filename) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Filename is NULL");
+        return NULL;
+    }
+
+    FILE *f = fopen(filename, "rb");
+
+    if (!f) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to open file %s", filename);
+        return NULL;
+    }
+
+    easyav1 = easyav1_init_from_file(f, settings);
+
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 structure from file %s", filename);
+        fclose(f);
+        return NULL;
+    }
+
+    easyav1->stream.type = STREAM_TYPE_FILE;
+    easyav1->stream.data = f;
+
+    size_t filename_length = strlen(filename);
+    easyav1->seek.index.scan.filename = malloc(filename_length + 1);
+
+    if (easyav1->seek.index.scan.filename) {
+        memcpy(easyav1->seek.index.scan.filename, filename, filename_length + 1);
+    }
+
+    start_keyframe_scan(easyav1);
+
+    return easyav1;
+}
+
+/**
+ * @brief Reopens an easyav1 instance on a new stream, reusing its decoders, threads and buffers.
+ *
+ * @param easyav1 The easyav1 instance to reopen.
+ * @param stream The stream to read from.
+ * @param packet_data If not `NULL`, the in-memory image of the stream, from which packet data is used in place.
+ * @param packet_data_size The size of the `packet_data` buffer.
+ * @param index The index saved by `easyav1_save_index` for the stream, or `NULL` to read the cues from the stream.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status reopen_from_stream(easyav1_t *easyav1, const easyav1_stream *stream, const uint8_t *packet_data,
+    size_t packet_data_size, const void *index, size_t index_size)
+{
+    if (!stream || !stream->read_func || !stream->seek_func != !stream->tell_func) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Stream is NULL, missing its read function, or has only one of its seek and tell "
+            "functions");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Playback must be stopped before reopening.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "An instance with an error can't be reopened, it must be destroyed.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    uint64_t reopen_start = easyav1_get_microseconds();
+
+    reset_keyframe_index(easyav1);
+
+    if (easyav1->video.active == EASYAV1_TRUE) {
+        pause_video_decoder_thread(easyav1);
+
+        release_packets_from_queue(easyav1, &easyav1->packets.video_queue);
+
+        // The decoder thread is paused, so no packets handed to it are in use
+        reset_video_decode_queue(easyav1);
+
+        release_displayed_picture(easyav1);
+
+        lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+
+        dequeue_all_video_frames(easyav1);
+
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+
+        dav1d_flush(easyav1->video.context);
+
+        easyav1->video.decoder_thread.sequence_header.found = EASYAV1_FALSE;
+
+        resume_video_decoder_thread(easyav1);
+    }
+
+    release_packets_from_queue(easyav1, &easyav1->packets.audio_queue);
+
+    easyav1->audio.begin = 0;
+    easyav1->audio.queued = 0;
+    easyav1->audio.has_samples_in_buffer = EASYAV1_FALSE;
+
+    close_webm_stream(easyav1);
+
+    atomic_store_status(&easyav1->status, EASYAV1_STATUS_OK);
+    atomic_store_u64(&easyav1->position, 0);
+    atomic_store_u64(&easyav1->video.processed_frames, 0);
+
+    easyav1->packets.synced = EASYAV1_FALSE;
+    easyav1->packets.all_fetched = EASYAV1_FALSE;
+
+    easyav1->seek.mode = NOT_SEEKING;
+    easyav1->seek.timestamp = 0;
+    easyav1->seek.position_lost = EASYAV1_FALSE;
+
+    // The decoder goes back to the requested quality at the first keyframe, if it was degraded
+    memset(&easyav1->degradation, 0, sizeof(easyav1->degradation));
+    atomic_store_size(&easyav1->counters.degradation.level, EASYAV1_DEGRADATION_NONE);
+
+    easyav1_status status = open_webm_stream(easyav1, stream, packet_data, packet_data_size);
+
+    if (status == EASYAV1_STATUS_OK) {
+        status = reopen_webm_tracks(easyav1);
+    }
+
+    if (status == EASYAV1_STATUS_OK) {
+        // An index is of no use on a stream that can't be seeked
+        if (easyav1->stream.seekable == EASYAV1_FALSE) {
+            if (index) {
+                log(EASYAV1_LOG_LEVEL_INFO, "Stream can't be seeked, ignoring the saved index.");
+            }
+        } else if (!index || load_index(easyav1, index, index_size) == EASYAV1_STATUS_ERROR) {
+            if (index) {
+                log(EASYAV1_LOG_LEVEL_WARNING, "The saved index doesn't match the stream, reading the cues instead.");
+            }
+
+            init_cue_index(easyav1);
+        }
+
+        status = sync_packet_queues(easyav1) == EASYAV1_STATUS_OK ? EASYAV1_STATUS_OK : EASYAV1_STATUS_ERROR;
+    }
+
+    if (status != EASYAV1_STATUS_OK) {
+
+        // The caller releases the new stream, so nothing may read from it anymore
+        close_webm_stream(easyav1);
+
+        if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_FALSE) {
+            atomic_store_status(&easyav1->status, EASYAV1_STATUS_INVALID_STATE);
+        }
+
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Stream reopened in %zu us.", (size_t) (easyav1_get_microseconds() - reopen_start));
+
+    return EASYAV1_STATUS_OK;
+}
+
+easyav1_status easyav1_reopen_from_custom_stream(easyav1_t *easyav1, const easyav1_stream *stream, const void *index,
+    size_t index_size)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    return reopen_from_stream(easyav1, stream, NULL, 0, index, index_size);
+}
+
+/**
+ * @brief Reopens an easyav1 instance on a memory buffer, using the packet data in place.
+ *
+ * @param easyav1 The easyav1 instance to reopen.
+ * @param data The buffer to read from.
+ * @param size The size of the buffer.
+ * @param type The stream type to set on the instance, which determines how the buffer is released on destroy.
+ * @param index The index saved by `easyav1_save_index` for the stream, or `NULL` to read the cues from the stream.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status reopen_from_memory_buffer(easyav1_t *easyav1, const void *data, size_t size, stream_type type,
+    const void *index, size_t index_size)
+{
+    easyav1_memory *mem = malloc(sizeof(easyav1_memory));
+
+    if (!mem) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for memory stream");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    mem->data = (uint8_t *) data;
+    mem->size = size;
+    mem->offset = 0;
+
+    easyav1_stream memory_stream = {
+        .read_func = memory_read,
+        .seek_func = memory_seek,
+        .tell_func = memory_tell,
+        .userdata = mem
+    };
+
+    if (reopen_from_stream(easyav1, &memory_stream, mem->data, mem->size, index, index_size) ==
+        EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to reopen easyav1 handle from memory stream");
+        free(mem);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->stream.type = type;
+    easyav1->stream.data = mem;
+
+    easyav1->seek.index.scan.data = mem->data;
+    easyav1->seek.index.scan.size = mem->size;
+
+    start_keyframe_scan(easyav1);
+
+    return EASYAV1_STATUS_OK;
+}
+
+easyav1_status easyav1_reopen_from_memory(easyav1_t *easyav1, const void *data, size_t size, const void *index,
+    size_t index_size)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (!data || !size) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Data is NULL or size is 0");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    return reopen_from_memory_buffer(easyav1, data, size, STREAM_TYPE_MEMORY, index, index_size);
+}
+
+easyav1_status easyav1_reopen_from_mapped_file(easyav1_t *easyav1, const char *filename, const void *index,
+    size_t index_size)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (!filename) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Filename is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    size_t size = 0;
+    void *data = map_file(filename, &size);
+
+    if (!data) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to map file %s to memory", filename);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (reopen_from_memory_buffer(easyav1, data, size, STREAM_TYPE_MAPPED_FILE, index, index_size) ==
+        EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to reopen easyav1 structure from mapped file %s", filename);
+        unmap_file(data, size);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+easyav1_status easyav1_reopen_from_file(easyav1_t *easyav1, FILE *f, const void *index, size_t index_size)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (!f) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "File handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_stream file_stream = {
+        .read_func = file_read,
+        .seek_func = file_seek,
+        .tell_func = file_tell,
+        .userdata = f
+    };
+
+    if (reopen_from_stream(easyav1, &file_stream, NULL, 0, index, index_size) == EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to reopen easyav1 structure from file handle");
+        if (easyav1->settings.close_handle_on_destroy) {
+            fclose(f);
+        }
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->settings.close_handle_on_destroy) {
+        easyav1->stream.type = STREAM_TYPE_FILE;
+        easyav1->stream.data = f;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+easyav1_status easyav1_reopen_from_filename(easyav1_t *easyav1, const char *filename, const void *index,
+    size_t index_size)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (!filename) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Filename is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    FILE *f = fopen(filename, "rb");
+
+    if (!f) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to open file %s", filename);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_stream file_stream = {
+        .read_func = file_read,
+        .seek_func = file_seek,
+        .tell_func = file_tell,
+        .userdata = f
+    };
+
+    if (reopen_from_stream(easyav1, &file_stream, NULL, 0, index, index_size) == EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to reopen easyav1 structure from file %s", filename);
+        fclose(f);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->stream.type = STREAM_TYPE_FILE;
+    easyav1->stream.data = f;
+
+    size_t filename_length = strlen(filename);
+    easyav1->seek.index.scan.filename = malloc(filename_length + 1);
+
+    if (easyav1->seek.index.scan.filename) {
+        memcpy(easyav1->seek.index.scan.filename, filename, filename_length + 1);
+    }
+
+    start_keyframe_scan(easyav1);
+
+    return EASYAV1_STATUS_OK;
+}
+
+
+/**
+ * Packet memory pool functions
+ */
+
+static void *packet_pool_alloc(size_t size, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    unsigned int size_class = 0;
+
+    while (size_class < PACKET_POOL_SIZE_CLASSES && ((size_t) 1 << (size_class + PACKET_POOL_MIN_BLOCK_SHIFT)) < size) {
+        size_class++;
+    }
+
+    size_t block_size = size_class == PACKET_POOL_UNPOOLED ? size :
+        (size_t) 1 << (size_class + PACKET_POOL_MIN_BLOCK_SHIFT);
+
+    pthread_mutex_lock(&easyav1->packets.pool.mutex);
+
+    easyav1_pool_block *block = NULL;
+
+    if (size_class != PACKET_POOL_UNPOOLED && easyav1->packets.pool.free_blocks[size_class]) {
+        block = easyav1->packets.pool.free_blocks[size_class];
+        easyav1->packets.pool.free_blocks[size_class] = block->info.next;
+    } else {
+        if (block_size > SIZE_MAX - sizeof(easyav1_pool_block)) {
+            pthread_mutex_unlock(&easyav1->packets.pool.mutex);
+            return NULL;
+        }
+
+        block = malloc(sizeof(easyav1_pool_block) + block_size);
+
+        if (!block) {
+            pthread_mutex_unlock(&easyav1->packets.pool.mutex);
+            return NULL;
+        }
+
+        block->info.size_class = size_class;
+        block->info.size = block_size;
+
+        easyav1->packets.pool.bytes_reserved += block_size;
+        easyav1->packets.pool.heap_allocations++;
+    }
+
+    block->info.next = NULL;
+
+    easyav1->packets.pool.bytes_in_use += block_size;
+
+    if (easyav1->packets.pool.bytes_in_use > easyav1->packets.pool.high_water_bytes) {
+        easyav1->packets.pool.high_water_bytes = easyav1->packets.pool.bytes_in_use;
+    }
+
+    pthread_mutex_unlock(&easyav1->packets.pool.mutex);
+
+    return block + 1;
+}
+
+static void packet_pool_free(void *ptr, void *userdata)
+{
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
+
+    if (!ptr) {
+        return;
+    }
+
+    easyav1_pool_block *block = (easyav1_pool_block *) ptr - 1;
+
+    pthread_mutex_lock(&easyav1->packets.pool.mutex);
+
+    easyav1->packets.pool.bytes_in_use -= block->info.size;
+
+    if (block->info.size_class == PACKET_POOL_UNPOOLED) {
+        easyav1->packets.pool.bytes_reserved -= block->info.size;
+        free(block);
+    } else {
+        block->info.next = easyav1->packets.pool.free_blocks[block->info.size_class];
+        easyav1->packets.pool.free_blocks[block->info.size_class] = block;
+    }
+
+    pthread_mutex_unlock(&easyav1->packets.pool.mutex);
+}
+
+static void destroy_packet_pool(easyav1_t *easyav1)
+{
+    for (unsigned int size_class = 0; size_class < PACKET_POOL_SIZE_CLASSES; size_class++) {
+        while (easyav1->packets.pool.free_blocks[size_class]) {
+            easyav1_pool_block *block = easyav1->packets.pool.free_blocks[size_class];
+            easyav1->packets.pool.free_blocks[size_class] = block->info.next;
+            free(block);
+        }
+    }
+
+    easyav1->packets.pool.bytes_reserved = 0;
+
+    pthread_mutex_destroy(&easyav1->packets.pool.mutex);
+}
+
+
+/**
+ * Picture allocation functions
+ */
+
+static void set_picture_buffer_layout(easyav1_picture_buffer *buffer, const Dav1dPictureParameters *params)
+{
+    memset(buffer, 0, sizeof(easyav1_picture_buffer));
+
+    buffer->width = (unsigned int) params->w;
+    buffer->height = (unsigned int) params->h;
+    buffer->alignment = DAV1D_PICTURE_ALIGNMENT;
+
+    switch (params->layout) {
+        case DAV1D_PIXEL_LAYOUT_I400:
+            buffer->pixel_layout = EASYAV1_PIXEL_LAYOUT_YUV400;
+            break;
+        case DAV1D_PIXEL_LAYOUT_I420:
+            buffer->pixel_layout = EASYAV1_PIXEL_LAYOUT_YUV420;
+            break;
+        case DAV1D_PIXEL_LAYOUT_I422:
+            buffer->pixel_layout = EASYAV1_PIXEL_LAYOUT_YUV422;
+            break;
+        default:
+            buffer->pixel_layout = EASYAV1_PIXEL_LAYOUT_YUV444;
+            break;
+    }
+
+    buffer->bits_per_color = params->bpc == 12 ? EASYAV1_BITS_PER_COLOR_12 :
+        params->bpc == 10 ? EASYAV1_BITS_PER_COLOR_10 : EASYAV1_BITS_PER_COLOR_8;
+
+    // The decoder writes whole 128 pixel blocks, so the planes are rounded up to them
+    size_t high_bit_depth = params->bpc > 8 ? 1 : 0;
+    size_t has_chroma = params->layout != DAV1D_PIXEL_LAYOUT_I400 ? 1 : 0;
+    size_t subsampled_width = params->layout != DAV1D_PIXEL_LAYOUT_I444 ? 1 : 0;
+    size_t subsampled_height = params->layout == DAV1D_PIXEL_LAYOUT_I420 ? 1 : 0;
+    size_t aligned_width = ((size_t) params->w + 127) & ~(size_t) 127;
+    size_t aligned_height = ((size_t) params->h + 127) & ~(size_t) 127;
+
+    size_t luma_stride = aligned_width << high_bit_depth;
+    size_t chroma_stride = has_chroma ? luma_stride >> subsampled_width : 0;
+
+    // Strides that are a multiple of 1024 make the rows of a plane compete for the same cache sets
+    if (!(luma_stride & 1023)) {
+        luma_stride += DAV1D_PICTURE_ALIGNMENT;
+    }
+
+    if (has_chroma && !(chroma_stride & 1023)) {
+        chroma_stride += DAV1D_PICTURE_ALIGNMENT;
+    }
+
+    size_t luma_size = luma_stride * aligned_height;
+    size_t chroma_size = chroma_stride * (aligned_height >> subsampled_height);
+
+    buffer->offset[0] = 0;
+    buffer->offset[1] = has_chroma ? luma_size : 0;
+    buffer->offset[2] = has_chroma ? luma_size + chroma_size : 0;
+
+    buffer->stride[0] = luma_stride;
+    buffer->stride[1] = chroma_stride;
+    buffer->stride[2] = chroma_stride;
+
+    buffer->size = luma_size + chroma_size * 2 + DAV1D_PICTURE_ALIGNMENT;
+}
+
+static int allocate_picture(Dav1dPicture *pic, void *cookie)
+{
+    easyav1_t *easyav1 = (easyav1_t *) cookie;
+
+    easyav1_picture_buffer buffer;
+    set_picture_buffer_layout(&buffer, &pic->p);
+
+    if (easyav1->video.picture_allocator.allocate) {
+        if (easyav1->video.picture_allocator.allocate(&buffer, easyav1->video.picture_allocator.userdata) ==
+            EASYAV1_FALSE || !buffer.data) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "The picture allocator failed to allocate %zu bytes.", buffer.size);
+            return DAV1D_ERR(ENOMEM);
+        }
+
+        if ((uintptr_t) buffer.data % buffer.alignment) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "The picture allocator returned a buffer that isn't aligned to %zu bytes.",
+                buffer.alignment);
+            easyav1->video.picture_allocator.release(buffer.data, buffer.userdata,
+                easyav1->video.picture_allocator.userdata);
+            return DAV1D_ERR(EINVAL);
+        }
+
+        pic->allocator_data = buffer.userdata;
+    } else {
+        easyav1_picture_pool_buffer *pool_buffer = NULL;
+
+        pthread_mutex_lock(&easyav1->video.picture_pool.mutex);
+
+        // The released buffers all have the same size unless the video size changed, in which case they're useless
+        while (easyav1->video.picture_pool.free_buffers && !pool_buffer) {
+            easyav1_picture_pool_buffer *released = easyav1->video.picture_pool.free_buffers;
+            easyav1->video.picture_pool.free_buffers = released->next;
+            easyav1->video.picture_pool.free_count--;
+
+            if (released->size == buffer.size) {
+                pool_buffer = released;
+            } else {
+                free(released);
+            }
+        }
+
+        pthread_mutex_unlock(&easyav1->video.picture_pool.mutex);
+
+        if (!pool_buffer) {
+            pool_buffer = malloc(sizeof(easyav1_picture_pool_buffer) + DAV1D_PICTURE_ALIGNMENT + buffer.size);
+
+            if (!pool_buffer) {
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate %zu bytes for a picture.", buffer.size);
+                return DAV1D_ERR(ENOMEM);
+            }
+
+            pool_buffer->size = buffer.size;
+            pool_buffer->data = (uint8_t *) (((uintptr_t) (pool_buffer + 1) + DAV1D_PICTURE_ALIGNMENT - 1) &
+                ~(uintptr_t) (DAV1D_PICTURE_ALIGNMENT - 1));
+        }
+
+        pool_buffer->next = NULL;
+
+        buffer.data = pool_buffer->data;
+        pic->allocator_data = pool_buffer;
+    }
+
+    pic->data[0] = buffer.data;
+    pic->data[1] = buffer.offset[1] ? (uint8_t *) buffer.data + buffer.offset[1] : NULL;
+    pic->data[2] = buffer.offset[2] ? (uint8_t *) buffer.data + buffer.offset[2] : NULL;
+    pic->stride[0] = (ptrdiff_t) buffer.stride[0];
+    pic->stride[1] = (ptrdiff_t) buffer.stride[1];
+
+    return 0;
+}
+
+static void release_picture(Dav1dPicture *pic, void *cookie)
+{
+    easyav1_t *easyav1 = (easyav1_t *) cookie;
+
+    if (easyav1->video.picture_allocator.allocate) {
+        easyav1->video.picture_allocator.release(pic->data[0], pic->allocator_data,
+            easyav1->video.picture_allocator.userdata);
+        return;
+    }
+
+    easyav1_picture_pool_buffer *pool_buffer = (easyav1_picture_pool_buffer *) pic->allocator_data;
+
+    pthread_mutex_lock(&easyav1->video.picture_pool.mutex);
+
+    if (easyav1->video.picture_pool.free_count < VIDEO_PICTURE_POOL_SIZE) {
+        pool_buffer->next = easyav1->video.picture_pool.free_buffers;
+        easyav1->video.picture_pool.free_buffers = pool_buffer;
+        easyav1->video.picture_pool.free_count++;
+        pool_buffer = NULL;
+    }
+
+    pthread_mutex_unlock(&easyav1->video.picture_pool.mutex);
+
+    free(pool_buffer);
+}
+
+static void destroy_picture_pool(easyav1_t *easyav1)
+{
+    while (easyav1->video.picture_pool.free_buffers) {
+        easyav1_picture_pool_buffer *pool_buffer = easyav1->video.picture_pool.free_buffers;
+        easyav1->video.picture_pool.free_buffers = pool_buffer->next;
+        free(pool_buffer);
+    }
+
+    easyav1->video.picture_pool.free_count = 0;
+
+    pthread_mutex_destroy(&easyav1->video.picture_pool.mutex);
+}
+
+
+/**
+ * WebM packet handling functions
+ */
+
+static easyav1_status increase_packet_queue_capacity(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    // Grow geometrically: each new chunk is as large as the whole queue so far
+    size_t chunk_capacity = queue->capacity ? queue->capacity : PACKET_QUEUE_BASE_CAPACITY;
+    size_t new_capacity = queue->capacity + chunk_capacity;
+
+    easyav1_packet *new_chunk = calloc(chunk_capacity, sizeof(easyav1_packet));
+    easyav1_packet **new_items = malloc(new_capacity * sizeof(easyav1_packet *));
+    easyav1_packet **new_chunks = realloc(queue->chunks, (queue->chunk_count + 1) * sizeof(easyav1_packet *));
+
+    if (!new_chunk || !new_items || !new_chunks) {
+        free(new_chunk);
+        free(new_items);
+
+        if (new_chunks) {
+            queue->chunks = new_chunks;
+        }
+
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for packet queue.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // Only the slot pointers are moved, the packets themselves stay where they are, so the video decoder thread
+    // can keep using the packets it was handed while the queue grows
+    if (queue->capacity) {
+        memcpy(new_items, queue->items + queue->begin, (queue->capacity - queue->begin) * sizeof(easyav1_packet *));
+        memcpy(new_items + queue->capacity - queue->begin, queue->items, queue->begin * sizeof(easyav1_packet *));
+    }
+
+    for (size_t i = 0; i < chunk_capacity; i++) {
+        new_items[queue->capacity + i] = &new_chunk[i];
+    }
+
+    new_chunks[queue->chunk_count] = new_chunk;
+
+    free(queue->items);
+
+    queue->items = new_items;
+    queue->chunks = new_chunks;
+    queue->chunk_count++;
+    queue->capacity = new_capacity;
+    queue->begin = 0;
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * @brief Publishes the number of packets in a packet queue to the performance counters.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param queue The packet queue that changed.
+ */
+static void update_packet_queue_depth(easyav1_t *easyav1, const easyav1_packet_queue *queue)
+{
+    if (queue == &easyav1->packets.video_queue) {
+        atomic_store_size(&easyav1->counters.video_queue_depth, queue->count);
+        atomic_store_size_max(&easyav1->counters.video_queue_high_water, queue->count);
+    } else {
+        atomic_store_size(&easyav1->counters.audio_queue_depth, queue->count);
+        atomic_store_size_max(&easyav1->counters.audio_queue_high_water, queue->count);
+    }
+}
+
+static easyav1_packet *queue_new_packet(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    if (queue->count == queue->capacity) {
+        if (increase_packet_queue_capacity(easyav1, queue) == EASYAV1_STATUS_ERROR) {
+            return NULL;
+        }
+    }
+
+    size_t index = (queue->begin + queue->count) % queue->capacity;
+
+    queue->count++;
+
+    update_packet_queue_depth(easyav1, queue);
+
+    return queue->items[index];
+}
+
+static void hand_off_video_packets(easyav1_t *easyav1)
+{
+    if (easyav1->video.decoder_thread.running == EASYAV1_FALSE ||
+        (easyav1->seek.mode != NOT_SEEKING && easyav1->seek.mode != SEEKING_FOR_TIMESTAMP)) {
+        return;
+    }
+
+    easyav1_packet_queue *queue = &easyav1->packets.video_queue;
+
+    if (queue->handed_off == queue->count) {
+        return;
+    }
+
+    size_t packets_after_timestamp = 0;
+
+    easyav1_timestamp timestamp = atomic_load_u64(&easyav1->position);
+
+    for (size_t i = 0; i < queue->count && packets_after_timestamp < easyav1->video.decoder_settings.prefetch_frames;
+        i++) {
+        easyav1_packet *packet = queue->items[(queue->begin + i) % queue->capacity];
+
+        if (i == queue->handed_off) {
+
+            // A seek packet is discardable when the next one doesn't go past the seek target either, so it's only
+            // handed off once the next one is read. The first packet is always handed off, as it may be waited on.
+            if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP && packet->is_seek_packet == EASYAV1_TRUE) {
+                if (i + 1 < queue->count) {
+                    easyav1_packet *next_packet = queue->items[(queue->begin + i + 1) % queue->capacity];
+                    packet->discardable = next_packet->timestamp < easyav1->seek.timestamp ?
+                        EASYAV1_TRUE : EASYAV1_FALSE;
+                } else if (i > 0 && easyav1->packets.all_fetched == EASYAV1_FALSE) {
+                    break;
+                }
+            }
+
+            // The packets from this keyframe on are decoded at a different quality, once the decoder is opened again
+            if (must_switch_video_decoder_quality(easyav1, packet) == EASYAV1_TRUE) {
+                break;
+            }
+
+            packet->droppable = easyav1->seek.mode == NOT_SEEKING &&
+                easyav1->degradation.level >= EASYAV1_DEGRADATION_DROP_FRAMES ? EASYAV1_TRUE : EASYAV1_FALSE;
+
+            if (push_video_packet_to_decoder(easyav1, packet) == EASYAV1_FALSE) {
+                break;
+            }
+
+            queue->handed_off++;
+        }
+
+        if (packet->timestamp > timestamp) {
+            packets_after_timestamp++;
+        }
+    }
+}
+
+static easyav1_packet *retrieve_first_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    if (!queue->count) {
+        return NULL;
+    }
+
+    return queue->items[queue->begin];
+}
+
+static easyav1_packet *retrieve_last_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    if (!queue->count) {
+        return NULL;
+    }
+
+    return queue->items[(queue->begin + queue->count - 1) % queue->capacity];
+}
+
+static void release_packet_from_queue(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    if (!packet) {
+        return;
+    }
+
+    if (packet->packet) {
+        nestegg_free_packet(packet->packet);
+    }
+
+    easyav1_packet_queue *queue = packet->type == PACKET_TYPE_VIDEO ?
+        &easyav1->packets.video_queue : &easyav1->packets.audio_queue;
+
+    // Should never happen
+    if (packet != queue->items[queue->begin]) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Released packet was not at the beginning of the queue.");
+    }
+
+    queue->begin = (queue->begin + 1) % queue->capacity;
+    queue->count--;
+
+    update_packet_queue_depth(easyav1, queue);
+
+    trace(packet->type == PACKET_TYPE_VIDEO ? EASYAV1_TRACE_VIDEO_PACKET_POP : EASYAV1_TRACE_AUDIO_PACKET_POP,
+        EASYAV1_TRACE_PHASE_INSTANT, packet->timestamp, (int64_t) queue->count);
+
+    if (queue->handed_off) {
+        queue->handed_off--;
+    }
+
+    // Resync list position
+    if (queue->count == 0) {
+        queue->begin = 0;
+    }
+
+    memset(packet, 0, sizeof(easyav1_packet));
+
+    if (easyav1->packets.all_fetched == EASYAV1_FALSE) {
+        easyav1->packets.synced = EASYAV1_FALSE;
+    } else {
+        if (easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0) {
+
+            atomic_store_status(&easyav1->status, EASYAV1_STATUS_FINISHED);
+        }
+    }
+}
+
+static void release_packets_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    while (queue->count) {
+        release_packet_from_queue(easyav1, queue->items[queue->begin]);
+    }
+}
+
+static void destroy_packet_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
+{
+    release_packets_from_queue(easyav1, queue);
+
+    for (size_t i = 0; i < queue->chunk_count; i++) {
+        free(queue->chunks[i]);
+    }
+
+    free(queue->chunks);
+    free(queue->items);
+    memset(queue, 0, sizeof(easyav1_packet_queue));
+}
+
+/**
+ * @brief Adds a packet read from the stream to the performance counters.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param packet The packet that was read.
+ */
+static void count_packet_read(easyav1_t *easyav1, nestegg_packet *packet)
+{
+    unsigned int chunks;
+    size_t bytes = 0;
+
+    if (nestegg_packet_count(packet, &chunks) == 0) {
+        for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+            unsigned char *data;
+            size_t size;
+
+            if (nestegg_packet_data(packet, chunk, &data, &size) == 0) {
+                bytes += size;
+            }
+        }
+    }
+
+    atomic_add_size(&easyav1->counters.packets_read, 1);
+    atomic_add_size(&easyav1->counters.bytes_read, bytes);
+}
+
+static easyav1_packet *prepare_new_packet(easyav1_t *easyav1)
+{
+    nestegg_packet *packet = NULL;
+
+    uint64_t read_start = easyav1->counters.startup.packet_read == EASYAV1_FALSE ? easyav1_get_microseconds() : 0;
+
+    trace(EASYAV1_TRACE_PACKET_READ, EASYAV1_TRACE_PHASE_BEGIN, 0, 0);
+
+    int status = nestegg_read_packet(easyav1->webm.context, &packet);
+
+    trace(EASYAV1_TRACE_PACKET_READ, EASYAV1_TRACE_PHASE_END, 0, status);
+
+    if (easyav1->counters.startup.packet_read == EASYAV1_FALSE) {
+        easyav1->counters.startup.packet_read = EASYAV1_TRUE;
+        atomic_store_size(&easyav1->counters.startup.first_packet_us,
+            (size_t) (easyav1_get_microseconds() - read_start));
+    }
+
+    if (status < 0) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to read packet.");
+        return NULL;
+    }
+
+    if (status == 0) {
+        easyav1->packets.all_fetched = EASYAV1_TRUE;
+        finish_keyframe_index(easyav1, &easyav1->seek.index.cursor);
+        return NULL;
+    }
+
+    count_packet_read(easyav1, packet);
+
+    unsigned int track;
+
+    if (nestegg_packet_track(packet, &track)) {
+        nestegg_free_packet(packet);
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track number from packet.");
+        return NULL;
+    }
+
+    int track_type = nestegg_track_type(easyav1->webm.context, track);
+
+    if (track_type == -1) {
+        nestegg_free_packet(packet);
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track type for track %u.", track);
+        return NULL;
+    } else if (track_type == NESTEGG_TRACK_UNKNOWN) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Skipping unknown track %u of type %d.", track, track_type);
+        nestegg_free_packet(packet);
+        return NULL;
+    }
+
+    easyav1_packet_type type = track_type == NESTEGG_TRACK_VIDEO ? PACKET_TYPE_VIDEO : PACKET_TYPE_AUDIO;
+
+    if (type == PACKET_TYPE_VIDEO &&
+        (easyav1->video.active == EASYAV1_FALSE || easyav1->video.track != track)) {
+        nestegg_free_packet(packet);
+        return NULL;
+    }
+
+    if (type == PACKET_TYPE_AUDIO &&
+        (easyav1->audio.active == EASYAV1_FALSE || easyav1->audio.track != track)) {
+        nestegg_free_packet(packet);
+        return NULL;
+    }
+
+    easyav1_timestamp packet_timestamp;
+
+    if (nestegg_packet_tstamp(packet, &packet_timestamp)) {
+        nestegg_free_packet(packet);
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet timestamp.");
+        return NULL;
+    }
+
+    packet_timestamp = internal_timestamp_to_ms(easyav1, packet_timestamp);
+
+    // This is the only place the duration changes after opening, so it's only ever raised here
+    if (easyav1->duration_is_provisional == EASYAV1_TRUE && packet_timestamp > easyav1->duration) {
+        atomic_store_u64(&easyav1->duration, packet_timestamp);
+    }
+
+    if (type == PACKET_TYPE_AUDIO) {
+        if (easyav1->packets.audio_offset < 0 && -easyav1->packets.audio_offset > packet_timestamp) {
+            nestegg_free_packet(packet);
+            return NULL;
+        }
+
+        // A provisional duration always trails the packets, so it can't tell which ones are past the end
+        if (easyav1->packets.audio_offset > 0 && easyav1->duration_is_provisional == EASYAV1_FALSE &&
+            packet_timestamp + easyav1->packets.audio_offset > easyav1->duration) {
+            nestegg_free_packet(packet);
+            return NULL;
+        }
+
+        packet_timestamp += easyav1->packets.audio_offset;
+    }
+
+    int has_keyframe = nestegg_packet_has_keyframe(packet);
+    if (has_keyframe == -1) {
+        nestegg_free_packet(packet);
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get keyframe status.");
+        return NULL;
+    }
+
+    if (type == PACKET_TYPE_VIDEO && has_keyframe == NESTEGG_PACKET_HAS_KEYFRAME_TRUE) {
+        index_keyframe(easyav1, easyav1->webm.context, packet, packet_timestamp, &easyav1->seek.index.cursor);
+
+        if (easyav1->settings.video_decoder.prefetch_memory_budget &&
+            easyav1->video.decoder_settings.prefetch_sized_from_sequence_header == EASYAV1_FALSE) {
+            size_video_prefetch_from_packet(easyav1, packet);
+        }
+    }
+
+    easyav1_packet *new_packet = queue_new_packet(easyav1, type == PACKET_TYPE_VIDEO ?
+        &easyav1->packets.video_queue : &easyav1->packets.audio_queue);
+
+    if (!new_packet) {
+        nestegg_free_packet(packet);
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for new packet.");
+        return NULL;
+    }
+
+    new_packet->packet = packet;
+    new_packet->timestamp = packet_timestamp;
+    new_packet->is_keyframe = has_keyframe == NESTEGG_PACKET_HAS_KEYFRAME_TRUE ? EASYAV1_TRUE : EASYAV1_FALSE;
+    new_packet->type = type;
+    new_packet->is_seek_packet = easyav1->seek.mode != NOT_SEEKING && packet_timestamp <= easyav1->seek.timestamp;
+    new_packet->discardable = EASYAV1_FALSE;
+    new_packet->droppable = EASYAV1_FALSE;
+    new_packet->skipped = EASYAV1_FALSE;
+
+    trace(type == PACKET_TYPE_VIDEO ? EASYAV1_TRACE_VIDEO_PACKET_PUSH : EASYAV1_TRACE_AUDIO_PACKET_PUSH,
+        EASYAV1_TRACE_PHASE_INSTANT, packet_timestamp, (int64_t) (type == PACKET_TYPE_VIDEO ?
+        easyav1->packets.video_queue.count : easyav1->packets.audio_queue.count));
+
+    if (type == PACKET_TYPE_VIDEO) {
+        hand_off_video_packets(easyav1);
+    }
+
+    return new_packet;
+}
+
+
+/**
+ * @brief Indicates whether we need to fetch at least one packet.
+ *
+ * @param easyav1 The easyav1 context to check.
+ * @return `EASYAV1_TRUE` if we need to fetch at least one packet, `EASYAV1_FALSE` otherwise. 
+ */
+static inline easyav1_bool must_fetch_one_packet(easyav1_t *easyav1)
+{
+    return easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0;
+}
+
+
+/**
+ * @brief Indicates whether we need to fetch more video packets.
+ * 
+ * @param easyav1 The easyav1 context to check.
+ *
+ * @return `EASYAV1_TRUE` if we need to fetch more video packets, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool must_fetch_video_packets(easyav1_t *easyav1)
+{
+    if (easyav1->video.active == EASYAV1_FALSE ||
+        (easyav1->seek.mode != NOT_SEEKING && easyav1->seek.mode != SEEKING_FOR_TIMESTAMP)) {
+        return EASYAV1_FALSE;
+    }
+
+    if (easyav1->packets.video_queue.count > easyav1->video.decoder_settings.prefetch_frames) {
+        return EASYAV1_FALSE;
+    }
+
+    return EASYAV1_TRUE;
+}
+
+
+/**
+ * @brief Indicates whether we need to fetch more audio packets.
+ *
+ * @param easyav1 The easyav1 context to check.
+ * @return `EASYAV1_TRUE` if we need to fetch more audio packets, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool must_fetch_audio_packets(easyav1_t *easyav1)
+{
+    // No audio or performing seek - skip
+    if (easyav1->audio.active == EASYAV1_FALSE) {
+        return EASYAV1_FALSE;
+    }
+
+    // No need to prefetch audio - skip
+    if (easyav1->packets.audio_offset >= 0) {
+        return EASYAV1_FALSE;
+    }
+
+    easyav1_packet *audio_packet = retrieve_last_packet_from_queue(easyav1, &easyav1->packets.audio_queue);
+
+    return audio_packet == NULL || audio_packet->timestamp < atomic_load_u64(&easyav1->position) ?
+        EASYAV1_TRUE : EASYAV1_FALSE;
+}
+
+static easyav1_status sync_packet_queues(easyav1_t *easyav1)
+{
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+        return EASYAV1_STATUS_FINISHED;
+    }
+
+    if (easyav1->packets.synced == EASYAV1_TRUE || easyav1->packets.all_fetched == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_OK;
+    }
+
+    while (easyav1->packets.all_fetched == EASYAV1_FALSE &&
+        (must_fetch_one_packet(easyav1) || must_fetch_video_packets(easyav1) || must_fetch_audio_packets(easyav1))) {
+
+        if (!prepare_new_packet(easyav1) && EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status))) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+    }
+
+    easyav1->packets.synced = EASYAV1_TRUE;
+
+    if (easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0 &&
+        easyav1->packets.all_fetched == EASYAV1_TRUE) {
+        atomic_store_status(&easyav1->status, EASYAV1_STATUS_FINISHED);
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_packet *get_next_packet(easyav1_t *easyav1)
+{
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+        return NULL;
+    }
+
+    if (sync_packet_queues(easyav1) != EASYAV1_STATUS_OK) {
+        return NULL;
+    }
+
+    easyav1_packet *video_packet = retrieve_first_packet_from_queue(easyav1, &easyav1->packets.video_queue);
+    easyav1_packet *audio_packet = retrieve_first_packet_from_queue(easyav1, &easyav1->packets.audio_queue);
+
+    if (!video_packet) {
+        return audio_packet;
+    }
+
+    if (!audio_packet) {
+        return video_packet;
+    }
+
+    if (video_packet->timestamp <= audio_packet->timestamp) {
+        return video_packet;
+    }
+    
+    return audio_packet;
+}
+
+
+/**
+ * Video frame queue functions
+ */
+
+static void enqueue_video_frame(easyav1_t *easyav1, Dav1dPicture *pic)
+{
+    if (easyav1->video.frame_queue.count >= easyav1->video.frame_queue.capacity) {
+        if (get_oldest_video_frame_from_queue(easyav1)->frame_hdr) {
+            atomic_add_size(&easyav1->counters.dropped_frames, 1);
+        }
+
+        dequeue_video_frame(easyav1);
+    }
+
+    size_t index = (easyav1->video.frame_queue.begin + easyav1->video.frame_queue.count) %
+        easyav1->video.frame_queue.capacity;
+    memcpy(&easyav1->video.frame_queue.frames[index], pic, sizeof(Dav1dPicture));
+
+    // The conversion goes into the slot, and the buffer that was there is reused for the next one
+    if (easyav1->video.frame_queue.rgb) {
+        easyav1_rgb_buffer converted = easyav1->video.rgb.spare;
+        easyav1->video.rgb.spare = easyav1->video.frame_queue.rgb[index];
+        easyav1->video.frame_queue.rgb[index] = converted;
+    }
+
+    if (easyav1->video.frame_queue.planes) {
+        easyav1_plane_buffer converted = easyav1->video.planes.spare;
+        easyav1->video.planes.spare = easyav1->video.frame_queue.planes[index];
+        easyav1->video.frame_queue.planes[index] = converted;
+    }
+
+    easyav1->video.frame_queue.count++;
+
+    trace(EASYAV1_TRACE_FRAME_ENQUEUE, EASYAV1_TRACE_PHASE_INSTANT, (easyav1_timestamp) pic->m.timestamp,
+        (int64_t) easyav1->video.frame_queue.count);
+}
+
+static Dav1dPicture *get_oldest_video_frame_from_queue(easyav1_t *easyav1)
+{
+    if (easyav1->video.frame_queue.count == 0) {
+        return NULL;
+    }
+
+    return &easyav1->video.frame_queue.frames[easyav1->video.frame_queue.begin];
+}
+
+static void dequeue_video_frame(easyav1_t *easyav1)
+{
+    Dav1dPicture *pic = get_oldest_video_frame_from_queue(easyav1);
+
+    if (!pic) {
+        return;
+    }
+
+    trace(EASYAV1_TRACE_FRAME_DEQUEUE, EASYAV1_TRACE_PHASE_INSTANT, (easyav1_timestamp) pic->m.timestamp,
+        (int64_t) easyav1->video.frame_queue.count - 1);
+
+    if (pic->frame_hdr) {
+        dav1d_picture_unref(pic);
+    }
+
+    easyav1->video.frame_queue.count--;
+
+    if (easyav1->video.frame_queue.count == 0) {
+        easyav1->video.frame_queue.begin = 0;
+    } else {
+        easyav1->video.frame_queue.begin = (easyav1->video.frame_queue.begin + 1) % easyav1->video.frame_queue.capacity;
+    }
+}
+
+static void dequeue_all_video_frames(easyav1_t *easyav1)
+{
+    while (easyav1->video.frame_queue.count > 0) {
+        dequeue_video_frame(easyav1);
+    }
+}
+
+
+/**
+ * Audio conversion functions
+ */
+
+static size_t audio_sample_size(const easyav1_t *easyav1)
+{
+    return easyav1->settings.audio_format == EASYAV1_AUDIO_FORMAT_S16 ? sizeof(int16_t) : sizeof(float);
+}
+
+#if defined(EASYAV1_HAS_SSE2)
+
+/**
+ * @brief Interleaves the samples of 2, 6 or 8 channels 4 samples at a time with SSE2.
+ *
+ * @return The number of samples interleaved. The remaining ones are left for `interleave_float_samples`.
+ */
+static unsigned int interleave_float_samples_simd(float **pcm, unsigned int offset, unsigned int channels,
+    unsigned int samples, float *out)
+{
+    unsigned int sample = 0;
+
+    if (channels == 2) {
+        for (; sample + 4 <= samples; sample += 4) {
+            __m128 left = _mm_loadu_ps(pcm[0] + offset + sample);
+            __m128 right = _mm_loadu_ps(pcm[1] + offset + sample);
+
+            _mm_storeu_ps(out + sample * 2, _mm_unpacklo_ps(left, right));
+            _mm_storeu_ps(out + sample * 2 + 4, _mm_unpackhi_ps(left, right));
+        }
+    } else if (channels == 6 || channels == 8) {
+        for (; sample + 4 <= samples; sample += 4) {
+            __m128 front[4];
+
+            for (unsigned int channel = 0; channel < 4; channel++) {
+                front[channel] = _mm_loadu_ps(pcm[channel] + offset + sample);
+            }
+
+            _MM_TRANSPOSE4_PS(front[0], front[1], front[2], front[3]);
+
+            if (channels == 8) {
+                __m128 back[4];
+
+                for (unsigned int channel = 0; channel < 4; channel++) {
+                    back[channel] = _mm_loadu_ps(pcm[channel + 4] + offset + sample);
+                }
+
+                _MM_TRANSPOSE4_PS(back[0], back[1], back[2], back[3]);
+
+                for (unsigned int i = 0; i < 4; i++) {
+                    _mm_storeu_ps(out + (sample + i) * 8, front[i]);
+                    _mm_storeu_ps(out + (sample + i) * 8 + 4, back[i]);
+                }
+            } else {
+                // The last two channels are paired up, and each pair is stored after the first four channels
+                __m128 fifth = _mm_loadu_ps(pcm[4] + offset + sample);
+                __m128 sixth = _mm_loadu_ps(pcm[5] + offset + sample);
+                __m128 low = _mm_unpacklo_ps(fifth, sixth);
+                __m128 high = _mm_unpackhi_ps(fifth, sixth);
+                __m128 pairs[4] = { low, _mm_movehl_ps(low, low), high, _mm_movehl_ps(high, high) };
+
+                for (unsigned int i = 0; i < 4; i++) {
+                    _mm_storeu_ps(out + (sample + i) * 6, front[i]);
+                    _mm_storel_epi64((__m128i *) (out + (sample + i) * 6 + 4), _mm_castps_si128(pairs[i]));
+                }
+            }
+        }
+    }
+
+    return sample;
+}
+
+#elif defined(EASYAV1_HAS_NEON)
+
+static inline void transpose_float_samples_neon(float32x4_t *rows)
+{
+    float32x4x2_t even = vzipq_f32(rows[0], rows[2]);
+    float32x4x2_t odd = vzipq_f32(rows[1], rows[3]);
+    float32x4x2_t first = vzipq_f32(even.val[0], odd.val[0]);
+    float32x4x2_t second = vzipq_f32(even.val[1], odd.val[1]);
+
+    rows[0] = first.val[0];
+    rows[1] = first.val[1];
+    rows[2] = second.val[0];
+    rows[3] = second.val[1];
+}
+
+/**
+ * @brief Interleaves the samples of 2, 6 or 8 channels 4 samples at a time with NEON.
+ *
+ * @return The number of samples interleaved. The remaining ones are left for `interleave_float_samples`.
+ */
+static unsigned int interleave_float_samples_simd(float **pcm, unsigned int offset, unsigned int channels,
+    unsigned int samples, float *out)
+{
+    unsigned int sample = 0;
+
+    if (channels == 2) {
+        for (; sample + 4 <= samples; sample += 4) {
+            float32x4x2_t pair = { { vld1q_f32(pcm[0] + offset + sample), vld1q_f32(pcm[1] + offset + sample) } };
+
+            vst2q_f32(out + sample * 2, pair);
+        }
+    } else if (channels == 6 || channels == 8) {
+        for (; sample + 4 <= samples; sample += 4) {
+            float32x4_t front[4];
+
+            for (unsigned int channel = 0; channel < 4; channel++) {
+                front[channel] = vld1q_f32(pcm[channel] + offset + sample);
+            }
+
+            transpose_float_samples_neon(front);
+
+            if (channels == 8) {
+                float32x4_t back[4];
+
+                for (unsigned int channel = 0; channel < 4; channel++) {
+                    back[channel] = vld1q_f32(pcm[channel + 4] + offset + sample);
+                }
+
+                transpose_float_samples_neon(back);
+
+                for (unsigned int i = 0; i < 4; i++) {
+                    vst1q_f32(out + (sample + i) * 8, front[i]);
+                    vst1q_f32(out + (sample + i) * 8 + 4, back[i]);
+                }
+            } else {
+                // The last two channels are paired up, and each pair is stored after the first four channels
+                float32x4x2_t pairs = vzipq_f32(vld1q_f32(pcm[4] + offset + sample), vld1q_f32(pcm[5] + offset + sample));
+
+                for (unsigned int i = 0; i < 4; i++) {
+                    vst1q_f32(out + (sample + i) * 6, front[i]);
+                    vst1_f32(out + (sample + i) * 6 + 4, i & 1 ? vget_high_f32(pairs.val[i / 2]) :
+                        vget_low_f32(pairs.val[i / 2]));
+                }
+            }
+        }
+    }
+
+    return sample;
+}
+
+#endif
+
+/**
+ * @brief Interleaves decoded audio samples.
+ *
+ * @param pcm The decoded samples of each channel.
+ * @param offset The index of the first sample to interleave in each channel.
+ * @param channels The number of channels.
+ * @param samples The number of samples per channel to interleave.
+ * @param out Where to store the interleaved samples.
+ */
+static void interleave_float_samples(float **pcm, unsigned int offset, unsigned int channels, unsigned int samples,
+    float *out)
+{
+    if (channels == 1) {
+        memcpy(out, pcm[0] + offset, samples * sizeof(float));
+        return;
+    }
+
+    unsigned int start = 0;
+
+#if defined(EASYAV1_HAS_SSE2) || defined(EASYAV1_HAS_NEON)
+    start = interleave_float_samples_simd(pcm, offset, channels, samples, out);
+#endif
+
+    // Go one channel at a time, so that at least the reads are sequential
+    for (unsigned int channel = 0; channel < channels; channel++) {
+        const float *in = pcm[channel] + offset;
+
+        for (unsigned int sample = start; sample < samples; sample++) {
+            out[sample * channels + channel] = in[sample];
+        }
+    }
+}
+
+/**
+ * @brief Converts float samples to signed 16-bit samples, rounding to the nearest value and clipping.
+ *
+ * @param in The samples to convert.
+ * @param out Where to store the converted samples.
+ * @param samples The number of samples to convert.
+ */
+static void convert_float_samples_to_s16(const float *in, int16_t *out, unsigned int samples)
+{
+    unsigned int sample = 0;
+
+#if defined(EASYAV1_HAS_SSE2)
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+
+    for (; sample + 8 <= samples; sample += 8) {
+        __m128 low = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + sample), scale), min), max);
+        __m128 high = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + sample + 4), scale), min), max);
+
+        _mm_storeu_si128((__m128i *) (out + sample), _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+    }
+#elif defined(EASYAV1_HAS_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    for (; sample + 8 <= samples; sample += 8) {
+        int32x4_t low = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + sample), 32767.0f));
+        int32x4_t high = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + sample + 4), 32767.0f));
+
+        vst1q_s16(out + sample, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+#endif
+
+    for (; sample < samples; sample++) {
+        float value = in[sample] * 32767.0f;
+
+        if (value < -32768.0f) {
+            value = -32768.0f;
+        } else if (value > 32767.0f) {
+            value = 32767.0f;
+        }
+
+        out[sample] = (int16_t) lrintf(value);
+    }
+}
+
+/**
+ * @brief Copies decoded audio samples to an audio buffer, in the layout and format given by the settings.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param pcm The decoded samples of each channel.
+ * @param offset The index of the first sample to copy in each channel.
+ * @param samples The number of samples per channel to copy. They must fit before the end of the buffer.
+ * @param output The buffer to copy the samples to, either the audio ring buffer or one given by the application.
+ * @param capacity The number of samples per channel the buffer holds, which separates the channels when deinterlaced.
+ * @param position The position in the buffer to copy the samples to.
+ */
+static void store_audio_samples(const easyav1_t *easyav1, float **pcm, unsigned int offset, unsigned int samples,
+    void *output, size_t capacity, unsigned int position)
+{
+    unsigned int channels = easyav1->audio.channels;
+
+    if (easyav1->settings.audio_format == EASYAV1_AUDIO_FORMAT_FLOAT) {
+        float *buffer = output;
+
+        if (easyav1->settings.interlace_audio) {
+            interleave_float_samples(pcm, offset, channels, samples, buffer + (size_t) position * channels);
+            return;
+        }
+
+        for (unsigned int channel = 0; channel < channels; channel++) {
+            memcpy(buffer + channel * capacity + position, pcm[channel] + offset, samples * sizeof(float));
+        }
+
+        return;
+    }
+
+    int16_t *buffer = output;
+
+    if (!easyav1->settings.interlace_audio) {
+        for (unsigned int channel = 0; channel < channels; channel++) {
+            convert_float_samples_to_s16(pcm[channel] + offset, buffer + channel * capacity + position, samples);
+        }
+
+        return;
+    }
+
+    // Interleave a block that stays in the cache, then convert it, so the samples are only read from memory once
+    float block[AUDIO_CONVERSION_BLOCK_SIZE];
+    unsigned int samples_per_block = AUDIO_CONVERSION_BLOCK_SIZE / channels;
+
+    for (unsigned int sample = 0; sample < samples; sample += samples_per_block) {
+        unsigned int block_samples = samples - sample < samples_per_block ? samples - sample : samples_per_block;
+
+        interleave_float_samples(pcm, offset + sample, channels, block_samples, block);
+        convert_float_samples_to_s16(block, buffer + (size_t) (position + sample) * channels, block_samples * channels);
+    }
+}
+
+
+/**
+ * Decoding functions
+ */
+
+static void callback_video(easyav1_t *easyav1)
+{
+    if (!easyav1->settings.callbacks.video) {
+        return;
+    }
+
+    const easyav1_video_frame *frame = easyav1_get_video_frame(easyav1);
+
+    if (!frame) {
+        return;
+    }
+
+    easyav1->settings.callbacks.video(frame, easyav1->settings.callbacks.userdata);
+}
+
+static void callback_audio(easyav1_t *easyav1)
+{
+    if (!easyav1->settings.callbacks.audio) {
+        return;
+    }
+
+    const easyav1_audio_frame *frame = easyav1_get_audio_frame(easyav1);
+
+    if (!frame) {
+        return;
+    }
+
+    easyav1->settings.callbacks.audio(frame, easyav1->settings.callbacks.userdata);
+
+    if (frame->wrapped_samples == 0) {
+        return;
+    }
+
+    // Give the samples that wrapped around the ring buffer as a frame of their own, so that callbacks get one span
+    easyav1_audio_frame wrapped = *frame;
+
+    wrapped.samples = frame->wrapped_samples;
+    wrapped.bytes = frame->wrapped_bytes;
+    wrapped.pcm = frame->wrapped_pcm;
+    wrapped.timestamp += (easyav1_timestamp) frame->samples * 1000 / easyav1->audio.sample_rate;
+    wrapped.wrapped_samples = 0;
+    wrapped.wrapped_bytes = 0;
+
+    easyav1->settings.callbacks.audio(&wrapped, easyav1->settings.callbacks.userdata);
+}
+
+static void pause_video_decoder_thread(easyav1_t *easyav1)
+{
+    // Without video there is no thread to pause, and nothing else takes the decoder thread mutexes
+    if (easyav1->video.decoder_thread.running == EASYAV1_FALSE) {
+        return;
+    }
+
+    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.status);
+
+    atomic_store_size(&easyav1->video.decoder_thread.command, THREAD_COMMAND_PAUSE);
+
+    while (atomic_load_size(&easyav1->video.decoder_thread.command) == THREAD_COMMAND_PAUSE &&
+        easyav1->video.decoder_thread.exited == EASYAV1_FALSE) {
+        // Force the video decoder thread to wake up and check the command
+        // This is necessary because the thread may be waiting for a packet
+        // and won't check the command until it gets one
+        wake_video_decoder_thread(easyav1);
+        pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_changed_status,
+            &easyav1->video.decoder_thread.mutexes.status);
+    }
+}
+
+static void resume_video_decoder_thread(easyav1_t *easyav1)
+{
+    if (easyav1->video.decoder_thread.running == EASYAV1_FALSE) {
+        return;
+    }
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.status);
+    pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_changed_status);
+}
+
+static void stop_video_decoder_thread(easyav1_t *easyav1)
+{
+    atomic_store_size(&easyav1->video.decoder_thread.command, THREAD_COMMAND_STOP);
+
+    resume_video_decoder_thread(easyav1);
+
+    pthread_join(easyav1->video.decoder_thread.decoder, NULL);
+
+    easyav1->video.decoder_thread.running = EASYAV1_FALSE;
+    atomic_store_size(&easyav1->video.decoder_thread.command, THREAD_COMMAND_NONE);
+}
+
+static thread_command handle_video_decoder_thread_command(easyav1_t *easyav1)
+{
+    thread_command command = (thread_command) atomic_load_size(&easyav1->video.decoder_thread.command);
+
+    // Commands are only given while the main thread holds the status mutex, so there's no need to lock it otherwise
+    if (command == THREAD_COMMAND_NONE) {
+        return command;
+    }
+
+    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.status);
+
+    if (atomic_load_size(&easyav1->video.decoder_thread.command) == THREAD_COMMAND_PAUSE) {
+        atomic_store_size(&easyav1->video.decoder_thread.command, THREAD_COMMAND_NONE);
+        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_changed_status);
+        pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_changed_status,
+            &easyav1->video.decoder_thread.mutexes.status);
+    }
+
+    command = (thread_command) atomic_load_size(&easyav1->video.decoder_thread.command);
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.status);
+
+    return command;
+}
+
+static easyav1_bool push_video_packet_to_decoder(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    size_t written = easyav1->video.decoder_thread.decode_queue.written;
+
+    if (written - atomic_load_size(&easyav1->video.decoder_thread.decode_queue.read) == VIDEO_DECODE_QUEUE_SIZE) {
+        return EASYAV1_FALSE;
+    }
+
+    easyav1->video.decoder_thread.decode_queue.packets[written % VIDEO_DECODE_QUEUE_SIZE] = packet;
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.written, written + 1);
+
+    // The store above and the load below pair with the opposite ones in wait_for_video_packets, so either the
+    // decoder thread sees the new packet or we see that it's waiting and wake it up
+    if (atomic_load_size(&easyav1->video.decoder_thread.decode_queue.consumer_waiting)) {
+        pthread_mutex_lock(&easyav1->video.decoder_thread.decode_queue.mutex);
+        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_packets);
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.decode_queue.mutex);
+    }
+
+    return EASYAV1_TRUE;
+}
+
+static easyav1_packet *pop_video_packet_to_decode(easyav1_t *easyav1)
+{
+    size_t read = easyav1->video.decoder_thread.decode_queue.read;
+
+    if (read == atomic_load_size(&easyav1->video.decoder_thread.decode_queue.written)) {
+        return NULL;
+    }
+
+    easyav1_packet *packet = easyav1->video.decoder_thread.decode_queue.packets[read % VIDEO_DECODE_QUEUE_SIZE];
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.read, read + 1);
+
+    return packet;
+}
+
+static void wait_for_video_packets(easyav1_t *easyav1)
+{
+    pthread_mutex_lock(&easyav1->video.decoder_thread.decode_queue.mutex);
+
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.consumer_waiting, 1);
+
+    while (atomic_load_size(&easyav1->video.decoder_thread.decode_queue.written) ==
+        easyav1->video.decoder_thread.decode_queue.read &&
+        easyav1->video.decoder_thread.decode_queue.wake_requested == EASYAV1_FALSE) {
+        pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_packets,
+            &easyav1->video.decoder_thread.decode_queue.mutex);
+    }
+
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.consumer_waiting, 0);
+    easyav1->video.decoder_thread.decode_queue.wake_requested = EASYAV1_FALSE;
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.decode_queue.mutex);
+}
+
+static void wake_video_decoder_thread(easyav1_t *easyav1)
+{
+    pthread_mutex_lock(&easyav1->video.decoder_thread.decode_queue.mutex);
+
+    easyav1->video.decoder_thread.decode_queue.wake_requested = EASYAV1_TRUE;
+    pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_packets);
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.decode_queue.mutex);
+}
+
+static void reset_video_decode_queue(easyav1_t *easyav1)
+{
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.written, 0);
+    atomic_store_size(&easyav1->video.decoder_thread.decode_queue.read, 0);
+
+    for (size_t i = 0; i < easyav1->video.decoder_thread.in_flight.count; i++) {
+        size_t index = (easyav1->video.decoder_thread.in_flight.begin + i) % VIDEO_DECODE_QUEUE_SIZE;
+
+        if (easyav1->video.decoder_thread.in_flight.items[index].picture.frame_hdr) {
+            dav1d_picture_unref(&easyav1->video.decoder_thread.in_flight.items[index].picture);
+        }
+    }
+
+    // The pictures of the packets that were in flight must not come out of the decoder later
+    if (easyav1->video.decoder_thread.in_flight.count > 0) {
+        dav1d_flush(easyav1->video.context);
+    }
+
+    easyav1->video.decoder_thread.in_flight.begin = 0;
+    easyav1->video.decoder_thread.in_flight.count = 0;
+
+    easyav1->packets.video_queue.handed_off = 0;
+}
+
+static void *video_decoder_thread(void *arg)
+{
+    easyav1_t *easyav1 = (easyav1_t *) arg;
+
+    while (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_FALSE) {
+
+        if (handle_video_decoder_thread_command(easyav1) == THREAD_COMMAND_STOP) {
+            break;
+        }
+
+        easyav1_packet *packet = NULL;
+
+        if (easyav1->video.decoder_thread.in_flight.count < VIDEO_DECODE_QUEUE_SIZE) {
+            packet = pop_video_packet_to_decode(easyav1);
+        }
+
+        if (packet == NULL && easyav1->video.decoder_thread.in_flight.count == 0) {
+            wait_for_video_packets(easyav1);
+            continue;
+        }
+
+        if (packet && packet->is_keyframe == EASYAV1_TRUE) {
+            update_decoder_thread_sequence_header(easyav1, packet);
+        }
+
+        // The frames a seek goes past, or that are dropped to keep up, don't need to be decoded at all if no other
+        // frame depends on them
+        if (packet && (packet->discardable == EASYAV1_TRUE || packet->droppable == EASYAV1_TRUE) &&
+            is_unreferenced_video_packet(easyav1, packet) == EASYAV1_TRUE) {
+            skip_video_packet(easyav1, packet);
+            queue_decoded_video_frames(easyav1);
+            continue;
+        }
+
+        acquire_decoder_pool_slot(easyav1->video.pool);
+
+        lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.decoder, &easyav1->counters.contentions.decoder);
+
+        uint64_t decode_start = easyav1_get_microseconds();
+
+        // Keep the decoder fed while there are packets, and only wait for the frames in flight once there are none
+        easyav1_status status = packet ? send_video_packet_to_decoder(easyav1, packet) :
+            collect_video_picture(easyav1, EASYAV1_TRUE);
+
+        size_t decode_time = (size_t) (easyav1_get_microseconds() - decode_start);
+
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
+
+        if (packet) {
+            atomic_add_size(&easyav1->counters.decoded_packets, 1);
+        }
+        atomic_add_size(&easyav1->counters.decode_us, decode_time);
+        atomic_store_size_max(&easyav1->counters.max_decode_us, decode_time);
+
+        release_decoder_pool_slot(easyav1->video.pool);
+
+        if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to decode video packet.");
+            break;
+        }
+
+        queue_decoded_video_frames(easyav1);
+    }
+
+    // Once the thread is gone, nothing would answer a pause command, so pausing must not wait for it
+    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.status);
+
+    easyav1->video.decoder_thread.exited = EASYAV1_TRUE;
+    pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_changed_status);
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.status);
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Video decoder thread exiting.");
+
+    return 0;
+}
+
+static void queue_decoded_video_frames(easyav1_t *easyav1)
+{
+    while (easyav1->video.decoder_thread.in_flight.count > 0) {
+        size_t index = easyav1->video.decoder_thread.in_flight.begin;
+
+        if (easyav1->video.decoder_thread.in_flight.items[index].done == EASYAV1_FALSE) {
+            break;
+        }
+
+        easyav1_packet *packet = easyav1->video.decoder_thread.in_flight.items[index].packet;
+        Dav1dPicture pic = easyav1->video.decoder_thread.in_flight.items[index].picture;
+
+        memset(&easyav1->video.decoder_thread.in_flight.items[index], 0,
+            sizeof(easyav1->video.decoder_thread.in_flight.items[index]));
+
+        easyav1->video.decoder_thread.in_flight.begin = (index + 1) % VIDEO_DECODE_QUEUE_SIZE;
+        easyav1->video.decoder_thread.in_flight.count--;
+
+        // A later packet replaces the frame of a discardable packet before it can be displayed, so it's dropped here
+        if (packet->discardable == EASYAV1_TRUE || packet->skipped == EASYAV1_TRUE) {
+            if (pic.frame_hdr) {
+                dav1d_picture_unref(&pic);
+            }
+        } else {
+            // The spare buffers only belong to this thread until the frame is queued, so no lock is needed
+            if (easyav1->video.frame_queue.rgb) {
+                convert_picture_to_rgb_buffer(easyav1, &pic, &easyav1->video.rgb.spare);
+            }
+
+            if (easyav1->video.frame_queue.planes) {
+                convert_picture_to_plane_buffer(easyav1, &pic, &easyav1->video.planes.spare);
+            }
+        }
+
+        lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+
+        if (packet->discardable == EASYAV1_FALSE && packet->skipped == EASYAV1_FALSE) {
+            if (packet->is_seek_packet == EASYAV1_TRUE) {
+                dequeue_video_frame(easyav1);
+            }
+
+            enqueue_video_frame(easyav1, &pic);
+        }
+
+        packet->decoded = EASYAV1_TRUE;
+
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+
+        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_frames_to_display);
+    }
+}
+
+static easyav1_status seek_sequence_header(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size)
+{
+    Dav1dSequenceHeader sequence_header;
+
+    int result = dav1d_parse_sequence_header(&sequence_header, data, size);
+
+    if (result < 0 && result != DAV1D_ERR(ENOENT)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to parse sequence header");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (result == 0) {
+        easyav1->seek.mode = SEEKING_FOR_KEYFRAME;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * Dummy function that is passed to the AV1 decoder to free the data buffer.
+ * This is a no-op function that does nothing.
+ */
+static void free_nothing(const uint8_t *data, void *cookie)
+{}
+
+static easyav1_status decode_video(easyav1_t *easyav1, Dav1dContext *context, easyav1_packet *packet,
+    Dav1dPicture *pic, uint64_t *processed_frames)
+{
+    unsigned int chunks;
+
+    if (nestegg_packet_count(packet->packet, &chunks)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to get packet count");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_bool has_picture = EASYAV1_FALSE;
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned char *data;
+        size_t size;
+
+        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to get data from packet");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        Dav1dData buf = { 0 };
+        int result = dav1d_data_wrap(&buf, data, size, free_nothing, 0);
+
+        if (result < 0) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create data buffer");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        do {
+
+            result = dav1d_send_data(context, &buf);
+            if (result < 0 && result != DAV1D_ERR(EAGAIN)) {
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to send data to AV1 decoder");
+                dav1d_data_unref(&buf);
+                return EASYAV1_STATUS_ERROR;
+            }
+
+            Dav1dPicture temp_pic = { 0 };
+
+            result = dav1d_get_picture(context, &temp_pic);
+
+            // For some reason, sometimes we need to insist on getting the picture without sending more data
+            if (result == DAV1D_ERR(EAGAIN)) {
+                result = dav1d_get_picture(context, &temp_pic);
+            }
+
+            if (result < 0) {
+                if (result == DAV1D_ERR(EAGAIN)) {
+                    continue;
+                }
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to get picture from AV1 decoder");
+                dav1d_data_unref(&buf);
+                return EASYAV1_STATUS_ERROR;
+            }
+
+            (*processed_frames)++;
+
+            if (has_picture == EASYAV1_FALSE) {
+                *pic = temp_pic;
+                pic->m.timestamp = packet->timestamp;
+                has_picture = EASYAV1_TRUE;
+            } else {
+                log(EASYAV1_LOG_LEVEL_WARNING, "Multiple pictures in single packet are not supported.");
+                dav1d_picture_unref(&temp_pic);
+            }
+
+        } while (buf.sz > 0);
+
+        dav1d_data_unref(&buf);
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status send_video_packet_to_decoder(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    unsigned int chunks;
+
+    if (nestegg_packet_count(packet->packet, &chunks)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet count");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    size_t index = (easyav1->video.decoder_thread.in_flight.begin + easyav1->video.decoder_thread.in_flight.count) %
+        VIDEO_DECODE_QUEUE_SIZE;
+
+    easyav1->video.decoder_thread.in_flight.items[index].packet = packet;
+    easyav1->video.decoder_thread.in_flight.items[index].done = EASYAV1_FALSE;
+    easyav1->video.decoder_thread.in_flight.count++;
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned char *data;
+        size_t size;
+
+        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get data from packet");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        Dav1dData buf = { 0 };
+        int result = dav1d_data_wrap(&buf, data, size, free_nothing, 0);
+
+        if (result < 0) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create data buffer");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        // The decoder copies the timestamp to the picture, which is how the picture finds its packet later
+        buf.m.timestamp = (int64_t) packet->timestamp;
+
+        do {
+            trace(EASYAV1_TRACE_DECODER_SEND, EASYAV1_TRACE_PHASE_BEGIN, packet->timestamp, 0);
+
+            result = dav1d_send_data(easyav1->video.context, &buf);
+
+            trace(EASYAV1_TRACE_DECODER_SEND, EASYAV1_TRACE_PHASE_END, packet->timestamp, result);
+
+            if (result < 0 && result != DAV1D_ERR(EAGAIN)) {
+                LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to send data to AV1 decoder");
+                dav1d_data_unref(&buf);
+                return EASYAV1_STATUS_ERROR;
+            }
+
+            // When the decoder can't take more data, a picture must be taken out first
+            if (collect_video_picture(easyav1, result == DAV1D_ERR(EAGAIN)) == EASYAV1_STATUS_ERROR) {
+                dav1d_data_unref(&buf);
+                return EASYAV1_STATUS_ERROR;
+            }
+        } while (buf.sz > 0);
+
+        dav1d_data_unref(&buf);
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+/**
+ * @brief Gets a picture from the AV1 decoder of the instance, tracing the call.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param pic The picture to fill.
+ *
+ * @return The result of `dav1d_get_picture`.
+ */
+static int get_picture_from_decoder(easyav1_t *easyav1, Dav1dPicture *pic)
+{
+    trace(EASYAV1_TRACE_DECODER_GET, EASYAV1_TRACE_PHASE_BEGIN, 0, 0);
+
+    int result = dav1d_get_picture(easyav1->video.context, pic);
+
+    trace(EASYAV1_TRACE_DECODER_GET, EASYAV1_TRACE_PHASE_END, result == 0 ? (easyav1_timestamp) pic->m.timestamp : 0,
+        result);
+
+    return result;
+}
+
+static easyav1_status collect_video_picture(easyav1_t *easyav1, easyav1_bool drain)
+{
+    Dav1dPicture pic = { 0 };
+
+    int result = get_picture_from_decoder(easyav1, &pic);
+
+    // Asking again without sending more data makes the decoder wait for the oldest frame in flight
+    if (result == DAV1D_ERR(EAGAIN) && drain == EASYAV1_TRUE) {
+        result = get_picture_from_decoder(easyav1, &pic);
+
+        // Nothing is left in the decoder, so the packets that didn't output a picture are done
+        if (result == DAV1D_ERR(EAGAIN)) {
+            for (size_t i = 0; i < easyav1->video.decoder_thread.in_flight.count; i++) {
+                size_t index = (easyav1->video.decoder_thread.in_flight.begin + i) % VIDEO_DECODE_QUEUE_SIZE;
+                easyav1->video.decoder_thread.in_flight.items[index].done = EASYAV1_TRUE;
+            }
+
+            return EASYAV1_STATUS_OK;
+        }
+    }
+
+    if (result == DAV1D_ERR(EAGAIN)) {
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (result < 0) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get picture from AV1 decoder");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->counters.startup.frame_decoded == EASYAV1_FALSE) {
+        easyav1->counters.startup.frame_decoded = EASYAV1_TRUE;
+        atomic_store_size(&easyav1->counters.startup.first_frame_us,
+            (size_t) (easyav1_get_microseconds() - easyav1->counters.startup.begin));
+    }
+
+    atomic_add_u64(&easyav1->video.processed_frames, 1);
+
+    // Pictures come out in the order their packets were sent, so the packets before the one this picture belongs to
+    // didn't output any picture. If no packet has the timestamp of the picture, it belongs to the oldest one left.
+    size_t target = easyav1->video.decoder_thread.in_flight.count;
+    size_t first_pending = easyav1->video.decoder_thread.in_flight.count;
+
+    for (size_t i = 0; i < easyav1->video.decoder_thread.in_flight.count; i++) {
+        size_t index = (easyav1->video.decoder_thread.in_flight.begin + i) % VIDEO_DECODE_QUEUE_SIZE;
+
+        if (easyav1->video.decoder_thread.in_flight.items[index].packet->timestamp ==
+            (easyav1_timestamp) pic.m.timestamp) {
+            target = i;
+            break;
+        }
+
+        if (first_pending == easyav1->video.decoder_thread.in_flight.count &&
+            easyav1->video.decoder_thread.in_flight.items[index].done == EASYAV1_FALSE) {
+            first_pending = i;
+        }
+    }
+
+    if (target == easyav1->video.decoder_thread.in_flight.count) {
+        target = first_pending;
+    }
+
+    size_t index = (easyav1->video.decoder_thread.in_flight.begin + target) % VIDEO_DECODE_QUEUE_SIZE;
+
+    if (target == easyav1->video.decoder_thread.in_flight.count) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Decoded a picture without a packet in flight.");
+        dav1d_picture_unref(&pic);
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (easyav1->video.decoder_thread.in_flight.items[index].picture.frame_hdr) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Multiple pictures in single packet are not supported.");
+        dav1d_picture_unref(&pic);
+        return EASYAV1_STATUS_OK;
+    }
+
+    for (size_t i = 0; i <= target; i++) {
+        easyav1->video.decoder_thread.in_flight.items[(easyav1->video.decoder_thread.in_flight.begin + i) %
+            VIDEO_DECODE_QUEUE_SIZE].done = EASYAV1_TRUE;
+    }
+
+    pic.m.timestamp = (int64_t) easyav1->video.decoder_thread.in_flight.items[index].packet->timestamp;
+    easyav1->video.decoder_thread.in_flight.items[index].picture = pic;
+
+    return EASYAV1_STATUS_OK;
+}
+
+static uint32_t read_bits(easyav1_bit_reader *reader, unsigned int bits)
+{
+    uint32_t value = 0;
+
+    for (unsigned int bit = 0; bit < bits; bit++) {
+        size_t byte = reader->position >> 3;
+
+        if (byte >= reader->size) {
+            reader->overrun = EASYAV1_TRUE;
+            value <<= 1;
+            continue;
+        }
+
+        value = (value << 1) | ((reader->data[byte] >> (7 - (reader->position & 7))) & 1);
+        reader->position++;
+    }
+
+    return value;
+}
+
+static uint64_t read_leb128(easyav1_bit_reader *reader)
+{
+    uint64_t value = 0;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        uint32_t byte = read_bits(reader, 8);
+
+        value |= (uint64_t) (byte & 0x7f) << (i * 7);
+
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+static easyav1_bool is_unreferenced_frame_header(const Dav1dSequenceHeader *sequence_header,
+    easyav1_bit_reader *reader, unsigned int temporal_id, unsigned int spatial_id)
+{
+    // Still pictures are always keyframes, and frames shown again from the reference frames are cheap anyway
+    if (sequence_header->reduced_still_picture_header || read_bits(reader, 1)) {
+        return EASYAV1_FALSE;
+    }
+
+    unsigned int frame_type = read_bits(reader, 2);
+    unsigned int show_frame = read_bits(reader, 1);
+
+    if (show_frame && sequence_header->decoder_model_info_present && !sequence_header->equal_picture_interval) {
+        read_bits(reader, sequence_header->frame_presentation_delay_length);
+    }
+
+    if (!show_frame) {
+        read_bits(reader, 1); // showable_frame
+    }
+
+    // These frames refresh all the reference frames
+    if (frame_type == DAV1D_FRAME_TYPE_SWITCH || (frame_type == DAV1D_FRAME_TYPE_KEY && show_frame)) {
+        return EASYAV1_FALSE;
+    }
+
+    unsigned int error_resilient_mode = read_bits(reader, 1);
+
+    read_bits(reader, 1); // disable_cdf_update
+
+    unsigned int allow_screen_content_tools = sequence_header->screen_content_tools == DAV1D_ADAPTIVE ?
+        read_bits(reader, 1) : sequence_header->screen_content_tools;
+
+    if (allow_screen_content_tools && sequence_header->force_integer_mv == DAV1D_ADAPTIVE) {
+        read_bits(reader, 1); // force_integer_mv
+    }
+
+    if (sequence_header->frame_id_numbers_present) {
+        read_bits(reader, sequence_header->frame_id_n_bits);
+    }
+
+    read_bits(reader, 1); // frame_size_override_flag
+
+    if (sequence_header->order_hint) {
+        read_bits(reader, sequence_header->order_hint_n_bits);
+    }
+
+    if (frame_type != DAV1D_FRAME_TYPE_INTRA && frame_type != DAV1D_FRAME_TYPE_KEY && !error_resilient_mode) {
+        read_bits(reader, 3); // primary_ref_frame
+    }
+
+    if (sequence_header->decoder_model_info_present && read_bits(reader, 1)) {
+        for (unsigned int i = 0; i < sequence_header->num_operating_points; i++) {
+            const Dav1dSequenceOperatingPoint *operating_point = &sequence_header->operating_points[i];
+
+            if (!operating_point->decoder_model_param_present) {
+                continue;
+            }
+
+            unsigned int in_temporal_layer = (operating_point->idc >> temporal_id) & 1;
+            unsigned int in_spatial_layer = (operating_point->idc >> (spatial_id + 8)) & 1;
+
+            if (!operating_point->idc || (in_temporal_layer && in_spatial_layer)) {
+                read_bits(reader, sequence_header->buffer_removal_delay_length);
+            }
+        }
+    }
+
+    unsigned int refresh_frame_flags = read_bits(reader, 8);
+
+    return refresh_frame_flags == 0 && reader->overrun == EASYAV1_FALSE ? EASYAV1_TRUE : EASYAV1_FALSE;
+}
+
+static easyav1_bool is_unreferenced_video_packet(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    if (easyav1->video.decoder_thread.sequence_header.found == EASYAV1_FALSE) {
+        return EASYAV1_FALSE;
+    }
+
+    unsigned int chunks;
+
+    if (nestegg_packet_count(packet->packet, &chunks)) {
+        return EASYAV1_FALSE;
+    }
+
+    easyav1_bool has_frame_header = EASYAV1_FALSE;
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned char *data;
+        size_t size;
+
+        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
+            return EASYAV1_FALSE;
+        }
+
+        easyav1_bit_reader reader = { .data = data, .size = size };
+
+        while (reader.position < size * 8) {
+            uint32_t header = read_bits(&reader, 8);
+            unsigned int type = (header >> 3) & 0xf;
+            unsigned int temporal_id = 0;
+            unsigned int spatial_id = 0;
+
+            if (header & 0x4) {
+                uint32_t extension = read_bits(&reader, 8);
+                temporal_id = extension >> 5;
+                spatial_id = (extension >> 3) & 0x3;
+            }
+
+            uint64_t obu_size = header & 0x2 ? read_leb128(&reader) : size - reader.position / 8;
+
+            if (reader.overrun == EASYAV1_TRUE || obu_size > size - reader.position / 8) {
+                return EASYAV1_FALSE;
+            }
+
+            if (type == DAV1D_OBU_SEQ_HDR) {
+                return EASYAV1_FALSE;
+            }
+
+            if (type == DAV1D_OBU_FRAME_HDR || type == DAV1D_OBU_FRAME) {
+                easyav1_bit_reader frame_reader = { .data = data + reader.position / 8, .size = (size_t) obu_size };
+
+                if (is_unreferenced_frame_header(&easyav1->video.decoder_thread.sequence_header.header,
+                    &frame_reader, temporal_id, spatial_id) == EASYAV1_FALSE) {
+                    return EASYAV1_FALSE;
+                }
+
+                has_frame_header = EASYAV1_TRUE;
+            }
+
+            reader.position += (size_t) obu_size * 8;
+        }
+    }
+
+    return has_frame_header;
+}
+
+static void update_decoder_thread_sequence_header(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    unsigned int chunks;
+
+    if (nestegg_packet_count(packet->packet, &chunks)) {
+        return;
+    }
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned char *data;
+        size_t size;
+
+        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
+            return;
+        }
+
+        if (dav1d_parse_sequence_header(&easyav1->video.decoder_thread.sequence_header.header, data, size) == 0) {
+            easyav1->video.decoder_thread.sequence_header.found = EASYAV1_TRUE;
+            return;
+        }
+    }
+}
+
+static void skip_video_packet(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    size_t index = (easyav1->video.decoder_thread.in_flight.begin + easyav1->video.decoder_thread.in_flight.count) %
+        VIDEO_DECODE_QUEUE_SIZE;
+
+    easyav1->video.decoder_thread.in_flight.items[index].packet = packet;
+    easyav1->video.decoder_thread.in_flight.items[index].done = EASYAV1_TRUE;
+    easyav1->video.decoder_thread.in_flight.count++;
+
+    // Only read once the packet is decoded, which is set with the io mutex locked
+    packet->skipped = EASYAV1_TRUE;
+
+    atomic_add_size(packet->discardable == EASYAV1_TRUE ? &easyav1->counters.seek_skipped_frames :
+        &easyav1->counters.degradation.dropped_frames, 1);
+}
+
+static easyav1_status decode_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size)
+{
+    ogg_packet audio_packet = {
+        .packet = data,
+        .bytes = size
+    };
+
+    if (easyav1->audio.has_samples_in_buffer == EASYAV1_FALSE) {
+        easyav1->audio.queued = 0;
+        easyav1->audio.frame.timestamp = packet->timestamp;
+    }
+
+    if (easyav1->seek.mode != NOT_SEEKING) {
+        if (vorbis_synthesis_trackonly(&easyav1->audio.vorbis.block, &audio_packet) ||
+            vorbis_synthesis_blockin(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio packet.");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        int decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, 0);
+        vorbis_synthesis_read(&easyav1->audio.vorbis.dsp, decoded_samples);
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (synthesize_audio(easyav1, packet, data, size) == EASYAV1_STATUS_ERROR) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    float **pcm;
+
+    int decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, &pcm);
+    
+    while (decoded_samples > 0) {
+        queue_audio_samples(easyav1, pcm, decoded_samples);
+
+        vorbis_synthesis_read(&easyav1->audio.vorbis.dsp, decoded_samples);
+
+        decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, &pcm);
+    }
+
+    if (easyav1->audio.queued > 0) {
+        easyav1->audio.has_samples_in_buffer = EASYAV1_TRUE;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status synthesize_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size)
+{
+    ogg_packet audio_packet = {
+        .packet = data,
+        .bytes = size
+    };
+
+    if (vorbis_synthesis(&easyav1->audio.vorbis.block, &audio_packet) ||
+        vorbis_synthesis_blockin(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio packet at timestamp %llu.",
+            packet->timestamp);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static void queue_audio_samples(easyav1_t *easyav1, float **pcm, unsigned int decoded_samples)
+{
+    unsigned int pcm_offset = prepare_audio_buffer_for_new_samples(easyav1, decoded_samples);
+    unsigned int samples = decoded_samples - pcm_offset;
+    unsigned int position = (easyav1->audio.begin + easyav1->audio.queued) % easyav1->audio.capacity;
+    unsigned int samples_before_end = easyav1->audio.capacity - position;
+
+    // The samples that don't fit before the end of the ring buffer wrap around to its start
+    if (samples > samples_before_end) {
+        store_audio_samples(easyav1, pcm, pcm_offset, samples_before_end, easyav1->audio.buffer,
+            easyav1->audio.capacity, position);
+        store_audio_samples(easyav1, pcm, pcm_offset + samples_before_end, samples - samples_before_end,
+            easyav1->audio.buffer, easyav1->audio.capacity, 0);
+    } else {
+        store_audio_samples(easyav1, pcm, pcm_offset, samples, easyav1->audio.buffer, easyav1->audio.capacity,
+            position);
+    }
+
+    easyav1->audio.queued += samples;
+}
+
+static unsigned int prepare_audio_buffer_for_new_samples(easyav1_t *easyav1, int decoded_samples)
+{
+    unsigned int capacity = easyav1->audio.capacity;
+
+    if (easyav1->audio.queued + decoded_samples <= capacity) {
+        return 0;
+    }
+
+    // The samples weren't read in time, so the oldest ones are dropped to fit the new ones
+    unsigned int samples_to_drop = easyav1->audio.queued + decoded_samples - capacity;
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Audio buffer overrun, dropping %u samples.", samples_to_drop);
+
+    atomic_store_size(&easyav1->audio.overrun.overruns, easyav1->audio.overrun.overruns + 1);
+    atomic_store_size(&easyav1->audio.overrun.dropped_samples,
+        easyav1->audio.overrun.dropped_samples + samples_to_drop);
+
+    easyav1->audio.frame.timestamp += (easyav1_timestamp) samples_to_drop * 1000 / easyav1->audio.sample_rate;
+
+    if (samples_to_drop <= easyav1->audio.queued) {
+        easyav1->audio.begin = (easyav1->audio.begin + samples_to_drop) % capacity;
+        easyav1->audio.queued -= samples_to_drop;
+        return 0;
+    }
+
+    // There are more new samples than the buffer holds, so only the last ones are kept
+    unsigned int pcm_offset = samples_to_drop - easyav1->audio.queued;
+
+    easyav1->audio.begin = (easyav1->audio.begin + easyav1->audio.queued) % capacity;
+    easyav1->audio.queued = 0;
+
+    return pcm_offset;
+}
+
+static easyav1_status send_packet_data_to_decoder(easyav1_t *easyav1, easyav1_packet *packet, decoder_function decode)
+{
+    unsigned int chunks;
+
+    if (nestegg_packet_count(packet->packet, &chunks)) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet count");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned char *data;
+        size_t size;
+
+        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get data from packet");
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (decode(easyav1, packet, data, size) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+static easyav1_status decode_packet(easyav1_t *easyav1, easyav1_packet *packet)
+{
+    if (packet->type == PACKET_TYPE_AUDIO) {
+        return send_packet_data_to_decoder(easyav1, packet, decode_audio);
+    }
+
+    // Decoding video: use multithreaded decoder
+    if (easyav1->seek.mode == NOT_SEEKING || easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
+
+        // A keyframe held back for a quality switch is only handed off once the decoder is opened again
+        if (easyav1->packets.video_queue.handed_off == 0 &&
+            must_switch_video_decoder_quality(easyav1, packet) == EASYAV1_TRUE &&
+            switch_video_decoder_quality(easyav1) == EASYAV1_STATUS_ERROR) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+
+        uint64_t wait_start = packet->decoded == EASYAV1_FALSE ? easyav1_get_microseconds() : 0;
+
+        while (packet->decoded == EASYAV1_FALSE) {
+
+            // The position may have moved since the packets were last handed off to the decoder thread,
+            // or the decode queue may have been full at the time, so more packets may need to be handed off now.
+            // This is done while holding the io mutex, so no decoded frame can be signaled before we start waiting.
+            hand_off_video_packets(easyav1);
+
+            log(EASYAV1_LOG_LEVEL_INFO, "Waiting for video frame to be decoded.");
+            atomic_add_size(&easyav1->counters.blocked_waits, 1);
+            pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_frames_to_display,
+                &easyav1->video.decoder_thread.mutexes.io);
+
+            if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+                pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+                return EASYAV1_STATUS_ERROR;
+            }
+        }
+
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+
+        if (wait_start) {
+            atomic_add_size(&easyav1->counters.blocked_us, (size_t) (easyav1_get_microseconds() - wait_start));
+        }
+
+        if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (easyav1->settings.skip_unprocessed_frames == EASYAV1_FALSE && packet->discardable == EASYAV1_FALSE &&
+            packet->skipped == EASYAV1_FALSE) {
+            callback_video(easyav1);
+        }
+
+        return EASYAV1_STATUS_OK;
+    }
+
+    // Seeking, do not decode video frames
+    if (easyav1->seek.mode == SEEKING_FOR_SQHDR) {
+        easyav1_status status = send_packet_data_to_decoder(easyav1, packet, seek_sequence_header);
+
+        if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    if (easyav1->seek.mode == SEEKING_FOR_KEYFRAME && packet->is_keyframe == EASYAV1_TRUE) {
+        easyav1->seek.mode = SEEKING_FOUND_KEYFRAME;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+easyav1_status easyav1_decode_next(easyav1_t *easyav1)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->seek.mode != NOT_SEEKING) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Cannot decode while seeking.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Cannot manually decode when using playback functions.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    uint64_t decode_start = easyav1->counters.startup.decoded == EASYAV1_FALSE ? easyav1_get_microseconds() : 0;
+
+    easyav1_packet *packet = get_next_packet(easyav1);
+
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+        return EASYAV1_STATUS_FINISHED;
+    }
+
+    if (!packet) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    atomic_store_u64(&easyav1->position, packet->timestamp);
+    easyav1_packet_type packet_type = packet->type;
+
+    easyav1_status status = decode_packet(easyav1, packet);
+
+    if (packet_type == PACKET_TYPE_VIDEO) {
+        lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+    }
+
+    release_packet_from_queue(easyav1, packet);
+
+    if (packet_type == PACKET_TYPE_VIDEO) {
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    }
+
+    if (status == EASYAV1_STATUS_OK) {
+        callback_video(easyav1);
+        callback_audio(easyav1);
+    }
+
+    if (easyav1->counters.startup.decoded == EASYAV1_FALSE) {
+        easyav1->counters.startup.decoded = EASYAV1_TRUE;
+        atomic_store_size(&easyav1->counters.startup.first_decode_us,
+            (size_t) (easyav1_get_microseconds() - decode_start));
+    }
+
+    return status;
+}
+
+static easyav1_status do_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+        return EASYAV1_STATUS_FINISHED;
+    }
+
+    if (timestamp <= atomic_load_u64(&easyav1->position)) {
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (easyav1->seek.mode != NOT_SEEKING) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Cannot decode while seeking.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    easyav1_timestamp position = atomic_load_u64(&easyav1->position);
+
+    // The lag is how late the oldest packet that still has to be decoded is
+    easyav1_packet *next_packet = get_next_packet(easyav1);
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1_timestamp lag = next_packet && next_packet->timestamp < timestamp ? timestamp - next_packet->timestamp : 0;
+
+    update_degradation_level(easyav1, lag);
+
+    // Skip to timestamp if too far behind and at different cue points, unless the stream can't be seeked
+    if (easyav1->settings.skip_unprocessed_frames == EASYAV1_TRUE && easyav1->settings.degradation.skip_ms &&
+        easyav1->stream.seekable == EASYAV1_TRUE &&
+        lag > easyav1->settings.degradation.skip_ms &&
+        get_closest_cue_point(easyav1, position) < get_closest_cue_point(easyav1, timestamp)) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Decoder too far behind at %llu, skipping to requested timestamp %llu.",
+            position, timestamp);
+
+        atomic_add_size(&easyav1->counters.degradation.skips, 1);
+
+        easyav1_bool use_fast_seeking = easyav1->settings.use_fast_seeking;
+        easyav1->settings.use_fast_seeking = EASYAV1_TRUE;
+
+        // Use fast seeking to prevent constantly seeking to the next seek point
+        easyav1_status status = do_seek_to_timestamp(easyav1, timestamp);
+
+        easyav1->settings.use_fast_seeking = use_fast_seeking;
+
+        if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    easyav1_status status = atomic_load_status(&easyav1->status);
+
+    while (status == EASYAV1_STATUS_OK) {
+        easyav1_packet *packet = get_next_packet(easyav1);
+
+        if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+            status = EASYAV1_STATUS_FINISHED;
+            break;
+        }
+
+        if (!packet) {
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        if (easyav1->playback.do_pause == EASYAV1_TRUE || atomic_load_size(&easyav1->playback.seek.requested)) {
+            return status;
+        }
+
+        if (packet->timestamp >= timestamp) {
+            break;
+        }
+
+        atomic_store_u64(&easyav1->position, packet->timestamp);
+        easyav1_packet_type packet_type = packet->type;
+
+        status = decode_packet(easyav1, packet);
+
+
+        if (packet_type == PACKET_TYPE_VIDEO) {
+            lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+        }
+    
+        release_packet_from_queue(easyav1, packet);
+
+        if (packet_type == PACKET_TYPE_VIDEO) {
+            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+        }
+    }
+
+    if (status == EASYAV1_STATUS_OK) {
+        atomic_store_u64(&easyav1->position, timestamp);
+    }
+
+    if (status != EASYAV1_STATUS_ERROR) {
+        callback_video(easyav1);
+        callback_audio(easyav1);
+    }
+
+    return status;
+}
+
+easyav1_status easyav1_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Cannot manually decode when using playback functions.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    return do_decode_until(easyav1, timestamp);
+}
+
+easyav1_status easyav1_decode_for(easyav1_t *easyav1, easyav1_timestamp time)
+{
+    return easyav1_decode_until(easyav1, atomic_load_u64(&easyav1->position) + time);
+}
+
+static size_t read_queued_audio_samples(easyav1_t *easyav1, void *output, size_t capacity)
+{
+    size_t samples = easyav1->audio.queued < capacity ? easyav1->audio.queued : capacity;
+    size_t sample_size = audio_sample_size(easyav1);
+    unsigned int channels = easyav1->audio.channels;
+    unsigned int begin = easyav1->audio.begin;
+    unsigned int ring_capacity = easyav1->audio.capacity;
+    const uint8_t *ring = easyav1->audio.buffer;
+    uint8_t *out = output;
+
+    // The samples may wrap around the end of the ring buffer, so they are copied in up to two spans
+    size_t first_span = begin + samples > ring_capacity ? ring_capacity - begin : samples;
+
+    if (easyav1->settings.interlace_audio) {
+        size_t frame_size = sample_size * channels;
+
+        memcpy(out, ring + begin * frame_size, first_span * frame_size);
+        memcpy(out + first_span * frame_size, ring, (samples - first_span) * frame_size);
+    } else {
+        for (unsigned int channel = 0; channel < channels; channel++) {
+            uint8_t *out_channel = out + channel * capacity * sample_size;
+            const uint8_t *ring_channel = ring + (size_t) channel * ring_capacity * sample_size;
+
+            memcpy(out_channel, ring_channel + begin * sample_size, first_span * sample_size);
+            memcpy(out_channel + first_span * sample_size, ring_channel, (samples - first_span) * sample_size);
+        }
+    }
+
+    easyav1->audio.begin = (unsigned int) ((begin + samples) % ring_capacity);
+    easyav1->audio.queued -= (unsigned int) samples;
+    easyav1->audio.frame.timestamp += (easyav1_timestamp) samples * 1000 / easyav1->audio.sample_rate;
+
+    if (easyav1->audio.queued == 0) {
+        easyav1->audio.has_samples_in_buffer = EASYAV1_FALSE;
+    }
+
+    return samples;
+}
+
+easyav1_status easyav1_decode_audio_samples(easyav1_t *easyav1, void *output, size_t samples, size_t *decoded)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (!output || !decoded) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "No output buffer or decoded sample count given.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    *decoded = 0;
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->audio.active == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "There is no active audio track to decode.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->video.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Audio can only be decoded into a buffer when there is no active video track.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1->playback.active == EASYAV1_TRUE || easyav1->seek.mode != NOT_SEEKING) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Can't decode audio into a buffer while playing or seeking.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // The samples decoded by the other decoding functions come first
+    size_t written = easyav1->audio.has_samples_in_buffer == EASYAV1_TRUE ?
+        read_queued_audio_samples(easyav1, output, samples) : 0;
+
+    while (written < samples) {
+        float **pcm;
+        int pending = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, &pcm);
+
+        // The samples that don't fit stay in the decoder until the next call
+        if (pending > 0) {
+            unsigned int count = (size_t) pending < samples - written ? (unsigned int) pending :
+                (unsigned int) (samples - written);
+
+            store_audio_samples(easyav1, pcm, 0, count, output, samples, (unsigned int) written);
+            vorbis_synthesis_read(&easyav1->audio.vorbis.dsp, (int) count);
+            written += count;
+            continue;
+        }
+
+        easyav1_packet *packet = get_next_packet(easyav1);
+
+        if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+            break;
+        }
+
+        if (!packet) {
+            *decoded = written;
+            return EASYAV1_STATUS_ERROR;
+        }
+
+        atomic_store_u64(&easyav1->position, packet->timestamp);
+
+        easyav1_status status = send_packet_data_to_decoder(easyav1, packet, synthesize_audio);
+
+        release_packet_from_queue(easyav1, packet);
+
+        if (status == EASYAV1_STATUS_ERROR) {
+            *decoded = written;
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
+
+    *decoded = written;
+
+    return written == 0 && atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED ?
+        EASYAV1_STATUS_FINISHED : EASYAV1_STATUS_OK;
+}
+
+
+/**
+ * Degradation functions
+ */
+
+static easyav1_video_quality get_degraded_video_quality(const easyav1_t *easyav1)
+{
+    return easyav1->degradation.level >= EASYAV1_DEGRADATION_LOWER_QUALITY ? EASYAV1_VIDEO_QUALITY_PREVIEW :
+        easyav1->settings.video_decoder.quality;
+}
+
+static void update_degradation_level(easyav1_t *easyav1, easyav1_timestamp lag)
+{
+    uint64_t now = easyav1_get_ticks();
+    uint64_t elapsed = easyav1->degradation.measured == EASYAV1_TRUE ? now - easyav1->degradation.last_measure : 0;
+
+    easyav1->degradation.measured = EASYAV1_TRUE;
+    easyav1->degradation.last_measure = now;
+
+    if (lag > elapsed) {
+        lag = elapsed;
+    }
+
+    atomic_store_size(&easyav1->counters.degradation.lag_ms, (size_t) lag);
+    atomic_store_size_max(&easyav1->counters.degradation.max_lag_ms, (size_t) lag);
+
+    unsigned int thresholds[] = {
+        0,
+        easyav1->settings.degradation.drop_frames_ms,
+        easyav1->settings.degradation.lower_quality_ms
+    };
+
+    easyav1_degradation_level level = EASYAV1_DEGRADATION_NONE;
+
+    if (easyav1->settings.skip_unprocessed_frames == EASYAV1_TRUE) {
+        for (easyav1_degradation_level step = EASYAV1_DEGRADATION_DROP_FRAMES;
+            step <= EASYAV1_DEGRADATION_LOWER_QUALITY; step++) {
+            if (thresholds[step] && lag > thresholds[step]) {
+                level = step;
+            }
+        }
+    }
+
+    if (level < easyav1->degradation.level && easyav1->settings.skip_unprocessed_frames == EASYAV1_TRUE &&
+        thresholds[easyav1->degradation.level]) {
+
+        // The lag is under the threshold of the current level, which is kept until that has lasted long enough
+        if (easyav1->degradation.recovering == EASYAV1_FALSE) {
+            easyav1->degradation.recovering = EASYAV1_TRUE;
+            easyav1->degradation.recovering_since = now;
+            return;
+        }
+
+        if (now - easyav1->degradation.recovering_since < easyav1->settings.degradation.recover_ms) {
+            return;
+        }
+
+        level = easyav1->degradation.level - 1;
+    }
+
+    if (level == easyav1->degradation.level) {
+        easyav1->degradation.recovering = EASYAV1_FALSE;
+        return;
+    }
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Decoding is %llu ms late, changing the degradation level from %u to %u.", lag,
+        easyav1->degradation.level, level);
+
+    easyav1->degradation.level = level;
+    easyav1->degradation.recovering = EASYAV1_FALSE;
 
-            has_video_track = EASYAV1_TRUE;
-            video_track = track;
+    atomic_store_size(&easyav1->counters.degradation.level, level);
+}
+
+static easyav1_bool must_switch_video_decoder_quality(const easyav1_t *easyav1, easyav1_packet *packet)
+{
+    if (packet->is_keyframe == EASYAV1_FALSE ||
+        get_degraded_video_quality(easyav1) == easyav1->video.decoder_settings.quality) {
+        return EASYAV1_FALSE;
+    }
+
+    unsigned char *data;
+    size_t size;
+    Dav1dSequenceHeader sequence_header;
+
+    if (nestegg_packet_data(packet->packet, 0, &data, &size) || dav1d_parse_sequence_header(&sequence_header, data,
+        size)) {
+        return EASYAV1_FALSE;
+    }
+
+    return EASYAV1_TRUE;
+}
+
+static easyav1_status switch_video_decoder_quality(easyav1_t *easyav1)
+{
+    pause_video_decoder_thread(easyav1);
+
+    // The pictures already decoded keep their own references, so they outlive the decoder
+    dav1d_close(&easyav1->video.context);
+
+    easyav1_status status = open_video_decoder(easyav1, (int) easyav1->video.decoder_settings.threads);
+
+    resume_video_decoder_thread(easyav1);
+
+    if (status != EASYAV1_STATUS_OK) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    atomic_add_size(&easyav1->counters.degradation.quality_switches, 1);
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Video decoder switched to %s quality.",
+        easyav1->video.decoder_settings.quality == EASYAV1_VIDEO_QUALITY_PREVIEW ? "preview" : "full");
+
+    return EASYAV1_STATUS_OK;
+}
+
+
+/**
+ * High-level decoding functions
+ */
+
+/**
+ * @brief Sleeps until the next packet is due to be decoded, or until a seek or a stop is requested.
+ *
+ * The playback mutex must be locked. When the stream has finished, it sleeps for at most `PLAYBACK_MAX_WAIT_MS`.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param ticks The ticks at which the current position was reached.
+ */
+static void wait_for_next_playback_deadline(easyav1_t *easyav1, easyav1_timestamp ticks)
+{
+    easyav1_timestamp wait_time = PLAYBACK_MAX_WAIT_MS;
+    easyav1_bool has_deadline = EASYAV1_FALSE;
+
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_OK) {
+        easyav1_packet *packet = get_next_packet(easyav1);
+
+        if (!packet && atomic_load_status(&easyav1->status) != EASYAV1_STATUS_FINISHED) {
+            return;
         }
 
-        if (type == NESTEGG_TRACK_AUDIO) {
+        if (packet) {
+            easyav1_timestamp position = atomic_load_u64(&easyav1->position);
 
-            // Audio already found or disabled - skip
-            if (easyav1->settings.enable_audio == EASYAV1_FALSE || has_audio_track == EASYAV1_TRUE ||
-                easyav1->webm.audio_tracks != easyav1->settings.audio_track) {
-                easyav1->webm.audio_tracks++;
-                continue;
+            // The decoder stopped early, so there's no need to wait
+            if (packet->timestamp < position) {
+                return;
             }
 
-            log(EASYAV1_LOG_LEVEL_INFO, "Found requested audio track %u at webm track %u.",
-                easyav1->webm.audio_tracks, track);
+            // Packets are decoded once the position goes past their timestamp
+            if (packet->timestamp - position + 1 < wait_time) {
+                wait_time = packet->timestamp - position + 1;
+                has_deadline = EASYAV1_TRUE;
+            }
+        }
+    }
 
-            easyav1->webm.audio_tracks++;
+    uint64_t deadline = (ticks + wait_time) * 1000;
 
-            if (codec != NESTEGG_CODEC_VORBIS) {
-                log(EASYAV1_LOG_LEVEL_WARNING,
-                    "Unsupported audio codec found. Only vorbis codec is supported. Not playing audio.");
-                continue;
+    while (easyav1->playback.do_pause == EASYAV1_FALSE) {
+        if (atomic_load_size(&easyav1->playback.seek.requested)) {
+            return;
+        }
+
+        uint64_t now = easyav1_get_microseconds();
+
+        if (now >= deadline) {
+            if (has_deadline == EASYAV1_TRUE) {
+                size_t jitter = (size_t) (now - deadline);
+
+                atomic_store_size(&easyav1->playback.timing.deadlines, easyav1->playback.timing.deadlines + 1);
+                atomic_store_size(&easyav1->playback.timing.total_jitter_us,
+                    easyav1->playback.timing.total_jitter_us + jitter);
+
+                if (jitter > easyav1->playback.timing.max_jitter_us) {
+                    atomic_store_size(&easyav1->playback.timing.max_jitter_us, jitter);
+                }
             }
 
-            has_audio_track = EASYAV1_TRUE;
-            audio_track = track;
+            return;
         }
+
+        easyav1_cond_wait_for(&easyav1->playback.wake, &easyav1->playback.mutex, deadline - now);
+
+        atomic_store_size(&easyav1->playback.timing.wakeups, easyav1->playback.timing.wakeups + 1);
     }
+}
 
-    if (has_video_track == EASYAV1_TRUE) {
-        if (init_video(easyav1, video_track) == EASYAV1_STATUS_ERROR) {
-            return EASYAV1_STATUS_ERROR;
+/**
+ * @brief The thread function that handles video playback.
+  * 
+  * @param arg The easyav1 instance.
+  * @return Always returns `NULL`.
+  */
+static void *easyav1_playback_thread(void *arg)
+{
+    easyav1_t *easyav1 = (easyav1_t *) arg;
+
+    easyav1_timestamp last_timestamp = easyav1_get_ticks();
+    easyav1_timestamp current_timestamp = last_timestamp;
+
+    pthread_mutex_lock(&easyav1->playback.mutex);
+
+    while (easyav1->playback.active == EASYAV1_TRUE && easyav1->playback.do_pause == EASYAV1_FALSE &&
+        do_decode_until(easyav1,
+            atomic_load_u64(&easyav1->position) + (current_timestamp - last_timestamp)) != EASYAV1_STATUS_ERROR) {
+
+        wait_for_next_playback_deadline(easyav1, current_timestamp);
+
+        pthread_mutex_unlock(&easyav1->playback.mutex);
+
+        // Update timestamp
+        last_timestamp = current_timestamp;
+        current_timestamp = easyav1_get_ticks();
+
+        trace(EASYAV1_TRACE_PLAYBACK_TICK, EASYAV1_TRACE_PHASE_INSTANT, atomic_load_u64(&easyav1->position), 0);
+
+        if (atomic_exchange_size(&easyav1->playback.seek.requested, 0)) {
+            easyav1_timestamp seek_timestamp = atomic_load_u64(&easyav1->playback.seek.timestamp);
+
+            if (do_seek_to_timestamp(easyav1, seek_timestamp) == EASYAV1_STATUS_ERROR) {
+                break;
+            }
+
+            current_timestamp = easyav1_get_ticks();
+            last_timestamp = current_timestamp;
         }
+
+        pthread_mutex_lock(&easyav1->playback.mutex);
     }
 
-    if (has_audio_track == EASYAV1_TRUE) {
-        if (init_audio(easyav1, audio_track) == EASYAV1_STATUS_ERROR) {
-            return EASYAV1_STATUS_ERROR;
+    pthread_mutex_unlock(&easyav1->playback.mutex);
+
+    return NULL;
+}
+
+easyav1_status easyav1_play(easyav1_t *easyav1)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
+        return EASYAV1_STATUS_FINISHED;
+    }
+
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Playback is already active.");
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (pthread_mutex_init(&easyav1->playback.mutex, NULL)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize playback mutex.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (easyav1_cond_init_monotonic(&easyav1->playback.wake)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize playback condition.");
+        pthread_mutex_destroy(&easyav1->playback.mutex);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    easyav1->playback.do_pause = EASYAV1_FALSE;
+    easyav1->playback.active = EASYAV1_TRUE;
+
+    easyav1->playback.seek.requested = EASYAV1_FALSE;
+    easyav1->playback.seek.timestamp = 0;
+
+    atomic_store_size(&easyav1->playback.timing.wakeups, 0);
+    atomic_store_size(&easyav1->playback.timing.deadlines, 0);
+    atomic_store_size(&easyav1->playback.timing.total_jitter_us, 0);
+    atomic_store_size(&easyav1->playback.timing.max_jitter_us, 0);
+
+    if (pthread_create(&easyav1->playback.thread, NULL, easyav1_playback_thread, easyav1)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create playback thread.");
+        easyav1->playback.active = EASYAV1_FALSE;
+        pthread_cond_destroy(&easyav1->playback.wake);
+        pthread_mutex_destroy(&easyav1->playback.mutex);
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    return EASYAV1_STATUS_OK;
+}
+
+void easyav1_stop(easyav1_t *easyav1)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return;
+    }
+
+    if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+        return;
+    }
+
+    if (easyav1->playback.active == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Playback is not active.");
+        return;
+    }
+
+    pthread_mutex_lock(&easyav1->playback.mutex);
+    easyav1->playback.do_pause = EASYAV1_TRUE;
+    pthread_cond_signal(&easyav1->playback.wake);
+    pthread_mutex_unlock(&easyav1->playback.mutex);
+
+    pthread_join(easyav1->playback.thread, NULL);
+
+    size_t deadlines = atomic_load_size(&easyav1->playback.timing.deadlines);
+
+    if (deadlines > 0) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Playback woke up %zu us late on average, and at most %zu us late.",
+            atomic_load_size(&easyav1->playback.timing.total_jitter_us) / deadlines,
+            atomic_load_size(&easyav1->playback.timing.max_jitter_us));
+    }
+
+    easyav1->playback.active = EASYAV1_FALSE;
+    easyav1->playback.do_pause = EASYAV1_FALSE;
+
+    easyav1->playback.seek.requested = EASYAV1_FALSE;
+    easyav1->playback.seek.timestamp = 0;
+
+    pthread_cond_destroy(&easyav1->playback.wake);
+    pthread_mutex_destroy(&easyav1->playback.mutex);
+}
+
+
+/**
+ * Seeking functions
+ */
+
+static int compare_cue_points(const void *a, const void *b)
+{
+    const easyav1_cue_point *first = a;
+    const easyav1_cue_point *second = b;
+
+    if (first->timestamp == second->timestamp) {
+        return 0;
+    }
+
+    return first->timestamp < second->timestamp ? -1 : 1;
+}
+
+static void init_cue_index(easyav1_t *easyav1)
+{
+    // Reading the cues means seeking to them, and the keyframes are only indexed as they are read
+    if (easyav1->stream.seekable == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Stream can't be seeked, the cues won't be read.");
+        return;
+    }
+
+    if (!nestegg_has_cues(easyav1->webm.context)) {
+        log(EASYAV1_LOG_LEVEL_INFO, "No cues found, seeking will start from the beginning of the file.");
+        return;
+    }
+
+    unsigned int capacity = 0;
+    unsigned int count = 0;
+    easyav1_cue_point *points = NULL;
+    easyav1_bool sorted = EASYAV1_TRUE;
+
+    int64_t start_pos;
+    int64_t end_pos;
+    uint64_t cue_timestamp;
+
+    do {
+        if (nestegg_get_cue_point(easyav1->webm.context, count, -1, &start_pos, &end_pos, &cue_timestamp)) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to get cue point %u.", count);
+            break;
+        }
+
+        if (start_pos == -1) {
+            break;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            easyav1_cue_point *new_points = realloc(points, capacity * sizeof(easyav1_cue_point));
+
+            if (!new_points) {
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the cue index.");
+                free(points);
+                return;
+            }
+
+            points = new_points;
+        }
+
+        points[count].timestamp = internal_timestamp_to_ms(easyav1, cue_timestamp);
+        points[count].offset = start_pos;
+
+        if (count > 0 && points[count].timestamp < points[count - 1].timestamp) {
+            sorted = EASYAV1_FALSE;
+        }
+
+        count++;
+    } while (end_pos != -1);
+
+    if (sorted == EASYAV1_FALSE) {
+        qsort(points, count, sizeof(easyav1_cue_point), compare_cue_points);
+    }
+
+    easyav1->webm.cues.points = points;
+    easyav1->webm.cues.count = count;
+
+    log(EASYAV1_LOG_LEVEL_INFO, "Indexed %u cue points.", count);
+}
+
+/**
+ * @brief Finds the index of the last cue point before (or at) the given timestamp.
+ *
+ * @param easyav1 The easyav1 context to search the cue index of.
+ * @param timestamp The timestamp to search for.
+ * @param inclusive Whether a cue point exactly at the timestamp should be returned.
+ *
+ * @return The one-based index of the found cue point, or `0` if there's no cue point before the timestamp.
+ */
+static unsigned int find_cue_point(const easyav1_t *easyav1, easyav1_timestamp timestamp, easyav1_bool inclusive)
+{
+    unsigned int low = 0;
+    unsigned int high = easyav1->webm.cues.count;
+
+    // Standard upper bound search: find the first cue point that is after the timestamp
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        easyav1_timestamp cue_timestamp = easyav1->webm.cues.points[mid].timestamp;
+
+        if (cue_timestamp < timestamp || (inclusive == EASYAV1_TRUE && cue_timestamp == timestamp)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static easyav1_timestamp get_closest_cue_point(const easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    unsigned int index = find_cue_point(easyav1, timestamp, EASYAV1_FALSE);
+
+    return index == 0 ? 0 : easyav1->webm.cues.points[index - 1].timestamp;
+}
+
+/**
+ * @brief Finds the index of the first keyframe in the keyframe index that is not before the given timestamp.
+ *
+ * @note The keyframe index mutex must be locked when calling this function.
+ *
+ * @param easyav1 The easyav1 context to search the keyframe index of.
+ * @param timestamp The timestamp to search for.
+ * @param inclusive Whether a keyframe exactly at the timestamp counts as being before it.
+ *
+ * @return The index of the found keyframe, or the number of keyframes if all keyframes are before the timestamp.
+ */
+static unsigned int find_keyframe(const easyav1_t *easyav1, easyav1_timestamp timestamp, easyav1_bool inclusive)
+{
+    unsigned int low = 0;
+    unsigned int high = easyav1->seek.index.count;
+
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        easyav1_timestamp keyframe_timestamp = easyav1->seek.index.items[mid].timestamp;
+
+        if (keyframe_timestamp < timestamp || (inclusive == EASYAV1_TRUE && keyframe_timestamp == timestamp)) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Total video tracks: %u", easyav1->webm.video_tracks);
-    log(EASYAV1_LOG_LEVEL_INFO, "Total audio tracks: %u", easyav1->webm.audio_tracks);
-
-    return EASYAV1_STATUS_OK;
+    return low;
 }
 
-static easyav1_status init_video(easyav1_t *easyav1, unsigned int track)
+static void index_keyframe(easyav1_t *easyav1, nestegg *context, nestegg_packet *packet, easyav1_timestamp timestamp,
+    easyav1_keyframe_cursor *cursor)
 {
-    nestegg_video_params params;
+    int64_t offset;
+    unsigned char *data;
+    size_t size;
+    Dav1dSequenceHeader sequence_header;
 
-    if (nestegg_track_video_params(easyav1->webm.context, track, &params)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get video track parameters.");
-        return EASYAV1_STATUS_ERROR;
+    if (nestegg_cluster_offset(context, &offset) || nestegg_packet_data(packet, 0, &data, &size) ||
+        dav1d_parse_sequence_header(&sequence_header, data, size)) {
+        return;
     }
 
-    easyav1_timestamp frame_duration;
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-    if (nestegg_track_default_duration(easyav1->webm.context, track, &frame_duration)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get video track frame duration.");
-        return EASYAV1_STATUS_ERROR;
-    }
+    unsigned int index = find_keyframe(easyav1, timestamp, EASYAV1_FALSE);
 
-    easyav1->video.fps = ms_to_internal_timestmap(easyav1, 1000) / frame_duration;
+    if (index == easyav1->seek.index.count || easyav1->seek.index.items[index].timestamp != timestamp) {
 
-    Dav1dSettings dav1d_settings;
-    dav1d_default_settings(&dav1d_settings);
-    dav1d_settings.logger = (Dav1dLogger) { .cookie = 0, .callback = log_from_dav1d };
+        if (easyav1->seek.index.count == easyav1->seek.index.capacity) {
+            unsigned int new_capacity = easyav1->seek.index.capacity ? easyav1->seek.index.capacity * 2 : 64;
+            easyav1_keyframe *new_items = realloc(easyav1->seek.index.items, new_capacity * sizeof(easyav1_keyframe));
 
-    if (dav1d_open(&easyav1->video.context, &dav1d_settings) < 0) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize AV1 decoder.");
-        return EASYAV1_STATUS_ERROR;
-    }
+            if (!new_items) {
+                pthread_mutex_unlock(&easyav1->seek.index.mutex);
+                log(EASYAV1_LOG_LEVEL_WARNING, "Failed to allocate memory for the keyframe index.");
+                return;
+            }
 
-    easyav1->video.active = EASYAV1_TRUE;
-    easyav1->video.track = track;
+            easyav1->seek.index.items = new_items;
+            easyav1->seek.index.capacity = new_capacity;
+        }
 
-    easyav1->video.width = params.width;
-    easyav1->video.height = params.height;
+        memmove(&easyav1->seek.index.items[index + 1], &easyav1->seek.index.items[index],
+            (easyav1->seek.index.count - index) * sizeof(easyav1_keyframe));
 
-    easyav1->video.sqhdr = NULL;
+        easyav1->seek.index.items[index].timestamp = timestamp;
+        easyav1->seek.index.items[index].covered_until = timestamp + 1;
+        easyav1->seek.index.items[index].offset = offset;
+        easyav1->seek.index.count++;
+    }
 
-    if (init_video_decoder_thread(easyav1) == EASYAV1_STATUS_ERROR) {
-        return EASYAV1_STATUS_ERROR;
+    // All packets between the previous keyframe of this read and this one were read, so there's no keyframe between
+    if (cursor->has_keyframe == EASYAV1_TRUE && index > 0 &&
+        easyav1->seek.index.items[index - 1].timestamp == cursor->keyframe &&
+        easyav1->seek.index.items[index - 1].covered_until < timestamp) {
+        easyav1->seek.index.items[index - 1].covered_until = timestamp;
     }
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Video initialized. Size: %ux%u, %u FPS.", easyav1->video.width, easyav1->video.height,
-        easyav1->video.fps);
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    return EASYAV1_STATUS_OK;
+    cursor->has_keyframe = EASYAV1_TRUE;
+    cursor->keyframe = timestamp;
 }
 
-static easyav1_status init_audio(easyav1_t *easyav1, unsigned int track)
+static void finish_keyframe_index(easyav1_t *easyav1, const easyav1_keyframe_cursor *cursor)
 {
-    unsigned int headers;
+    if (cursor->has_keyframe == EASYAV1_FALSE) {
+        return;
+    }
 
-    if (nestegg_track_codec_data_count(easyav1->webm.context, track, &headers)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio codec header count.");
-        return EASYAV1_STATUS_ERROR;
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
+
+    unsigned int index = find_keyframe(easyav1, cursor->keyframe, EASYAV1_FALSE);
+
+    if (index < easyav1->seek.index.count && easyav1->seek.index.items[index].timestamp == cursor->keyframe) {
+        easyav1->seek.index.items[index].covered_until = UINT64_MAX;
     }
 
-    // Vorbis data should always have 3 headers
-    if (headers != VORBIS_HEADERS_COUNT) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Vorbis data should always have 3 headers.");
-        return EASYAV1_STATUS_ERROR;
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
+}
+
+/**
+ * @brief Gets the keyframe that decoding should start from to reach the given timestamp, if it's indexed.
+ *
+ * @param easyav1 The easyav1 context to search the keyframe index of.
+ * @param timestamp The timestamp to find the keyframe for.
+ * @param keyframe Pointer that receives the keyframe.
+ *
+ * @return `EASYAV1_TRUE` if the keyframe was found, `EASYAV1_FALSE` if the index doesn't cover the timestamp.
+ */
+static easyav1_bool get_indexed_keyframe(easyav1_t *easyav1, easyav1_timestamp timestamp, easyav1_keyframe *keyframe)
+{
+    easyav1_bool found = EASYAV1_FALSE;
+
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
+
+    unsigned int index = find_keyframe(easyav1, timestamp, EASYAV1_TRUE);
+
+    if (index > 0 && timestamp < easyav1->seek.index.items[index - 1].covered_until) {
+        *keyframe = easyav1->seek.index.items[index - 1];
+        found = EASYAV1_TRUE;
     }
 
-    vorbis_comment comment;
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    vorbis_info_init(&easyav1->audio.vorbis.info);
-    vorbis_comment_init(&comment);
+    return found;
+}
 
-    for (int header = 0; header < VORBIS_HEADERS_COUNT; header++) {
-        unsigned char *header_data;
-        size_t header_size;
+/**
+ * @brief Opens another webm context over the stream of an instance, to read it independently from the instance.
+ *
+ * Only memory streams, mapped files and files opened by name can be opened again.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param memory The memory reader state, which must remain valid while the context is used.
+ * @param file Where to store the opened file, if any, to be closed after the context is destroyed.
+ * @param context Where to store the webm context.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status open_stream_copy(easyav1_t *easyav1, easyav1_memory *memory, FILE **file, nestegg **context)
+{
+    memory->data = (uint8_t *) easyav1->seek.index.scan.data;
+    memory->size = easyav1->seek.index.scan.size;
+    memory->offset = 0;
 
-        if (nestegg_track_codec_data(easyav1->webm.context, track, header, &header_data, &header_size)) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio codec header data for header %u.",
-                header);
-            return EASYAV1_STATUS_ERROR;
-        }
+    *file = NULL;
+    *context = NULL;
 
-        ogg_packet packet;
-        packet.packet = header_data;
-        packet.bytes = header_size;
-        packet.b_o_s = header == 0;
-        packet.e_o_s = header == VORBIS_HEADERS_COUNT - 1;
-        packet.granulepos = 0;
-        packet.packetno = header;
+    nestegg_io io = {
+        .read = memory_read,
+        .seek = memory_seek,
+        .tell = memory_tell,
+        .userdata = memory
+    };
 
-        if (vorbis_synthesis_headerin(&easyav1->audio.vorbis.info, &comment, &packet)) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio codec header %u.", header);
+    if (!memory->data) {
+        if (!easyav1->seek.index.scan.filename) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "The stream can't be opened again.");
             return EASYAV1_STATUS_ERROR;
         }
-    }
 
-    vorbis_comment_clear(&comment);
+        *file = fopen(easyav1->seek.index.scan.filename, "rb");
 
-    if (vorbis_synthesis_init(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.info)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize vorbis synthesis.");
-        return EASYAV1_STATUS_ERROR;
-    }
+        if (!*file) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to open file %s again.", easyav1->seek.index.scan.filename);
+            return EASYAV1_STATUS_ERROR;
+        }
 
-    if (vorbis_block_init(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to initialize vorbis block.");
-        return EASYAV1_STATUS_ERROR;
+        io.read = file_read;
+        io.seek = file_seek;
+        io.tell = file_tell;
+        io.userdata = *file;
     }
 
-    nestegg_audio_params params;
-    if (nestegg_track_audio_params(easyav1->webm.context, track, &params)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get audio track parameters.");
-        return EASYAV1_STATUS_ERROR;
-    }
+    if (nestegg_init(context, io, log_from_nestegg, -1)) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Failed to initialize webm context.");
 
-    easyav1->audio.active = EASYAV1_TRUE;
-    easyav1->audio.track = track;
+        if (*file) {
+            fclose(*file);
+            *file = NULL;
+        }
 
-    easyav1->audio.channels = params.channels;
-    easyav1->audio.sample_rate = params.rate;
-    easyav1->packets.audio_offset = easyav1->settings.audio_offset_time +
-        internal_timestamp_to_ms(easyav1, params.codec_delay);
+        *context = NULL;
 
-    if (prepare_audio_buffer(easyav1) == EASYAV1_STATUS_ERROR) {
         return EASYAV1_STATUS_ERROR;
     }
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Audio initialized. Channels: %u, sample rate: %uhz.",
-        easyav1->audio.channels, easyav1->audio.sample_rate);
+    if (memory->data) {
+        nestegg_set_packet_data_source(*context, memory->data, memory->size);
+    }
 
     return EASYAV1_STATUS_OK;
 }
 
-static easyav1_status init_video_decoder_thread(easyav1_t *easyav1)
+/**
+ * @brief The background keyframe scan thread function.
+ *
+ * Reads the whole file with its own webm context and adds all its keyframes to the keyframe index.
+ *
+ * @param userdata The easyav1 context.
+ */
+static void *keyframe_scan_thread(void *userdata)
 {
-    if (easyav1->video.decoder_thread.command != THREAD_COMMAND_NONE) {
-        return EASYAV1_STATUS_ERROR;
-    }
+    easyav1_t *easyav1 = (easyav1_t *) userdata;
 
-    if (pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.io, NULL) ||
-        pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.decoder, NULL) ||
-        pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.info, NULL) ||
-        pthread_mutex_init(&easyav1->video.decoder_thread.mutexes.status, NULL)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread mutexes.");
-        return EASYAV1_STATUS_ERROR;
-    }
+    easyav1_memory memory;
+    FILE *f;
+    nestegg *context;
 
-    if (pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_packets, NULL) ||
-        pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_frames_to_display, NULL) ||
-        pthread_cond_init(&easyav1->video.decoder_thread.conditions.has_changed_status, NULL)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread condition variable.");
-        return EASYAV1_STATUS_ERROR;
+    if (open_stream_copy(easyav1, &memory, &f, &context) == EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Failed to open the stream for keyframe indexing.");
+        return 0;
     }
 
-    if (pthread_create(&easyav1->video.decoder_thread.decoder, NULL, video_decoder_thread, easyav1)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create decoder thread.");
-        return EASYAV1_STATUS_ERROR;
-    }
+    easyav1_keyframe_cursor cursor = { 0 };
 
-    return EASYAV1_STATUS_OK;
-}
+    while (1) {
+        pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-static easyav1_status prepare_audio_buffer(easyav1_t *easyav1)
-{
-    unsigned max_samples = AUDIO_BUFFER_SIZE * easyav1->audio.channels;
+        easyav1_bool stop = easyav1->seek.index.scan.stop;
 
-    easyav1->audio.buffer = malloc(max_samples * sizeof(float));
+        pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    if (!easyav1->audio.buffer) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate audio buffer.");
-        return EASYAV1_STATUS_ERROR;
-    }
+        if (stop == EASYAV1_TRUE) {
+            break;
+        }
 
-    memset(easyav1->audio.buffer, 0, max_samples * sizeof(float));
+        nestegg_packet *packet = NULL;
 
-    easyav1->audio.frame.channels = easyav1->audio.channels;
+        int status = nestegg_read_packet(context, &packet);
 
-    if (easyav1->settings.interlace_audio) {
-        easyav1->audio.frame.pcm.interlaced = easyav1->audio.buffer;
-        return EASYAV1_STATUS_OK;
-    }
+        if (status == 0) {
+            finish_keyframe_index(easyav1, &cursor);
 
-    easyav1->audio.frame.pcm.deinterlaced = malloc(easyav1->audio.channels * sizeof(float *));
-    if (!easyav1->audio.frame.pcm.deinterlaced) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate deinterlaced audio buffer.");
-        return EASYAV1_STATUS_ERROR;
-    }
-    for (unsigned int i = 0; i < easyav1->audio.channels; i++) {
-        easyav1->audio.frame.pcm.deinterlaced[i] = easyav1->audio.buffer + i * AUDIO_BUFFER_SIZE;
-    }
+            pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-    return EASYAV1_STATUS_OK;
-}
+            easyav1->seek.index.scan.finished = EASYAV1_TRUE;
 
-easyav1_t *easyav1_init_from_custom_stream(const easyav1_stream *stream, const easyav1_settings *settings)
-{
-    easyav1_t *easyav1 = NULL;
+            pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    if (!stream || !stream->read_func || !stream->seek_func || !stream->tell_func) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_ARGUMENT, "Stream is NULL or missing read, seek or tell functions");
-        return NULL;
+            log(EASYAV1_LOG_LEVEL_INFO, "Finished indexing keyframes.");
+            break;
+        }
+
+        if (status < 0) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to read packet for keyframe indexing.");
+            break;
+        }
+
+        unsigned int track;
+        uint64_t packet_timestamp;
+
+        if (!nestegg_packet_track(packet, &track) && track == easyav1->video.track &&
+            nestegg_packet_has_keyframe(packet) == NESTEGG_PACKET_HAS_KEYFRAME_TRUE &&
+            !nestegg_packet_tstamp(packet, &packet_timestamp)) {
+            index_keyframe(easyav1, context, packet, internal_timestamp_to_ms(easyav1, packet_timestamp), &cursor);
+        }
+
+        nestegg_free_packet(packet);
     }
 
-    easyav1 = malloc(sizeof(easyav1_t));
+    nestegg_destroy(context);
 
-    if (!easyav1) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for the easyav1 handle");
-        return NULL;
+    if (f) {
+        fclose(f);
     }
 
-    memset(easyav1, 0, sizeof(easyav1_t));
+    return 0;
+}
 
-    easyav1->status = EASYAV1_STATUS_OK;
+static void start_keyframe_scan(easyav1_t *easyav1)
+{
+    if (easyav1->settings.index_keyframes_in_background == EASYAV1_FALSE || easyav1->video.active == EASYAV1_FALSE ||
+        easyav1->seek.index.scan.running == EASYAV1_TRUE || easyav1->seek.index.scan.finished == EASYAV1_TRUE) {
+        return;
+    }
 
-    if (settings) {
-        easyav1->settings = *settings;
-    } else {
-        easyav1->settings = DEFAULT_SETTINGS;
-        log(EASYAV1_LOG_LEVEL_INFO, "No settings provided, using default settings.");
+    if (!easyav1->seek.index.scan.data && !easyav1->seek.index.scan.filename) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Keyframe indexing in the background is not supported for this stream type.");
+        return;
     }
 
-    nestegg_io io = {
-        .read = stream->read_func,
-        .seek = stream->seek_func,
-        .tell = stream->tell_func,
-        .userdata = stream->userdata
-    };
+    easyav1->seek.index.scan.stop = EASYAV1_FALSE;
 
-    if (nestegg_init(&easyav1->webm.context, io, log_from_nestegg, -1)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_INVALID_STATE, "Failed to initialize webm context");
-        easyav1_destroy(&easyav1);
-        return NULL;
+    if (pthread_create(&easyav1->seek.index.scan.thread, NULL, keyframe_scan_thread, easyav1)) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Failed to create keyframe scan thread.");
+        return;
     }
 
-    easyav1_timestamp duration;
+    easyav1->seek.index.scan.running = EASYAV1_TRUE;
+}
 
-    if (nestegg_duration(easyav1->webm.context, &duration)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get duration");
-        easyav1_destroy(&easyav1);
-        return NULL;
+static void stop_keyframe_scan(easyav1_t *easyav1)
+{
+    if (easyav1->seek.index.scan.running == EASYAV1_FALSE) {
+        return;
     }
 
-    if (nestegg_tstamp_scale(easyav1->webm.context, &easyav1->time_scale)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get time scale.");
-        easyav1_destroy(&easyav1);
-        return NULL;
-    }
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-    if (easyav1->time_scale == 0) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Time scale is 0.");
-        easyav1_destroy(&easyav1);
-        return NULL;
-    }
+    easyav1->seek.index.scan.stop = EASYAV1_TRUE;
 
-    easyav1->duration = internal_timestamp_to_ms(easyav1, duration);
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    log(EASYAV1_LOG_LEVEL_INFO, "File duration: %llu minutes and %llu seconds.",
-        easyav1->duration / 60000, (easyav1->duration / 1000) % 60);
+    pthread_join(easyav1->seek.index.scan.thread, NULL);
 
-    if (init_webm_tracks(easyav1) == EASYAV1_STATUS_ERROR || sync_packet_queues(easyav1) != EASYAV1_STATUS_OK) {
-        easyav1_destroy(&easyav1);
-        return NULL;
-    }
+    easyav1->seek.index.scan.running = EASYAV1_FALSE;
+}
 
-    return easyav1;
+static void reset_keyframe_index(easyav1_t *easyav1)
+{
+    stop_keyframe_scan(easyav1);
+
+    free(easyav1->seek.index.items);
+
+    easyav1->seek.index.items = NULL;
+    easyav1->seek.index.count = 0;
+    easyav1->seek.index.capacity = 0;
+    easyav1->seek.index.cursor.has_keyframe = EASYAV1_FALSE;
+    easyav1->seek.index.scan.finished = EASYAV1_FALSE;
 }
 
-easyav1_t *easyav1_init_from_memory(const void *data, size_t size, const easyav1_settings *settings)
+static easyav1_status do_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
 {
-    easyav1_t *easyav1 = NULL;
+    easyav1_status status = atomic_load_status(&easyav1->status);
+    easyav1_timestamp position = atomic_load_u64(&easyav1->position);
+    easyav1_timestamp duration = easyav1_get_duration(easyav1);
 
-    if (!data || !size) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Data is NULL or size is 0");
-        return NULL;
+    if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
+        return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1_memory *mem = malloc(sizeof(easyav1_memory));
+    if (timestamp == position && easyav1->seek.position_lost == EASYAV1_FALSE) {
+        return EASYAV1_STATUS_OK;
+    }
+
+    if (duration && timestamp >= duration) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Requested timestamp is beyond the end of the stream.");
+        timestamp = duration;
+
+        if (status == EASYAV1_STATUS_FINISHED) {
+            return EASYAV1_STATUS_OK;
+        }
+    }
+
+    easyav1_timestamp original_timestamp = atomic_load_u64(&easyav1->position);
+    easyav1_timestamp corrected_timestamp = get_closest_cue_point(easyav1, timestamp);
+
+    unsigned int track = 0;
 
-    if (!mem) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for memory stream");
-        return NULL;
+    if (easyav1->video.active == EASYAV1_TRUE) {
+        track = easyav1->video.track;
+    } else {
+        track = easyav1->audio.track;
     }
 
-    mem->data = (uint8_t *) data;
-    mem->size = size;
-    mem->offset = 0;
+    /**
+     * Two-pass seek when there's video:
+     *
+     * - The first pass finds the closest keyframe to the requested timestamp without decoding anything
+     * - The second pass skips all video decoding until that keyframe
+     *
+     * If the keyframe is already in the keyframe index, the first pass is skipped and the second pass starts reading
+     * directly from the cluster that contains the keyframe.
+     */
+    easyav1_timestamp last_keyframe_timestamp = 0;
+    int64_t keyframe_offset = -1;
+    int first_pass = 0;
 
-    easyav1_stream memory_stream = {
-        .read_func = memory_read,
-        .seek_func = memory_seek,
-        .tell_func = memory_tell,
-        .userdata = mem
-    };
+    easyav1_keyframe keyframe;
 
-    easyav1 = easyav1_init_from_custom_stream(&memory_stream, settings);
+    if (easyav1->video.active == EASYAV1_TRUE && get_indexed_keyframe(easyav1, timestamp, &keyframe) == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Found indexed keyframe %llu for timestamp %llu.", keyframe.timestamp, timestamp);
 
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 handle from memory stream");
-        free(mem);
-        return NULL;
+        corrected_timestamp = keyframe.timestamp;
+        last_keyframe_timestamp = keyframe.timestamp;
+        keyframe_offset = keyframe.offset;
+        first_pass = 1;
     }
 
-    easyav1->stream.type = STREAM_TYPE_MEMORY;
-    easyav1->stream.data = mem;
+    easyav1_bool audio_is_active = easyav1->audio.active;
 
-    return easyav1;
-}
+    uint64_t seek_start = easyav1_get_microseconds();
 
-easyav1_t *easyav1_init_from_file(FILE *f, const easyav1_settings *settings)
-{
-    easyav1_t *easyav1 = NULL;
+    trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_BEGIN, timestamp, 0);
 
-    if (!f) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "File handle is NULL");
-        return NULL;
-    }
+    pause_video_decoder_thread(easyav1);
 
-    easyav1_stream file_stream = {
-        .read_func = file_read,
-        .seek_func = file_seek,
-        .tell_func = file_tell,
-        .userdata = f
-    };
+    easyav1->seek.mode = STARTING_SEEKING;
+    atomic_store_status(&easyav1->status, EASYAV1_STATUS_OK);
 
-    easyav1 = easyav1_init_from_custom_stream(&file_stream, settings);
+    for (int pass = first_pass; pass < 2; pass++) {
 
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 structure from file handle");
-        if ((settings && settings->close_handle_on_destroy) || (!settings && DEFAULT_SETTINGS.close_handle_on_destroy)) {
-            fclose(f);
-        }
-        return NULL;
-    }
+        atomic_store_u64(&easyav1->position, corrected_timestamp);
 
-    if (easyav1->settings.close_handle_on_destroy) {
-        easyav1->stream.type = STREAM_TYPE_FILE;
-        easyav1->stream.data = f;
-    }
+        easyav1->seek.index.cursor.has_keyframe = EASYAV1_FALSE;
 
-    return easyav1;
-}
+        int seek_result = keyframe_offset >= 0 ? nestegg_offset_seek(easyav1->webm.context, keyframe_offset) :
+            nestegg_track_seek(easyav1->webm.context, track, ms_to_internal_timestmap(easyav1, corrected_timestamp));
 
-easyav1_t *easyav1_init_from_filename(const char *filename, const easyav1_settings *settings)
-{
-    easyav1_t *easyav1 = NULL;
+        if (seek_result) {
+            LOG_AND_SET_ERROR(EASYAV1_STATUS_IO_ERROR, "Failed to seek to requested timestamp %llu.",
+                corrected_timestamp);
+            resume_video_decoder_thread(easyav1);
 
-    if (!filename) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Filename is NULL");
-        return NULL;
-    }
+            if (easyav1->playback.active == EASYAV1_TRUE) {
+                pthread_mutex_unlock(&easyav1->playback.mutex);
+            }
 
-    FILE *f = fopen(filename, "rb");
+            trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_END, timestamp, 0);
 
-    if (!f) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to open file %s", filename);
-        return NULL;
-    }
+            return EASYAV1_STATUS_ERROR;
+        }
 
-    easyav1 = easyav1_init_from_file(f, settings);
+        release_packets_from_queue(easyav1, &easyav1->packets.video_queue);
+        release_packets_from_queue(easyav1, &easyav1->packets.audio_queue);
 
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create easyav1 structure from file %s", filename);
-        fclose(f);
-        return NULL;
-    }
+        // The decoder thread is paused, so no packets handed to it are in use
+        reset_video_decode_queue(easyav1);
 
-    easyav1->stream.type = STREAM_TYPE_FILE;
-    easyav1->stream.data = f;
+        easyav1->packets.synced = EASYAV1_FALSE;
+        easyav1->packets.all_fetched = EASYAV1_FALSE;
 
-    return easyav1;
-}
+        atomic_store_status(&easyav1->status, EASYAV1_STATUS_OK);
 
+        easyav1->seek.timestamp = timestamp;
 
-/**
- * WebM packet handling functions
- */
+        if (easyav1->video.active == EASYAV1_TRUE) {
 
-static easyav1_status increase_packet_queue_capacity(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    size_t new_capacity = queue->capacity + PACKET_QUEUE_BASE_CAPACITY;
-    easyav1_packet *new_queue = malloc(new_capacity * sizeof(easyav1_packet));
+            lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
 
-    if (!new_queue) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for packet queue.");
-        return EASYAV1_STATUS_ERROR;
-    }
+            dequeue_all_video_frames(easyav1);
 
-    if (queue->capacity) {
-        memcpy(new_queue, queue->items + queue->begin, (queue->capacity - queue->begin) * sizeof(easyav1_packet));
-        memcpy(new_queue + queue->capacity - queue->begin, queue->items, queue->begin * sizeof(easyav1_packet));
-    }
+            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+
+            dav1d_flush(easyav1->video.context);
+            easyav1->seek.mode = SEEKING_FOR_SQHDR;
+        }
 
-    memset(new_queue + queue->capacity, 0, PACKET_QUEUE_BASE_CAPACITY * sizeof(easyav1_packet));
+        if (audio_is_active) {
+            if (easyav1->seek.mode == STARTING_SEEKING) {
+                easyav1->seek.mode = SEEKING_FOR_TIMESTAMP;
 
-    // This is the only instance where we need to lock the decoder thread mutexes, because we are changing
-    // the packet queue's memory location and the video decoder may be using its data at the same time.
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.decoder);
+                // No need for a second pass for audio only
+                pass = 1;
+            }
 
-    free(queue->items);
+            // No need to decode audio at all on first pass
+            if (pass == 0) {
+                easyav1->audio.active = EASYAV1_FALSE;
+            } else {
+                easyav1->audio.active = EASYAV1_TRUE;
 
-    queue->items = new_queue;
-    queue->capacity = new_capacity;
-    queue->begin = 0;
+                vorbis_synthesis_restart(&easyav1->audio.vorbis.dsp);
+                easyav1->audio.has_samples_in_buffer = EASYAV1_FALSE;
+            }
+        }
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
+        // The pass may be restarted below, so remember which one this is
+        volatile size_t *pass_time = pass == 0 ? &easyav1->counters.keyframe_search_us :
+            &easyav1->counters.decode_to_target_us;
+        easyav1_trace_event pass_event = pass == 0 ? EASYAV1_TRACE_SEEK_KEYFRAME_SEARCH :
+            EASYAV1_TRACE_SEEK_DECODE_TO_TARGET;
+        uint64_t pass_start = easyav1_get_microseconds();
 
-    return EASYAV1_STATUS_OK;
-}
+        trace(pass_event, EASYAV1_TRACE_PHASE_BEGIN, corrected_timestamp, 0);
 
-static easyav1_packet *queue_new_packet(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    if (queue->count == queue->capacity) {
-        if (increase_packet_queue_capacity(easyav1, queue) == EASYAV1_STATUS_ERROR) {
-            return NULL;
-        }
-    }
+        while (1) {
+            easyav1_packet *packet = get_next_packet(easyav1);
 
-    size_t index = (queue->begin + queue->count) % queue->capacity;
+            if (EASYAV1_STATUS_IS_ERROR(atomic_load_status(&easyav1->status)) == EASYAV1_TRUE) {
+                resume_video_decoder_thread(easyav1);
 
-    queue->count++;
+                if (easyav1->playback.active == EASYAV1_TRUE) {
+                    pthread_mutex_unlock(&easyav1->playback.mutex);
+                }
 
-    return &queue->items[index];
-}
+                trace(pass_event, EASYAV1_TRACE_PHASE_END, 0, 0);
+                trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_END, timestamp, 0);
 
-static easyav1_packet *get_video_packet_to_decode(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    if (!queue->count) {
-        return NULL;
-    }
+                return EASYAV1_STATUS_ERROR;
+            }
 
-    size_t packets_after_timestamp = 0;
+            if (packet) {
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+                atomic_store_u64(&easyav1->position, packet->timestamp);
 
-    easyav1_timestamp timestamp = easyav1->position;
-    
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+                if (pass == 1) {
+                    if (packet->timestamp >= last_keyframe_timestamp) {
 
-    for (size_t i = 0; i < queue->count && packets_after_timestamp < VIDEO_FRAMES_TO_PREFETCH; i++) {
-        size_t index = (queue->begin + i) % queue->capacity;
+                        // If fast seeking is enabled, we don't decode until we find the correct timestamp, rather we
+                        // resume playing immediately after we get to the last keyframe before the requested timestamp
+                        if (easyav1->settings.use_fast_seeking == EASYAV1_TRUE) {
+                            easyav1->seek.mode = NOT_SEEKING;
+                            resume_video_decoder_thread(easyav1);
+                            break;
+                        } else if (easyav1->seek.mode != SEEKING_FOR_TIMESTAMP) {
+                            easyav1->seek.mode = SEEKING_FOR_TIMESTAMP;
+                            resume_video_decoder_thread(easyav1);
+                        }
+                    } else if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
+                        easyav1->seek.mode = SEEKING_FOUND_KEYFRAME;
+                    }
+                }
+            }
 
-        easyav1_packet *packet = &queue->items[index];
+            if (atomic_load_u64(&easyav1->position) >= timestamp ||
+                atomic_load_status(&easyav1->status) == EASYAV1_STATUS_FINISHED) {
 
-        if (packet->type == PACKET_TYPE_VIDEO && packet->packet != NULL && packet->decoded == EASYAV1_FALSE) {
-            return packet;
-        }
+                // If we couldn't find a keyframe on the first pass, we need to seek again,
+                // starting on the previous cue point
+                if (pass == 0 && last_keyframe_timestamp < corrected_timestamp) {
 
-        if (packet->timestamp > timestamp) {
-            packets_after_timestamp++;
-        }
-    }
+                    // No keyframe found from the beginning of the file - this shouldn't happen, but just in case
+                    if (corrected_timestamp == 0) {
+                        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR,
+                            "Unable to seek, no sequence header or keyframes found. Aborting.");
+                        release_packet_from_queue(easyav1, packet);
+                        resume_video_decoder_thread(easyav1);
 
-    return NULL;
-}
+                        if (easyav1->playback.active == EASYAV1_TRUE) {
+                            pthread_mutex_unlock(&easyav1->playback.mutex);
+                        }
 
-static easyav1_packet *retrieve_first_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    if (!queue->count) {
-        return NULL;
-    }
+                        trace(pass_event, EASYAV1_TRACE_PHASE_END, 0, 0);
+                        trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_END, timestamp, 0);
 
-    return &queue->items[queue->begin];
-}
+                        return EASYAV1_STATUS_ERROR;
+                    }
 
-static easyav1_packet *retrieve_last_packet_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    if (!queue->count) {
-        return NULL;
-    }
+                    corrected_timestamp = get_closest_cue_point(easyav1, corrected_timestamp);
+                    last_keyframe_timestamp = 0;
+                    pass = -1;
+                }
 
-    return &queue->items[(queue->begin + queue->count - 1) % queue->capacity];
-}
+                atomic_store_u64(&easyav1->position, timestamp);
 
-static void release_packet_from_queue(easyav1_t *easyav1, easyav1_packet *packet)
-{
-    if (!packet) {
-        return;
-    }
+                easyav1->seek.mode = STARTING_SEEKING;
+                break;
+            }
 
-    if (packet->packet) {
-        nestegg_free_packet(packet->packet);
-    }
+            seeking_mode last_seek_mode = easyav1->seek.mode;
 
-    easyav1_packet_queue *queue = packet->type == PACKET_TYPE_VIDEO ?
-        &easyav1->packets.video_queue : &easyav1->packets.audio_queue;
+            if (decode_packet(easyav1, packet) == EASYAV1_STATUS_ERROR) {
+                if (easyav1->seek.mode != SEEKING_FOR_TIMESTAMP) {
+                    resume_video_decoder_thread(easyav1);
+                }
 
-    // Should never happen
-    if (packet != queue->items + queue->begin) {
-        log(EASYAV1_LOG_LEVEL_WARNING, "Released packet was not at the beginning of the queue.");
-    }
+                if (easyav1->playback.active == EASYAV1_TRUE) {
+                    pthread_mutex_unlock(&easyav1->playback.mutex);
+                }
 
-    queue->begin = (queue->begin + 1) % queue->capacity;
-    queue->count--;
+                trace(pass_event, EASYAV1_TRACE_PHASE_END, 0, 0);
+                trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_END, timestamp, 0);
 
-    // Resync list position
-    if (queue->count == 0) {
-        queue->begin = 0;
-    }
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to decode packet when seeking.");
+                return EASYAV1_STATUS_ERROR;
+            }
 
-    memset(packet, 0, sizeof(easyav1_packet));
+            if (pass == 0 && easyav1->seek.mode == SEEKING_FOUND_KEYFRAME) {
+                last_keyframe_timestamp = packet->timestamp;
+                easyav1->seek.mode = SEEKING_FOR_KEYFRAME;
+            }
 
-    if (easyav1->packets.all_fetched == EASYAV1_FALSE) {
-        easyav1->packets.synced = EASYAV1_FALSE;
-    } else {
-        if (easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0) {
+            // If we found a sequence header, we may need to decode the video frame from this packet.
+            // To do that, we need to keep the packet so it's fetched again and properly decoded.
+            if (pass == 0 || (pass == 1 && (last_seek_mode != SEEKING_FOR_SQHDR ||
+                last_seek_mode == easyav1->seek.mode || packet->timestamp < last_keyframe_timestamp))) {
 
-            pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+                easyav1_bool lock_io = easyav1->seek.mode == SEEKING_FOR_TIMESTAMP &&
+                    easyav1->video.decoder_thread.running == EASYAV1_TRUE;
 
-            easyav1->status = EASYAV1_STATUS_FINISHED;
+                if (lock_io == EASYAV1_TRUE) {
+                    lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+                }
+
+                release_packet_from_queue(easyav1, packet);
 
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+                if (lock_io == EASYAV1_TRUE) {
+                    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+                }
+            }
         }
-    }
-}
 
-static void release_packets_from_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    while (queue->count) {
-        release_packet_from_queue(easyav1, queue->items + queue->begin);
+        atomic_add_size(pass_time, (size_t) (easyav1_get_microseconds() - pass_start));
+
+        trace(pass_event, EASYAV1_TRACE_PHASE_END, 0, 0);
     }
-}
 
-static void destroy_packet_queue(easyav1_t *easyav1, easyav1_packet_queue *queue)
-{
-    release_packets_from_queue(easyav1, queue);
-    free(queue->items);
-    memset(queue, 0, sizeof(easyav1_packet_queue));
-}
+    easyav1->seek.timestamp = 0;
+    easyav1->seek.mode = NOT_SEEKING;
+    easyav1->seek.position_lost = EASYAV1_FALSE;
 
-static easyav1_packet *prepare_new_packet(easyav1_t *easyav1)
-{
-    nestegg_packet *packet = NULL;
+    size_t seek_time = (size_t) (easyav1_get_microseconds() - seek_start);
 
-    int status = nestegg_read_packet(easyav1->webm.context, &packet);
+    atomic_add_size(&easyav1->counters.seeks, 1);
+    atomic_add_size(&easyav1->counters.seek_us, seek_time);
+    atomic_store_size_max(&easyav1->counters.max_seek_us, seek_time);
 
-    if (status < 0) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to read packet.");
-        return NULL;
-    }
+    trace(EASYAV1_TRACE_SEEK, EASYAV1_TRACE_PHASE_END, timestamp, 0);
 
-    if (status == 0) {
-        easyav1->packets.all_fetched = EASYAV1_TRUE;
-        return NULL;
-    }
+    log(EASYAV1_LOG_LEVEL_INFO, "Seeked to timestamp %llu from timestamp %llu.",
+        atomic_load_u64(&easyav1->position), original_timestamp);
 
-    unsigned int track;
+    return EASYAV1_STATUS_OK;
+}
 
-    if (nestegg_packet_track(packet, &track)) {
-        nestegg_free_packet(packet);
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track number from packet.");
-        return NULL;
+static void request_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    // The timestamp is stored before the request is raised, so the playback thread always seeks to the latest one
+    atomic_store_u64(&easyav1->playback.seek.timestamp, timestamp);
+    atomic_store_size(&easyav1->playback.seek.requested, 1);
+
+    // The playback thread holds the mutex for as long as it decodes, and it checks the request before waiting, so it
+    // only has to be woken up when the mutex is free. It may also be held just between that check and the wait, in
+    // which case the seek starts at the next deadline, at most `PLAYBACK_MAX_WAIT_MS` later
+    if (pthread_mutex_trylock(&easyav1->playback.mutex) == 0) {
+        pthread_cond_signal(&easyav1->playback.wake);
+        pthread_mutex_unlock(&easyav1->playback.mutex);
     }
+}
 
-    int track_type = nestegg_track_type(easyav1->webm.context, track);
-
-    if (track_type == -1) {
-        nestegg_free_packet(packet);
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get track type for track %u.", track);
-        return NULL;
-    } else if (track_type == NESTEGG_TRACK_UNKNOWN) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Skipping unknown track %u of type %d.", track, track_type);
-        nestegg_free_packet(packet);
-        return NULL;
+easyav1_status easyav1_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1_packet_type type = track_type == NESTEGG_TRACK_VIDEO ? PACKET_TYPE_VIDEO : PACKET_TYPE_AUDIO;
-
-    if (type == PACKET_TYPE_VIDEO &&
-        (easyav1->video.active == EASYAV1_FALSE || easyav1->video.track != track)) {
-        nestegg_free_packet(packet);
-        return NULL;
+    if (easyav1->stream.seekable == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The stream can't be seeked.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (type == PACKET_TYPE_AUDIO &&
-        (easyav1->audio.active == EASYAV1_FALSE || easyav1->audio.track != track)) {
-        nestegg_free_packet(packet);
-        return NULL;
+    if (easyav1->seek.mode != NOT_SEEKING) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Trying to seek while already seeking.");
+        return EASYAV1_STATUS_OK;
     }
 
-    easyav1_timestamp packet_timestamp;
-
-    if (nestegg_packet_tstamp(packet, &packet_timestamp)) {
-        nestegg_free_packet(packet);
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet timestamp.");
-        return NULL;
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        request_seek_to_timestamp(easyav1, timestamp);
+        return EASYAV1_STATUS_OK;
     }
 
-    packet_timestamp = internal_timestamp_to_ms(easyav1, packet_timestamp);
-
-    if (type == PACKET_TYPE_AUDIO) {
-        if (easyav1->packets.audio_offset < 0 && -easyav1->packets.audio_offset > packet_timestamp) {
-            nestegg_free_packet(packet);
-            return NULL;
-        }
-
-        if (easyav1->packets.audio_offset > 0 &&
-            packet_timestamp + easyav1->packets.audio_offset > easyav1->duration) {
-            nestegg_free_packet(packet);
-            return NULL;
-        }
+    return do_seek_to_timestamp(easyav1, timestamp);
+}
 
-        packet_timestamp += easyav1->packets.audio_offset;
+easyav1_timestamp easyav1_get_keyframe_before(const easyav1_t *easyav1, easyav1_timestamp timestamp)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return 0;
     }
 
-    int has_keyframe = nestegg_packet_has_keyframe(packet);
-    if (has_keyframe == -1) {
-        nestegg_free_packet(packet);
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get keyframe status.");
-        return NULL;
-    }
+    unsigned int index = find_cue_point(easyav1, timestamp, EASYAV1_TRUE);
 
-    easyav1_bool should_lock_thread = easyav1->seek.mode == NOT_SEEKING || easyav1->seek.mode == SEEKING_FOR_TIMESTAMP ?
-        EASYAV1_TRUE : EASYAV1_FALSE;
+    return index == 0 ? 0 : easyav1->webm.cues.points[index - 1].timestamp;
+}
 
-    if (type == PACKET_TYPE_VIDEO && should_lock_thread) {
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+easyav1_status easyav1_seek_forward(easyav1_t *easyav1, easyav1_timestamp time)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1_packet *new_packet = queue_new_packet(easyav1, type == PACKET_TYPE_VIDEO ?
-        &easyav1->packets.video_queue : &easyav1->packets.audio_queue);
+    return easyav1_seek_to_timestamp(easyav1, atomic_load_u64(&easyav1->position) + time);
+}
 
-    if (!new_packet) {
-        if (type == PACKET_TYPE_VIDEO && should_lock_thread) {
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-        }
-        nestegg_free_packet(packet);
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_OUT_OF_MEMORY, "Failed to allocate memory for new packet.");
-        return NULL;
+easyav1_status easyav1_seek_backward(easyav1_t *easyav1, easyav1_timestamp time)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    new_packet->packet = packet;
-    new_packet->timestamp = packet_timestamp;
-    new_packet->is_keyframe = has_keyframe == NESTEGG_PACKET_HAS_KEYFRAME_TRUE ? EASYAV1_TRUE : EASYAV1_FALSE;
-    new_packet->type = type;
-    new_packet->is_seek_packet = easyav1->seek.mode != NOT_SEEKING && packet_timestamp <= easyav1->seek.timestamp;
+    easyav1_timestamp position = atomic_load_u64(&easyav1->position);
 
-    if (type == PACKET_TYPE_VIDEO && should_lock_thread) {
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_packets);
+    if (time > position) {
+        time = position;
     }
 
-    return new_packet;
+    return easyav1_seek_to_timestamp(easyav1, position - time);
 }
 
 
+
 /**
- * @brief Indicates whether we need to fetch at least one packet.
- *
- * @param easyav1 The easyav1 context to check.
- * @return `EASYAV1_TRUE` if we need to fetch at least one packet, `EASYAV1_FALSE` otherwise. 
+ * Index persistence functions
  */
-static inline easyav1_bool must_fetch_one_packet(easyav1_t *easyav1)
-{
-    return easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0;
-}
-
 
 /**
- * @brief Indicates whether we need to fetch more video packets.
- * 
- * @param easyav1 The easyav1 context to check.
+ * @brief Stores a value in a saved index, in little-endian byte order.
  *
- * @return `EASYAV1_TRUE` if we need to fetch more video packets, `EASYAV1_FALSE` otherwise.
+ * @param data Where to store the value.
+ * @param value The value to store.
+ * @param bytes The number of bytes to store the value in.
  */
-static easyav1_bool must_fetch_video_packets(easyav1_t *easyav1)
+static void store_index_value(uint8_t *data, uint64_t value, unsigned int bytes)
 {
-    if (easyav1->video.active == EASYAV1_FALSE ||
-        (easyav1->seek.mode != NOT_SEEKING && easyav1->seek.mode != SEEKING_FOR_TIMESTAMP)) {
-        return EASYAV1_FALSE;
-    }
-
-    if (easyav1->packets.video_queue.count > VIDEO_FRAMES_TO_PREFETCH) {
-        return EASYAV1_FALSE;
+    for (unsigned int byte = 0; byte < bytes; byte++) {
+        data[byte] = (uint8_t) (value >> (byte * 8));
     }
-
-    return EASYAV1_TRUE;
 }
 
-
 /**
- * @brief Indicates whether we need to fetch more audio packets.
+ * @brief Loads a value stored in a saved index by `store_index_value`.
  *
- * @param easyav1 The easyav1 context to check.
- * @return `EASYAV1_TRUE` if we need to fetch more audio packets, `EASYAV1_FALSE` otherwise.
+ * @param data Where the value is stored.
+ * @param bytes The number of bytes the value is stored in.
+ *
+ * @return The value.
  */
-static easyav1_bool must_fetch_audio_packets(easyav1_t *easyav1)
+static uint64_t load_index_value(const uint8_t *data, unsigned int bytes)
 {
-    // No audio or performing seek - skip
-    if (easyav1->audio.active == EASYAV1_FALSE) {
-        return EASYAV1_FALSE;
-    }
+    uint64_t value = 0;
 
-    // No need to prefetch audio - skip
-    if (easyav1->packets.audio_offset >= 0) {
-        return EASYAV1_FALSE;
+    for (unsigned int byte = 0; byte < bytes; byte++) {
+        value |= (uint64_t) data[byte] << (byte * 8);
     }
 
-    easyav1_packet *audio_packet = retrieve_last_packet_from_queue(easyav1, &easyav1->packets.audio_queue);
-
-    return audio_packet == NULL || audio_packet->timestamp < easyav1->position ? EASYAV1_TRUE : EASYAV1_FALSE;
+    return value;
 }
 
-static easyav1_status sync_packet_queues(easyav1_t *easyav1)
+size_t easyav1_save_index(easyav1_t *easyav1, void *buffer, size_t size)
 {
-    if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-        return EASYAV1_STATUS_FINISHED;
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return 0;
     }
 
-    if (easyav1->packets.synced == EASYAV1_TRUE || easyav1->packets.all_fetched == EASYAV1_TRUE) {
-        return EASYAV1_STATUS_OK;
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
+
+    // The keyframes belong to the video track, so there are none to save without one
+    unsigned int keyframes = easyav1->video.active == EASYAV1_TRUE ? easyav1->seek.index.count : 0;
+    size_t index_size = INDEX_HEADER_SIZE + (size_t) easyav1->webm.cues.count * INDEX_CUE_POINT_SIZE +
+        (size_t) keyframes * INDEX_KEYFRAME_SIZE;
+
+    if (!buffer || size < index_size) {
+        pthread_mutex_unlock(&easyav1->seek.index.mutex);
+        return index_size;
     }
 
-    while (easyav1->packets.all_fetched == EASYAV1_FALSE &&
-        (must_fetch_one_packet(easyav1) || must_fetch_video_packets(easyav1) || must_fetch_audio_packets(easyav1))) {
+    uint8_t *data = buffer;
 
-        if (!prepare_new_packet(easyav1) && EASYAV1_STATUS_IS_ERROR(easyav1->status)) {
-            return EASYAV1_STATUS_ERROR;
-        }
+    store_index_value(data, INDEX_MAGIC, 4);
+    store_index_value(data + 4, INDEX_VERSION, 4);
+    store_index_value(data + 8, easyav1->duration, 8);
+    store_index_value(data + 16, easyav1->time_scale, 8);
+    store_index_value(data + 24, easyav1->webm.num_tracks, 4);
+    store_index_value(data + 28, easyav1->video.active == EASYAV1_TRUE ? easyav1->video.track : UINT32_MAX, 4);
+    store_index_value(data + 32, easyav1->webm.cues.count, 4);
+    store_index_value(data + 36, keyframes, 4);
+    store_index_value(data + 40, easyav1->video.active == EASYAV1_TRUE &&
+        easyav1->seek.index.scan.finished == EASYAV1_TRUE ? INDEX_FLAG_SCAN_FINISHED : 0, 4);
+    store_index_value(data + 44, 0, 4);
 
-    }
+    data += INDEX_HEADER_SIZE;
 
-    easyav1->packets.synced = EASYAV1_TRUE;
+    for (unsigned int cue = 0; cue < easyav1->webm.cues.count; cue++) {
+        store_index_value(data, easyav1->webm.cues.points[cue].timestamp, 8);
+        store_index_value(data + 8, (uint64_t) easyav1->webm.cues.points[cue].offset, 8);
+        data += INDEX_CUE_POINT_SIZE;
+    }
 
-    if (easyav1->packets.video_queue.count == 0 && easyav1->packets.audio_queue.count == 0 &&
-        easyav1->packets.all_fetched == EASYAV1_TRUE) {
-        easyav1->status = EASYAV1_STATUS_FINISHED;
+    for (unsigned int keyframe = 0; keyframe < keyframes; keyframe++) {
+        store_index_value(data, easyav1->seek.index.items[keyframe].timestamp, 8);
+        store_index_value(data + 8, easyav1->seek.index.items[keyframe].covered_until, 8);
+        store_index_value(data + 16, (uint64_t) easyav1->seek.index.items[keyframe].offset, 8);
+        data += INDEX_KEYFRAME_SIZE;
     }
 
-    return EASYAV1_STATUS_OK;
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
+
+    return index_size;
 }
 
-static easyav1_packet *get_next_packet(easyav1_t *easyav1)
+static easyav1_status load_index(easyav1_t *easyav1, const uint8_t *data, size_t size)
 {
-    if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-        return NULL;
-    }
-
-    if (sync_packet_queues(easyav1) != EASYAV1_STATUS_OK) {
-        return NULL;
+    if (size < INDEX_HEADER_SIZE || load_index_value(data, 4) != INDEX_MAGIC ||
+        load_index_value(data + 4, 4) != INDEX_VERSION) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The data is not a saved index.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1_packet *video_packet = retrieve_first_packet_from_queue(easyav1, &easyav1->packets.video_queue);
-    easyav1_packet *audio_packet = retrieve_first_packet_from_queue(easyav1, &easyav1->packets.audio_queue);
+    uint64_t video_track = easyav1->video.active == EASYAV1_TRUE ? easyav1->video.track : UINT32_MAX;
 
-    if (!video_packet) {
-        return audio_packet;
+    if (load_index_value(data + 8, 8) != easyav1->duration || load_index_value(data + 16, 8) != easyav1->time_scale ||
+        load_index_value(data + 24, 4) != easyav1->webm.num_tracks || load_index_value(data + 28, 4) != video_track) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The saved index was saved for another stream or video track.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (!audio_packet) {
-        return video_packet;
-    }
+    unsigned int cues = (unsigned int) load_index_value(data + 32, 4);
+    unsigned int keyframes = (unsigned int) load_index_value(data + 36, 4);
+    easyav1_bool finished = load_index_value(data + 40, 4) & INDEX_FLAG_SCAN_FINISHED ? EASYAV1_TRUE : EASYAV1_FALSE;
 
-    if (video_packet->timestamp <= audio_packet->timestamp) {
-        return video_packet;
+    // The counts come from untrusted data, so they're checked against the size before multiplying to avoid overflows
+    size_t remaining = size - INDEX_HEADER_SIZE;
+
+    if (cues > remaining / INDEX_CUE_POINT_SIZE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The saved index is truncated or corrupted.");
+        return EASYAV1_STATUS_ERROR;
     }
-    
-    return audio_packet;
-}
 
+    remaining -= (size_t) cues * INDEX_CUE_POINT_SIZE;
 
-/**
- * Video frame queue functions
- */
+    if (keyframes > remaining / INDEX_KEYFRAME_SIZE || remaining != (size_t) keyframes * INDEX_KEYFRAME_SIZE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The saved index is truncated or corrupted.");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-static void enqueue_video_frame(easyav1_t *easyav1, Dav1dPicture *pic)
-{
-    if (easyav1->video.frame_queue.count >= VIDEO_FRAME_QUEUE_SIZE) {
-        dequeue_video_frame(easyav1);
+    if (cues > SIZE_MAX / sizeof(easyav1_cue_point) || keyframes > SIZE_MAX / sizeof(easyav1_keyframe)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "The saved index is too large to be loaded.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    size_t index = (easyav1->video.frame_queue.begin + easyav1->video.frame_queue.count) % VIDEO_FRAME_QUEUE_SIZE;
-    memcpy(&easyav1->video.frame_queue.frames[index], pic, sizeof(Dav1dPicture));
-    easyav1->video.frame_queue.count++;
-}
+    easyav1_cue_point *points = cues ? malloc(cues * sizeof(easyav1_cue_point)) : NULL;
+    easyav1_keyframe *items = keyframes ? malloc(keyframes * sizeof(easyav1_keyframe)) : NULL;
 
-static Dav1dPicture *get_oldest_video_frame_from_queue(easyav1_t *easyav1)
-{
-    if (easyav1->video.frame_queue.count == 0) {
-        return NULL;
+    if ((cues && !points) || (keyframes && !items)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the saved index.");
+        free(points);
+        free(items);
+        return EASYAV1_STATUS_ERROR;
     }
 
-    return &easyav1->video.frame_queue.frames[easyav1->video.frame_queue.begin];
-}
+    // Both indexes are searched with binary searches, so they must be sorted
+    easyav1_bool sorted = EASYAV1_TRUE;
 
-static void dequeue_video_frame(easyav1_t *easyav1)
-{
-    Dav1dPicture *pic = get_oldest_video_frame_from_queue(easyav1);
+    data += INDEX_HEADER_SIZE;
 
-    if (!pic) {
-        return;
-    }
+    for (unsigned int cue = 0; cue < cues; cue++) {
+        points[cue].timestamp = load_index_value(data, 8);
+        points[cue].offset = (int64_t) load_index_value(data + 8, 8);
+        data += INDEX_CUE_POINT_SIZE;
 
-    if (pic->frame_hdr) {
-        dav1d_picture_unref(pic);
+        if (cue > 0 && points[cue].timestamp < points[cue - 1].timestamp) {
+            sorted = EASYAV1_FALSE;
+        }
     }
 
-    easyav1->video.frame_queue.count--;
+    for (unsigned int keyframe = 0; keyframe < keyframes; keyframe++) {
+        items[keyframe].timestamp = load_index_value(data, 8);
+        items[keyframe].covered_until = load_index_value(data + 8, 8);
+        items[keyframe].offset = (int64_t) load_index_value(data + 16, 8);
+        data += INDEX_KEYFRAME_SIZE;
 
-    if (easyav1->video.frame_queue.count == 0) {
-        easyav1->video.frame_queue.begin = 0;
-    } else {
-        easyav1->video.frame_queue.begin = (easyav1->video.frame_queue.begin + 1) % VIDEO_FRAME_QUEUE_SIZE;
+        if ((keyframe > 0 && items[keyframe].timestamp <= items[keyframe - 1].timestamp) ||
+            items[keyframe].covered_until <= items[keyframe].timestamp) {
+            sorted = EASYAV1_FALSE;
+        }
     }
-}
 
-static void dequeue_all_video_frames(easyav1_t *easyav1)
-{
-    while (easyav1->video.frame_queue.count > 0) {
-        dequeue_video_frame(easyav1);
+    if (sorted == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The saved index is corrupted.");
+        free(points);
+        free(items);
+        return EASYAV1_STATUS_ERROR;
     }
-}
 
+    free(easyav1->webm.cues.points);
+    easyav1->webm.cues.points = points;
+    easyav1->webm.cues.count = cues;
 
-/**
- * Decoding functions
- */
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-static void callback_video(easyav1_t *easyav1)
-{
-    if (!easyav1->settings.callbacks.video) {
-        return;
-    }
+    // A running scan keeps adding keyframes to the loaded ones, which it does just as if they were its own
+    free(easyav1->seek.index.items);
+    easyav1->seek.index.items = items;
+    easyav1->seek.index.count = keyframes;
+    easyav1->seek.index.capacity = keyframes;
+    easyav1->seek.index.cursor.has_keyframe = EASYAV1_FALSE;
 
-    const easyav1_video_frame *frame = easyav1_get_video_frame(easyav1);
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-    if (!frame) {
-        return;
+    if (finished == EASYAV1_TRUE) {
+        stop_keyframe_scan(easyav1);
+        easyav1->seek.index.scan.finished = EASYAV1_TRUE;
     }
 
-    easyav1->settings.callbacks.video(frame, easyav1->settings.callbacks.userdata);
+    log(EASYAV1_LOG_LEVEL_INFO, "Loaded %u cue points and %u keyframes from the saved index.", cues, keyframes);
+
+    return EASYAV1_STATUS_OK;
 }
 
-static void callback_audio(easyav1_t *easyav1)
+easyav1_status easyav1_load_index(easyav1_t *easyav1, const void *data, size_t size)
 {
-    if (!easyav1->settings.callbacks.audio) {
-        return;
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    const easyav1_audio_frame *frame = easyav1_get_audio_frame(easyav1);
+    if (!data) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Index data is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-    if (!frame) {
-        return;
+    // The playback thread reads the cue index when seeking
+    if (easyav1->playback.active == EASYAV1_TRUE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Playback must be stopped before loading an index.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1->settings.callbacks.audio(frame, easyav1->settings.callbacks.userdata);
+    return load_index(easyav1, data, size);
 }
 
-static void pause_video_decoder_thread(easyav1_t *easyav1)
+/**
+ * Color conversion functions
+ */
+
+static unsigned int rgb_format_bytes_per_pixel(easyav1_rgb_format format)
 {
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.status);
+    return format == EASYAV1_RGB_FORMAT_RGB ? 3 : 4;
+}
 
-    easyav1->video.decoder_thread.command = THREAD_COMMAND_PAUSE;
+/**
+ * @brief Builds the fixed point conversion matrix for a set of luma coefficients.
+ *
+ * @param kr The red luma coefficient.
+ * @param kb The blue luma coefficient.
+ * @param full_range Whether the samples use the full range instead of the limited (studio) range.
+ * @param bits The bit depth of the samples.
+ * @param matrix The matrix to fill.
+ */
+static void init_yuv_matrix(double kr, double kb, easyav1_bool full_range, unsigned int bits,
+    easyav1_yuv_matrix *matrix)
+{
+    double kg = 1.0 - kr - kb;
+    double y_scale = full_range == EASYAV1_TRUE ? 1.0 : 255.0 / 219.0;
+    double c_scale = full_range == EASYAV1_TRUE ? 1.0 : 255.0 / 224.0;
+
+    matrix->y_offset = (int16_t) (full_range == EASYAV1_TRUE ? 0 : 16 << (bits - 8));
+    matrix->c_offset = (int16_t) (128 << (bits - 8));
+    matrix->shift = (int16_t) (15 - bits);
+
+    matrix->y = (int16_t) (y_scale * 4096.0 + 0.5);
+    matrix->r_v = (int16_t) (c_scale * 2.0 * (1.0 - kr) * 4096.0 + 0.5);
+    matrix->g_u = (int16_t) (c_scale * 2.0 * kb * (1.0 - kb) / kg * 4096.0 + 0.5);
+    matrix->g_v = (int16_t) (c_scale * 2.0 * kr * (1.0 - kr) / kg * 4096.0 + 0.5);
+    matrix->b_u = (int16_t) (c_scale * 2.0 * (1.0 - kb) * 4096.0 + 0.5);
+}
 
-    while (easyav1->video.decoder_thread.command == THREAD_COMMAND_PAUSE) {
-        // Force the video decoder thread to wake up and check the command
-        // This is necessary because the thread may be waiting for a packet
-        // and won't check the command until it gets one
-        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_packets);
-        pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_changed_status,
-            &easyav1->video.decoder_thread.mutexes.status);
+/**
+ * @brief Gets the luma coefficients of a color matrix.
+ *
+ * When the matrix isn't specified, BT.601 is used for standard definition video and BT.709 for the rest.
+ *
+ * @param matrix_coefficients The color matrix.
+ * @param height The height of the video.
+ * @param kr Where to store the red luma coefficient.
+ * @param kb Where to store the blue luma coefficient.
+ *
+ * @return `EASYAV1_TRUE` if the matrix is supported, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool get_luma_coefficients(easyav1_matrix_coefficients matrix_coefficients, unsigned int height,
+    double *kr, double *kb)
+{
+    switch (matrix_coefficients) {
+        case EASYAV1_MATRIX_COEFFICIENTS_UNSPECIFIED:
+        case EASYAV1_MATRIX_COEFFICIENTS_UNKNOWN:
+            if (height > 576) {
+                *kr = 0.2126;
+                *kb = 0.0722;
+            } else {
+                *kr = 0.299;
+                *kb = 0.114;
+            }
+            return EASYAV1_TRUE;
+        case EASYAV1_MATRIX_COEFFICIENTS_BT709:
+            *kr = 0.2126;
+            *kb = 0.0722;
+            return EASYAV1_TRUE;
+        case EASYAV1_MATRIX_COEFFICIENTS_FCC:
+            *kr = 0.30;
+            *kb = 0.11;
+            return EASYAV1_TRUE;
+        case EASYAV1_MATRIX_COEFFICIENTS_BT470BG:
+        case EASYAV1_MATRIX_COEFFICIENTS_BT601:
+            *kr = 0.299;
+            *kb = 0.114;
+            return EASYAV1_TRUE;
+        case EASYAV1_MATRIX_COEFFICIENTS_SMPTE240:
+            *kr = 0.212;
+            *kb = 0.087;
+            return EASYAV1_TRUE;
+        case EASYAV1_MATRIX_COEFFICIENTS_BT2020_NCL:
+        case EASYAV1_MATRIX_COEFFICIENTS_BT2020_CL:
+            *kr = 0.2627;
+            *kb = 0.0593;
+            return EASYAV1_TRUE;
+        default:
+            return EASYAV1_FALSE;
     }
 }
 
-static void resume_video_decoder_thread(easyav1_t *easyav1)
+static inline int16_t multiply_high(int16_t a, int16_t b)
 {
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.status);
-    pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_changed_status);
+    return (int16_t) (((int32_t) a * b) >> 16);
 }
 
-static void stop_video_decoder_thread(easyav1_t *easyav1)
+static inline uint8_t to_color(int16_t value)
 {
-    easyav1->video.decoder_thread.command = THREAD_COMMAND_STOP;
-
-    resume_video_decoder_thread(easyav1);
+    int color = (value + 4) >> 3;
 
-    pthread_join(easyav1->video.decoder_thread.decoder, NULL);
+    return color < 0 ? 0 : color > 255 ? 255 : (uint8_t) color;
 }
 
-static thread_command handle_video_decoder_thread_command(easyav1_t *easyav1)
+static inline int16_t load_sample(const void *row, unsigned int x, easyav1_bool high_bit_depth)
 {
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.status);
+    return high_bit_depth == EASYAV1_TRUE ? (int16_t) ((const uint16_t *) row)[x] : ((const uint8_t *) row)[x];
+}
 
-    if (easyav1->video.decoder_thread.command == THREAD_COMMAND_PAUSE) {
-        easyav1->video.decoder_thread.command = THREAD_COMMAND_NONE;
-        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_changed_status);
-        pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_changed_status,
-            &easyav1->video.decoder_thread.mutexes.status);
+static inline void store_pixel(uint8_t *out, easyav1_rgb_format format, uint8_t r, uint8_t g, uint8_t b)
+{
+    switch (format) {
+        case EASYAV1_RGB_FORMAT_RGB:
+            out[0] = r;
+            out[1] = g;
+            out[2] = b;
+            break;
+        case EASYAV1_RGB_FORMAT_BGRA:
+            out[0] = b;
+            out[1] = g;
+            out[2] = r;
+            out[3] = 255;
+            break;
+        default:
+            out[0] = r;
+            out[1] = g;
+            out[2] = b;
+            out[3] = 255;
+            break;
     }
+}
 
-    thread_command command = easyav1->video.decoder_thread.command;
+/**
+ * @brief Converts the pixels of a row from `start` to the end, one at a time.
+ *
+ * This is the reference implementation: the vectorized versions give the exact same results.
+ */
+static void convert_row_scalar(const void *y_row, const void *u_row, const void *v_row, uint8_t *out,
+    unsigned int start, unsigned int width, unsigned int chroma_shift, easyav1_bool high_bit_depth,
+    const easyav1_yuv_matrix *matrix, easyav1_rgb_format format)
+{
+    unsigned int bytes_per_pixel = rgb_format_bytes_per_pixel(format);
+    int scale = 1 << matrix->shift;
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.status);
+    for (unsigned int x = start; x < width; x++) {
+        int16_t y = (int16_t) ((load_sample(y_row, x, high_bit_depth) - matrix->y_offset) * scale);
+        int16_t u = 0;
+        int16_t v = 0;
 
-    return command;
+        if (u_row) {
+            u = (int16_t) ((load_sample(u_row, x >> chroma_shift, high_bit_depth) - matrix->c_offset) * scale);
+            v = (int16_t) ((load_sample(v_row, x >> chroma_shift, high_bit_depth) - matrix->c_offset) * scale);
+        }
+
+        int16_t luma = multiply_high(y, matrix->y);
+        int16_t r = (int16_t) (luma + multiply_high(v, matrix->r_v));
+        int16_t g = (int16_t) (luma - multiply_high(u, matrix->g_u) - multiply_high(v, matrix->g_v));
+        int16_t b = (int16_t) (luma + multiply_high(u, matrix->b_u));
+
+        store_pixel(out + x * bytes_per_pixel, format, to_color(r), to_color(g), to_color(b));
+    }
 }
 
-static void *video_decoder_thread(void *arg)
+#ifdef EASYAV1_HAS_SSE2
+
+static inline __m128i load_samples_sse2(const void *row, unsigned int x, easyav1_bool high_bit_depth)
 {
-    easyav1_t *easyav1 = (easyav1_t *) arg;
+    if (high_bit_depth == EASYAV1_TRUE) {
+        return _mm_loadu_si128((const __m128i *) ((const uint16_t *) row + x));
+    }
 
-    while (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_FALSE) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) ((const uint8_t *) row + x)), _mm_setzero_si128());
+}
 
-        if (handle_video_decoder_thread_command(easyav1) == THREAD_COMMAND_STOP) {
-            break;
-        }
-    
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+static inline __m128i load_chroma_samples_sse2(const void *row, unsigned int x, unsigned int chroma_shift,
+    easyav1_bool high_bit_depth)
+{
+    if (!chroma_shift) {
+        return load_samples_sse2(row, x, high_bit_depth);
+    }
 
-        easyav1_packet *packet = get_video_packet_to_decode(easyav1, &easyav1->packets.video_queue);
+    __m128i samples;
 
-        while (packet == NULL) {
-            pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_packets,
-                &easyav1->video.decoder_thread.mutexes.io);
+    // Load half as many samples and use each one for two pixels
+    if (high_bit_depth == EASYAV1_TRUE) {
+        samples = _mm_loadl_epi64((const __m128i *) ((const uint16_t *) row + x / 2));
+    } else {
+        int32_t packed;
+        memcpy(&packed, (const uint8_t *) row + x / 2, sizeof(packed));
+        samples = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), _mm_setzero_si128());
+    }
 
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    return _mm_unpacklo_epi16(samples, samples);
+}
 
-            if (handle_video_decoder_thread_command(easyav1) == THREAD_COMMAND_STOP) {
-                return 0;
-            }
+/**
+ * @brief Stores 8 pixels held as 8-bit colors in the low halves of the registers.
+ */
+static inline void store_pixels_sse2(uint8_t *out, __m128i r, __m128i g, __m128i b, easyav1_rgb_format format)
+{
+    if (format == EASYAV1_RGB_FORMAT_RGB) {
+        uint8_t colors[3][16];
 
-            pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+        _mm_storeu_si128((__m128i *) colors[0], r);
+        _mm_storeu_si128((__m128i *) colors[1], g);
+        _mm_storeu_si128((__m128i *) colors[2], b);
 
-            packet = get_video_packet_to_decode(easyav1, &easyav1->packets.video_queue);
+        for (unsigned int i = 0; i < 8; i++) {
+            out[i * 3] = colors[0][i];
+            out[i * 3 + 1] = colors[1][i];
+            out[i * 3 + 2] = colors[2][i];
         }
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.decoder);
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-
-        Dav1dPicture pic = { 0 };
+        return;
+    }
 
-        easyav1_status status = decode_video(easyav1, packet, &pic);
+    __m128i first = format == EASYAV1_RGB_FORMAT_BGRA ? b : r;
+    __m128i third = format == EASYAV1_RGB_FORMAT_BGRA ? r : b;
+    __m128i first_and_second = _mm_unpacklo_epi8(first, g);
+    __m128i third_and_alpha = _mm_unpacklo_epi8(third, _mm_set1_epi8((char) 0xff));
 
-        if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
-            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to decode video packet.");
-            return 0;
-        }
+    _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi16(first_and_second, third_and_alpha));
+    _mm_storeu_si128((__m128i *) (out + 16), _mm_unpackhi_epi16(first_and_second, third_and_alpha));
+}
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
+#endif // EASYAV1_HAS_SSE2
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+#if defined(EASYAV1_HAS_AVX2)
 
-        if (packet->is_seek_packet == EASYAV1_TRUE) {
-            dequeue_video_frame(easyav1);
-        }
+static inline __m256i load_samples_avx2(const void *row, unsigned int x, easyav1_bool high_bit_depth)
+{
+    if (high_bit_depth == EASYAV1_TRUE) {
+        return _mm256_loadu_si256((const __m256i *) ((const uint16_t *) row + x));
+    }
 
-        enqueue_video_frame(easyav1, &pic);
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) ((const uint8_t *) row + x)));
+}
 
-        packet->decoded = EASYAV1_TRUE;
+static inline __m256i load_chroma_samples_avx2(const void *row, unsigned int x, unsigned int chroma_shift,
+    easyav1_bool high_bit_depth)
+{
+    if (!chroma_shift) {
+        return load_samples_avx2(row, x, high_bit_depth);
+    }
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    // Load half as many samples and use each one for two pixels
+    if (high_bit_depth == EASYAV1_TRUE) {
+        __m128i samples = _mm_loadu_si128((const __m128i *) ((const uint16_t *) row + x / 2));
 
-        pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_frames_to_display);
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(samples, samples)),
+            _mm_unpackhi_epi16(samples, samples), 1);
     }
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Video decoder thread exiting.");
+    __m128i samples = _mm_loadl_epi64((const __m128i *) ((const uint8_t *) row + x / 2));
 
-    return 0;
+    return _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(samples, samples));
 }
 
-static easyav1_status seek_sequence_header(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size)
+static inline __m128i pack_colors_avx2(__m256i value)
 {
-    Dav1dSequenceHeader sequence_header;
+    __m256i colors = _mm256_srai_epi16(_mm256_add_epi16(value, _mm256_set1_epi16(4)), 3);
 
-    int result = dav1d_parse_sequence_header(&sequence_header, data, size);
+    // Packing works on each 128-bit lane, so the two 64-bit halves holding the colors are brought together
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(colors, colors), 0xd8));
+}
 
-    if (result < 0 && result != DAV1D_ERR(ENOENT)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to parse sequence header");
-        return EASYAV1_STATUS_ERROR;
-    }
+/**
+ * @brief Converts the pixels of a row 16 at a time with AVX2.
+ *
+ * @return The number of pixels converted. The remaining ones are left for `convert_row_scalar`.
+ */
+static unsigned int convert_row_simd(const void *y_row, const void *u_row, const void *v_row, uint8_t *out,
+    unsigned int width, unsigned int chroma_shift, easyav1_bool high_bit_depth, const easyav1_yuv_matrix *matrix,
+    easyav1_rgb_format format)
+{
+    const __m256i y_offset = _mm256_set1_epi16(matrix->y_offset);
+    const __m256i c_offset = _mm256_set1_epi16(matrix->c_offset);
+    const __m128i shift = _mm_cvtsi32_si128(matrix->shift);
+    const __m256i y_coefficient = _mm256_set1_epi16(matrix->y);
+    const __m256i r_v = _mm256_set1_epi16(matrix->r_v);
+    const __m256i g_u = _mm256_set1_epi16(matrix->g_u);
+    const __m256i g_v = _mm256_set1_epi16(matrix->g_v);
+    const __m256i b_u = _mm256_set1_epi16(matrix->b_u);
+    unsigned int bytes_per_pixel = rgb_format_bytes_per_pixel(format);
+    unsigned int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m256i y = _mm256_sll_epi16(_mm256_sub_epi16(load_samples_avx2(y_row, x, high_bit_depth), y_offset), shift);
+        __m256i u = _mm256_sll_epi16(_mm256_sub_epi16(
+            load_chroma_samples_avx2(u_row, x, chroma_shift, high_bit_depth), c_offset), shift);
+        __m256i v = _mm256_sll_epi16(_mm256_sub_epi16(
+            load_chroma_samples_avx2(v_row, x, chroma_shift, high_bit_depth), c_offset), shift);
+
+        __m256i luma = _mm256_mulhi_epi16(y, y_coefficient);
+        __m128i r = pack_colors_avx2(_mm256_add_epi16(luma, _mm256_mulhi_epi16(v, r_v)));
+        __m128i g = pack_colors_avx2(_mm256_sub_epi16(_mm256_sub_epi16(luma, _mm256_mulhi_epi16(u, g_u)),
+            _mm256_mulhi_epi16(v, g_v)));
+        __m128i b = pack_colors_avx2(_mm256_add_epi16(luma, _mm256_mulhi_epi16(u, b_u)));
+
+        store_pixels_sse2(out + x * bytes_per_pixel, r, g, b, format);
+        store_pixels_sse2(out + (x + 8) * bytes_per_pixel, _mm_srli_si128(r, 8), _mm_srli_si128(g, 8),
+            _mm_srli_si128(b, 8), format);
+    }
+
+    return x;
+}
 
-    if (result == 0) {
-        easyav1->seek.mode = SEEKING_FOR_KEYFRAME;
-    }
+#elif defined(EASYAV1_HAS_SSE2)
 
-    return EASYAV1_STATUS_OK;
+static inline __m128i pack_colors_sse2(__m128i value)
+{
+    return _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(value, _mm_set1_epi16(4)), 3), _mm_setzero_si128());
 }
 
 /**
- * Dummy function that is passed to the AV1 decoder to free the data buffer.
- * This is a no-op function that does nothing.
+ * @brief Converts the pixels of a row 8 at a time with SSE2.
+ *
+ * @return The number of pixels converted. The remaining ones are left for `convert_row_scalar`.
  */
-static void free_nothing(const uint8_t *data, void *cookie)
-{}
+static unsigned int convert_row_simd(const void *y_row, const void *u_row, const void *v_row, uint8_t *out,
+    unsigned int width, unsigned int chroma_shift, easyav1_bool high_bit_depth, const easyav1_yuv_matrix *matrix,
+    easyav1_rgb_format format)
+{
+    const __m128i y_offset = _mm_set1_epi16(matrix->y_offset);
+    const __m128i c_offset = _mm_set1_epi16(matrix->c_offset);
+    const __m128i shift = _mm_cvtsi32_si128(matrix->shift);
+    const __m128i y_coefficient = _mm_set1_epi16(matrix->y);
+    const __m128i r_v = _mm_set1_epi16(matrix->r_v);
+    const __m128i g_u = _mm_set1_epi16(matrix->g_u);
+    const __m128i g_v = _mm_set1_epi16(matrix->g_v);
+    const __m128i b_u = _mm_set1_epi16(matrix->b_u);
+    unsigned int bytes_per_pixel = rgb_format_bytes_per_pixel(format);
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sll_epi16(_mm_sub_epi16(load_samples_sse2(y_row, x, high_bit_depth), y_offset), shift);
+        __m128i u = _mm_sll_epi16(_mm_sub_epi16(
+            load_chroma_samples_sse2(u_row, x, chroma_shift, high_bit_depth), c_offset), shift);
+        __m128i v = _mm_sll_epi16(_mm_sub_epi16(
+            load_chroma_samples_sse2(v_row, x, chroma_shift, high_bit_depth), c_offset), shift);
+
+        __m128i luma = _mm_mulhi_epi16(y, y_coefficient);
+        __m128i r = pack_colors_sse2(_mm_add_epi16(luma, _mm_mulhi_epi16(v, r_v)));
+        __m128i g = pack_colors_sse2(_mm_sub_epi16(_mm_sub_epi16(luma, _mm_mulhi_epi16(u, g_u)),
+            _mm_mulhi_epi16(v, g_v)));
+        __m128i b = pack_colors_sse2(_mm_add_epi16(luma, _mm_mulhi_epi16(u, b_u)));
+
+        store_pixels_sse2(out + x * bytes_per_pixel, r, g, b, format);
+    }
+
+    return x;
+}
+
+#elif defined(EASYAV1_HAS_NEON)
 
-static easyav1_status decode_video(easyav1_t *easyav1, easyav1_packet *packet, Dav1dPicture *pic)
+static inline int16x8_t load_samples_neon(const void *row, unsigned int x, easyav1_bool high_bit_depth)
 {
-    unsigned int chunks;
+    if (high_bit_depth == EASYAV1_TRUE) {
+        return vreinterpretq_s16_u16(vld1q_u16((const uint16_t *) row + x));
+    }
 
-    if (nestegg_packet_count(packet->packet, &chunks)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet count");
-        return EASYAV1_STATUS_ERROR;
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8((const uint8_t *) row + x)));
+}
+
+static inline int16x8_t load_chroma_samples_neon(const void *row, unsigned int x, unsigned int chroma_shift,
+    easyav1_bool high_bit_depth)
+{
+    if (!chroma_shift) {
+        return load_samples_neon(row, x, high_bit_depth);
     }
 
-    easyav1_bool has_picture = EASYAV1_FALSE;
+    // Load half as many samples and use each one for two pixels
+    if (high_bit_depth == EASYAV1_TRUE) {
+        uint16x4_t samples = vld1_u16((const uint16_t *) row + x / 2);
+        uint16x4x2_t pairs = vzip_u16(samples, samples);
 
-    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
-        unsigned char *data;
-        size_t size;
+        return vreinterpretq_s16_u16(vcombine_u16(pairs.val[0], pairs.val[1]));
+    }
 
-        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get data from packet");
-            return EASYAV1_STATUS_ERROR;
+    uint32_t packed;
+    memcpy(&packed, (const uint8_t *) row + x / 2, sizeof(packed));
+
+    uint8x8_t samples = vreinterpret_u8_u32(vdup_n_u32(packed));
+
+    return vreinterpretq_s16_u16(vmovl_u8(vzip_u8(samples, samples).val[0]));
+}
+
+/**
+ * @brief Converts the pixels of a row 8 at a time with NEON.
+ *
+ * @return The number of pixels converted. The remaining ones are left for `convert_row_scalar`.
+ */
+static unsigned int convert_row_simd(const void *y_row, const void *u_row, const void *v_row, uint8_t *out,
+    unsigned int width, unsigned int chroma_shift, easyav1_bool high_bit_depth, const easyav1_yuv_matrix *matrix,
+    easyav1_rgb_format format)
+{
+    const int16x8_t y_offset = vdupq_n_s16(matrix->y_offset);
+    const int16x8_t c_offset = vdupq_n_s16(matrix->c_offset);
+
+    // The doubling multiply keeps bits 15 to 30 of the product, so the samples are shifted one bit less
+    const int16x8_t shift = vdupq_n_s16((int16_t) (matrix->shift - 1));
+    const int16x8_t y_coefficient = vdupq_n_s16(matrix->y);
+    const int16x8_t r_v = vdupq_n_s16(matrix->r_v);
+    const int16x8_t g_u = vdupq_n_s16(matrix->g_u);
+    const int16x8_t g_v = vdupq_n_s16(matrix->g_v);
+    const int16x8_t b_u = vdupq_n_s16(matrix->b_u);
+    unsigned int bytes_per_pixel = rgb_format_bytes_per_pixel(format);
+    unsigned int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t y = vshlq_s16(vsubq_s16(load_samples_neon(y_row, x, high_bit_depth), y_offset), shift);
+        int16x8_t u = vshlq_s16(vsubq_s16(load_chroma_samples_neon(u_row, x, chroma_shift, high_bit_depth),
+            c_offset), shift);
+        int16x8_t v = vshlq_s16(vsubq_s16(load_chroma_samples_neon(v_row, x, chroma_shift, high_bit_depth),
+            c_offset), shift);
+
+        int16x8_t luma = vqdmulhq_s16(y, y_coefficient);
+        uint8x8_t r = vqrshrun_n_s16(vaddq_s16(luma, vqdmulhq_s16(v, r_v)), 3);
+        uint8x8_t g = vqrshrun_n_s16(vsubq_s16(vsubq_s16(luma, vqdmulhq_s16(u, g_u)), vqdmulhq_s16(v, g_v)), 3);
+        uint8x8_t b = vqrshrun_n_s16(vaddq_s16(luma, vqdmulhq_s16(u, b_u)), 3);
+
+        if (format == EASYAV1_RGB_FORMAT_RGB) {
+            uint8x8x3_t pixels = { { r, g, b } };
+            vst3_u8(out + x * bytes_per_pixel, pixels);
+        } else if (format == EASYAV1_RGB_FORMAT_BGRA) {
+            uint8x8x4_t pixels = { { b, g, r, vdup_n_u8(255) } };
+            vst4_u8(out + x * bytes_per_pixel, pixels);
+        } else {
+            uint8x8x4_t pixels = { { r, g, b, vdup_n_u8(255) } };
+            vst4_u8(out + x * bytes_per_pixel, pixels);
         }
+    }
 
-        Dav1dData buf = { 0 };
-        int result = dav1d_data_wrap(&buf, data, size, free_nothing, 0);
+    return x;
+}
 
-        if (result < 0) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to create data buffer");
-            return EASYAV1_STATUS_ERROR;
+#endif
+
+/**
+ * @brief Converts a YUV image to RGB.
+ *
+ * Chroma is upsampled by using each chroma sample for all the pixels it covers.
+ *
+ * @param image The image to convert.
+ * @param matrix The conversion matrix to use.
+ * @param format The RGB format to convert to.
+ * @param output Where to store the converted pixels.
+ * @param stride The number of bytes per row in `output`.
+ */
+static void convert_yuv_image(const easyav1_yuv_image *image, const easyav1_yuv_matrix *matrix,
+    easyav1_rgb_format format, uint8_t *output, size_t stride)
+{
+    unsigned int chroma_shift_x = image->layout == EASYAV1_PIXEL_LAYOUT_YUV420 ||
+        image->layout == EASYAV1_PIXEL_LAYOUT_YUV422 ? 1 : 0;
+    unsigned int chroma_shift_y = image->layout == EASYAV1_PIXEL_LAYOUT_YUV420 ? 1 : 0;
+    easyav1_bool has_chroma = image->layout != EASYAV1_PIXEL_LAYOUT_YUV400 ? EASYAV1_TRUE : EASYAV1_FALSE;
+
+    for (unsigned int row = 0; row < image->height; row++) {
+        const uint8_t *y_row = (const uint8_t *) image->planes[0] + row * image->strides[0];
+        const uint8_t *u_row = NULL;
+        const uint8_t *v_row = NULL;
+        uint8_t *out = output + row * stride;
+        unsigned int converted = 0;
+
+        if (has_chroma == EASYAV1_TRUE) {
+            u_row = (const uint8_t *) image->planes[1] + (row >> chroma_shift_y) * image->strides[1];
+            v_row = (const uint8_t *) image->planes[2] + (row >> chroma_shift_y) * image->strides[2];
+
+#if defined(EASYAV1_HAS_SSE2) || defined(EASYAV1_HAS_NEON)
+            converted = convert_row_simd(y_row, u_row, v_row, out, image->width, chroma_shift_x,
+                image->high_bit_depth, matrix, format);
+#endif
         }
 
-        do {
+        convert_row_scalar(y_row, u_row, v_row, out, converted, image->width, chroma_shift_x, image->high_bit_depth,
+            matrix, format);
+    }
+}
 
-            result = dav1d_send_data(easyav1->video.context, &buf);
-            if (result < 0 && result != DAV1D_ERR(EAGAIN)) {
-                LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to send data to AV1 decoder");
-                dav1d_data_unref(&buf);
-                return EASYAV1_STATUS_ERROR;
-            }
+static void convert_picture_to_rgb_buffer(easyav1_t *easyav1, const Dav1dPicture *pic, easyav1_rgb_buffer *buffer)
+{
+    easyav1_video_frame frame = { 0 };
 
-            Dav1dPicture temp_pic = { 0 };
+    buffer->filled = EASYAV1_FALSE;
 
-            result = dav1d_get_picture(easyav1->video.context, &temp_pic);
+    if (!pic->frame_hdr || !pic->seq_hdr || set_frame_picture_type(easyav1, &frame, pic->seq_hdr) == EASYAV1_FALSE) {
+        return;
+    }
 
-            // For some reason, sometimes we need to insist on getting the picture without sending more data
-            if (result == DAV1D_ERR(EAGAIN)) {
-                result = dav1d_get_picture(easyav1->video.context, &temp_pic);
-            }
+    set_frame_picture_data(easyav1, &frame, pic);
 
-            if (result < 0) {
-                if (result == DAV1D_ERR(EAGAIN)) {
-                    continue;
-                }
-                LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get picture from AV1 decoder");
-                dav1d_data_unref(&buf);
-                return EASYAV1_STATUS_ERROR;
-            }
+    easyav1_rgb_format format = easyav1->video.decoder_settings.rgb_format;
+    size_t stride = (size_t) frame.properties.width * rgb_format_bytes_per_pixel(format);
+    size_t size = stride * frame.properties.height;
 
-            easyav1->video.processed_frames++;
+    if (buffer->size < size) {
+        uint8_t *data = realloc(buffer->data, size);
 
-            if (has_picture == EASYAV1_FALSE) {
-                *pic = temp_pic;
-                pic->m.timestamp = packet->timestamp;
-                has_picture = EASYAV1_TRUE;
-            } else {
-                log(EASYAV1_LOG_LEVEL_WARNING, "Multiple pictures in single packet are not supported.");
-                dav1d_picture_unref(&temp_pic);
-            }
+        if (!data) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to allocate memory for the RGB conversion.");
+            return;
+        }
 
-        } while (buf.sz > 0);
+        buffer->data = data;
+        buffer->size = size;
+    }
 
-        dav1d_data_unref(&buf);
+    if (easyav1_convert_video_frame(&frame, format, buffer->data, stride) != EASYAV1_STATUS_OK) {
+        return;
     }
 
-    return EASYAV1_STATUS_OK;
+    buffer->stride = stride;
+    buffer->filled = EASYAV1_TRUE;
 }
 
-static easyav1_status decode_audio(easyav1_t *easyav1, easyav1_packet *packet, uint8_t *data, size_t size)
+easyav1_status easyav1_convert_video_frame(const easyav1_video_frame *frame, easyav1_rgb_format format, void *output,
+    size_t stride)
 {
-    ogg_packet audio_packet = {
-        .packet = data,
-        .bytes = size
-    };
+    easyav1_t *easyav1 = NULL;
 
-    if (easyav1->audio.has_samples_in_buffer == EASYAV1_FALSE) {
-        easyav1->audio.frame.samples = 0;
-        easyav1->audio.frame.timestamp = packet->timestamp;
+    if (!frame || !output) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "No frame or output buffer given.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
-        if (vorbis_synthesis_trackonly(&easyav1->audio.vorbis.block, &audio_packet) ||
-            vorbis_synthesis_blockin(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio packet.");
+    if (format != EASYAV1_RGB_FORMAT_RGB && format != EASYAV1_RGB_FORMAT_RGBA && format != EASYAV1_RGB_FORMAT_BGRA) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported RGB format.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (stride < (size_t) frame->properties.width * rgb_format_bytes_per_pixel(format)) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The output stride is too small for the frame width.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (frame->properties.pixel_layout == EASYAV1_PIXEL_LAYOUT_UNKNOWN) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported pixel layout for RGB conversion.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    if (frame->plane_format == EASYAV1_PLANE_FORMAT_P010) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported plane format for RGB conversion.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    unsigned int bits;
+
+    switch (frame->properties.bits_per_color) {
+        case EASYAV1_BITS_PER_COLOR_8:
+            bits = 8;
+            break;
+        case EASYAV1_BITS_PER_COLOR_10:
+            bits = 10;
+            break;
+        case EASYAV1_BITS_PER_COLOR_12:
+            bits = 12;
+            break;
+        default:
+            log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported bit depth for RGB conversion.");
             return EASYAV1_STATUS_ERROR;
-        }
-
-        int decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, 0);
-        vorbis_synthesis_read(&easyav1->audio.vorbis.dsp, decoded_samples);
-        return EASYAV1_STATUS_OK;
     }
 
-    if (vorbis_synthesis(&easyav1->audio.vorbis.block, &audio_packet) ||
-        vorbis_synthesis_blockin(&easyav1->audio.vorbis.dsp, &easyav1->audio.vorbis.block)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to process audio packet.");
+    double kr, kb;
+
+    if (get_luma_coefficients(frame->properties.matrix_coefficients, frame->properties.height, &kr, &kb) ==
+        EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported color matrix for RGB conversion.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    float **pcm;
-    easyav1_audio_frame *frame = &easyav1->audio.frame;
-    float *buffer = easyav1->audio.buffer;
+    easyav1_yuv_matrix matrix;
+    init_yuv_matrix(kr, kb, frame->properties.color_space == EASYAV1_COLOR_SPACE_FULL ? EASYAV1_TRUE : EASYAV1_FALSE,
+        bits, &matrix);
 
-    int decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, &pcm);
-    unsigned int pcm_offset = prepare_audio_buffer_for_new_samples(easyav1, decoded_samples);
-    
-    while (decoded_samples > 0) {
-        for (unsigned int sample = 0; sample < decoded_samples; sample++) {
-            for (unsigned int channel = 0; channel < easyav1->audio.channels; channel++) {
-                if (easyav1->settings.interlace_audio) {
-                    buffer[(frame->samples + sample) * easyav1->audio.channels + channel] =
-                        pcm[channel][sample + pcm_offset];
-                } else {
-                    buffer[channel * AUDIO_BUFFER_SIZE + frame->samples + sample] = pcm[channel][sample + pcm_offset];
-                }
-            }
-        }
+    easyav1_yuv_image image = {
+        .planes = { frame->data[0], frame->data[1], frame->data[2] },
+        .strides = { (ptrdiff_t) frame->stride[0], (ptrdiff_t) frame->stride[1], (ptrdiff_t) frame->stride[2] },
+        .width = frame->properties.width,
+        .height = frame->properties.height,
+        .layout = frame->properties.pixel_layout,
+        .high_bit_depth = bits > 8 ? EASYAV1_TRUE : EASYAV1_FALSE
+    };
 
-        vorbis_synthesis_read(&easyav1->audio.vorbis.dsp, decoded_samples);
+    convert_yuv_image(&image, &matrix, format, output, stride);
 
-        frame->samples += decoded_samples;
-        if (frame->samples > AUDIO_BUFFER_SIZE) {
-            frame->samples = AUDIO_BUFFER_SIZE;
-        }
+    return EASYAV1_STATUS_OK;
+}
 
-        decoded_samples = vorbis_synthesis_pcmout(&easyav1->audio.vorbis.dsp, &pcm);
-        pcm_offset = prepare_audio_buffer_for_new_samples(easyav1, decoded_samples);
-    }
 
-    if (frame->samples > 0) {
-        easyav1->audio.has_samples_in_buffer = EASYAV1_TRUE;
-    }
+/**
+ * Plane conversion functions
+ */
 
-    return EASYAV1_STATUS_OK;
+/**
+ * 8x8 ordered dither matrix - the thresholds of each pixel, from 0 to 63
+ */
+static const uint8_t DITHER_MATRIX[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+/**
+ * @brief Moves the samples of a row to the high bits of 16-bit samples, from `start` to the end.
+ *
+ * This is the reference implementation: the vectorized versions give the exact same results.
+ */
+static void widen_row_scalar(const void *row, uint16_t *out, unsigned int start, unsigned int width,
+    unsigned int shift, easyav1_bool high_bit_depth)
+{
+    for (unsigned int x = start; x < width; x++) {
+        out[x] = (uint16_t) (load_sample(row, x, high_bit_depth) << shift);
+    }
 }
 
-static unsigned int prepare_audio_buffer_for_new_samples(easyav1_t *easyav1, int decoded_samples)
+/**
+ * @brief Interleaves the chroma samples of a row as 16-bit samples in their high bits, from `start` to the end.
+ *
+ * This is the reference implementation: the vectorized versions give the exact same results.
+ */
+static void interleave_chroma_row_scalar(const void *u_row, const void *v_row, uint16_t *out, unsigned int start,
+    unsigned int width, unsigned int shift, easyav1_bool high_bit_depth)
 {
-    // If we have too many samples, we need to discard some
-    if (decoded_samples > AUDIO_BUFFER_SIZE) {
-        easyav1->audio.frame.samples = 0;
-        return decoded_samples - AUDIO_BUFFER_SIZE;
+    for (unsigned int x = start; x < width; x++) {
+        out[x * 2] = (uint16_t) (load_sample(u_row, x, high_bit_depth) << shift);
+        out[x * 2 + 1] = (uint16_t) (load_sample(v_row, x, high_bit_depth) << shift);
     }
+}
 
-    if (decoded_samples + easyav1->audio.frame.samples <= AUDIO_BUFFER_SIZE) {
-        return 0;
+/**
+ * @brief Dithers the 16-bit samples of a row down to 8 bits, from `start` to the end.
+ *
+ * This is the reference implementation: the vectorized versions give the exact same results. The dither offsets of
+ * the row repeat every 8 samples.
+ */
+static void dither_row_scalar(const uint16_t *row, uint8_t *out, unsigned int start, unsigned int width,
+    unsigned int shift, const uint16_t *dither)
+{
+    for (unsigned int x = start; x < width; x++) {
+        unsigned int value = (row[x] + dither[x & 7]) >> shift;
+
+        out[x] = value > 255 ? 255 : (uint8_t) value;
     }
+}
 
-    // If the audio buffer is too small for the incoming samples, we need to move the stored samples to fit the new ones
-    unsigned int samples_to_move = decoded_samples + easyav1->audio.frame.samples - AUDIO_BUFFER_SIZE;
+#if defined(EASYAV1_HAS_SSE2)
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Audio buffer full, moving %u samples to fit new samples.", samples_to_move);
+/**
+ * @brief Moves the samples of a row to the high bits of 16-bit samples 8 at a time with SSE2.
+ *
+ * @return The number of samples converted. The remaining ones are left for `widen_row_scalar`.
+ */
+static unsigned int widen_row_simd(const void *row, uint16_t *out, unsigned int width, unsigned int shift,
+    easyav1_bool high_bit_depth)
+{
+    const __m128i count = _mm_cvtsi32_si128((int) shift);
+    unsigned int x = 0;
 
-    if (easyav1->settings.interlace_audio) {
-        memmove(easyav1->audio.buffer, easyav1->audio.buffer + samples_to_move * easyav1->audio.channels,
-            (AUDIO_BUFFER_SIZE - samples_to_move) * easyav1->audio.channels * sizeof(float));
-    } else {
-        for (unsigned int channel = 0; channel < easyav1->audio.channels; channel++) {
-            memmove(easyav1->audio.buffer + channel * AUDIO_BUFFER_SIZE,
-                easyav1->audio.buffer + channel * AUDIO_BUFFER_SIZE + samples_to_move,
-                (AUDIO_BUFFER_SIZE - samples_to_move) * sizeof(float));
-        }
+    for (; x + 8 <= width; x += 8) {
+        _mm_storeu_si128((__m128i *) (out + x), _mm_sll_epi16(load_samples_sse2(row, x, high_bit_depth), count));
     }
 
-    easyav1->audio.frame.samples = AUDIO_BUFFER_SIZE - decoded_samples;
-
-    return 0;
+    return x;
 }
 
-static easyav1_status send_packet_data_to_decoder(easyav1_t *easyav1, easyav1_packet *packet, decoder_function decode)
+/**
+ * @brief Interleaves the chroma samples of a row as 16-bit samples in their high bits 8 at a time with SSE2.
+ *
+ * @return The number of samples converted. The remaining ones are left for `interleave_chroma_row_scalar`.
+ */
+static unsigned int interleave_chroma_row_simd(const void *u_row, const void *v_row, uint16_t *out,
+    unsigned int width, unsigned int shift, easyav1_bool high_bit_depth)
 {
-    unsigned int chunks;
+    const __m128i count = _mm_cvtsi32_si128((int) shift);
+    unsigned int x = 0;
 
-    if (nestegg_packet_count(packet->packet, &chunks)) {
-        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get packet count");
-        return EASYAV1_STATUS_ERROR;
+    for (; x + 8 <= width; x += 8) {
+        __m128i u = _mm_sll_epi16(load_samples_sse2(u_row, x, high_bit_depth), count);
+        __m128i v = _mm_sll_epi16(load_samples_sse2(v_row, x, high_bit_depth), count);
+
+        _mm_storeu_si128((__m128i *) (out + x * 2), _mm_unpacklo_epi16(u, v));
+        _mm_storeu_si128((__m128i *) (out + x * 2 + 8), _mm_unpackhi_epi16(u, v));
     }
 
-    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
-        unsigned char *data;
-        size_t size;
+    return x;
+}
 
-        if (nestegg_packet_data(packet->packet, chunk, &data, &size)) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to get data from packet");
-            return EASYAV1_STATUS_ERROR;
-        }
+/**
+ * @brief Dithers the 16-bit samples of a row down to 8 bits 8 at a time with SSE2.
+ *
+ * @return The number of samples converted. The remaining ones are left for `dither_row_scalar`.
+ */
+static unsigned int dither_row_simd(const uint16_t *row, uint8_t *out, unsigned int width, unsigned int shift,
+    const uint16_t *dither)
+{
+    const __m128i offsets = _mm_loadu_si128((const __m128i *) dither);
+    const __m128i count = _mm_cvtsi32_si128((int) shift);
+    unsigned int x = 0;
 
-        if (decode(easyav1, packet, data, size) == EASYAV1_STATUS_ERROR) {
-            return EASYAV1_STATUS_ERROR;
-        }
+    // The saturating add keeps out of range samples at the top, where they end up as 255 either way
+    for (; x + 8 <= width; x += 8) {
+        __m128i samples = _mm_srl_epi16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *) (row + x)), offsets), count);
+
+        _mm_storel_epi64((__m128i *) (out + x), _mm_packus_epi16(samples, samples));
     }
 
-    return EASYAV1_STATUS_OK;
+    return x;
 }
 
-static easyav1_status decode_packet(easyav1_t *easyav1, easyav1_packet *packet)
+#elif defined(EASYAV1_HAS_NEON)
+
+/**
+ * @brief Moves the samples of a row to the high bits of 16-bit samples 8 at a time with NEON.
+ *
+ * @return The number of samples converted. The remaining ones are left for `widen_row_scalar`.
+ */
+static unsigned int widen_row_simd(const void *row, uint16_t *out, unsigned int width, unsigned int shift,
+    easyav1_bool high_bit_depth)
 {
-    if (packet->type == PACKET_TYPE_AUDIO) {
-        return send_packet_data_to_decoder(easyav1, packet, decode_audio);
-    }
+    const int16x8_t count = vdupq_n_s16((int16_t) shift);
+    unsigned int x = 0;
 
-    // Decoding video: use multithreaded decoder
-    if (easyav1->seek.mode == NOT_SEEKING || easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
+    for (; x + 8 <= width; x += 8) {
+        vst1q_u16(out + x, vreinterpretq_u16_s16(vshlq_s16(load_samples_neon(row, x, high_bit_depth), count)));
+    }
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+    return x;
+}
 
-        while (packet->decoded == EASYAV1_FALSE) {
+/**
+ * @brief Interleaves the chroma samples of a row as 16-bit samples in their high bits 8 at a time with NEON.
+ *
+ * @return The number of samples converted. The remaining ones are left for `interleave_chroma_row_scalar`.
+ */
+static unsigned int interleave_chroma_row_simd(const void *u_row, const void *v_row, uint16_t *out,
+    unsigned int width, unsigned int shift, easyav1_bool high_bit_depth)
+{
+    const int16x8_t count = vdupq_n_s16((int16_t) shift);
+    unsigned int x = 0;
 
-            // On some occasions, some video packets may have been fetched after the last signal to the decoder thread.
-            // In this case, we need to signal the decoder thread again to process the new packets.
-            if (get_video_packet_to_decode(easyav1, &easyav1->packets.video_queue)) {
-                pthread_cond_signal(&easyav1->video.decoder_thread.conditions.has_packets);
-            }
+    for (; x + 8 <= width; x += 8) {
+        uint16x8x2_t samples = { {
+            vreinterpretq_u16_s16(vshlq_s16(load_samples_neon(u_row, x, high_bit_depth), count)),
+            vreinterpretq_u16_s16(vshlq_s16(load_samples_neon(v_row, x, high_bit_depth), count))
+        } };
 
-            log(EASYAV1_LOG_LEVEL_INFO, "Waiting for video frame to be decoded.");
-            pthread_cond_wait(&easyav1->video.decoder_thread.conditions.has_frames_to_display,
-                &easyav1->video.decoder_thread.mutexes.io);
+        vst2q_u16(out + x * 2, samples);
+    }
 
-            if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-                pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-                return EASYAV1_STATUS_ERROR;
-            }
-        }
+    return x;
+}
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+/**
+ * @brief Dithers the 16-bit samples of a row down to 8 bits 8 at a time with NEON.
+ *
+ * @return The number of samples converted. The remaining ones are left for `dither_row_scalar`.
+ */
+static unsigned int dither_row_simd(const uint16_t *row, uint8_t *out, unsigned int width, unsigned int shift,
+    const uint16_t *dither)
+{
+    const uint16x8_t offsets = vld1q_u16(dither);
+    const int16x8_t count = vdupq_n_s16((int16_t) -(int) shift);
+    unsigned int x = 0;
 
-        if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-            return EASYAV1_STATUS_ERROR;
-        }
+    // The saturating add keeps out of range samples at the top, where they end up as 255 either way
+    for (; x + 8 <= width; x += 8) {
+        vst1_u8(out + x, vqmovn_u16(vshlq_u16(vqaddq_u16(vld1q_u16(row + x), offsets), count)));
+    }
 
-        if (easyav1->settings.skip_unprocessed_frames == EASYAV1_FALSE) {
-            callback_video(easyav1);
-        }
+    return x;
+}
 
-        return EASYAV1_STATUS_OK;
-    }
+#endif
 
-    // Seeking, do not decode video frames
-    if (easyav1->seek.mode == SEEKING_FOR_SQHDR) {
-        easyav1_status status = send_packet_data_to_decoder(easyav1, packet, seek_sequence_header);
+/**
+ * @brief Converts a plane to 16-bit samples holding their value in the high bits.
+ *
+ * The chroma planes are given together, as the samples of both are interleaved into the same output row.
+ */
+static void widen_plane(const Dav1dPicture *pic, unsigned int plane, unsigned int width, unsigned int height,
+    easyav1_plane_buffer *buffer)
+{
+    easyav1_bool high_bit_depth = pic->p.bpc > 8 ? EASYAV1_TRUE : EASYAV1_FALSE;
+    unsigned int shift = 16 - (unsigned int) pic->p.bpc;
+    ptrdiff_t stride = pic->stride[plane ? 1 : 0];
+
+    for (unsigned int row = 0; row < height; row++) {
+        uint16_t *out = (uint16_t *) (buffer->data + buffer->offset[plane] + row * buffer->stride[plane]);
+        const uint8_t *in = (const uint8_t *) pic->data[plane] + row * stride;
+        unsigned int converted = 0;
+
+        if (plane == 0) {
+#if defined(EASYAV1_HAS_SSE2) || defined(EASYAV1_HAS_NEON)
+            converted = widen_row_simd(in, out, width, shift, high_bit_depth);
+#endif
+            widen_row_scalar(in, out, converted, width, shift, high_bit_depth);
+        } else {
+            const uint8_t *v_in = (const uint8_t *) pic->data[2] + row * stride;
 
-        if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-            return EASYAV1_STATUS_ERROR;
+#if defined(EASYAV1_HAS_SSE2) || defined(EASYAV1_HAS_NEON)
+            converted = interleave_chroma_row_simd(in, v_in, out, width, shift, high_bit_depth);
+#endif
+            interleave_chroma_row_scalar(in, v_in, out, converted, width, shift, high_bit_depth);
         }
     }
+}
 
-    if (easyav1->seek.mode == SEEKING_FOR_KEYFRAME && packet->is_keyframe == EASYAV1_TRUE) {
-        easyav1->seek.mode = SEEKING_FOUND_KEYFRAME;
-    }
+/**
+ * @brief Dithers a plane of high bit depth samples down to 8 bits.
+ */
+static void dither_plane(const Dav1dPicture *pic, unsigned int plane, unsigned int width, unsigned int height,
+    easyav1_plane_buffer *buffer)
+{
+    unsigned int shift = (unsigned int) pic->p.bpc - 8;
+    ptrdiff_t stride = pic->stride[plane ? 1 : 0];
+    uint16_t dither[8];
+
+    for (unsigned int row = 0; row < height; row++) {
+        uint8_t *out = buffer->data + buffer->offset[plane] + row * buffer->stride[plane];
+        const uint16_t *in = (const uint16_t *) ((const uint8_t *) pic->data[plane] + row * stride);
+        unsigned int converted = 0;
+
+        // The thresholds are scaled to the bits that are dropped
+        for (unsigned int x = 0; x < 8; x++) {
+            dither[x] = (uint16_t) (DITHER_MATRIX[row & 7][x] >> (6 - shift));
+        }
 
-    return EASYAV1_STATUS_OK;
+#if defined(EASYAV1_HAS_SSE2) || defined(EASYAV1_HAS_NEON)
+        converted = dither_row_simd(in, out, width, shift, dither);
+#endif
+        dither_row_scalar(in, out, converted, width, shift, dither);
+    }
 }
 
-easyav1_status easyav1_decode_next(easyav1_t *easyav1)
+static void convert_picture_to_plane_buffer(easyav1_t *easyav1, const Dav1dPicture *pic,
+    easyav1_plane_buffer *buffer)
 {
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
-        return EASYAV1_STATUS_ERROR;
-    }
+    easyav1_plane_format format = easyav1->video.decoder_settings.plane_format;
 
-    if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-        return EASYAV1_STATUS_ERROR;
-    }
+    buffer->filled = EASYAV1_FALSE;
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Cannot decode while seeking.");
-        return EASYAV1_STATUS_OK;
+    if (!pic->frame_hdr || (pic->p.bpc != 8 && pic->p.bpc != 10 && pic->p.bpc != 12)) {
+        return;
     }
 
-    if (easyav1->playback.active == EASYAV1_TRUE) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Cannot manually decode when using playback functions.");
-        return EASYAV1_STATUS_OK;
+    // There's nothing to dither in 8-bit pictures, so they are given as they are
+    if (format == EASYAV1_PLANE_FORMAT_8BIT && pic->p.bpc == 8) {
+        return;
     }
 
-    easyav1_packet *packet = get_next_packet(easyav1);
-
-    if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-        return EASYAV1_STATUS_FINISHED;
+    unsigned int width = (unsigned int) pic->p.w;
+    unsigned int height = (unsigned int) pic->p.h;
+    unsigned int chroma_shift_x = pic->p.layout == DAV1D_PIXEL_LAYOUT_I420 ||
+        pic->p.layout == DAV1D_PIXEL_LAYOUT_I422 ? 1 : 0;
+    unsigned int chroma_shift_y = pic->p.layout == DAV1D_PIXEL_LAYOUT_I420 ? 1 : 0;
+    unsigned int chroma_width = (width + chroma_shift_x) >> chroma_shift_x;
+    unsigned int chroma_height = (height + chroma_shift_y) >> chroma_shift_y;
+    easyav1_bool has_chroma = pic->p.layout != DAV1D_PIXEL_LAYOUT_I400 ? EASYAV1_TRUE : EASYAV1_FALSE;
+    size_t luma_bytes, chroma_bytes;
+
+    // The P010 chroma plane holds both chroma samples of each position, and the one after it isn't used
+    if (format == EASYAV1_PLANE_FORMAT_P010) {
+        luma_bytes = (size_t) width * 2;
+        chroma_bytes = has_chroma == EASYAV1_TRUE ? (size_t) chroma_width * 4 : 0;
+    } else {
+        luma_bytes = width;
+        chroma_bytes = has_chroma == EASYAV1_TRUE ? chroma_width : 0;
     }
 
-    if (!packet) {
-        return EASYAV1_STATUS_ERROR;
-    }
+    size_t stride[3];
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    stride[0] = (luma_bytes + DAV1D_PICTURE_ALIGNMENT - 1) & ~(size_t) (DAV1D_PICTURE_ALIGNMENT - 1);
+    stride[1] = (chroma_bytes + DAV1D_PICTURE_ALIGNMENT - 1) & ~(size_t) (DAV1D_PICTURE_ALIGNMENT - 1);
+    stride[2] = format == EASYAV1_PLANE_FORMAT_8BIT ? stride[1] : 0;
 
-    easyav1->position = packet->timestamp;
-    easyav1_packet_type packet_type = packet->type;
+    size_t luma_size = stride[0] * height;
+    size_t chroma_size = stride[1] * chroma_height;
+    size_t size = luma_size + chroma_size + stride[2] * chroma_height;
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    if (buffer->size < size) {
+        uint8_t *data = realloc(buffer->data, size);
 
-    easyav1_status status = decode_packet(easyav1, packet);
+        if (!data) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to allocate memory for the plane conversion.");
+            return;
+        }
 
-    if (packet_type == PACKET_TYPE_VIDEO) {
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+        buffer->data = data;
+        buffer->size = size;
     }
 
-    release_packet_from_queue(easyav1, packet);
+    buffer->offset[0] = 0;
+    buffer->offset[1] = luma_size;
+    buffer->offset[2] = luma_size + chroma_size;
 
-    if (packet_type == PACKET_TYPE_VIDEO) {
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    for (unsigned int plane = 0; plane < 3; plane++) {
+        buffer->stride[plane] = stride[plane];
     }
 
-    if (status == EASYAV1_STATUS_OK) {
-        callback_video(easyav1);
-        callback_audio(easyav1);
+    buffer->format = format;
+
+    if (format == EASYAV1_PLANE_FORMAT_P010) {
+        widen_plane(pic, 0, width, height, buffer);
+
+        if (has_chroma == EASYAV1_TRUE) {
+            widen_plane(pic, 1, chroma_width, chroma_height, buffer);
+        }
+    } else {
+        dither_plane(pic, 0, width, height, buffer);
+
+        if (has_chroma == EASYAV1_TRUE) {
+            dither_plane(pic, 1, chroma_width, chroma_height, buffer);
+            dither_plane(pic, 2, chroma_width, chroma_height, buffer);
+        }
     }
 
-    return status;
+    buffer->filled = EASYAV1_TRUE;
 }
 
-static easyav1_status do_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp)
+
+/**
+ * Frame extraction functions
+ */
+
+/**
+ * @brief Finds the latest known position of a keyframe at or before a timestamp.
+ *
+ * Both the keyframe index and the cue points are looked up, and the closest of the two is used.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param timestamp The timestamp to find the keyframe for.
+ * @param keyframe_timestamp Where to store the timestamp of the keyframe.
+ * @param offset Where to store the offset of the cluster holding the keyframe.
+ *
+ * @return `EASYAV1_TRUE` if a keyframe position is known, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool locate_keyframe(easyav1_t *easyav1, easyav1_timestamp timestamp,
+    easyav1_timestamp *keyframe_timestamp, int64_t *offset)
 {
-    if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-        return EASYAV1_STATUS_ERROR;
-    }
+    easyav1_bool found = EASYAV1_FALSE;
 
-    if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-        return EASYAV1_STATUS_FINISHED;
-    }
+    pthread_mutex_lock(&easyav1->seek.index.mutex);
 
-    if (timestamp <= easyav1->position) {
-        return EASYAV1_STATUS_OK;
-    }
+    unsigned int index = find_keyframe(easyav1, timestamp, EASYAV1_TRUE);
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Cannot decode while seeking.");
-        return EASYAV1_STATUS_OK;
+    if (index > 0) {
+        *keyframe_timestamp = easyav1->seek.index.items[index - 1].timestamp;
+        *offset = easyav1->seek.index.items[index - 1].offset;
+        found = EASYAV1_TRUE;
     }
 
-    // Skip to timestamp if too far behind and at different cue points
-    if (easyav1->settings.skip_unprocessed_frames == EASYAV1_TRUE &&
-        timestamp - easyav1->position > DECODE_UNTIL_SKIP_MS &&
-        get_closest_cue_point(easyav1, easyav1->position) < get_closest_cue_point(easyav1, timestamp)) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Decoder too far behind at %llu, skipping to requested timestamp %llu.",
-            easyav1->position, timestamp);
+    pthread_mutex_unlock(&easyav1->seek.index.mutex);
 
-        easyav1_bool use_fast_seeking = easyav1->settings.use_fast_seeking;
-        easyav1->settings.use_fast_seeking = EASYAV1_TRUE;
+    index = find_cue_point(easyav1, timestamp, EASYAV1_TRUE);
 
-        // Use fast seeking to prevent constantly seeking to the next seek point
-        easyav1_status status = do_seek_to_timestamp(easyav1, timestamp);
+    if (index > 0 && (found == EASYAV1_FALSE || easyav1->webm.cues.points[index - 1].timestamp > *keyframe_timestamp)) {
+        *keyframe_timestamp = easyav1->webm.cues.points[index - 1].timestamp;
+        *offset = easyav1->webm.cues.points[index - 1].offset;
+        found = EASYAV1_TRUE;
+    }
 
-        easyav1->settings.use_fast_seeking = use_fast_seeking;
+    return found;
+}
 
-        if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
-            return EASYAV1_STATUS_ERROR;
+/**
+ * @brief Reads the next video packet of the current video track, discarding all other packets.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param context The webm context to read the packet from.
+ * @param packet Where to store the packet.
+ * @param cursor The indexing cursor to add the keyframes that are read to the keyframe index with, or `NULL` to not
+ * index them.
+ *
+ * @return `EASYAV1_STATUS_OK` if a packet was read, `EASYAV1_STATUS_FINISHED` at the end of the stream or
+ * `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status read_video_packet(easyav1_t *easyav1, nestegg *context, easyav1_packet *packet,
+    easyav1_keyframe_cursor *cursor)
+{
+    while (1) {
+        nestegg_packet *webm_packet;
+        int result = nestegg_read_packet(context, &webm_packet);
+
+        if (result == 0) {
+            return EASYAV1_STATUS_FINISHED;
         }
-    }
 
-    easyav1_status status = easyav1->status;
+        if (result < 0) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to read packet.");
+            return EASYAV1_STATUS_ERROR;
+        }
 
-    while (status == EASYAV1_STATUS_OK) {
-        easyav1_packet *packet = get_next_packet(easyav1);
+        unsigned int track;
+        uint64_t timestamp;
+        int has_keyframe;
 
-        if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-            status = EASYAV1_STATUS_FINISHED;
-            break;
+        if (nestegg_packet_track(webm_packet, &track) || track != easyav1->video.track) {
+            nestegg_free_packet(webm_packet);
+            continue;
         }
 
-        if (!packet) {
+        has_keyframe = nestegg_packet_has_keyframe(webm_packet);
+
+        if (nestegg_packet_tstamp(webm_packet, &timestamp) || has_keyframe == -1) {
+            nestegg_free_packet(webm_packet);
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to get packet information.");
             return EASYAV1_STATUS_ERROR;
         }
 
-        if (easyav1->playback.do_pause == EASYAV1_TRUE || easyav1->playback.seek.requested == EASYAV1_TRUE) {
-            return status;
+        if (cursor && has_keyframe == NESTEGG_PACKET_HAS_KEYFRAME_TRUE) {
+            index_keyframe(easyav1, context, webm_packet, internal_timestamp_to_ms(easyav1, timestamp), cursor);
         }
 
-        if (packet->timestamp >= timestamp) {
-            break;
-        }
+        memset(packet, 0, sizeof(easyav1_packet));
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+        packet->packet = webm_packet;
+        packet->timestamp = internal_timestamp_to_ms(easyav1, timestamp);
+        packet->is_keyframe = has_keyframe == NESTEGG_PACKET_HAS_KEYFRAME_TRUE ? EASYAV1_TRUE : EASYAV1_FALSE;
+        packet->type = PACKET_TYPE_VIDEO;
 
-        easyav1->position = packet->timestamp;
-        easyav1_packet_type packet_type = packet->type;
+        return EASYAV1_STATUS_OK;
+    }
+}
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+/**
+ * @brief Decodes the video frames for all the requested timestamps, in a single forward pass over the file.
+ *
+ * Runs on the calling thread while the video decoder thread is paused. The picture for the current request is kept
+ * in `video.picture`, so it can be given to the callback through `prepare_video_frame`.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status extract_video_frames(easyav1_t *easyav1, const easyav1_timestamp *timestamps, size_t count,
+    easyav1_bool exact, easyav1_extracted_frame_callback callback, void *userdata)
+{
+    easyav1_packet pending = { 0 };
+    easyav1_bool has_pending = EASYAV1_FALSE;
+    easyav1_bool reached_end = EASYAV1_FALSE;
+    easyav1_timestamp read_position = INVALID_TIMESTAMP;
+    easyav1_keyframe_cursor cursor = { 0 };
+    uint64_t processed_frames = 0;
+    easyav1_status status = EASYAV1_STATUS_OK;
 
-        status = decode_packet(easyav1, packet);
+    for (size_t index = 0; index < count && status == EASYAV1_STATUS_OK; index++) {
+        easyav1_timestamp timestamp = timestamps[index];
+        easyav1_timestamp keyframe_timestamp;
+        int64_t offset;
 
+        easyav1_bool located = locate_keyframe(easyav1, timestamp, &keyframe_timestamp, &offset);
 
-        if (packet_type == PACKET_TYPE_VIDEO) {
-            pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
-        }
-    
-        release_packet_from_queue(easyav1, packet);
+        // With no keyframe known before the timestamp, the first keyframe after it is the closest frame there is, so
+        // read the file from its start, as the keyframe index may not cover it
+        if (located == EASYAV1_FALSE && read_position == INVALID_TIMESTAMP) {
+            if (nestegg_first_cluster_offset(easyav1->webm.context, &offset)) {
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to find the start of the stream.");
+                status = EASYAV1_STATUS_ERROR;
+                break;
+            }
 
-        if (packet_type == PACKET_TYPE_VIDEO) {
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+            keyframe_timestamp = 0;
+            located = EASYAV1_TRUE;
         }
-    }
 
-    if (status == EASYAV1_STATUS_OK) {
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+        // Only go back to the file when the keyframe is ahead of what was read, otherwise keep reading forward
+        if (located == EASYAV1_TRUE && (read_position == INVALID_TIMESTAMP || keyframe_timestamp > read_position)) {
 
-        easyav1->position = timestamp;
+            if (nestegg_offset_seek(easyav1->webm.context, offset)) {
+                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to seek to keyframe at timestamp %llu.", keyframe_timestamp);
+                status = EASYAV1_STATUS_ERROR;
+                break;
+            }
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
-    }
+            if (has_pending == EASYAV1_TRUE) {
+                nestegg_free_packet(pending.packet);
+                has_pending = EASYAV1_FALSE;
+            }
 
-    if (status != EASYAV1_STATUS_ERROR) {
-        callback_video(easyav1);
-        callback_audio(easyav1);
-    }
+            release_displayed_picture(easyav1);
 
-    return status;
-}
+            dav1d_flush(easyav1->video.context);
 
-easyav1_status easyav1_decode_until(easyav1_t *easyav1, easyav1_timestamp timestamp)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
-        return EASYAV1_STATUS_ERROR;
-    }
+            read_position = keyframe_timestamp;
+            reached_end = EASYAV1_FALSE;
+            cursor.has_keyframe = EASYAV1_FALSE;
+        }
 
-    if (easyav1->playback.active == EASYAV1_TRUE) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Cannot manually decode when using playback functions.");
-        return EASYAV1_STATUS_OK;
-    }
+        while (reached_end == EASYAV1_FALSE) {
+            easyav1_packet packet;
 
-    return do_decode_until(easyav1, timestamp);
-}
+            if (has_pending == EASYAV1_TRUE) {
+                packet = pending;
+                has_pending = EASYAV1_FALSE;
+            } else {
+                easyav1_status read_status = read_video_packet(easyav1, easyav1->webm.context, &packet, &cursor);
 
-easyav1_status easyav1_decode_for(easyav1_t *easyav1, easyav1_timestamp time)
-{
-    return easyav1_decode_until(easyav1, easyav1->position + time);
-}
+                if (read_status == EASYAV1_STATUS_FINISHED) {
+                    reached_end = EASYAV1_TRUE;
+                    break;
+                }
 
+                if (read_status == EASYAV1_STATUS_ERROR) {
+                    status = EASYAV1_STATUS_ERROR;
+                    break;
+                }
+            }
 
-/**
- * High-level decoding functions
- */
+            // The packet belongs to a later request, so keep it for then
+            if (packet.timestamp > timestamp && easyav1->video.picture.frame_hdr) {
+                pending = packet;
+                has_pending = EASYAV1_TRUE;
+                break;
+            }
 
- /**
-  * @brief The thread function that handles video playback.
-  * 
-  * @param arg The easyav1 instance.
-  * @return Always returns `NULL`.
-  */
-static void *easyav1_playback_thread(void *arg)
-{
-    easyav1_t *easyav1 = (easyav1_t *) arg;
+            read_position = packet.timestamp;
 
-    easyav1_timestamp last_timestamp = easyav1_get_ticks();
-    easyav1_timestamp current_timestamp = last_timestamp;
+            // Frames other than keyframes can't be decoded without the frames before them, and aren't needed
+            // at all when only keyframes are extracted
+            if (packet.is_keyframe == EASYAV1_FALSE && (exact == EASYAV1_FALSE || !easyav1->video.picture.frame_hdr)) {
+                nestegg_free_packet(packet.packet);
+                continue;
+            }
 
-    pthread_mutex_lock(&easyav1->playback.mutex);
+            Dav1dPicture pic = { 0 };
 
-    while (easyav1->playback.active == EASYAV1_TRUE && easyav1->playback.do_pause == EASYAV1_FALSE &&
-        do_decode_until(easyav1, easyav1->position + (current_timestamp - last_timestamp)) != EASYAV1_STATUS_ERROR) {
+            acquire_decoder_pool_slot(easyav1->video.pool);
 
-        pthread_mutex_unlock(&easyav1->playback.mutex);
+            lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.decoder, &easyav1->counters.contentions.decoder);
 
-        // Prevent busy waiting
-        if (current_timestamp == last_timestamp) {
-            easyav1_sleep(1);
-        }
+            status = decode_video(easyav1, easyav1->video.context, &packet, &pic, &processed_frames);
 
-        // Update timestamp
-        last_timestamp = current_timestamp;
-        current_timestamp = easyav1_get_ticks();
+            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+            release_decoder_pool_slot(easyav1->video.pool);
 
-        easyav1_bool should_seek = easyav1->playback.seek.requested;
-        easyav1_timestamp seek_timestamp = easyav1->playback.seek.timestamp;
+            nestegg_free_packet(packet.packet);
 
-        easyav1->playback.seek.requested = EASYAV1_FALSE;
-        easyav1->playback.seek.timestamp = 0;
+            if (status == EASYAV1_STATUS_ERROR) {
+                break;
+            }
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+            if (pic.frame_hdr) {
+                release_displayed_picture(easyav1);
 
-        if (should_seek == EASYAV1_TRUE) {
-            if (do_seek_to_timestamp(easyav1, seek_timestamp) == EASYAV1_STATUS_ERROR) {
+                easyav1->video.picture = pic;
+            }
+
+            // A keyframe found after the requested timestamp is the closest frame there is
+            if (packet.timestamp >= timestamp) {
                 break;
             }
+        }
 
-            current_timestamp = easyav1_get_ticks();
-            last_timestamp = current_timestamp;
+        if (status == EASYAV1_STATUS_OK && easyav1->video.picture.frame_hdr) {
+            const easyav1_video_frame *frame = prepare_video_frame(easyav1);
+
+            if (frame) {
+                callback(frame, index, userdata);
+            }
         }
+    }
 
-        pthread_mutex_lock(&easyav1->playback.mutex);
+    if (has_pending == EASYAV1_TRUE) {
+        nestegg_free_packet(pending.packet);
     }
 
-    pthread_mutex_unlock(&easyav1->playback.mutex);
+    release_displayed_picture(easyav1);
 
-    return NULL;
+    atomic_add_u64(&easyav1->video.processed_frames, processed_frames);
+
+    return status;
 }
 
-easyav1_status easyav1_play(easyav1_t *easyav1)
+easyav1_status easyav1_extract_video_frames(easyav1_t *easyav1, const easyav1_timestamp *timestamps, size_t count,
+    easyav1_bool exact, easyav1_extracted_frame_callback callback, void *userdata)
 {
     if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
         return EASYAV1_STATUS_ERROR;
     }
 
-    if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
+    if (!timestamps || !callback) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "No timestamps or callback given.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    if (easyav1->status == EASYAV1_STATUS_FINISHED) {
-        return EASYAV1_STATUS_FINISHED;
+    if (easyav1->video.active == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "There is no active video track to extract frames from.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (easyav1->playback.active == EASYAV1_TRUE) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Playback is already active.");
-        return EASYAV1_STATUS_OK;
+    if (easyav1->playback.active == EASYAV1_TRUE || easyav1->seek.mode != NOT_SEEKING) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Can't extract frames while playing or seeking.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (pthread_mutex_init(&easyav1->playback.mutex, NULL)) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize playback mutex.");
+    if (easyav1->stream.seekable == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Can't extract frames from a stream that can't be seeked.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    easyav1->playback.do_pause = EASYAV1_FALSE;
-    easyav1->playback.active = EASYAV1_TRUE;
-
-    easyav1->playback.seek.requested = EASYAV1_FALSE;
-    easyav1->playback.seek.timestamp = 0;
+    for (size_t index = 1; index < count; index++) {
+        if (timestamps[index] < timestamps[index - 1]) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "The timestamps to extract frames from must be sorted.");
+            return EASYAV1_STATUS_ERROR;
+        }
+    }
 
-    if (pthread_create(&easyav1->playback.thread, NULL, easyav1_playback_thread, easyav1)) {
-        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create playback thread.");
-        easyav1->playback.active = EASYAV1_FALSE;
-        return EASYAV1_STATUS_ERROR;
+    if (count == 0) {
+        return EASYAV1_STATUS_OK;
     }
 
-    return EASYAV1_STATUS_OK;
-}
+    easyav1_timestamp position = atomic_load_u64(&easyav1->position);
 
-void easyav1_stop(easyav1_t *easyav1)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
-        return;
-    }
+    pause_video_decoder_thread(easyav1);
 
-    if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-        return;
-    }
+    // The queued packets and frames belong to the playback position and aren't used by the extraction
+    release_packets_from_queue(easyav1, &easyav1->packets.video_queue);
+    release_packets_from_queue(easyav1, &easyav1->packets.audio_queue);
+    reset_video_decode_queue(easyav1);
 
-    if (easyav1->playback.active == EASYAV1_FALSE) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Playback is not active.");
-        return;
-    }
+    lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
 
-    easyav1->playback.do_pause = EASYAV1_TRUE;
+    dequeue_all_video_frames(easyav1);
 
-    pthread_join(easyav1->playback.thread, NULL);
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
 
-    easyav1->playback.active = EASYAV1_FALSE;
-    easyav1->playback.do_pause = EASYAV1_FALSE;
+    release_displayed_picture(easyav1);
 
-    easyav1->playback.seek.requested = EASYAV1_FALSE;
-    easyav1->playback.seek.timestamp = 0;
+    // The extracted frames aren't converted to RGB, and keep their native planes
+    easyav1->video.rgb.displayed.filled = EASYAV1_FALSE;
+    easyav1->video.planes.displayed.filled = EASYAV1_FALSE;
 
-    pthread_mutex_destroy(&easyav1->playback.mutex);
+    easyav1_status status = extract_video_frames(easyav1, timestamps, count, exact, callback, userdata);
+
+    easyav1->seek.position_lost = EASYAV1_TRUE;
+
+    dav1d_flush(easyav1->video.context);
+
+    resume_video_decoder_thread(easyav1);
+
+    if (status == EASYAV1_STATUS_ERROR) {
+        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR, "Failed to extract video frames.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    // Go back to where the caller was before the extraction
+    return do_seek_to_timestamp(easyav1, position);
 }
 
 
 /**
- * Seeking functions
+ * Segment decoding functions
  */
 
-static easyav1_timestamp get_closest_cue_point(const easyav1_t *easyav1, easyav1_timestamp timestamp)
+/**
+ * @brief Splits the file into segments at its cue points.
+ *
+ * The first segment always starts at the start of the file, so the frames before the first cue point aren't lost.
+ *
+ * @param easyav1 The easyav1 context.
+ * @param segments Where to store the segments, with room for one more segment than there are cue points.
+ *
+ * @return The number of segments.
+ */
+static size_t build_segments(easyav1_t *easyav1, easyav1_segment *segments)
 {
-    if (!nestegg_has_cues(easyav1->webm.context)) {
-        return 0;
-    }
+    size_t count = 1;
 
-    unsigned int cluster = 0;
-    int64_t start_pos;
-    int64_t end_pos;
-    easyav1_timestamp cue_timestamp;
-    easyav1_timestamp closest = 0;
+    segments[0] = (easyav1_segment) { .offset = -1, .start = 0, .end = INVALID_TIMESTAMP };
 
-    do {
-        if (nestegg_get_cue_point(easyav1->webm.context, cluster, -1, &start_pos, &end_pos, &cue_timestamp)) {
-            log(EASYAV1_LOG_LEVEL_WARNING, "Failed to get cue point %u.", cluster);
-            return closest;
+    for (unsigned int index = 0; index < easyav1->webm.cues.count; index++) {
+        const easyav1_cue_point *cue = &easyav1->webm.cues.points[index];
+
+        // A cue point at the start of the file or at the start of the previous segment doesn't add a segment
+        if (cue->timestamp <= segments[count - 1].start) {
+            continue;
         }
 
-        cue_timestamp = internal_timestamp_to_ms(easyav1, cue_timestamp);
+        segments[count - 1].end = cue->timestamp;
+        segments[count].offset = cue->offset;
+        segments[count].start = cue->timestamp;
+        segments[count].end = INVALID_TIMESTAMP;
+        count++;
+    }
 
-        if (cue_timestamp >= timestamp) {
-            break;
+    return count;
+}
+
+/**
+ * @brief Gives a decoded picture of a segment to the callback, then releases the picture.
+ *
+ * @param decoder The segment decoder the picture was decoded by.
+ * @param pic The picture to deliver.
+ * @param segment The index of the segment the picture belongs to.
+ */
+static void deliver_segment_picture(easyav1_segment_decoder *decoder, Dav1dPicture *pic, size_t segment)
+{
+    easyav1_t *easyav1 = decoder->job->easyav1;
+    easyav1_video_frame *frame = &decoder->frame;
+
+    if (pic->seq_hdr && set_frame_picture_type(easyav1, frame, pic->seq_hdr) == EASYAV1_TRUE) {
+        set_frame_picture_data(easyav1, frame, pic);
+
+        frame->rgb = NULL;
+        frame->rgb_stride = 0;
+
+        if (easyav1->video.decoder_settings.rgb_format != EASYAV1_RGB_FORMAT_NONE) {
+            convert_picture_to_rgb_buffer(easyav1, pic, &decoder->rgb);
+
+            if (decoder->rgb.filled == EASYAV1_TRUE) {
+                frame->rgb = decoder->rgb.data;
+                frame->rgb_stride = decoder->rgb.stride;
+            }
         }
 
-        closest = cue_timestamp;
+        if (easyav1->video.decoder_settings.plane_format != EASYAV1_PLANE_FORMAT_NATIVE) {
+            convert_picture_to_plane_buffer(easyav1, pic, &decoder->planes);
+            set_frame_plane_data(frame, pic, &decoder->planes);
+        } else {
+            set_frame_plane_data(frame, pic, NULL);
+        }
 
-        cluster++;
-    } while (end_pos != -1);
+        decoder->job->callback(frame, segment, decoder->job->userdata);
+    }
 
-    return closest;
+    dav1d_picture_unref(pic);
 }
 
-static easyav1_status do_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
+/**
+ * @brief Keeps a decoded picture of a segment until it's the turn of the segment to be delivered.
+ *
+ * @param decoder The segment decoder the picture was decoded by.
+ * @param pic The picture to keep. It is released if it can't be kept.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status keep_segment_picture(easyav1_segment_decoder *decoder, Dav1dPicture *pic)
 {
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    easyav1_t *easyav1 = decoder->job->easyav1;
 
-    easyav1_status status = easyav1->status;
-    easyav1_timestamp position = easyav1->position;
-    easyav1_timestamp duration = easyav1_get_duration(easyav1);
+    if (decoder->pending.count == decoder->pending.capacity) {
+        size_t capacity = decoder->pending.capacity ? decoder->pending.capacity * 2 : 16;
+        Dav1dPicture *pictures = realloc(decoder->pending.pictures, capacity * sizeof(Dav1dPicture));
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+        if (!pictures) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the segment frames.");
+            decoder->error = EASYAV1_STATUS_OUT_OF_MEMORY;
+            dav1d_picture_unref(pic);
+            return EASYAV1_STATUS_ERROR;
+        }
 
-    if (EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE) {
-        return EASYAV1_STATUS_ERROR;
+        decoder->pending.pictures = pictures;
+        decoder->pending.capacity = capacity;
     }
 
-    if (timestamp == position) {
-        return EASYAV1_STATUS_OK;
+    decoder->pending.pictures[decoder->pending.count++] = *pic;
+
+    return EASYAV1_STATUS_OK;
+}
+
+static void deliver_pending_segment_pictures(easyav1_segment_decoder *decoder, size_t segment)
+{
+    for (size_t index = 0; index < decoder->pending.count; index++) {
+        deliver_segment_picture(decoder, &decoder->pending.pictures[index], segment);
     }
 
-    if (duration && timestamp >= duration) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Requested timestamp is beyond the end of the stream.");
-        timestamp = duration;
+    decoder->pending.count = 0;
+}
 
-        if (status == EASYAV1_STATUS_FINISHED) {
-            return EASYAV1_STATUS_OK;
-        }
+static void release_pending_segment_pictures(easyav1_segment_decoder *decoder)
+{
+    for (size_t index = 0; index < decoder->pending.count; index++) {
+        dav1d_picture_unref(&decoder->pending.pictures[index]);
     }
 
-    easyav1_timestamp original_timestamp = easyav1->position;
-    easyav1_timestamp corrected_timestamp = get_closest_cue_point(easyav1, timestamp);
+    decoder->pending.count = 0;
+}
 
-    unsigned int track = 0;
+/**
+ * @brief Checks whether it's the turn of a segment to have its frames delivered, when they are ordered.
+ *
+ * @param job The segment decoding job.
+ * @param segment The index of the segment.
+ * @param wait Whether to wait for the turn of the segment.
+ *
+ * @return `EASYAV1_TRUE` if it's the turn of the segment, `EASYAV1_FALSE` if it isn't or if the job failed.
+ */
+static easyav1_bool is_segment_turn(easyav1_segment_job *job, size_t segment, easyav1_bool wait)
+{
+    pthread_mutex_lock(&job->mutex);
 
-    if (easyav1->video.active == EASYAV1_TRUE) {
-        track = easyav1->video.track;
-    } else {
-        track = easyav1->audio.track;
+    while (wait == EASYAV1_TRUE && job->delivering != segment && job->failed == EASYAV1_FALSE) {
+        pthread_cond_wait(&job->turn_changed, &job->mutex);
     }
 
-    /**
-     * Two-pass seek when there's video:
-     *
-     * - The first pass finds the closest keyframe to the requested timestamp without decoding anything
-     * - The second pass skips all video decoding until that keyframe
-     */
-    easyav1_timestamp last_keyframe_timestamp = 0;
+    easyav1_bool turn = job->delivering == segment && job->failed == EASYAV1_FALSE;
 
-    easyav1_bool audio_is_active = easyav1->audio.active;
+    pthread_mutex_unlock(&job->mutex);
 
-    pause_video_decoder_thread(easyav1);
+    return turn;
+}
+
+/**
+ * @brief Decodes all the frames of a segment and delivers them.
+ *
+ * A segment is decoded from its first keyframe until the keyframe the next segment starts with.
+ *
+ * @param decoder The segment decoder to use.
+ * @param segment The index of the segment to decode.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error or if the job failed.
+ */
+static easyav1_status decode_segment(easyav1_segment_decoder *decoder, size_t segment)
+{
+    easyav1_segment_job *job = decoder->job;
+    easyav1_t *easyav1 = job->easyav1;
+    const easyav1_segment *current = &job->segments[segment];
+
+    // The first segment is the first one taken by any thread, so its webm reader is still at the start of the file
+    if (current->offset >= 0 && nestegg_offset_seek(decoder->webm, current->offset)) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to seek to segment %zu at timestamp %llu.", segment, current->start);
+        decoder->error = EASYAV1_STATUS_IO_ERROR;
+        return EASYAV1_STATUS_ERROR;
+    }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    dav1d_flush(decoder->decoder);
 
-    easyav1->seek.mode = STARTING_SEEKING;
-    easyav1->status = EASYAV1_STATUS_OK;
+    easyav1_bool started = EASYAV1_FALSE;
+    easyav1_bool turn = job->ordered == EASYAV1_FALSE ? EASYAV1_TRUE : EASYAV1_FALSE;
+    easyav1_status status = EASYAV1_STATUS_OK;
+
+    while (status == EASYAV1_STATUS_OK) {
+        easyav1_packet packet;
+        easyav1_status read_status = read_video_packet(easyav1, decoder->webm, &packet, NULL);
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+        if (read_status == EASYAV1_STATUS_FINISHED) {
+            break;
+        }
+
+        if (read_status == EASYAV1_STATUS_ERROR) {
+            decoder->error = EASYAV1_STATUS_IO_ERROR;
+            status = EASYAV1_STATUS_ERROR;
+            break;
+        }
 
-    for (int pass = 0; pass < 2; pass++) {
+        // The next segment starts here, which never happens for the last segment as it ends at `INVALID_TIMESTAMP`
+        if (packet.is_keyframe == EASYAV1_TRUE && packet.timestamp >= current->end) {
+            nestegg_free_packet(packet.packet);
+            break;
+        }
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+        // The frames before the first keyframe of the segment belong to the previous one
+        if (started == EASYAV1_FALSE && (packet.is_keyframe == EASYAV1_FALSE || packet.timestamp < current->start)) {
+            nestegg_free_packet(packet.packet);
+            continue;
+        }
 
-        easyav1->position = corrected_timestamp;
+        started = EASYAV1_TRUE;
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+        Dav1dPicture pic = { 0 };
 
-        if (nestegg_track_seek(easyav1->webm.context, track, ms_to_internal_timestmap(easyav1, corrected_timestamp))) {
-            LOG_AND_SET_ERROR(EASYAV1_STATUS_IO_ERROR, "Failed to seek to requested timestamp %u.", easyav1->position);
-            resume_video_decoder_thread(easyav1);
+        status = decode_video(easyav1, decoder->decoder, &packet, &pic, &decoder->processed_frames);
 
-            if (easyav1->playback.active == EASYAV1_TRUE) {
-                pthread_mutex_unlock(&easyav1->playback.mutex);
-            }
+        nestegg_free_packet(packet.packet);
 
-            return EASYAV1_STATUS_ERROR;
+        if (status == EASYAV1_STATUS_ERROR || !pic.frame_hdr) {
+            continue;
         }
 
-        release_packets_from_queue(easyav1, &easyav1->packets.video_queue);
-        release_packets_from_queue(easyav1, &easyav1->packets.audio_queue);
+        if (turn == EASYAV1_FALSE) {
+            turn = is_segment_turn(job, segment, EASYAV1_FALSE);
+        }
 
-        easyav1->packets.synced = EASYAV1_FALSE;
-        easyav1->packets.all_fetched = EASYAV1_FALSE;
+        if (turn == EASYAV1_TRUE) {
+            deliver_pending_segment_pictures(decoder, segment);
+            deliver_segment_picture(decoder, &pic, segment);
+        } else {
+            status = keep_segment_picture(decoder, &pic);
+        }
+    }
 
-        pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    if (status == EASYAV1_STATUS_ERROR) {
+        release_pending_segment_pictures(decoder);
+        return EASYAV1_STATUS_ERROR;
+    }
 
-        easyav1->status = EASYAV1_STATUS_OK;
+    if (job->ordered == EASYAV1_FALSE) {
+        return EASYAV1_STATUS_OK;
+    }
 
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    if (is_segment_turn(job, segment, EASYAV1_TRUE) == EASYAV1_FALSE) {
+        release_pending_segment_pictures(decoder);
+        return EASYAV1_STATUS_ERROR;
+    }
 
-        easyav1->seek.timestamp = timestamp;
+    deliver_pending_segment_pictures(decoder, segment);
 
-        if (easyav1->video.active == EASYAV1_TRUE) {
+    pthread_mutex_lock(&job->mutex);
 
-            pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+    job->delivering++;
 
-            dequeue_all_video_frames(easyav1);
+    pthread_cond_broadcast(&job->turn_changed);
 
-            pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    pthread_mutex_unlock(&job->mutex);
 
-            dav1d_flush(easyav1->video.context);
-            easyav1->seek.mode = SEEKING_FOR_SQHDR;
-        }
+    return EASYAV1_STATUS_OK;
+}
 
-        if (audio_is_active) {
-            if (easyav1->seek.mode == STARTING_SEEKING) {
-                easyav1->seek.mode = SEEKING_FOR_TIMESTAMP;
+/**
+ * @brief The segment decoder thread function.
+ *
+ * Decodes the next segment nobody has taken yet, until all the segments are taken or the job fails.
+ *
+ * @param userdata The segment decoder.
+ */
+static void *segment_decoder_thread(void *userdata)
+{
+    easyav1_segment_decoder *decoder = (easyav1_segment_decoder *) userdata;
+    easyav1_segment_job *job = decoder->job;
 
-                // No need for a second pass for audio only
-                pass = 1;
-            }
+    while (1) {
+        pthread_mutex_lock(&job->mutex);
 
-            // No need to decode audio at all on first pass
-            if (pass == 0) {
-                easyav1->audio.active = EASYAV1_FALSE;
-            } else {
-                easyav1->audio.active = EASYAV1_TRUE;
+        size_t segment = job->next;
+        easyav1_bool stop = job->failed == EASYAV1_TRUE || segment == job->count ? EASYAV1_TRUE : EASYAV1_FALSE;
 
-                vorbis_synthesis_restart(&easyav1->audio.vorbis.dsp);
-                easyav1->audio.has_samples_in_buffer = EASYAV1_FALSE;
-            }
+        if (stop == EASYAV1_FALSE) {
+            job->next++;
         }
 
-        while (1) {
-            easyav1_packet *packet = get_next_packet(easyav1);
+        pthread_mutex_unlock(&job->mutex);
 
-            if (EASYAV1_STATUS_IS_ERROR(easyav1->status) == EASYAV1_TRUE) {
-                resume_video_decoder_thread(easyav1);
+        if (stop == EASYAV1_TRUE) {
+            break;
+        }
 
-                if (easyav1->playback.active == EASYAV1_TRUE) {
-                    pthread_mutex_unlock(&easyav1->playback.mutex);
-                }
+        if (decode_segment(decoder, segment) == EASYAV1_STATUS_ERROR) {
+            pthread_mutex_lock(&job->mutex);
 
-                return EASYAV1_STATUS_ERROR;
+            // A segment that stops because another one failed isn't a failure of its own
+            if (job->failed == EASYAV1_FALSE && decoder->error == EASYAV1_STATUS_OK) {
+                decoder->error = EASYAV1_STATUS_DECODER_ERROR;
             }
 
-            if (packet) {
+            if (decoder->error != EASYAV1_STATUS_OK) {
+                decoder->failed_segment = segment;
+            }
 
-                pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+            job->failed = EASYAV1_TRUE;
 
-                easyav1->position = packet->timestamp;
+            pthread_cond_broadcast(&job->turn_changed);
 
-                pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+            pthread_mutex_unlock(&job->mutex);
 
-                if (pass == 1) {
-                    if (packet->timestamp >= last_keyframe_timestamp) {
+            break;
+        }
+    }
 
-                        // If fast seeking is enabled, we don't decode until we find the correct timestamp, rather we
-                        // resume playing immediately after we get to the last keyframe before the requested timestamp
-                        if (easyav1->settings.use_fast_seeking == EASYAV1_TRUE) {
-                            easyav1->seek.mode = NOT_SEEKING;
-                            resume_video_decoder_thread(easyav1);
-                            break;
-                        } else if (easyav1->seek.mode != SEEKING_FOR_TIMESTAMP) {
-                            easyav1->seek.mode = SEEKING_FOR_TIMESTAMP;
-                            resume_video_decoder_thread(easyav1);
-                        }
-                    } else if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
-                        easyav1->seek.mode = SEEKING_FOUND_KEYFRAME;
-                    }
-                }
-            }
+    return 0;
+}
 
-            if (easyav1->position >= timestamp || easyav1->status == EASYAV1_STATUS_FINISHED) {
+static void close_segment_decoder(easyav1_segment_decoder *decoder)
+{
+    release_pending_segment_pictures(decoder);
 
-                // If we couldn't find a keyframe on the first pass, we need to seek again,
-                // starting on the previous cue point
-                if (pass == 0 && last_keyframe_timestamp < corrected_timestamp) {
+    free(decoder->pending.pictures);
+    free(decoder->rgb.data);
+    free(decoder->planes.data);
 
-                    // No keyframe found from the beginning of the file - this shouldn't happen, but just in case
-                    if (corrected_timestamp == 0) {
-                        LOG_AND_SET_ERROR(EASYAV1_STATUS_DECODER_ERROR,
-                            "Unable to seek, no sequence header or keyframes found. Aborting.");
-                        release_packet_from_queue(easyav1, packet);
-                        resume_video_decoder_thread(easyav1);
+    if (decoder->decoder) {
+        dav1d_close(&decoder->decoder);
+    }
 
-                        if (easyav1->playback.active == EASYAV1_TRUE) {
-                            pthread_mutex_unlock(&easyav1->playback.mutex);
-                        }
+    if (decoder->webm) {
+        nestegg_destroy(decoder->webm);
+    }
 
-                        return EASYAV1_STATUS_ERROR;
-                    }
+    if (decoder->file) {
+        fclose(decoder->file);
+    }
+}
 
-                    corrected_timestamp = get_closest_cue_point(easyav1, corrected_timestamp);
-                    last_keyframe_timestamp = 0;
-                    pass = -1;
-                }
+static easyav1_status open_segment_decoder(easyav1_segment_decoder *decoder, easyav1_segment_job *job)
+{
+    easyav1_t *easyav1 = job->easyav1;
 
-                if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
-                    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
-                }
+    memset(decoder, 0, sizeof(easyav1_segment_decoder));
 
-                easyav1->position = timestamp;
+    decoder->job = job;
 
-                if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
-                    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
-                }
+    if (open_stream_copy(easyav1, &decoder->memory, &decoder->file, &decoder->webm) == EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to open the stream for a segment decoder.");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-                easyav1->seek.mode = STARTING_SEEKING;
-                break;
-            }
+    Dav1dSettings dav1d_settings;
+    dav1d_default_settings(&dav1d_settings);
+    dav1d_settings.logger = (Dav1dLogger) { .cookie = 0, .callback = log_from_dav1d };
 
-            seeking_mode last_seek_mode = easyav1->seek.mode;
+    // The segments are what runs in parallel, so each decoder works on a single frame at a time
+    dav1d_settings.n_threads = 1;
+    dav1d_settings.max_frame_delay = 1;
+    set_decoder_quality(easyav1, easyav1->settings.video_decoder.quality, &dav1d_settings);
 
-            if (decode_packet(easyav1, packet) == EASYAV1_STATUS_ERROR) {
-                if (easyav1->seek.mode != SEEKING_FOR_TIMESTAMP) {
-                    resume_video_decoder_thread(easyav1);
-                }
+    dav1d_settings.allocator = (Dav1dPicAllocator) {
+        .cookie = easyav1,
+        .alloc_picture_callback = allocate_picture,
+        .release_picture_callback = release_picture
+    };
 
-                if (easyav1->playback.active == EASYAV1_TRUE) {
-                    pthread_mutex_unlock(&easyav1->playback.mutex);
-                }
+    if (dav1d_open(&decoder->decoder, &dav1d_settings) < 0) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to initialize the AV1 decoder for a segment decoder.");
+        close_segment_decoder(decoder);
+        return EASYAV1_STATUS_ERROR;
+    }
 
-                log(EASYAV1_LOG_LEVEL_ERROR, "Failed to decode packet when seeking.");
-                return EASYAV1_STATUS_ERROR;
-            }
+    return EASYAV1_STATUS_OK;
+}
 
-            if (pass == 0 && easyav1->seek.mode == SEEKING_FOUND_KEYFRAME) {
-                last_keyframe_timestamp = packet->timestamp;
-                easyav1->seek.mode = SEEKING_FOR_KEYFRAME;
+/**
+ * @brief Decodes all the segments of a job with the given segment decoders, and waits for them to finish.
+ *
+ * @return `EASYAV1_STATUS_OK` on success, `EASYAV1_STATUS_ERROR` on error.
+ */
+static easyav1_status run_segment_decoders(easyav1_segment_job *job, easyav1_segment_decoder *decoders,
+    unsigned int threads)
+{
+    easyav1_t *easyav1 = job->easyav1;
+    unsigned int opened = 0;
+    unsigned int started = 0;
+
+    for (; opened < threads; opened++) {
+        if (open_segment_decoder(&decoders[opened], job) == EASYAV1_STATUS_ERROR) {
+            break;
+        }
+    }
+
+    if (opened == threads) {
+        for (; started < threads; started++) {
+            if (pthread_create(&decoders[started].thread, NULL, segment_decoder_thread, &decoders[started])) {
+                log(EASYAV1_LOG_LEVEL_WARNING, "Failed to create segment decoder thread, using %u threads.", started);
+                break;
             }
+        }
+    }
 
-            // If we found a sequence header, we may need to decode the video frame from this packet.
-            // To do that, we need to keep the packet so it's fetched again and properly decoded.
-            if (pass == 0 || (pass == 1 && (last_seek_mode != SEEKING_FOR_SQHDR ||
-                last_seek_mode == easyav1->seek.mode || packet->timestamp < last_keyframe_timestamp))) {
+    for (unsigned int index = 0; index < started; index++) {
+        pthread_join(decoders[index].thread, NULL);
+    }
 
-                if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
-                    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
-                }
+    // The counters and errors are kept by each thread, and only reported once they all finished
+    uint64_t processed_frames = 0;
 
-                release_packet_from_queue(easyav1, packet);
+    for (unsigned int index = 0; index < started; index++) {
+        processed_frames += decoders[index].processed_frames;
 
-                if (easyav1->seek.mode == SEEKING_FOR_TIMESTAMP) {
-                    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-                }
-            }
+        if (decoders[index].error != EASYAV1_STATUS_OK) {
+            log(EASYAV1_LOG_LEVEL_ERROR, "Segment %zu failed to decode with status %d.", decoders[index].failed_segment,
+                decoders[index].error);
         }
     }
 
-    easyav1->seek.timestamp = 0;
-    easyav1->seek.mode = NOT_SEEKING;
+    log(EASYAV1_LOG_LEVEL_INFO, "Decoded %llu frames of %zu segments.", processed_frames, job->count);
 
-    log(EASYAV1_LOG_LEVEL_INFO, "Seeked to timestamp %llu from timestamp %llu.", easyav1->position,
-        original_timestamp);
+    for (unsigned int index = 0; index < opened; index++) {
+        close_segment_decoder(&decoders[index]);
+    }
 
-    return EASYAV1_STATUS_OK;
+    return started > 0 && job->failed == EASYAV1_FALSE ? EASYAV1_STATUS_OK : EASYAV1_STATUS_ERROR;
 }
 
-static void request_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
+easyav1_status easyav1_decode_segments(easyav1_t *easyav1, unsigned int threads, easyav1_bool ordered,
+    easyav1_segment_frame_callback callback, void *userdata)
 {
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-    easyav1->playback.seek.requested = EASYAV1_TRUE;
-    easyav1->playback.seek.timestamp = timestamp;
+    if (!callback) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "No callback given.");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
-}
+    if (easyav1->video.active == EASYAV1_FALSE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "There is no active video track to decode segments from.");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-easyav1_status easyav1_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+    if (!easyav1->seek.index.scan.data && !easyav1->seek.index.scan.filename) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Segments can only be decoded from files opened by name or from memory.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Trying to seek while already seeking.");
-        return EASYAV1_STATUS_OK;
+    easyav1_segment *segments = malloc(((size_t) easyav1->webm.cues.count + 1) * sizeof(easyav1_segment));
+
+    if (!segments) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the segments.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    if (easyav1->playback.active == EASYAV1_TRUE) {
-        request_seek_to_timestamp(easyav1, timestamp);
-        return EASYAV1_STATUS_OK;
+    easyav1_segment_job job = {
+        .easyav1 = easyav1,
+        .segments = segments,
+        .count = build_segments(easyav1, segments),
+        .next = 0,
+        .delivering = 0,
+        .ordered = ordered,
+        .failed = EASYAV1_FALSE,
+        .callback = callback,
+        .userdata = userdata
+    };
+
+    if (!threads) {
+        threads = get_logical_processor_count();
     }
 
-    return do_seek_to_timestamp(easyav1, timestamp);
-}
+    if (threads > job.count) {
+        threads = (unsigned int) job.count;
+    }
 
-easyav1_status easyav1_seek_forward(easyav1_t *easyav1, easyav1_timestamp time)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+    easyav1_segment_decoder *decoders = calloc(threads, sizeof(easyav1_segment_decoder));
+
+    if (!decoders) {
+        free(segments);
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the segment decoders.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    return easyav1_seek_to_timestamp(easyav1, easyav1->position + time);
-}
+    if (pthread_mutex_init(&job.mutex, NULL)) {
+        free(decoders);
+        free(segments);
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create the segment decoding mutex.");
+        return EASYAV1_STATUS_ERROR;
+    }
 
-easyav1_status easyav1_seek_backward(easyav1_t *easyav1, easyav1_timestamp time)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Handle is NULL");
+    if (pthread_cond_init(&job.turn_changed, NULL)) {
+        pthread_mutex_destroy(&job.mutex);
+        free(decoders);
+        free(segments);
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to create the segment decoding condition.");
         return EASYAV1_STATUS_ERROR;
     }
 
-    if (time > easyav1->position) {
-        time = easyav1->position;
+    log(EASYAV1_LOG_LEVEL_INFO, "Decoding %zu segments with %u threads.", job.count, threads);
+
+    // The segments are decoded apart from the instance, so a failure doesn't change the status of the instance
+    easyav1_status status = run_segment_decoders(&job, decoders, threads);
+
+    pthread_cond_destroy(&job.turn_changed);
+    pthread_mutex_destroy(&job.mutex);
+
+    free(decoders);
+    free(segments);
+
+    if (status == EASYAV1_STATUS_ERROR) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to decode the video segments.");
+        return EASYAV1_STATUS_ERROR;
     }
 
-    return easyav1_seek_to_timestamp(easyav1, easyav1->position - time);
+    return EASYAV1_STATUS_OK;
 }
 
 
@@ -3271,17 +10394,17 @@ easyav1_bool easyav1_has_video_frame(easyav1_t *easyav1)
         return EASYAV1_FALSE;
     }
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
+    if (easyav1->seek.mode != NOT_SEEKING || easyav1->video.active == EASYAV1_FALSE) {
         return EASYAV1_FALSE;
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+    lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
 
     Dav1dPicture *pic = get_oldest_video_frame_from_queue(easyav1);
 
     pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
 
-    return pic == NULL || pic->m.timestamp > easyav1->position ? EASYAV1_FALSE : EASYAV1_TRUE;
+    return pic == NULL || pic->m.timestamp > atomic_load_u64(&easyav1->position) ? EASYAV1_FALSE : EASYAV1_TRUE;
 }
 
 static easyav1_bool update_frame_picture_type(easyav1_t *easyav1, easyav1_video_frame *frame, Dav1dSequenceHeader *sqhdr)
@@ -3292,6 +10415,12 @@ static easyav1_bool update_frame_picture_type(easyav1_t *easyav1, easyav1_video_
 
     easyav1->video.sqhdr = sqhdr;
 
+    return set_frame_picture_type(easyav1, frame, sqhdr);
+}
+
+static easyav1_bool set_frame_picture_type(const easyav1_t *easyav1, easyav1_video_frame *frame,
+    const Dav1dSequenceHeader *sqhdr)
+{
     switch (sqhdr->layout) {
         case DAV1D_PIXEL_LAYOUT_I400:
             frame->properties.pixel_layout = EASYAV1_PIXEL_LAYOUT_YUV400;
@@ -3503,57 +10632,193 @@ static easyav1_bool update_frame_picture_type(easyav1_t *easyav1, easyav1_video_
             return EASYAV1_FALSE;
     }
 
-    return EASYAV1_TRUE;
-}
+    return EASYAV1_TRUE;
+}
+
+const easyav1_video_frame *easyav1_get_video_frame(easyav1_t *easyav1)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return NULL;
+    }
+
+    if (easyav1->seek.mode != NOT_SEEKING || easyav1->video.active == EASYAV1_FALSE) {
+        return NULL;
+    }
+
+    // Remove the old picture being displayed if it exists
+    release_displayed_picture(easyav1);
+
+    easyav1_timestamp timestamp = atomic_load_u64(&easyav1->position);
+
+    lock_mutex(easyav1, &easyav1->video.decoder_thread.mutexes.io, &easyav1->counters.contentions.io);
+
+    Dav1dPicture *pic = get_oldest_video_frame_from_queue(easyav1);
+
+    // No pending new image to display - don't return anything
+    if (!pic || pic->m.timestamp > timestamp) {
+        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+        return NULL;
+    }
+
+    // Copy the image to the output frame
+    memcpy(&easyav1->video.picture, pic, sizeof(Dav1dPicture));
+
+    // Take the conversions along, giving the previously displayed ones back to the slot
+    if (easyav1->video.frame_queue.rgb) {
+        easyav1_rgb_buffer *converted = &easyav1->video.frame_queue.rgb[easyav1->video.frame_queue.begin];
+        easyav1_rgb_buffer displayed = easyav1->video.rgb.displayed;
+
+        easyav1->video.rgb.displayed = *converted;
+        *converted = displayed;
+        converted->filled = EASYAV1_FALSE;
+    }
+
+    if (easyav1->video.frame_queue.planes) {
+        easyav1_plane_buffer *converted = &easyav1->video.frame_queue.planes[easyav1->video.frame_queue.begin];
+        easyav1_plane_buffer displayed = easyav1->video.planes.displayed;
+
+        easyav1->video.planes.displayed = *converted;
+        *converted = displayed;
+        converted->filled = EASYAV1_FALSE;
+    }
+
+    // Remove the reference to the image from the frame queue and free the slot
+    memset(pic, 0, sizeof(Dav1dPicture));
+    dequeue_video_frame(easyav1);
+
+    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+
+    return prepare_video_frame(easyav1);
+}
+
+static const easyav1_video_frame *prepare_video_frame(easyav1_t *easyav1)
+{
+    Dav1dPicture *pic = &easyav1->video.picture;
+    easyav1_video_frame *frame = &easyav1->video.frame;
+
+    if (update_frame_picture_type(easyav1, frame, pic->seq_hdr) == EASYAV1_FALSE) {
+        return NULL;
+    }
+
+    set_frame_picture_data(easyav1, frame, pic);
+
+    if (easyav1->video.rgb.displayed.filled == EASYAV1_TRUE) {
+        frame->rgb = easyav1->video.rgb.displayed.data;
+        frame->rgb_stride = easyav1->video.rgb.displayed.stride;
+    } else {
+        frame->rgb = NULL;
+        frame->rgb_stride = 0;
+    }
+
+    set_frame_plane_data(frame, pic, &easyav1->video.planes.displayed);
+
+    return frame;
+}
+
+const easyav1_video_frame *easyav1_acquire_video_frame(easyav1_t *easyav1)
+{
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return NULL;
+    }
+
+    if (!easyav1->video.picture.frame_hdr) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "There is no video frame being displayed to acquire.");
+        return NULL;
+    }
+
+    easyav1_held_frame *held = easyav1->video.held;
+
+    if (held) {
+        atomic_add_size(&held->references, 1);
+        return &held->frame;
+    }
+
+    held = malloc(sizeof(easyav1_held_frame));
 
-const easyav1_video_frame *easyav1_get_video_frame(easyav1_t *easyav1)
-{
-    if (!easyav1) {
-        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+    if (!held) {
+        log(EASYAV1_LOG_LEVEL_ERROR, "Failed to allocate memory for the held video frame.");
         return NULL;
     }
 
-    if (easyav1->seek.mode != NOT_SEEKING) {
-        return NULL;
+    held->frame = easyav1->video.frame;
+    memset(&held->picture, 0, sizeof(Dav1dPicture));
+    held->rgb = NULL;
+    held->planes = NULL;
+    held->easyav1 = easyav1;
+
+    // One reference for the caller and one for as long as the frame is being displayed
+    held->references = 2;
+
+    // The conversions are taken right away, so the buffers given back to the frame queue slot are new ones
+    if (held->frame.rgb) {
+        held->rgb = easyav1->video.rgb.displayed.data;
+        memset(&easyav1->video.rgb.displayed, 0, sizeof(easyav1_rgb_buffer));
     }
 
-    // Remove the old picture being displayed if it exists
-    if (easyav1->video.picture.frame_hdr) {
-        dav1d_picture_unref(&easyav1->video.picture);
+    if (easyav1->video.planes.displayed.filled == EASYAV1_TRUE) {
+        held->planes = easyav1->video.planes.displayed.data;
+        memset(&easyav1->video.planes.displayed, 0, sizeof(easyav1_plane_buffer));
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
+    easyav1->video.held = held;
+    atomic_add_size(&easyav1->video.held_frames, 1);
+
+    return &held->frame;
+}
 
-    easyav1_timestamp timestamp = easyav1->position;
+void easyav1_release_video_frame(const easyav1_video_frame *frame)
+{
+    easyav1_t *easyav1 = NULL;
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    if (!frame) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Frame is NULL");
+        return;
+    }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.io);
+    release_held_frame((easyav1_held_frame *) frame);
+}
 
-    Dav1dPicture *pic = get_oldest_video_frame_from_queue(easyav1);
+static void release_displayed_picture(easyav1_t *easyav1)
+{
+    easyav1_held_frame *held = easyav1->video.held;
 
-    // No pending new image to display - don't return anything
-    if (!pic || pic->m.timestamp > timestamp) {
-        pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
-        return NULL;
+    if (!held) {
+        if (easyav1->video.picture.frame_hdr) {
+            dav1d_picture_unref(&easyav1->video.picture);
+        }
+        return;
     }
 
-    // Copy the image to the output frame
-    memcpy(&easyav1->video.picture, pic, sizeof(Dav1dPicture));
+    // The picture is handed over before dropping the reference, as the application may release its own at any time
+    held->picture = easyav1->video.picture;
+    memset(&easyav1->video.picture, 0, sizeof(Dav1dPicture));
 
-    // Remove the reference to the image from the frame queue and free the slot
-    memset(pic, 0, sizeof(Dav1dPicture));
-    dequeue_video_frame(easyav1);
+    easyav1->video.held = NULL;
 
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.io);
+    release_held_frame(held);
+}
 
-    pic = &easyav1->video.picture;
-    easyav1_video_frame *frame = &easyav1->video.frame;
+static void release_held_frame(easyav1_held_frame *held)
+{
+    if (atomic_decrement_size(&held->references) > 0) {
+        return;
+    }
 
-    if (update_frame_picture_type(easyav1, frame, pic->seq_hdr) == EASYAV1_FALSE) {
-        return NULL;
+    atomic_decrement_size(&held->easyav1->video.held_frames);
+
+    if (held->picture.frame_hdr) {
+        dav1d_picture_unref(&held->picture);
     }
 
+    free(held->rgb);
+    free(held->planes);
+    free(held);
+}
+
+static void set_frame_picture_data(const easyav1_t *easyav1, easyav1_video_frame *frame, const Dav1dPicture *pic)
+{
     frame->data[0] = pic->data[0];
     frame->data[1] = pic->data[1];
     frame->data[2] = pic->data[2];
@@ -3562,12 +10827,36 @@ const easyav1_video_frame *easyav1_get_video_frame(easyav1_t *easyav1)
     frame->stride[1] = pic->stride[1];
     frame->stride[2] = pic->stride[1];
 
+    // With the built-in allocator, the allocator data is the pool buffer header, which is of no use to the caller
+    frame->buffer_userdata = easyav1->video.picture_allocator.allocate ? pic->allocator_data : NULL;
+
     frame->properties.width = (unsigned int) pic->p.w;
     frame->properties.height = (unsigned int) pic->p.h;
 
     frame->timestamp = (uint64_t) pic->m.timestamp;
+}
 
-    return frame;
+static void set_frame_plane_data(easyav1_video_frame *frame, const Dav1dPicture *pic,
+    const easyav1_plane_buffer *buffer)
+{
+    frame->properties.bits_per_color = pic->p.bpc == 12 ? EASYAV1_BITS_PER_COLOR_12 :
+        pic->p.bpc == 10 ? EASYAV1_BITS_PER_COLOR_10 : EASYAV1_BITS_PER_COLOR_8;
+
+    if (!buffer || buffer->filled == EASYAV1_FALSE) {
+        frame->plane_format = EASYAV1_PLANE_FORMAT_NATIVE;
+        return;
+    }
+
+    frame->plane_format = buffer->format;
+
+    if (frame->plane_format == EASYAV1_PLANE_FORMAT_8BIT) {
+        frame->properties.bits_per_color = EASYAV1_BITS_PER_COLOR_8;
+    }
+
+    for (unsigned int plane = 0; plane < 3; plane++) {
+        frame->data[plane] = buffer->stride[plane] ? buffer->data + buffer->offset[plane] : NULL;
+        frame->stride[plane] = buffer->stride[plane];
+    }
 }
 
 uint64_t easyav1_get_total_video_frames_processed(easyav1_t *easyav1)
@@ -3577,13 +10866,7 @@ uint64_t easyav1_get_total_video_frames_processed(easyav1_t *easyav1)
         return 0;
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.decoder);
-
-    uint64_t result = easyav1->video.processed_frames;
-
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.decoder);
-
-    return result;
+    return atomic_load_u64(&easyav1->video.processed_frames);
 }
 
 easyav1_bool easyav1_is_audio_buffer_filled(const easyav1_t *easyav1)
@@ -3597,7 +10880,7 @@ easyav1_bool easyav1_is_audio_buffer_filled(const easyav1_t *easyav1)
         return EASYAV1_FALSE;
     }
 
-    return easyav1->audio.has_samples_in_buffer && easyav1->audio.frame.samples == AUDIO_BUFFER_SIZE ?
+    return easyav1->audio.has_samples_in_buffer && easyav1->audio.queued == easyav1->audio.capacity ?
         EASYAV1_TRUE : EASYAV1_FALSE;
 }
 
@@ -3616,16 +10899,34 @@ const easyav1_audio_frame *easyav1_get_audio_frame(easyav1_t *easyav1)
 
     easyav1_audio_frame *frame = &easyav1->audio.frame;
 
-    if (frame->samples == 0) {
+    if (easyav1->audio.queued == 0) {
         return NULL;
     }
 
-    frame->bytes = frame->samples * sizeof(float);
+    unsigned int begin = easyav1->audio.begin;
+    unsigned int capacity = easyav1->audio.capacity;
+    size_t sample_size = audio_sample_size(easyav1);
+    uint8_t *buffer = easyav1->audio.buffer;
+
+    frame->samples = easyav1->audio.queued < capacity - begin ? easyav1->audio.queued : capacity - begin;
+    frame->wrapped_samples = easyav1->audio.queued - frame->samples;
 
     if (easyav1->settings.interlace_audio) {
-        frame->bytes *= easyav1->audio.channels;
+        frame->pcm.interlaced = (const float *) (buffer + (size_t) begin * easyav1->audio.channels * sample_size);
+        sample_size *= easyav1->audio.channels;
+    } else {
+        for (unsigned int i = 0; i < easyav1->audio.channels; i++) {
+            frame->pcm.deinterlaced[i] = (const float *) (buffer + ((size_t) i * capacity + begin) * sample_size);
+        }
     }
 
+    frame->bytes = frame->samples * sample_size;
+    frame->wrapped_bytes = frame->wrapped_samples * sample_size;
+
+    // The samples are played from the buffer in place, so only mark them as read
+    easyav1->audio.begin = (begin + easyav1->audio.queued) % capacity;
+    easyav1->audio.queued = 0;
+
     return frame;
 }
 
@@ -3646,11 +10947,7 @@ easyav1_status easyav1_get_status(easyav1_t *easyav1)
         return EASYAV1_STATUS_ERROR;
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
-
-    easyav1_status status = easyav1->status;
-
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    easyav1_status status = atomic_load_status(&easyav1->status);
 
     return EASYAV1_STATUS_IS_ERROR(status) == EASYAV1_TRUE ? EASYAV1_STATUS_ERROR : status;
 }
@@ -3662,11 +10959,7 @@ easyav1_timestamp easyav1_get_current_timestamp(easyav1_t *easyav1)
         return 0;
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
-
-    easyav1_timestamp timestamp = easyav1->position;
-
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    easyav1_timestamp timestamp = atomic_load_u64(&easyav1->position);
 
     return timestamp;
 }
@@ -3748,7 +11041,28 @@ easyav1_timestamp easyav1_get_duration(const easyav1_t *easyav1)
         return 0;
     }
 
-    return easyav1->duration;
+    // A provisional duration is raised by the demuxer while this may be called from another thread
+    return atomic_load_u64((volatile uint64_t *) &easyav1->duration);
+}
+
+easyav1_bool easyav1_is_seekable(const easyav1_t *easyav1)
+{
+    if (!easyav1 || !easyav1->webm.context) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_FALSE;
+    }
+
+    return easyav1->stream.seekable;
+}
+
+easyav1_bool easyav1_is_duration_provisional(const easyav1_t *easyav1)
+{
+    if (!easyav1 || !easyav1->webm.context) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return EASYAV1_FALSE;
+    }
+
+    return easyav1->duration_is_provisional;
 }
 
 unsigned int easyav1_get_total_video_tracks(const easyav1_t *easyav1)
@@ -3768,11 +11082,7 @@ easyav1_bool easyav1_is_finished(easyav1_t *easyav1)
         return EASYAV1_FALSE;
     }
 
-    pthread_mutex_lock(&easyav1->video.decoder_thread.mutexes.info);
-
-    easyav1_status status = easyav1->status;
-
-    pthread_mutex_unlock(&easyav1->video.decoder_thread.mutexes.info);
+    easyav1_status status = atomic_load_status(&easyav1->status);
 
     return status == EASYAV1_STATUS_FINISHED ? EASYAV1_TRUE : EASYAV1_FALSE;
 }
@@ -3789,7 +11099,267 @@ easyav1_settings easyav1_get_current_settings(const easyav1_t *easyav1)
         return DEFAULT_SETTINGS;
     }
 
-    return easyav1->settings;
+    easyav1_settings settings = easyav1->settings;
+
+    // Report the values the video decoder is actually using instead of the requested ones
+    if (easyav1->video.active == EASYAV1_TRUE) {
+        settings.video_decoder.threads = easyav1->video.decoder_settings.threads;
+        settings.video_decoder.max_frame_delay = easyav1->video.decoder_settings.max_frame_delay;
+        settings.video_decoder.prefetch_frames = easyav1->video.decoder_settings.prefetch_frames;
+    }
+
+    return settings;
+}
+
+easyav1_stats easyav1_get_stats(easyav1_t *easyav1)
+{
+    easyav1_stats stats = { 0 };
+
+    if (!easyav1) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Handle is NULL");
+        return stats;
+    }
+
+    pthread_mutex_lock(&easyav1->packets.pool.mutex);
+
+    stats.packet_pool.bytes_in_use = easyav1->packets.pool.bytes_in_use;
+    stats.packet_pool.high_water_bytes = easyav1->packets.pool.high_water_bytes;
+    stats.packet_pool.bytes_reserved = easyav1->packets.pool.bytes_reserved;
+    stats.packet_pool.heap_allocations = easyav1->packets.pool.heap_allocations;
+
+    pthread_mutex_unlock(&easyav1->packets.pool.mutex);
+
+    size_t decoded_packets = atomic_load_size(&easyav1->counters.decoded_packets);
+    size_t seeks = atomic_load_size(&easyav1->counters.seeks);
+
+    stats.packets.packets_read = atomic_load_size(&easyav1->counters.packets_read);
+    stats.packets.bytes_read = atomic_load_size(&easyav1->counters.bytes_read);
+    stats.packets.video_queue_depth = atomic_load_size(&easyav1->counters.video_queue_depth);
+    stats.packets.video_queue_high_water = atomic_load_size(&easyav1->counters.video_queue_high_water);
+    stats.packets.audio_queue_depth = atomic_load_size(&easyav1->counters.audio_queue_depth);
+    stats.packets.audio_queue_high_water = atomic_load_size(&easyav1->counters.audio_queue_high_water);
+
+    stats.video.dropped_frames = atomic_load_size(&easyav1->counters.dropped_frames);
+    stats.video.decoded_packets = decoded_packets;
+    stats.video.average_decode_us = decoded_packets ? atomic_load_size(&easyav1->counters.decode_us) /
+        decoded_packets : 0;
+    stats.video.max_decode_us = atomic_load_size(&easyav1->counters.max_decode_us);
+    stats.video.blocked_waits = atomic_load_size(&easyav1->counters.blocked_waits);
+    stats.video.blocked_us = atomic_load_size(&easyav1->counters.blocked_us);
+
+    stats.seek.seeks = seeks;
+    stats.seek.average_us = seeks ? atomic_load_size(&easyav1->counters.seek_us) / seeks : 0;
+    stats.seek.max_us = atomic_load_size(&easyav1->counters.max_seek_us);
+    stats.seek.keyframe_search_us = atomic_load_size(&easyav1->counters.keyframe_search_us);
+    stats.seek.decode_to_target_us = atomic_load_size(&easyav1->counters.decode_to_target_us);
+    stats.seek.skipped_frames = atomic_load_size(&easyav1->counters.seek_skipped_frames);
+
+    stats.contention.io = atomic_load_size(&easyav1->counters.contentions.io);
+    stats.contention.decoder = atomic_load_size(&easyav1->counters.contentions.decoder);
+
+    stats.io.starvations = easyav1->stream.read_ahead.active == EASYAV1_TRUE ?
+        atomic_load_size(&easyav1->stream.read_ahead.starvations) : 0;
+
+    stats.degradation.level = (easyav1_degradation_level) atomic_load_size(&easyav1->counters.degradation.level);
+    stats.degradation.lag_ms = atomic_load_size(&easyav1->counters.degradation.lag_ms);
+    stats.degradation.max_lag_ms = atomic_load_size(&easyav1->counters.degradation.max_lag_ms);
+    stats.degradation.dropped_frames = atomic_load_size(&easyav1->counters.degradation.dropped_frames);
+    stats.degradation.quality_switches = atomic_load_size(&easyav1->counters.degradation.quality_switches);
+    stats.degradation.skips = atomic_load_size(&easyav1->counters.degradation.skips);
+
+    stats.startup.init_us = atomic_load_size(&easyav1->counters.startup.init_us);
+    stats.startup.demuxer_us = atomic_load_size(&easyav1->counters.startup.demuxer_us);
+    stats.startup.tracks_us = atomic_load_size(&easyav1->counters.startup.tracks_us);
+    stats.startup.audio_headers_us = atomic_load_size(&easyav1->counters.startup.audio_headers_us);
+    stats.startup.video_decoder_us = atomic_load_size(&easyav1->counters.startup.video_decoder_us);
+    stats.startup.threads_us = atomic_load_size(&easyav1->counters.startup.threads_us);
+    stats.startup.cues_us = atomic_load_size(&easyav1->counters.startup.cues_us);
+    stats.startup.first_packet_us = atomic_load_size(&easyav1->counters.startup.first_packet_us);
+    stats.startup.first_decode_us = atomic_load_size(&easyav1->counters.startup.first_decode_us);
+    stats.startup.first_frame_us = atomic_load_size(&easyav1->counters.startup.first_frame_us);
+
+    stats.audio.overruns = atomic_load_size(&easyav1->audio.overrun.overruns);
+    stats.audio.dropped_samples = atomic_load_size(&easyav1->audio.overrun.dropped_samples);
+
+    size_t deadlines = atomic_load_size(&easyav1->playback.timing.deadlines);
+
+    stats.playback.wakeups = atomic_load_size(&easyav1->playback.timing.wakeups);
+    stats.playback.deadlines = deadlines;
+    stats.playback.average_jitter_us = deadlines ? atomic_load_size(&easyav1->playback.timing.total_jitter_us) /
+        deadlines : 0;
+    stats.playback.max_jitter_us = atomic_load_size(&easyav1->playback.timing.max_jitter_us);
+
+    return stats;
+}
+
+static easyav1_bool validate_settings(const easyav1_t *easyav1, const easyav1_settings *settings)
+{
+    if (settings->video_decoder.threads > EASYAV1_MAX_VIDEO_DECODER_THREADS) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested %u video decoder threads, the maximum is %u.",
+            settings->video_decoder.threads, EASYAV1_MAX_VIDEO_DECODER_THREADS);
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.max_frame_delay > EASYAV1_MAX_VIDEO_FRAME_DELAY) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested a video decoder frame delay of %u, the maximum is %u.",
+            settings->video_decoder.max_frame_delay, EASYAV1_MAX_VIDEO_FRAME_DELAY);
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.prefetch_frames > EASYAV1_MAX_VIDEO_PREFETCH_FRAMES) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested %u video frames to prefetch, the maximum is %u.",
+            settings->video_decoder.prefetch_frames, EASYAV1_MAX_VIDEO_PREFETCH_FRAMES);
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.picture_allocator.allocate && !settings->video_decoder.picture_allocator.release) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The picture allocator has no release function.");
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->audio_buffer_samples > EASYAV1_MAX_AUDIO_BUFFER_SAMPLES) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested an audio buffer of %u samples, the maximum is %u.",
+            settings->audio_buffer_samples, EASYAV1_MAX_AUDIO_BUFFER_SAMPLES);
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->audio_format != EASYAV1_AUDIO_FORMAT_FLOAT && settings->audio_format != EASYAV1_AUDIO_FORMAT_S16) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported audio format.");
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.rgb_format > EASYAV1_RGB_FORMAT_BGRA) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported RGB format for the video decoder.");
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.plane_format > EASYAV1_PLANE_FORMAT_8BIT) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported plane format for the video decoder.");
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.quality > EASYAV1_VIDEO_QUALITY_PREVIEW) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Unsupported video quality for the video decoder.");
+        return EASYAV1_FALSE;
+    }
+
+    if (settings->video_decoder.operating_point > EASYAV1_MAX_VIDEO_OPERATING_POINT) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "Requested video operating point %u, the maximum is %u.",
+            settings->video_decoder.operating_point, EASYAV1_MAX_VIDEO_OPERATING_POINT);
+        return EASYAV1_FALSE;
+    }
+
+    unsigned int degradation_thresholds[] = {
+        settings->degradation.drop_frames_ms,
+        settings->degradation.lower_quality_ms,
+        settings->degradation.skip_ms
+    };
+    unsigned int previous_threshold = 0;
+
+    for (size_t i = 0; i < sizeof(degradation_thresholds) / sizeof(degradation_thresholds[0]); i++) {
+        if (!degradation_thresholds[i]) {
+            continue;
+        }
+
+        if (degradation_thresholds[i] <= previous_threshold) {
+            log(EASYAV1_LOG_LEVEL_WARNING, "The degradation thresholds must grow from one step to the next.");
+            return EASYAV1_FALSE;
+        }
+
+        previous_threshold = degradation_thresholds[i];
+    }
+
+    return EASYAV1_TRUE;
+}
+
+/**
+ * @brief Indicates whether the video decoder settings have changed.
+ *
+ * Values that match the ones the decoder is currently using are not considered a change, so that settings obtained
+ * from `easyav1_get_current_settings` can be passed back without restarting the decoder.
+ *
+ * @param easyav1 The easyav1 context to check.
+ * @param old_settings The previous settings.
+ * @param new_settings The new settings.
+ *
+ * @return `EASYAV1_TRUE` if the video decoder must be restarted, `EASYAV1_FALSE` otherwise.
+ */
+static easyav1_bool video_decoder_settings_changed(const easyav1_t *easyav1, const easyav1_settings *old_settings,
+    const easyav1_settings *new_settings)
+{
+    if (new_settings->video_decoder.threads != old_settings->video_decoder.threads &&
+        new_settings->video_decoder.threads != easyav1->video.decoder_settings.threads) {
+        return EASYAV1_TRUE;
+    }
+
+    if (new_settings->video_decoder.max_frame_delay != old_settings->video_decoder.max_frame_delay &&
+        new_settings->video_decoder.max_frame_delay != easyav1->video.decoder_settings.max_frame_delay) {
+        return EASYAV1_TRUE;
+    }
+
+    if (new_settings->video_decoder.prefetch_frames != old_settings->video_decoder.prefetch_frames &&
+        new_settings->video_decoder.prefetch_frames != easyav1->video.decoder_settings.prefetch_frames) {
+        return EASYAV1_TRUE;
+    }
+
+    if (new_settings->video_decoder.prefetch_memory_budget != old_settings->video_decoder.prefetch_memory_budget) {
+        return EASYAV1_TRUE;
+    }
+
+    if (new_settings->video_decoder.rgb_format != old_settings->video_decoder.rgb_format ||
+        new_settings->video_decoder.plane_format != old_settings->video_decoder.plane_format) {
+        return EASYAV1_TRUE;
+    }
+
+    if (new_settings->video_decoder.pool != old_settings->video_decoder.pool) {
+        return EASYAV1_TRUE;
+    }
+
+    // The AV1 decoder only takes these when it's opened
+    if (new_settings->video_decoder.quality != old_settings->video_decoder.quality ||
+        new_settings->video_decoder.operating_point != old_settings->video_decoder.operating_point) {
+        return EASYAV1_TRUE;
+    }
+
+    return EASYAV1_FALSE;
+}
+
+/**
+ * @brief Gets the changes of new settings that restart a decoder, which is done by seeking to the current position.
+ *
+ * @param easyav1 The easyav1 context to check.
+ * @param old_settings The previous settings.
+ * @param new_settings The new settings.
+ *
+ * @return A combination of `settings_change` values, or `SETTINGS_CHANGE_NONE` if no decoder has to be restarted.
+ */
+static unsigned int get_settings_changes(const easyav1_t *easyav1, const easyav1_settings *old_settings,
+    const easyav1_settings *new_settings)
+{
+    unsigned int changes = SETTINGS_CHANGE_NONE;
+
+    if (new_settings->enable_audio != old_settings->enable_audio ||
+        new_settings->audio_track != old_settings->audio_track) {
+        changes |= SETTINGS_CHANGE_AUDIO_TRACK;
+    } else if (new_settings->enable_audio == EASYAV1_TRUE &&
+        (new_settings->interlace_audio != old_settings->interlace_audio ||
+        new_settings->audio_format != old_settings->audio_format ||
+        new_settings->audio_buffer_samples != old_settings->audio_buffer_samples)) {
+        changes |= SETTINGS_CHANGE_AUDIO_BUFFER;
+    } else if (new_settings->enable_audio == EASYAV1_TRUE &&
+        new_settings->audio_offset_time != old_settings->audio_offset_time) {
+        changes |= SETTINGS_CHANGE_AUDIO_OFFSET;
+    }
+
+    if (new_settings->enable_video != old_settings->enable_video ||
+        new_settings->video_track != old_settings->video_track) {
+        changes |= SETTINGS_CHANGE_VIDEO_TRACK;
+    } else if (easyav1->video.active == EASYAV1_TRUE &&
+        video_decoder_settings_changed(easyav1, old_settings, new_settings) == EASYAV1_TRUE) {
+        changes |= SETTINGS_CHANGE_VIDEO_DECODER;
+    }
+
+    return changes;
 }
 
 static easyav1_status change_track(easyav1_t *easyav1, easyav1_packet_type type, unsigned int track_id)
@@ -3863,16 +11433,33 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
         return EASYAV1_STATUS_ERROR;
     }
 
+    if (validate_settings(easyav1, settings) == EASYAV1_FALSE) {
+        return EASYAV1_STATUS_ERROR;
+    }
+
+    unsigned int changes = get_settings_changes(easyav1, &easyav1->settings, settings);
+
+    if (easyav1->stream.seekable == EASYAV1_FALSE && changes != SETTINGS_CHANGE_NONE) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "The stream can't be seeked, so the decoders can't be restarted with the new "
+            "settings.");
+        return EASYAV1_STATUS_ERROR;
+    }
+
     easyav1_settings old_settings = easyav1->settings;
     easyav1->settings = *settings;
 
-    easyav1_bool must_seek = EASYAV1_FALSE;
+    // The read-ahead stage is set up along with the demuxer, so it can't be changed afterwards
+    easyav1->settings.read_ahead_bytes = old_settings.read_ahead_bytes;
 
-    easyav1_status status = EASYAV1_STATUS_OK;
+    // Pictures allocated by the old allocator may still be in use, so it can't be changed either
+    easyav1->settings.video_decoder.picture_allocator = old_settings.video_decoder.picture_allocator;
 
-    if (settings->enable_audio != old_settings.enable_audio || settings->audio_track != old_settings.audio_track) {
+    // The trace hook is read by the decoding threads without a lock
+    easyav1->settings.trace = old_settings.trace;
 
-        must_seek = EASYAV1_TRUE;
+    easyav1_status status = EASYAV1_STATUS_OK;
+
+    if (changes & SETTINGS_CHANGE_AUDIO_TRACK) {
 
         if (old_settings.enable_audio == EASYAV1_TRUE) {
             destroy_audio(easyav1);
@@ -3884,9 +11471,9 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
             status = change_track(easyav1, PACKET_TYPE_AUDIO, settings->audio_track);
         }
 
-    } else if (settings->enable_audio == EASYAV1_TRUE && settings->interlace_audio != old_settings.interlace_audio) {
+    } else if (changes & SETTINGS_CHANGE_AUDIO_BUFFER) {
 
-        if (old_settings.interlace_audio == EASYAV1_TRUE) {
+        if (old_settings.interlace_audio == EASYAV1_FALSE) {
             free(easyav1->audio.frame.pcm.deinterlaced);
             easyav1->audio.frame.pcm.deinterlaced = NULL;
         }
@@ -3895,9 +11482,7 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
         easyav1->audio.buffer = NULL;
         status = prepare_audio_buffer(easyav1);
 
-        must_seek = EASYAV1_TRUE;
-
-    } else if (settings->enable_audio == EASYAV1_TRUE && settings->audio_offset_time != old_settings.audio_offset_time) {
+    } else if (changes & SETTINGS_CHANGE_AUDIO_OFFSET) {
 
         nestegg_audio_params params;
 
@@ -3909,13 +11494,10 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
         easyav1->packets.audio_offset = easyav1->settings.audio_offset_time +
             internal_timestamp_to_ms(easyav1, params.codec_delay);
 
-        must_seek = EASYAV1_TRUE;
-
     }
 
-    if (settings->enable_video != old_settings.enable_video ||
-        settings->video_track != old_settings.video_track) {
-        must_seek = EASYAV1_TRUE;
+    if (changes & SETTINGS_CHANGE_VIDEO_TRACK) {
+        reset_keyframe_index(easyav1);
 
         if (old_settings.enable_video == EASYAV1_TRUE) {
             destroy_video(easyav1);
@@ -3925,22 +11507,37 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
         if (settings->enable_video == EASYAV1_TRUE && settings->video_track != old_settings.video_track) {
             status = change_track(easyav1, PACKET_TYPE_VIDEO, settings->video_track);
         }
+    } else if (changes & SETTINGS_CHANGE_VIDEO_DECODER) {
+        unsigned int track = easyav1->video.track;
+
+        destroy_video(easyav1);
+        easyav1->video.active = EASYAV1_FALSE;
+
+        status = init_video(easyav1, track);
     }
 
     if (status != EASYAV1_STATUS_OK) {
         return status;
     }
 
-    if (must_seek == EASYAV1_TRUE) {
-        log(EASYAV1_LOG_LEVEL_INFO, "Settings changed, seeking to timestamp %llu.", easyav1->position);
+    if (settings->index_keyframes_in_background == EASYAV1_TRUE) {
+        start_keyframe_scan(easyav1);
+    } else {
+        stop_keyframe_scan(easyav1);
+    }
+
+    if (changes != SETTINGS_CHANGE_NONE) {
+        easyav1_timestamp position = atomic_load_u64(&easyav1->position);
+
+        log(EASYAV1_LOG_LEVEL_INFO, "Settings changed, seeking to timestamp %llu.", position);
 
         // Force slow seeking to keep the video at the current position
         easyav1_bool use_fast_seeking = easyav1->settings.use_fast_seeking;
         easyav1->settings.use_fast_seeking = EASYAV1_FALSE;
 
         // Change the timestamp to force seeking
-        easyav1->position++;
-        status = easyav1_seek_to_timestamp(easyav1, easyav1->position - 1);
+        atomic_store_u64(&easyav1->position, position + 1);
+        status = easyav1_seek_to_timestamp(easyav1, position);
 
         easyav1->settings.use_fast_seeking = use_fast_seeking;
     }
@@ -3955,20 +11552,66 @@ easyav1_status easyav1_update_settings(easyav1_t *easyav1, const easyav1_setting
 
 static void destroy_video(easyav1_t *easyav1)
 {
-    pause_video_decoder_thread(easyav1);
+    easyav1_bool thread_running = easyav1->video.decoder_thread.running;
+
+    if (thread_running == EASYAV1_TRUE) {
+        pause_video_decoder_thread(easyav1);
 
-    if (easyav1->video.picture.frame_hdr) {
-        dav1d_picture_unref(&easyav1->video.picture);
+        // Releases the pictures of the packets still in flight
+        reset_video_decode_queue(easyav1);
+    }
+
+    release_displayed_picture(easyav1);
+
+    // Their pictures would be released into the picture pool after it's gone
+    if (atomic_load_size(&easyav1->video.held_frames) > 0) {
+        log(EASYAV1_LOG_LEVEL_WARNING, "%zu held video frames were not released before destroying the instance.",
+            atomic_load_size(&easyav1->video.held_frames));
     }
 
     dequeue_all_video_frames(easyav1);
 
-    stop_video_decoder_thread(easyav1);
+    free(easyav1->video.frame_queue.frames);
+    easyav1->video.frame_queue.frames = NULL;
+
+    if (thread_running == EASYAV1_TRUE) {
+        stop_video_decoder_thread(easyav1);
+    }
+
+    if (easyav1->video.frame_queue.rgb) {
+        for (size_t index = 0; index < easyav1->video.frame_queue.capacity; index++) {
+            free(easyav1->video.frame_queue.rgb[index].data);
+        }
+
+        free(easyav1->video.frame_queue.rgb);
+        easyav1->video.frame_queue.rgb = NULL;
+    }
+
+    if (easyav1->video.frame_queue.planes) {
+        for (size_t index = 0; index < easyav1->video.frame_queue.capacity; index++) {
+            free(easyav1->video.frame_queue.planes[index].data);
+        }
+
+        free(easyav1->video.frame_queue.planes);
+        easyav1->video.frame_queue.planes = NULL;
+    }
+
+    easyav1->video.frame_queue.capacity = 0;
+
+    free(easyav1->video.rgb.spare.data);
+    free(easyav1->video.rgb.displayed.data);
+    memset(&easyav1->video.rgb, 0, sizeof(easyav1->video.rgb));
+
+    free(easyav1->video.planes.spare.data);
+    free(easyav1->video.planes.displayed.data);
+    memset(&easyav1->video.planes, 0, sizeof(easyav1->video.planes));
 
     if (easyav1->video.context) {
         dav1d_close(&easyav1->video.context);
         easyav1->video.context = NULL;
     }
+
+    leave_decoder_pool(easyav1);
 }
 
 static void destroy_audio(easyav1_t *easyav1)
@@ -3978,6 +11621,9 @@ static void destroy_audio(easyav1_t *easyav1)
     vorbis_info_clear(&easyav1->audio.vorbis.info);
     memset(&easyav1->audio.vorbis, 0, sizeof(easyav1->audio.vorbis));
 
+    free(easyav1->audio.headers.data);
+    memset(&easyav1->audio.headers, 0, sizeof(easyav1->audio.headers));
+
     free(easyav1->audio.buffer);
     easyav1->audio.buffer = NULL;
 
@@ -3987,6 +11633,48 @@ static void destroy_audio(easyav1_t *easyav1)
     }
 }
 
+static void close_webm_stream(easyav1_t *easyav1)
+{
+    if (easyav1->webm.context) {
+        nestegg_destroy(easyav1->webm.context);
+        easyav1->webm.context = NULL;
+    }
+
+    stop_read_ahead(easyav1);
+
+    free(easyav1->webm.cues.points);
+    easyav1->webm.cues.points = NULL;
+    easyav1->webm.cues.count = 0;
+
+    free(easyav1->seek.index.scan.filename);
+    easyav1->seek.index.scan.filename = NULL;
+    easyav1->seek.index.scan.data = NULL;
+    easyav1->seek.index.scan.size = 0;
+
+    if (easyav1->stream.data) {
+        switch (easyav1->stream.type) {
+            case STREAM_TYPE_FILE:
+                fclose(easyav1->stream.data);
+                break;
+            case STREAM_TYPE_MEMORY:
+                free(easyav1->stream.data);
+                break;
+            case STREAM_TYPE_MAPPED_FILE: {
+                easyav1_memory *mem = easyav1->stream.data;
+                unmap_file(mem->data, mem->size);
+                free(mem);
+                break;
+            }
+            default:
+                log(EASYAV1_LOG_LEVEL_WARNING, "Unknown stream type");
+                break;
+        }
+    }
+
+    easyav1->stream.data = NULL;
+    easyav1->stream.type = STREAM_TYPE_NONE;
+}
+
 void easyav1_destroy(easyav1_t **handle)
 {
     easyav1_t *easyav1 = NULL;
@@ -4003,36 +11691,27 @@ void easyav1_destroy(easyav1_t **handle)
         return;
     }
 
+    reset_keyframe_index(easyav1);
+
     destroy_video(easyav1);
     destroy_audio(easyav1);
 
     destroy_packet_queue(easyav1, &easyav1->packets.video_queue);
     destroy_packet_queue(easyav1, &easyav1->packets.audio_queue);
 
-    if (easyav1->webm.context) {
-        nestegg_destroy(easyav1->webm.context);
-    }
+    close_webm_stream(easyav1);
+
+    destroy_packet_pool(easyav1);
+    destroy_picture_pool(easyav1);
+
+    pthread_mutex_destroy(&easyav1->seek.index.mutex);
 
     pthread_mutex_destroy(&easyav1->video.decoder_thread.mutexes.io);
     pthread_mutex_destroy(&easyav1->video.decoder_thread.mutexes.decoder);
-    pthread_mutex_destroy(&easyav1->video.decoder_thread.mutexes.info);
     pthread_mutex_destroy(&easyav1->video.decoder_thread.mutexes.status);
     pthread_cond_destroy(&easyav1->video.decoder_thread.conditions.has_packets);
     pthread_cond_destroy(&easyav1->video.decoder_thread.conditions.has_frames_to_display);
-
-    if (easyav1->stream.data) {
-        switch (easyav1->stream.type) {
-            case STREAM_TYPE_FILE:
-                fclose(easyav1->stream.data);
-                break;
-            case STREAM_TYPE_MEMORY:
-                free(easyav1->stream.data);
-                break;
-            default:
-                log(EASYAV1_LOG_LEVEL_WARNING, "Unknown stream type");
-                break;
-        }
-    }
+    pthread_mutex_destroy(&easyav1->video.decoder_thread.decode_queue.mutex);
 
     free(easyav1);
     *handle = NULL;
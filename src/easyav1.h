@@ -76,6 +76,14 @@ extern "C" {
 typedef struct easyav1_t easyav1_t;
 
 
+/**
+ * Decoder pool.
+ *
+ * Shares a video decoder thread budget between several easyav1 instances. This is an opaque pointer.
+ */
+typedef struct easyav1_pool easyav1_pool;
+
+
 /**
  * Timestamp type. This is used for all timestamp related operations.
  */
@@ -164,6 +172,11 @@ typedef int64_t(*easyav1_tell_func)(void *userdata);
  *
  * - `tell_func`: A function that returns the current position in the stream.
  *
+ * `seek_func` and `tell_func` may both be `NULL` for sources that can only be read forward, such as live or progressive
+ * network streams. Decoding then starts as soon as the first cluster is read, the cues aren't loaded, seeking and
+ * frame extraction aren't possible and the duration is provisional. Please refer to `easyav1_is_seekable` and
+ * `easyav1_is_duration_provisional` for more information.
+ *
  * @note The `userdata` field is a pointer to an optional user-defined data that will be passed to the read, seek,
  * and tell functions.
  */
@@ -282,6 +295,44 @@ typedef enum {
 } easyav1_chroma_sample_position;
 
 
+/**
+ * RGB pixel format, for the built-in color conversion.
+ */
+typedef enum {
+    EASYAV1_RGB_FORMAT_NONE = 0, // No conversion.
+    EASYAV1_RGB_FORMAT_RGB = 1,  // 3 bytes per pixel, red first.
+    EASYAV1_RGB_FORMAT_RGBA = 2, // 4 bytes per pixel, red first, with an opaque alpha.
+    EASYAV1_RGB_FORMAT_BGRA = 3  // 4 bytes per pixel, blue first, with an opaque alpha.
+} easyav1_rgb_format;
+
+/**
+ * Layout of the YUV planes of the video frames.
+ */
+typedef enum {
+    EASYAV1_PLANE_FORMAT_NATIVE = 0, // The planes as decoded: 1 byte per sample for 8-bit frames, 2 bytes otherwise.
+    EASYAV1_PLANE_FORMAT_P010 = 1,   // 2 bytes per sample with the value in the high bits, and the chroma samples
+                                     // interleaved in the second plane, U first. P010 for 10-bit 4:2:0 frames.
+    EASYAV1_PLANE_FORMAT_8BIT = 2    // 1 byte per sample, with higher bit depths dithered down to 8 bits.
+} easyav1_plane_format;
+
+/**
+ * Video decoding quality.
+ */
+typedef enum {
+    EASYAV1_VIDEO_QUALITY_FULL = 0,   // Frames are decoded exactly as they were encoded.
+    EASYAV1_VIDEO_QUALITY_PREVIEW = 1 // Film grain, CDEF and loop restoration are skipped, and only the highest
+                                      // spatial layer of the operating point is output.
+} easyav1_video_quality;
+
+/**
+ * How much the decoding is degraded to keep up with playback.
+ */
+typedef enum {
+    EASYAV1_DEGRADATION_NONE = 0,         // All the frames are decoded at the requested quality.
+    EASYAV1_DEGRADATION_DROP_FRAMES = 1,  // The frames no other frame references are dropped without decoding them.
+    EASYAV1_DEGRADATION_LOWER_QUALITY = 2 // The frames are also decoded at `EASYAV1_VIDEO_QUALITY_PREVIEW`.
+} easyav1_degradation_level;
+
 /**
  * Video frame.
  */
@@ -298,24 +349,92 @@ typedef struct {
         unsigned int height;                                       // The height of the frame.
     } properties;
     easyav1_timestamp timestamp;                               // The timestamp of the frame.
-    const void *data[3];                                       // The data for each YUV plane.
+    const void *data[3];                                       // The data for each YUV plane, or NULL.
     size_t stride[3];                                          // The stride for each YUV plane.
+    const void *rgb;                                           // The frame converted to RGB, or NULL.
+    size_t rgb_stride;                                         // The stride of the RGB data.
+    void *buffer_userdata;                                     // The userdata the picture allocator gave the
+                                                               // buffer holding `data`, or NULL.
+    easyav1_plane_format plane_format;                         // The layout of the YUV planes.
 } easyav1_video_frame;
 
+/**
+ * Picture buffer requested by the video decoder from a picture allocator.
+ *
+ * The video decoder fills in the picture format and the layout of the buffer. The allocator must set `data` to
+ * `size` bytes aligned to `alignment`, and may set `userdata` to find the buffer again, such as a mapped GPU buffer.
+ * The YUV planes are written to `data` at the given offsets, with the given strides.
+ */
+typedef struct {
+    easyav1_pixel_layout pixel_layout;     // The pixel layout of the picture.
+    easyav1_bits_per_color bits_per_color; // The bits per color of the picture.
+    unsigned int width;                    // The width of the picture.
+    unsigned int height;                   // The height of the picture.
+    size_t size;                           // The number of bytes to allocate.
+    size_t alignment;                      // The alignment the buffer must have, in bytes.
+    size_t offset[3];                      // Where each YUV plane starts in the buffer.
+    size_t stride[3];                      // The stride of each YUV plane.
+    void *data;                            // The buffer, set by the allocator.
+    void *userdata;                        // The userdata of the buffer, set by the allocator. Optional.
+} easyav1_picture_buffer;
+
+/**
+ * Picture allocator, for the video decoder to decode frames into memory provided by the application.
+ *
+ * - `allocate`: Sets the `data` and optionally the `userdata` of the buffer. Returns `EASYAV1_FALSE` if the buffer
+ *    couldn't be allocated, which stops decoding with an error.
+ *
+ * - `release`: Releases a buffer, given the `data` and `userdata` that `allocate` set.
+ *
+ * - `userdata`: Passed to both functions.
+ *
+ * Both functions may be called from any of the video decoder threads, at the same time. A buffer is released once
+ * the decoder no longer references it, it isn't being displayed, and no frame held with `easyav1_acquire_video_frame`
+ * uses it. When the instance is destroyed, all the buffers are released, except the ones used by frames that are
+ * still held, which are never released: release the held frames before `easyav1_destroy` to get every buffer back.
+ */
+typedef struct {
+    easyav1_bool (*allocate)(easyav1_picture_buffer *buffer, void *userdata);
+    void (*release)(void *data, void *buffer_userdata, void *userdata);
+    void *userdata;
+} easyav1_picture_allocator;
+
+
+/**
+ * Audio sample format.
+ */
+typedef enum {
+    EASYAV1_AUDIO_FORMAT_FLOAT = 0, // 32-bit floating point samples, from -1.0 to 1.0.
+    EASYAV1_AUDIO_FORMAT_S16 = 1    // Signed 16-bit integer samples.
+} easyav1_audio_format;
+
+/**
+ * Audio PCM samples. This is either deinterlaced or interlaced depending on the `interlace_audio` setting.
+ */
+typedef union {
+    const float **deinterlaced;       // Deinterlaced audio samples.
+    const float *interlaced;          // Interlaced audio samples.
+    const int16_t **deinterlaced_s16; // Deinterlaced audio samples, if `format` is `EASYAV1_AUDIO_FORMAT_S16`.
+    const int16_t *interlaced_s16;    // Interlaced audio samples, if `format` is `EASYAV1_AUDIO_FORMAT_S16`.
+} easyav1_audio_pcm;
 
 /**
  * Audio frame.
+ *
+ * The samples are read in place from the audio ring buffer, so they may be split in two spans when they wrap around
+ * the end of the buffer: first `samples` samples in `pcm`, then `wrapped_samples` samples in `wrapped_pcm`.
  */
 typedef struct {
     unsigned int channels; // Number of channels.
-    unsigned int samples;  // Number of samples in this frame.
+    unsigned int samples;  // Number of samples in `pcm`.
     easyav1_timestamp timestamp; // The timestamp of the frame.
-    size_t bytes; // Number of bytes in this frame. This is equal to `samples * sizeof(float) * channels` if
-                  // `interlace_audio` is 1, and `samples * sizeof(float)` if `interlace_audio` is 0.
-    union {
-        const float **deinterlaced; // Deinterlaced audio samples.
-        const float *interlaced;    // Interlaced audio samples.
-    } pcm; // The PCM samples. This is either deinterlaced or interlaced depending on the `interlace_audio` setting.
+    size_t bytes; // Number of bytes in `pcm`. This is equal to `samples * sample size * channels` if
+                  // `interlace_audio` is 1, and `samples * sample size` if `interlace_audio` is 0.
+    easyav1_audio_pcm pcm; // The PCM samples.
+    unsigned int wrapped_samples; // Number of samples in `wrapped_pcm`, which follow the ones in `pcm`. Usually `0`.
+    size_t wrapped_bytes;         // Number of bytes in `wrapped_pcm`, counted like `bytes`.
+    easyav1_audio_pcm wrapped_pcm; // The PCM samples that wrapped around to the start of the buffer.
+    easyav1_audio_format format; // The format of the samples, as set by the `audio_format` setting.
 } easyav1_audio_frame;
 
 /**
@@ -324,6 +443,107 @@ typedef struct {
 typedef void(*easyav1_video_callback)(const easyav1_video_frame *frame, void *userdata);
 typedef void(*easyav1_audio_callback)(const easyav1_audio_frame *frame, void *userdata);
 
+/**
+ * Callback for the video frames extracted by `easyav1_extract_video_frames`.
+ *
+ * `index` is the position, in the list of requested timestamps, of the timestamp the frame was extracted for.
+ * The frame is only valid until the callback returns.
+ */
+typedef void(*easyav1_extracted_frame_callback)(const easyav1_video_frame *frame, size_t index, void *userdata);
+
+/**
+ * Callback for the video frames decoded by `easyav1_decode_segments`.
+ *
+ * `segment` is the index of the segment the frame belongs to, the segments being numbered in file order.
+ * The frame is only valid until the callback returns.
+ */
+typedef void(*easyav1_segment_frame_callback)(const easyav1_video_frame *frame, size_t segment, void *userdata);
+
+/**
+ * The events reported to the `trace` callback of the settings.
+ *
+ * - `EASYAV1_TRACE_PACKET_READ`: Reading a packet from the stream. `value` is `1` when a packet was read, `0` at the
+ *    end of the stream and `-1` on error.
+ *
+ * - `EASYAV1_TRACE_VIDEO_PACKET_PUSH`, `EASYAV1_TRACE_AUDIO_PACKET_PUSH`: A packet was added to its packet queue.
+ *
+ * - `EASYAV1_TRACE_VIDEO_PACKET_POP`, `EASYAV1_TRACE_AUDIO_PACKET_POP`: A packet was released from its packet queue.
+ *
+ *    For all packet queue events, `timestamp` is the one of the packet and `value` the number of packets left in the
+ *    queue.
+ *
+ * - `EASYAV1_TRACE_DECODER_SEND`: Sending the data of a packet to the AV1 decoder. `timestamp` is the one of the
+ *    packet and `value` is the result of the decoder on end.
+ *
+ * - `EASYAV1_TRACE_DECODER_GET`: Getting a picture from the AV1 decoder. On end, `value` is the result of the
+ *    decoder and `timestamp` is the one of the picture, if there was one.
+ *
+ * - `EASYAV1_TRACE_FRAME_ENQUEUE`: A decoded frame was added to the frame queue.
+ *
+ * - `EASYAV1_TRACE_FRAME_DEQUEUE`: A frame was released from the frame queue.
+ *
+ *    For both frame queue events, `timestamp` is the one of the frame and `value` the number of frames left in the
+ *    queue.
+ *
+ * - `EASYAV1_TRACE_SEEK`: A whole seek. `timestamp` is the requested timestamp.
+ *
+ * - `EASYAV1_TRACE_SEEK_KEYFRAME_SEARCH`: The seek pass that looks for the keyframe before the requested timestamp.
+ *
+ * - `EASYAV1_TRACE_SEEK_DECODE_TO_TARGET`: The seek pass that decodes from the keyframe to the requested timestamp.
+ *
+ *    For both seek passes, `timestamp` is the one the pass starts from when it begins.
+ *
+ * - `EASYAV1_TRACE_PLAYBACK_TICK`: The playback thread woke up to decode. `timestamp` is the current position.
+ *
+ * - `EASYAV1_TRACE_MUTEX_WAIT`: Waiting for a lock held by another thread. `value` is `0` for the lock of the decoded
+ *    frame queue and `1` for the lock of the video decoder, as in the `contention` statistics.
+ */
+typedef enum {
+    EASYAV1_TRACE_PACKET_READ,
+    EASYAV1_TRACE_VIDEO_PACKET_PUSH,
+    EASYAV1_TRACE_VIDEO_PACKET_POP,
+    EASYAV1_TRACE_AUDIO_PACKET_PUSH,
+    EASYAV1_TRACE_AUDIO_PACKET_POP,
+    EASYAV1_TRACE_DECODER_SEND,
+    EASYAV1_TRACE_DECODER_GET,
+    EASYAV1_TRACE_FRAME_ENQUEUE,
+    EASYAV1_TRACE_FRAME_DEQUEUE,
+    EASYAV1_TRACE_SEEK,
+    EASYAV1_TRACE_SEEK_KEYFRAME_SEARCH,
+    EASYAV1_TRACE_SEEK_DECODE_TO_TARGET,
+    EASYAV1_TRACE_PLAYBACK_TICK,
+    EASYAV1_TRACE_MUTEX_WAIT
+} easyav1_trace_event;
+
+/**
+ * The phases of a trace event. Events that take time are reported once when they begin and once when they end, on
+ * the same thread. The others are reported once, as instants.
+ */
+typedef enum {
+    EASYAV1_TRACE_PHASE_BEGIN,
+    EASYAV1_TRACE_PHASE_END,
+    EASYAV1_TRACE_PHASE_INSTANT
+} easyav1_trace_phase;
+
+/**
+ * A trace event, as reported to the `trace` callback of the settings.
+ */
+typedef struct {
+    easyav1_trace_event event;   // The event.
+    easyav1_trace_phase phase;   // Whether the event begins, ends or is an instant.
+    const char *name;            // A static name for the event, such as `"packet_read"`, to label it in a trace.
+    uint64_t time_us;            // When the event happened, in microseconds of the monotonic clock.
+    uint64_t thread_id;          // The system identifier of the thread the event happened on.
+    easyav1_timestamp timestamp; // The stream timestamp the event relates to, in ms, or `0`.
+    int64_t value;               // A value that depends on the event, or `0`.
+} easyav1_trace_record;
+
+/**
+ * Callback for the trace events. It's called from every thread that decodes, so it must be thread-safe, and it runs
+ * in the middle of decoding, so it should return quickly.
+ */
+typedef void(*easyav1_trace_callback)(const easyav1_trace_record *record, void *userdata);
+
 
 /**
  * Log levels.
@@ -335,6 +555,35 @@ typedef enum {
 } easyav1_log_level_t;
 
 
+/**
+ * The maximum number of threads that can be requested for the video decoder.
+ */
+#define EASYAV1_MAX_VIDEO_DECODER_THREADS 256
+
+
+/**
+ * The maximum frame delay that can be requested for the video decoder.
+ */
+#define EASYAV1_MAX_VIDEO_FRAME_DELAY 256
+
+
+/**
+ * The maximum number of video frames that can be requested to be decoded ahead of the current position.
+ */
+#define EASYAV1_MAX_VIDEO_PREFETCH_FRAMES 60
+
+
+/**
+ * The highest AV1 operating point that can be requested for the video decoder.
+ */
+#define EASYAV1_MAX_VIDEO_OPERATING_POINT 31
+
+/**
+ * @brief The maximum number of samples per channel that the audio buffer can hold.
+ */
+#define EASYAV1_MAX_AUDIO_BUFFER_SAMPLES (1 << 20)
+
+
 /**
  * @brief Settings for the easyav1 instance.
  *
@@ -372,6 +621,8 @@ typedef enum {
  *      The format of the callback should be: `void callback(const easyav1_video_frame *frame, void *userdata)`.
  *
  *   - `audio`: The audio callback to use. If this is set to `NULL`, no audio callback will be used.
+ *      When the samples wrap around the end of the audio buffer, the callback is called once for each span, so
+ *      `wrapped_samples` is always `0` for the frames it receives.
  *      The format of the callback should be: `void callback(const easyav1_audio_frame *frame, void *userdata)`.
  *
  *   - `userdata`: The userdata to pass to the callbacks.
@@ -386,7 +637,8 @@ typedef enum {
  *
  * - `use_fast_seeking`: Indicates whether fast seeking should be used. If fast seeking is enabled, easyav1 will seek
  *    to the nearest keyframe before the requested timestamp. Otherwise it will seek to the requested timestamp, which
- *    can be slower as all frames between the nearest keyframe and the requested timestamp will need to be decoded.
+ *    can be slower as the frames between the nearest keyframe and the requested timestamp will need to be decoded.
+ *    Frames before the requested timestamp that no other frame depends on are skipped without decoding them.
  *
  * - `audio_offset_time`: The audio offset time in relation to video, in milliseconds.
  *
@@ -408,6 +660,121 @@ typedef enum {
  *
  *     - `EASYAV1_LOG_LEVEL_INFO`: Errors, warnings, and info messages are logged. This is most useful for debugging
  *        purposes.
+ *
+ * - `audio_format`: The format of the audio samples.
+ *
+ *    If this is set to `EASYAV1_AUDIO_FORMAT_FLOAT`, the samples are floats from -1.0 to 1.0. If it is set to
+ *    `EASYAV1_AUDIO_FORMAT_S16`, the samples are converted to signed 16-bit integers while they are copied from the
+ *    decoder, which saves a conversion pass for audio devices that expect them. The samples are then accessed through
+ *    the `pcm.interlaced_s16` or `pcm.deinterlaced_s16` fields.
+ *
+ * - `audio_buffer_samples`: The number of samples per channel the audio ring buffer holds.
+ *
+ *    Decoded samples wait in the buffer until `easyav1_get_audio_frame` is called or the audio callback runs. If the
+ *    buffer overruns, the oldest samples are dropped and counted in the `audio` statistics of `easyav1_get_stats`.
+ *    A larger buffer lets the application fetch audio less often. If set to `0`, the buffer holds 4096 samples.
+ *    Can't be larger than `EASYAV1_MAX_AUDIO_BUFFER_SAMPLES`.
+ *
+ * - `read_ahead_bytes`: The number of bytes of the stream that a separate thread reads ahead of the demuxer.
+ *
+ *    With this set, decoding only waits for the read function of the stream when the data read ahead runs out, which
+ *    is counted in the `io` statistics of `easyav1_get_stats`. This helps with slow disks and network streams. It only
+ *    applies to files and to custom streams whose size can be found by seeking to their end, and can only be set
+ *    when the instance is initialized. If set to `0`, the stream is read on the thread that decodes it.
+ *
+ * - `index_keyframes_in_background`: Indicates whether the keyframe positions of the whole file should be indexed in
+ *    a background thread. easyav1 always indexes the keyframes it reads, which makes seeking into already played parts
+ *    of the file read the data only once. With this setting, seeking anywhere in the file benefits from the index.
+ *    This is only supported for files opened by name and for memory buffers, as it needs to read the file separately.
+ *
+ * - `video_decoder`: Tuning options for the AV1 video decoder.
+ *
+ *   - `threads`: The number of threads the video decoder may use. If set to `0`, the decoder picks the number of
+ *      threads based on the number of logical cores. Can't be larger than `EASYAV1_MAX_VIDEO_DECODER_THREADS`.
+ *
+ *   - `max_frame_delay`: The maximum number of frames the video decoder may have in flight before outputting a
+ *      frame. Setting it to `1` provides the lowest latency, which is useful for scrubbing. If set to `0`, the delay
+ *      is derived from the number of threads. Frames are only decoded in parallel while enough of them are prefetched,
+ *      so `prefetch_frames` should be at least as large. Can't be larger than `EASYAV1_MAX_VIDEO_FRAME_DELAY`.
+ *
+ *   - `prefetch_frames`: The number of video frames decoded ahead of the current position. Deeper buffering rides out
+ *      frames that are slow to decode, at the cost of memory. If set to `0`, 10 frames are prefetched. Can't be larger
+ *      than `EASYAV1_MAX_VIDEO_PREFETCH_FRAMES`.
+ *
+ *   - `prefetch_memory_budget`: The maximum number of bytes the decoded video frames held by easyav1 may use. If the
+ *      prefetched frames wouldn't fit, fewer are prefetched, but never less than one. The size of a frame is estimated
+ *      from the video size and the pixel format, and doesn't account for the frames held internally by the decoder.
+ *      If set to `0`, there's no limit.
+ *
+ *   - `rgb_format`: If set, the video decoder thread also converts each decoded frame to this RGB format, and the
+ *      result is available in the `rgb` field of the video frame. This moves the color conversion out of the thread
+ *      that displays the frames, at the cost of one RGB buffer per prefetched frame. If set to
+ *      `EASYAV1_RGB_FORMAT_NONE`, frames are only provided as YUV.
+ *
+ *   - `plane_format`: The layout the video decoder thread converts the YUV planes of each decoded frame to, which is
+ *      then the one given in `data` and `stride`, and in the `plane_format` field of the video frame. With
+ *      `EASYAV1_PLANE_FORMAT_P010`, every sample takes 2 bytes with its value in the high bits, and the U and V
+ *      samples are interleaved in `data[1]`, leaving `data[2]` as `NULL`. With `EASYAV1_PLANE_FORMAT_8BIT`, 10 and
+ *      12-bit frames are dithered down to 8 bits, and their `bits_per_color` property is `EASYAV1_BITS_PER_COLOR_8`,
+ *      so displays that only take 8-bit frames can use them as they are. 8-bit frames are left as decoded, without
+ *      a copy, so their `plane_format` is `EASYAV1_PLANE_FORMAT_NATIVE`, which for them has the same layout. If set
+ *      to `EASYAV1_PLANE_FORMAT_NATIVE`, the planes are given as decoded. Frames given by
+ *      `easyav1_extract_video_frames` always keep the native planes.
+ *
+ *   - `pool`: The decoder pool the video decoder joins, created with `easyav1_pool_create`. The decoder then uses its
+ *      share of the pool threads, capped by `threads` if that's lower, and waits for the pool to let it decode each
+ *      packet. This keeps many instances decoding at the same time from oversubscribing the CPU. The pool must not be
+ *      destroyed before the instance. If set to `NULL`, the video decoder doesn't share its threads.
+ *
+ *   - `picture_allocator`: The allocator the video decoder gets its picture buffers from. Decoding straight into
+ *      memory the application can upload from, such as persistently mapped GPU buffers, saves copying each frame.
+ *      The `buffer_userdata` field of each video frame tells which buffer holds it. Can only be set when the instance
+ *      is initialized. If `allocate` is set, `release` must be set too. If `allocate` is `NULL`, the buffers come from
+ *      a pool that reuses them from frame to frame.
+ *
+ *   - `quality`: How faithfully the frames are decoded. With `EASYAV1_VIDEO_QUALITY_PREVIEW`, the most costly
+ *      filters are skipped, which is faster but gives softer frames with some artifacts. Good enough for scrubbing
+ *      previews and thumbnails. Switching it with `easyav1_update_settings` restarts the video decoder and decodes
+ *      again from the keyframe before the current position, so an application can switch to preview quality while
+ *      the seek bar is dragged and back to full quality when it's released.
+ *
+ *   - `operating_point`: The AV1 operating point to decode, for streams with scalability layers. In a scalable
+ *      stream, the operating points after the first one usually leave out the higher-resolution layers, so they are
+ *      cheaper to decode. If the stream has fewer operating points, the first one is used. Can't be larger than
+ *      `EASYAV1_MAX_VIDEO_OPERATING_POINT`.
+ *
+ *   When calling `easyav1_get_current_settings`, these fields hold the values that the video decoder actually applied.
+ *
+ * - `degradation`: How decoding degrades when the video decoder can't keep up, which is only done when
+ *    `skip_unprocessed_frames` is set. The steps follow the playback lag, not the time it takes to decode each frame:
+ *    the lag is how late the oldest packet still to be decoded is when decoding until a timestamp, which is what
+ *    playback does. It never counts more than the real time since the previous call, so jumping ahead with
+ *    `easyav1_decode_until` isn't taken as lag. Each step starts once the lag goes over its threshold, and setting a
+ *    threshold to `0` disables the step. The thresholds that are set must grow from one step to the next. The current
+ *    step can be read with `easyav1_get_stats`.
+ *
+ *   - `drop_frames_ms`: The lag over which the frames that no other frame references are dropped without decoding
+ *      them, which lowers the frame rate.
+ *
+ *   - `lower_quality_ms`: The lag over which the video decoder switches to `EASYAV1_VIDEO_QUALITY_PREVIEW`. The switch
+ *      happens at the next keyframe, so no frame is decoded again.
+ *
+ *   - `skip_ms`: How far behind the requested timestamp the oldest packet still to be decoded must be for decoding to
+ *      skip ahead to the keyframe before the requested timestamp, if that keyframe is past the current position. This
+ *      one does count jumps ahead. The frames in between are never displayed.
+ *
+ *   - `recover_ms`: How long the lag must stay under the threshold of the current step before going back one step.
+ *
+ * - `trace`: A hook that reports structured events from the hot paths of decoding, such as reading and queuing
+ *    packets, sending them to the AV1 decoder, seek passes and lock waits, with the thread and the time they happened
+ *    on. The events can be forwarded to a profiler such as Perfetto or Tracy to line them up with the rest of an
+ *    application's timeline. Please refer to `easyav1_trace_event` for the list of events. Can only be set when the
+ *    instance is initialized. When easyav1 is built with `EASYAV1_DISABLE_TRACING`, the hook is never called.
+ *
+ *   - `callback`: The function called for each event. If this is `NULL`, no events are reported, which costs a
+ *      single check at each event.
+ *
+ *   - `userdata`: The userdata to pass to the callback.
  */
 typedef struct {
     easyav1_bool enable_video;
@@ -425,8 +792,246 @@ typedef struct {
     easyav1_bool use_fast_seeking;
     int64_t audio_offset_time;
     easyav1_log_level_t log_level;
+    easyav1_audio_format audio_format;
+    unsigned int audio_buffer_samples;
+    size_t read_ahead_bytes;
+    easyav1_bool index_keyframes_in_background;
+    struct {
+        unsigned int threads;
+        unsigned int max_frame_delay;
+        unsigned int prefetch_frames;
+        size_t prefetch_memory_budget;
+        easyav1_rgb_format rgb_format;
+        easyav1_plane_format plane_format;
+        easyav1_pool *pool;
+        easyav1_picture_allocator picture_allocator;
+        easyav1_video_quality quality;
+        unsigned int operating_point;
+    } video_decoder;
+    struct {
+        unsigned int drop_frames_ms;
+        unsigned int lower_quality_ms;
+        unsigned int skip_ms;
+        unsigned int recover_ms;
+    } degradation;
+    struct {
+        easyav1_trace_callback callback;
+        void *userdata;
+    } trace;
 } easyav1_settings;
 
+
+/**
+ * @brief Settings for a decoder pool.
+ *
+ * - `threads`: The total number of threads the video decoders in the pool may use. If set to `0`, the number of
+ *    logical cores is used. Can't be larger than `EASYAV1_MAX_VIDEO_DECODER_THREADS`.
+ *
+ * - `max_decoders`: The maximum number of instances that may decode a video packet at the same time. Each video
+ *    decoder gets `threads / max_decoders` threads, so fewer decoders make each stream decode faster while more
+ *    decoders let more streams make progress at once. Instances past this limit wait in turn. If set to `0`, or if
+ *    larger than `threads`, it's the same as `threads`, so each video decoder uses a single thread.
+ */
+typedef struct {
+    unsigned int threads;
+    unsigned int max_decoders;
+} easyav1_pool_settings;
+
+/**
+ * @brief Runtime statistics of the easyav1 instance.
+ *
+ * - `packet_pool`: Statistics of the memory pool that holds the compressed packets read from the file.
+ *
+ *   - `bytes_in_use`: The number of bytes currently used by packets.
+ *
+ *   - `high_water_bytes`: The largest number of bytes that were used by packets at the same time.
+ *
+ *   - `bytes_reserved`: The number of bytes held by the pool, including the memory kept to be reused.
+ *
+ *   - `heap_allocations`: The number of times the pool had to allocate memory from the heap. Once the pool holds
+ *      enough memory for the stream, this stops growing.
+ *
+ * - `packets`: Statistics of the packets read from the stream.
+ *
+ *   - `packets_read`: The number of packets read from the stream, including the ones read again after seeking.
+ *
+ *   - `bytes_read`: The number of bytes of packet data read from the stream.
+ *
+ *   - `video_queue_depth`, `audio_queue_depth`: The number of packets read ahead and waiting to be decoded.
+ *
+ *   - `video_queue_high_water`, `audio_queue_high_water`: The largest number of packets that were waiting at once.
+ *
+ * - `video`: Statistics of the video decoding.
+ *
+ *   - `dropped_frames`: The number of decoded frames that were discarded without being displayed, because newer frames
+ *      were decoded before they were fetched. This only happens with `skip_unprocessed_frames`.
+ *
+ *   - `decoded_packets`: The number of video packets decoded by the video decoder thread.
+ *
+ *   - `average_decode_us`, `max_decode_us`: How long the video decoder took for each of those packets, on average and
+ *      at most, in microseconds.
+ *
+ *   - `blocked_waits`: The number of times decoding had to wait for the video decoder thread to decode a frame.
+ *
+ *   - `blocked_us`: The total time spent waiting for the video decoder thread, in microseconds. When this grows
+ *      while playing, the video decoder can't keep up with the stream.
+ *
+ * - `seek`: Statistics of the seeks, including the ones made when `easyav1_decode_until` skips ahead.
+ *
+ *   - `seeks`: The number of seeks that completed.
+ *
+ *   - `average_us`, `max_us`: How long the seeks took, on average and at most, in microseconds.
+ *
+ *   - `keyframe_search_us`: The total time spent looking for the keyframe before the requested timestamp, in
+ *      microseconds. This pass is skipped when the keyframe is already indexed.
+ *
+ *   - `decode_to_target_us`: The total time spent decoding from the keyframe to the requested timestamp, in
+ *      microseconds.
+ *
+ *   - `skipped_frames`: The number of frames before the requested timestamps that weren't decoded at all, because
+ *      they are never displayed and no other frame depends on them.
+ *
+ * - `contention`: The number of times a thread had to wait for another to release one of the locks shared with the
+ *    video decoder thread.
+ *
+ *   - `io`: The lock of the decoded frame queue.
+ *
+ *   - `decoder`: The lock of the video decoder.
+ *
+ * - `audio`: Statistics of the audio ring buffer.
+ *
+ *   - `overruns`: The number of times decoded audio didn't fit in the buffer because it wasn't read in time.
+ *
+ *   - `dropped_samples`: The number of samples per channel that were dropped because of the overruns.
+ *
+ * - `playback`: Timing statistics of the playback thread started by `easyav1_play`.
+ *
+ *   - `wakeups`: The number of times the playback thread woke up from waiting.
+ *
+ *   - `deadlines`: The number of times the playback thread slept until the next packet was due.
+ *
+ *   - `average_jitter_us`: How late the playback thread woke up for a packet on average, in microseconds. This
+ *      delays the frames and audio that the packets carry by the same amount.
+ *
+ *   - `max_jitter_us`: The latest the playback thread woke up for a packet, in microseconds.
+ *
+ * - `io`: Statistics of the read-ahead stage enabled by the `read_ahead_bytes` setting.
+ *
+ *   - `starvations`: The number of times the demuxer had to wait for data because the read-ahead window ran dry.
+ *      If this keeps growing while playing, the window is too small for the stream.
+ *
+ * - `degradation`: The decisions taken to keep up with playback, as set with the `degradation` settings.
+ *
+ *   - `level`: The current degradation step.
+ *
+ *   - `lag_ms`: The last lag measured, in milliseconds.
+ *
+ *   - `max_lag_ms`: The largest lag measured, in milliseconds.
+ *
+ *   - `dropped_frames`: The number of frames dropped without decoding them.
+ *
+ *   - `quality_switches`: The number of times the video decoder switched between the requested quality and
+ *      `EASYAV1_VIDEO_QUALITY_PREVIEW`.
+ *
+ *   - `skips`: The number of times decoding skipped ahead to a keyframe.
+ *
+ * - `startup`: How long each phase of the initialization took, in microseconds. Phases that didn't run, such as the
+ *    audio ones for a file without an audio track, are `0`. Reopening the instance doesn't change them.
+ *
+ *   - `init_us`: The total time spent in the initialization function, including all the phases below except
+ *      `first_decode_us` and `first_frame_us`.
+ *
+ *   - `demuxer_us`: The time spent reading the webm headers, up to the first cluster.
+ *
+ *   - `tracks_us`: The time spent setting up the tracks, which includes `audio_headers_us`, `video_decoder_us` and
+ *      the creation of the video decoder thread.
+ *
+ *   - `audio_headers_us`: The time spent parsing the Vorbis headers.
+ *
+ *   - `video_decoder_us`: The time spent opening the AV1 decoder.
+ *
+ *   - `threads_us`: The time spent creating the read-ahead and video decoder threads.
+ *
+ *   - `cues_us`: The time spent reading the cues.
+ *
+ *   - `first_packet_us`: The time spent reading the first packet, which includes reading the start of the first
+ *      cluster.
+ *
+ *   - `first_decode_us`: The time spent in the first call to `easyav1_decode_next`.
+ *
+ *   - `first_frame_us`: The time from the start of the initialization until the AV1 decoder output its first
+ *      picture, or `0` if it didn't yet.
+ */
+typedef struct {
+    struct {
+        size_t bytes_in_use;
+        size_t high_water_bytes;
+        size_t bytes_reserved;
+        uint64_t heap_allocations;
+    } packet_pool;
+    struct {
+        uint64_t packets_read;
+        uint64_t bytes_read;
+        size_t video_queue_depth;
+        size_t video_queue_high_water;
+        size_t audio_queue_depth;
+        size_t audio_queue_high_water;
+    } packets;
+    struct {
+        uint64_t dropped_frames;
+        uint64_t decoded_packets;
+        uint64_t average_decode_us;
+        uint64_t max_decode_us;
+        uint64_t blocked_waits;
+        uint64_t blocked_us;
+    } video;
+    struct {
+        uint64_t seeks;
+        uint64_t average_us;
+        uint64_t max_us;
+        uint64_t keyframe_search_us;
+        uint64_t decode_to_target_us;
+        uint64_t skipped_frames;
+    } seek;
+    struct {
+        uint64_t io;
+        uint64_t decoder;
+    } contention;
+    struct {
+        uint64_t overruns;
+        uint64_t dropped_samples;
+    } audio;
+    struct {
+        uint64_t wakeups;
+        uint64_t deadlines;
+        uint64_t average_jitter_us;
+        uint64_t max_jitter_us;
+    } playback;
+    struct {
+        uint64_t starvations;
+    } io;
+    struct {
+        easyav1_degradation_level level;
+        uint64_t lag_ms;
+        uint64_t max_lag_ms;
+        uint64_t dropped_frames;
+        uint64_t quality_switches;
+        uint64_t skips;
+    } degradation;
+    struct {
+        uint64_t init_us;
+        uint64_t demuxer_us;
+        uint64_t tracks_us;
+        uint64_t audio_headers_us;
+        uint64_t video_decoder_us;
+        uint64_t threads_us;
+        uint64_t cues_us;
+        uint64_t first_packet_us;
+        uint64_t first_decode_us;
+        uint64_t first_frame_us;
+    } startup;
+} easyav1_stats;
+
 /**
  * @brief Returns the default settings for easyav1.
  *
@@ -436,19 +1041,72 @@ typedef struct {
  * - Audio enabled (`.enable_audio = EASYAV1_TRUE`)
  * - Skip unprocessed frames (`.skip_unprocessed_frames = EASYAV1_TRUE`)
  * - Interlace audio (`.interlace_audio = EASYAV1_TRUE`)
+ * - Float audio samples (`.audio_format = EASYAV1_AUDIO_FORMAT_FLOAT`)
+ * - Audio buffer of 4096 samples (`.audio_buffer_samples = 0`)
+ * - No read-ahead (`.read_ahead_bytes = 0`)
  * - Don't close the handle on destroy (`.close_handle_on_destroy = EASYAV1_FALSE`)
  * - No callbacks (`callbacks.video = NULL, callbacks.audio = NULL, callbacks.userdata = NULL`)
  * - Video track 0 (`.video_track = 0`)
  * - Audio track 0 (`.audio_track = 0`)
  * - Don't use fast seeking (`.use_fast_seeking = EASYAV1_FALSE`)
+ * - Don't index keyframes in the background (`.index_keyframes_in_background = EASYAV1_FALSE`)
  * - No audio offset time (`.audio_offset_time = 0`)
  * - Log level warning (`.log_level = EASYAV1_LOG_LEVEL_WARNING`)
+ * - Automatic video decoder threads (`.video_decoder.threads = 0`)
+ * - Automatic video decoder frame delay (`.video_decoder.max_frame_delay = 0`)
+ * - Prefetch 10 video frames (`.video_decoder.prefetch_frames = 0`)
+ * - No memory budget for prefetched video frames (`.video_decoder.prefetch_memory_budget = 0`)
+ * - No RGB conversion on the video decoder thread (`.video_decoder.rgb_format = EASYAV1_RGB_FORMAT_NONE`)
+ * - Native YUV planes (`.video_decoder.plane_format = EASYAV1_PLANE_FORMAT_NATIVE`)
+ * - No decoder pool (`.video_decoder.pool = NULL`)
+ * - Built-in picture allocator (`.video_decoder.picture_allocator = { 0 }`)
+ * - Full video quality (`.video_decoder.quality = EASYAV1_VIDEO_QUALITY_FULL`)
+ * - First operating point (`.video_decoder.operating_point = 0`)
+ * - Drop frames at a lag of 100 ms (`.degradation.drop_frames_ms = 100`)
+ * - Lower the video quality at a lag of 300 ms (`.degradation.lower_quality_ms = 300`)
+ * - Skip ahead at a lag of 1 second (`.degradation.skip_ms = 1000`)
+ * - Go back one step after 2 seconds without lag (`.degradation.recover_ms = 2000`)
+ * - No trace callback (`.trace.callback = NULL, .trace.userdata = NULL`)
  *
  * @return The default settings.
  */
 easyav1_settings easyav1_default_settings(void);
 
 
+/**
+ * @brief Returns the default settings for a decoder pool.
+ *
+ * The default settings are:
+ *
+ * - As many threads as logical cores (`.threads = 0`)
+ * - As many simultaneous decoders as threads (`.max_decoders = 0`)
+ *
+ * @return The default decoder pool settings.
+ */
+easyav1_pool_settings easyav1_default_pool_settings(void);
+
+
+/**
+ * @brief Creates a decoder pool that easyav1 instances can join through the `video_decoder.pool` setting.
+ *
+ * @param settings The settings to use for the pool. If this is `NULL`, the default pool settings will be used.
+ *
+ * @return The decoder pool, or `NULL` if an error occurred.
+ */
+easyav1_pool *easyav1_pool_create(const easyav1_pool_settings *settings);
+
+
+/**
+ * @brief Destroys a decoder pool.
+ *
+ * @note All the instances that joined the pool must be destroyed first. If some of them still use the pool, an error
+ * is logged and the pool is left as it is.
+ *
+ * @param pool The decoder pool to destroy. Set to `NULL` once the pool is destroyed.
+ */
+void easyav1_pool_destroy(easyav1_pool **pool);
+
+
 /**
  * @brief Initializes an easyav1 instance from a file.
  *
@@ -474,6 +1132,9 @@ easyav1_t *easyav1_init_from_file(FILE *f, const easyav1_settings *settings);
 /**
  * @brief Initializes an easyav1 instance from a memory buffer.
  *
+ * The compressed video and audio data is used directly from the buffer, so it must remain valid until the instance is
+ * destroyed.
+ *
  * @param data The buffer to read from.
  * @param size The size of the buffer.
  * @param settings The settings to use for the easyav1 instance. If this is `NULL`, the default settings will be used.
@@ -483,6 +1144,20 @@ easyav1_t *easyav1_init_from_file(FILE *f, const easyav1_settings *settings);
 easyav1_t *easyav1_init_from_memory(const void *data, size_t size, const easyav1_settings *settings);
 
 
+/**
+ * @brief Initializes an easyav1 instance from a memory-mapped file.
+ *
+ * The file is mapped to memory for the lifetime of the instance, and the compressed video and audio data is handed to
+ * the decoders directly from the mapping, without being copied. This is the most efficient way to decode local files.
+ *
+ * @param filename The filename of the file to map.
+ * @param settings The settings to use for the easyav1 instance. If this is `NULL`, the default settings will be used.
+ *
+ * @return The `easyav1` instance, or `NULL` if an error occurred or memory mapping is not supported on the platform.
+ */
+easyav1_t *easyav1_init_from_mapped_file(const char *filename, const easyav1_settings *settings);
+
+
 /**
  * @brief Initializes an easyav1 instance from a custom stream.
  *
@@ -494,6 +1169,96 @@ easyav1_t *easyav1_init_from_memory(const void *data, size_t size, const easyav1
 easyav1_t *easyav1_init_from_custom_stream(const easyav1_stream *stream, const easyav1_settings *settings);
 
 
+/**
+ * @brief Reopens an easyav1 instance on another file, reusing its decoders, threads and buffers.
+ *
+ * This is much faster than destroying the instance and initializing a new one, which makes it useful for opening
+ * short clips over and over. The video decoder and its thread are kept as they are, and the audio decoder is only
+ * set up again if the vorbis headers of the new file are different. The instance keeps its settings and statistics,
+ * and starts from the beginning of the new file, as if it was just initialized.
+ *
+ * If an index saved by `easyav1_save_index` is provided, the cues and keyframes are loaded from it instead of being
+ * read from the file. An index saved for another file is ignored.
+ *
+ * @note Playback must be stopped first. Frames acquired through `easyav1_acquire_video_frame` remain valid.
+ *       If reopening fails, the instance is left with an error and can only be destroyed.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param filename The filename of the file to open.
+ * @param index The index saved for the file, or `NULL` to read it from the file.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the instance was reopened, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_reopen_from_filename(easyav1_t *easyav1, const char *filename, const void *index,
+    size_t index_size);
+
+
+/**
+ * @brief Reopens an easyav1 instance on a `FILE` handle, reusing its decoders, threads and buffers.
+ *
+ * Please refer to `easyav1_reopen_from_filename` for more information.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param f The open `FILE` handle.
+ * @param index The index saved for the file, or `NULL` to read it from the file.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the instance was reopened, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_reopen_from_file(easyav1_t *easyav1, FILE *f, const void *index, size_t index_size);
+
+
+/**
+ * @brief Reopens an easyav1 instance on a memory buffer, reusing its decoders, threads and buffers.
+ *
+ * The buffer must remain valid until the instance is reopened again or destroyed. Please refer to
+ * `easyav1_reopen_from_filename` for more information.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param data The buffer to read from.
+ * @param size The size of the buffer.
+ * @param index The index saved for the buffer, or `NULL` to read it from the buffer.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the instance was reopened, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_reopen_from_memory(easyav1_t *easyav1, const void *data, size_t size, const void *index,
+    size_t index_size);
+
+
+/**
+ * @brief Reopens an easyav1 instance on a memory-mapped file, reusing its decoders, threads and buffers.
+ *
+ * Please refer to `easyav1_reopen_from_filename` for more information.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param filename The filename of the file to map.
+ * @param index The index saved for the file, or `NULL` to read it from the file.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the instance was reopened, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_reopen_from_mapped_file(easyav1_t *easyav1, const char *filename, const void *index,
+    size_t index_size);
+
+
+/**
+ * @brief Reopens an easyav1 instance on a custom stream, reusing its decoders, threads and buffers.
+ *
+ * Please refer to `easyav1_reopen_from_filename` for more information.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param stream The custom stream to read from. Please refer to the `easyav1_stream` struct for more information.
+ * @param index The index saved for the stream, or `NULL` to read it from the stream.
+ * @param index_size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the instance was reopened, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_reopen_from_custom_stream(easyav1_t *easyav1, const easyav1_stream *stream, const void *index,
+    size_t index_size);
+
+
 /**
  * @brief Decodes the next packet.
  *
@@ -528,6 +1293,32 @@ easyav1_status easyav1_decode_until(easyav1_t *easyav1, easyav1_timestamp timest
 easyav1_status easyav1_decode_for(easyav1_t *easyav1, easyav1_timestamp time);
 
 
+/**
+ * @brief Decodes audio straight into a buffer provided by the caller, for files without video.
+ *
+ * This is a fast path for audio extraction and analysis. It can only be used when there is no active video track,
+ * either because the file has none or because `enable_video` is `EASYAV1_FALSE`, so no video decoder thread runs.
+ * The packets are decoded on the calling thread until the buffer is full, without going through the audio buffer and
+ * without calling the audio callback. The samples decoded beyond the buffer are kept for the next call.
+ * Samples decoded by the other decoding functions that weren't retrieved with `easyav1_get_audio_frame` are given
+ * first.
+ *
+ * The samples use the `audio_format` and `interlace_audio` settings. When deinterlaced, the buffer holds each channel
+ * one after the other, each one `samples` long.
+ *
+ * Can't be used at the same time as the playback functions.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param output Where to store the samples. Must hold `samples` samples for each channel.
+ * @param samples The maximum number of samples per channel to decode.
+ * @param decoded Set to the number of samples per channel stored in `output`.
+ *
+ * @return `EASYAV1_STATUS_OK` if samples were decoded, `EASYAV1_STATUS_FINISHED` if the end of the stream was reached
+ *          and there are no samples left or `EASYAV1_STATUS_ERROR` if there was an error.
+ */
+easyav1_status easyav1_decode_audio_samples(easyav1_t *easyav1, void *output, size_t samples, size_t *decoded);
+
+
 /**
  * @brief Starts playing the video and audio.
  *
@@ -589,6 +1380,8 @@ easyav1_status easyav1_seek_backward(easyav1_t *easyav1, easyav1_timestamp time)
 /**
  * @brief Seeks to a specified timestamp.
  *
+ * Seeking is not possible on streams that can't be seeked, in which case this function fails.
+ *
  * @param easyav1 The easyav1 instance.
  * @param timestamp The timestamp to seek to.
  *
@@ -597,6 +1390,135 @@ easyav1_status easyav1_seek_backward(easyav1_t *easyav1, easyav1_timestamp time)
 easyav1_status easyav1_seek_to_timestamp(easyav1_t *easyav1, easyav1_timestamp timestamp);
 
 
+/**
+ * @brief Gets the timestamp of the closest keyframe at or before the specified timestamp.
+ *
+ * The keyframe positions come from the cue index of the file, which is built when the instance is initialized.
+ * This is useful to snap a seek bar to positions that can be seeked to quickly.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param timestamp The timestamp to find the keyframe for.
+ *
+ * @return The timestamp of the keyframe, or `0` if there are no cues or no keyframe before the timestamp.
+ */
+easyav1_timestamp easyav1_get_keyframe_before(const easyav1_t *easyav1, easyav1_timestamp timestamp);
+
+
+/**
+ * @brief Saves the cue index and the keyframe index of the file, to be loaded again when it's opened later.
+ *
+ * The saved index holds the cue points of the file and the keyframes indexed so far, either while decoding or by the
+ * background keyframe scan. Loading it skips reading the cues from the file, and if the whole file was indexed, the
+ * background keyframe scan as well. The saved index doesn't depend on the platform, so it can be stored anywhere.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param buffer The buffer to save the index to, or `NULL` to only get the size of the index.
+ * @param size The size of the buffer.
+ *
+ * @return The size of the index. If it's larger than `size`, nothing was saved.
+ */
+size_t easyav1_save_index(easyav1_t *easyav1, void *buffer, size_t size);
+
+
+/**
+ * @brief Loads an index saved by `easyav1_save_index`, replacing the cue index and the keyframe index of the file.
+ *
+ * The index is only loaded if it was saved for a file with the same duration, time scale and tracks. To also skip
+ * reading the cues from the file, pass the index to one of the `easyav1_reopen_*` functions instead.
+ *
+ * @note Playback must be stopped first.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param data The saved index.
+ * @param size The size of the saved index.
+ *
+ * @return `EASYAV1_STATUS_OK` if the index was loaded, `EASYAV1_STATUS_ERROR` otherwise.
+ */
+easyav1_status easyav1_load_index(easyav1_t *easyav1, const void *data, size_t size);
+
+
+/**
+ * @brief Extracts the video frames for a list of timestamps, such as thumbnails, in a single pass over the file.
+ *
+ * For each timestamp, the callback receives the closest keyframe at or before it. If `exact` is `EASYAV1_TRUE`,
+ * it receives the frame displayed at that timestamp instead, which requires decoding all frames from the keyframe.
+ *
+ * The keyframe positions come from the cue points and from the keyframe index, so the file is only read forward,
+ * skipping to the next keyframe when it's ahead. Audio isn't decoded at all during the extraction.
+ *
+ * When there's no keyframe before a timestamp, the first keyframe after it is used. When there's no frame for a
+ * timestamp at all, such as past the end of the file, the callback isn't called for it.
+ *
+ * After the frames are extracted, the instance seeks back to the position it was at. Frames can't be extracted
+ * while playing with `easyav1_play`, nor from streams that can't be seeked.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param timestamps The timestamps to extract the frames for, sorted from earliest to latest.
+ * @param count The number of timestamps.
+ * @param exact Whether to extract the exact frame for each timestamp instead of the closest keyframe before it.
+ * @param callback The function to call with each extracted frame.
+ * @param userdata Custom optional user-defined data passed to the callback.
+ *
+ * @return `EASYAV1_STATUS_OK` if successful, `EASYAV1_STATUS_ERROR` if there was an error.
+ */
+easyav1_status easyav1_extract_video_frames(easyav1_t *easyav1, const easyav1_timestamp *timestamps, size_t count,
+    easyav1_bool exact, easyav1_extracted_frame_callback callback, void *userdata);
+
+
+/**
+ * @brief Decodes all the video frames of the file, splitting it into segments that are decoded in parallel.
+ *
+ * This is meant for offline work such as transcoding or analysis, where the frames are needed as fast as possible
+ * rather than in real time. The file is split at its cue points, which start with a keyframe, and each segment is
+ * decoded by its own webm reader and AV1 decoder. Audio isn't decoded at all.
+ *
+ * If `ordered` is `EASYAV1_FALSE`, the callback is called from the decoding threads as soon as each frame is decoded,
+ * so it can be called concurrently and must be thread-safe. The frames of a segment are still given in order.
+ * If `ordered` is `EASYAV1_TRUE`, the callback is called for a single frame at a time, with all the frames in
+ * timestamp order. The frames of the segments after the one being delivered are kept until their turn, so at most
+ * one segment per thread is held in memory.
+ *
+ * Only files opened by name, mapped files and memory buffers can be decoded in segments, as they can be read again
+ * independently from the instance. Without cue points, the whole file is a single segment. The playback position of
+ * the instance isn't changed, and the frames aren't converted to RGB unless an RGB format is set. Neither a failure
+ * nor the decoded frames affect the status and the statistics of the instance.
+ *
+ * The function returns once all the segments are decoded.
+ *
+ * @param easyav1 The easyav1 instance.
+ * @param threads The number of segments to decode at the same time, or 0 to use one per logical processor.
+ * @param ordered Whether to deliver the frames one at a time in timestamp order.
+ * @param callback The function to call with each decoded frame.
+ * @param userdata Custom optional user-defined data passed to the callback.
+ *
+ * @return `EASYAV1_STATUS_OK` if successful, `EASYAV1_STATUS_ERROR` if there was an error.
+ */
+easyav1_status easyav1_decode_segments(easyav1_t *easyav1, unsigned int threads, easyav1_bool ordered,
+    easyav1_segment_frame_callback callback, void *userdata);
+
+
+/**
+ * @brief Converts a video frame to RGB into a buffer provided by the caller.
+ *
+ * The conversion follows the matrix coefficients and the color space of the frame. When the matrix coefficients are
+ * unspecified, BT.601 is used for videos up to 576 lines tall and BT.709 for the rest. Chroma is upsampled by using
+ * each chroma sample for all the pixels it covers. 8, 10 and 12-bit frames are supported, with any pixel layout.
+ * Identity, YCgCo and ICtCp matrices aren't supported, and neither are frames with `EASYAV1_PLANE_FORMAT_P010` planes.
+ *
+ * SSE2, AVX2 or NEON are used when the library is built for a target that has them.
+ *
+ * @param frame The video frame to convert.
+ * @param format The RGB format to convert to.
+ * @param output Where to store the converted pixels. Must hold `stride * frame->properties.height` bytes.
+ * @param stride The number of bytes per row in `output`. Must be at least the frame width times 3 for
+ *        `EASYAV1_RGB_FORMAT_RGB`, or times 4 for the other formats.
+ *
+ * @return `EASYAV1_STATUS_OK` if successful, `EASYAV1_STATUS_ERROR` if there was an error.
+ */
+easyav1_status easyav1_convert_video_frame(const easyav1_video_frame *frame, easyav1_rgb_format format, void *output,
+    size_t stride);
+
+
 /**
  * @brief Indicates the current status of the easyav1 instance.
  *
@@ -728,7 +1650,8 @@ easyav1_bool easyav1_has_video_frame(easyav1_t *easyav1);
 /**
  * @brief Gets the current video frame, is one is available.
  *
- * The returned frame is only valid until the next call to `easyav1_get_video_frame`.
+ * The returned frame is only valid until the next call to `easyav1_get_video_frame`, unless it's held with
+ * `easyav1_acquire_video_frame`.
  * Calling this function will mark the frame as displayed, so you will only receive a decoded frame once.
  *
  * @param easyav1 The easyav1 instance.
@@ -738,6 +1661,34 @@ easyav1_bool easyav1_has_video_frame(easyav1_t *easyav1);
 const easyav1_video_frame *easyav1_get_video_frame(easyav1_t *easyav1);
 
 
+/**
+ * @brief Holds the video frame being displayed, so that it stays valid until it's released.
+ *
+ * This allows keeping several frames at once, for instance while they are still in use by the GPU, without copying
+ * them. The held frame shares the picture and RGB data of the frame last returned by `easyav1_get_video_frame`, or
+ * of the frame given to an `easyav1_extracted_frame_callback`.
+ *
+ * Each call takes a new reference to the frame, which must be released with `easyav1_release_video_frame`.
+ * All the held frames must be released before the easyav1 instance is destroyed.
+ *
+ * @param easyav1 The easyav1 instance.
+ *
+ * @return A pointer to the held video frame, or `NULL` if there is no frame being displayed or on error.
+ */
+const easyav1_video_frame *easyav1_acquire_video_frame(easyav1_t *easyav1);
+
+
+/**
+ * @brief Releases a video frame held with `easyav1_acquire_video_frame`.
+ *
+ * This function can be called from any thread, but only while the instance the frame was held from exists: the held
+ * frame refers to its instance, so releasing it after `easyav1_destroy` is a use after free.
+ *
+ * @param frame The held video frame. It must not be used after this call.
+ */
+void easyav1_release_video_frame(const easyav1_video_frame *frame);
+
+
 /**
  * @brief Gets the total number of video frames processed up to this point.
  *
@@ -764,6 +1715,9 @@ easyav1_bool easyav1_is_audio_buffer_filled(const easyav1_t *easyav1);
  * The frame is only valid until the next call to `easyav1_decode_next` or `easyav1_decode_until`.
  * Calling this function will mark all the samples in the frame as played, so you will only receive the samples once.
  *
+ * The samples aren't copied out of the audio buffer. When they wrap around its end, the ones at the start of the
+ * buffer are given in the `wrapped_pcm` field of the frame, so both spans must be played in order.
+ *
  * @param easyav1 The easyav1 instance.
  *
  * @return A pointer to the audio frame, or `NULL` if there are no samples to process.
@@ -774,6 +1728,9 @@ const easyav1_audio_frame *easyav1_get_audio_frame(easyav1_t *easyav1);
 /**
  * @brief Gets the duration of the file.
  *
+ * When the duration is provisional, as for streams that can't be seeked or files whose header has no duration, this
+ * is the timestamp of the latest packet read so far. It grows while decoding and is final once decoding finishes.
+ *
  * @param easyav1 The easyav1 instance.
  *
  * @return The duration of the file, or `0` if there was an error.
@@ -781,6 +1738,29 @@ const easyav1_audio_frame *easyav1_get_audio_frame(easyav1_t *easyav1);
 easyav1_timestamp easyav1_get_duration(const easyav1_t *easyav1);
 
 
+/**
+ * @brief Checks whether the stream of the easyav1 instance can be seeked.
+ *
+ * Custom streams without a seek function can only be read forward. Their cues aren't loaded, and seeking, frame
+ * extraction and settings changes that restart the decoders fail.
+ *
+ * @param easyav1 The easyav1 instance.
+ *
+ * @return `EASYAV1_TRUE` if the stream can be seeked, `EASYAV1_FALSE` otherwise.
+ */
+easyav1_bool easyav1_is_seekable(const easyav1_t *easyav1);
+
+
+/**
+ * @brief Checks whether the duration returned by `easyav1_get_duration` is provisional.
+ *
+ * @param easyav1 The easyav1 instance.
+ *
+ * @return `EASYAV1_TRUE` if the duration may still grow while decoding, `EASYAV1_FALSE` otherwise.
+ */
+easyav1_bool easyav1_is_duration_provisional(const easyav1_t *easyav1);
+
+
 /**
  * @brief Gets the current settings of the easyav1 instance.
  *
@@ -791,11 +1771,29 @@ easyav1_timestamp easyav1_get_duration(const easyav1_t *easyav1);
 easyav1_settings easyav1_get_current_settings(const easyav1_t *easyav1);
 
 
+/**
+ * @brief Gets the runtime statistics of the easyav1 instance.
+ *
+ * This doesn't wait for any of the locks used while decoding, so it can be called at any time from any thread. Each
+ * value is read on its own, so values that are related may be slightly out of step with each other.
+ *
+ * @param easyav1 The easyav1 instance.
+ *
+ * @return The statistics of the easyav1 instance. If the instance is `NULL`, all statistics are `0`.
+ */
+easyav1_stats easyav1_get_stats(easyav1_t *easyav1);
+
+
 /**
  * @brief Updates the settings of the easyav1 instance.
  *
  * @note This will only update the settings that are different from the current settings.
  *
+ * @note Changing the `video_decoder` settings restarts the video decoder at the current position.
+ *
+ * @note On streams that can't be seeked, changes that restart the decoders, such as enabling or disabling a track,
+ * fail and keep the current settings.
+ *
  * @param easyav1 The easyav1 instance.
  * @param settings The new settings to use.
  *
@@ -817,6 +1815,10 @@ easyav1_bool easyav1_is_finished(easyav1_t *easyav1);
 /**
  * @brief Destroys an easyav1 instance.
  *
+ * All the video frames held with `easyav1_acquire_video_frame` must be released before. The frames that are still
+ * held aren't released, and can no longer be released or used once the instance is destroyed. A warning is logged
+ * when there are any.
+ *
  * @param easyav1 The easyav1 instance to destroy.
  */
 void easyav1_destroy(easyav1_t **easyav1);
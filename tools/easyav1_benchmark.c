@@ -3,8 +3,13 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define DEFAULT_SEEKS 20
+#define DEFAULT_SEED 1
+#define AUDIO_BLOCK_SAMPLES 4096
+
 #ifdef _WIN32
 #include <windows.h>
 typedef struct {
@@ -26,17 +31,17 @@ int64_t benchmark_clock_get_elapsed_time(benchmark_clock *clock)
     QueryPerformanceCounter(&current_time);
 
     int64_t elapsed = current_time.QuadPart - clock->start.QuadPart;
-    elapsed *= 1000;
-    elapsed /= clock->frequency.QuadPart;
 
-    return elapsed;
+    // Split the conversion so that long runs don't overflow
+    return elapsed / clock->frequency.QuadPart * 1000000 +
+        elapsed % clock->frequency.QuadPart * 1000000 / clock->frequency.QuadPart;
 }
 
 void benchmark_clock_reset_timer(benchmark_clock *clock)
 {
     QueryPerformanceCounter(&clock->start);
 }
-#else 
+#else
 #include <sys/time.h>
 #include <time.h>
 
@@ -59,7 +64,7 @@ int64_t benchmark_clock_get_elapsed_time(benchmark_clock *clock)
     int64_t elapsed = (current_time.tv_sec - clock->start.tv_sec) * 1000000000 +
                       current_time.tv_nsec - clock->start.tv_nsec;
 
-    return elapsed / 1000000;
+    return elapsed / 1000;
 }
 
 void benchmark_clock_reset_timer(benchmark_clock *clock)
@@ -68,123 +73,833 @@ void benchmark_clock_reset_timer(benchmark_clock *clock)
 }
 #endif
 
+typedef enum {
+    SCENARIO_DECODE,
+    SCENARIO_DECODE_AUDIO,
+    SCENARIO_SEEK,
+    SCENARIO_FAST_SEEK,
+    SCENARIO_PLAYBACK,
+    SCENARIO_AUDIO_ONLY,
+    SCENARIO_AUDIO_DIRECT,
+    SCENARIO_SEGMENTS,
+    SCENARIO_COUNT
+} benchmark_scenario;
+
+static const char *SCENARIO_NAMES[SCENARIO_COUNT] = {
+    "decode",
+    "decode-audio",
+    "seek",
+    "fast-seek",
+    "playback",
+    "audio-only",
+    "audio-direct",
+    "segments"
+};
+
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_JSON,
+    OUTPUT_CSV
+} output_format;
 
-int main(int argc, const char **argv)
+typedef struct {
+    const char *filename;
+    easyav1_bool scenarios[SCENARIO_COUNT];
+    unsigned int runs;
+    unsigned int warmup_runs;
+    unsigned int seeks;
+    uint64_t seed;
+    output_format format;
+    easyav1_bool startup;
+} benchmark_options;
+
+// Latencies, in microseconds, of each frame, seek or playback step of a run
+typedef struct {
+    int64_t *values;
+    size_t count;
+    size_t capacity;
+} sample_list;
+
+typedef struct {
+    benchmark_scenario scenario;
+    unsigned int run;
+    int64_t init_time;
+    int64_t total_time;
+    uint64_t frames;
+    size_t samples;
+    uint64_t audio_samples;
+    int64_t p50;
+    int64_t p95;
+    int64_t p99;
+    int64_t max;
+    size_t late;
+} run_result;
+
+static int add_sample(sample_list *list, int64_t value)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        int64_t *values = realloc(list->values, capacity * sizeof(int64_t));
+
+        if (!values) {
+            return 0;
+        }
+
+        list->values = values;
+        list->capacity = capacity;
+    }
+
+    list->values[list->count++] = value;
+
+    return 1;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    int64_t first = *(const int64_t *) a;
+    int64_t second = *(const int64_t *) b;
+
+    return first < second ? -1 : first > second;
+}
+
+// Nearest-rank percentile of sorted samples
+static int64_t get_percentile(const sample_list *list, unsigned int percentile)
+{
+    if (list->count == 0) {
+        return 0;
+    }
+
+    size_t rank = (list->count * percentile + 99) / 100;
+
+    return list->values[rank ? rank - 1 : 0];
+}
+
+// A small deterministic generator, so that seek runs hit the same timestamps on every machine
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [options] <filename>\n\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --scenario <name>  Run only this scenario, can be repeated. One of decode, decode-audio, seek,\n");
+    fprintf(stderr, "                     fast-seek, playback, audio-only, audio-direct, segments or all (default).\n");
+    fprintf(stderr, "  --runs <n>         Measured runs of each scenario (default 1).\n");
+    fprintf(stderr, "  --warmup <n>       Unmeasured runs of each scenario before the measured ones (default 0).\n");
+    fprintf(stderr, "  --seeks <n>        Seeks per run of the seek scenarios (default %u).\n", DEFAULT_SEEKS);
+    fprintf(stderr, "  --seed <n>         Seed for the seek timestamps (default %u).\n", DEFAULT_SEED);
+    fprintf(stderr, "  --format <format>  Output format: text (default), json or csv.\n");
+    fprintf(stderr, "  --startup          Profile the phases of the initialization and the first decode instead of\n");
+    fprintf(stderr, "                     running the scenarios.\n");
+}
+
+static int parse_number(const char *text, uint64_t *value)
+{
+    char *end = NULL;
+    unsigned long long number = strtoull(text, &end, 10);
+
+    if (!*text || *end || text[0] == '-') {
+        return 0;
+    }
+
+    *value = (uint64_t) number;
+
+    return 1;
+}
+
+static int parse_options(int argc, const char **argv, benchmark_options *options)
+{
+    memset(options, 0, sizeof(benchmark_options));
+
+    options->runs = 1;
+    options->seeks = DEFAULT_SEEKS;
+    options->seed = DEFAULT_SEED;
+    options->format = OUTPUT_TEXT;
+
+    easyav1_bool any_scenario = EASYAV1_FALSE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+
+        if (arg[0] != '-' || arg[1] != '-') {
+            if (options->filename) {
+                return 0;
+            }
+            options->filename = arg;
+            continue;
+        }
+
+        if (strcmp(arg, "--startup") == 0) {
+            options->startup = EASYAV1_TRUE;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return 0;
+        }
+
+        const char *value = argv[++i];
+        uint64_t number = 0;
+
+        if (strcmp(arg, "--scenario") == 0) {
+            any_scenario = EASYAV1_TRUE;
+
+            if (strcmp(value, "all") == 0) {
+                for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+                    options->scenarios[scenario] = EASYAV1_TRUE;
+                }
+                continue;
+            }
+
+            int found = 0;
+
+            for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+                if (strcmp(value, SCENARIO_NAMES[scenario]) == 0) {
+                    options->scenarios[scenario] = EASYAV1_TRUE;
+                    found = 1;
+                }
+            }
+
+            if (!found) {
+                fprintf(stderr, "Unknown scenario: %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "text") == 0) {
+                options->format = OUTPUT_TEXT;
+            } else if (strcmp(value, "json") == 0) {
+                options->format = OUTPUT_JSON;
+            } else if (strcmp(value, "csv") == 0) {
+                options->format = OUTPUT_CSV;
+            } else {
+                fprintf(stderr, "Unknown format: %s\n", value);
+                return 0;
+            }
+        } else if (parse_number(value, &number) && number <= 0xffffffffu) {
+            if (strcmp(arg, "--runs") == 0 && number > 0) {
+                options->runs = (unsigned int) number;
+            } else if (strcmp(arg, "--warmup") == 0) {
+                options->warmup_runs = (unsigned int) number;
+            } else if (strcmp(arg, "--seeks") == 0 && number > 0) {
+                options->seeks = (unsigned int) number;
+            } else if (strcmp(arg, "--seed") == 0) {
+                options->seed = number;
+            } else {
+                fprintf(stderr, "Invalid option: %s %s\n", arg, value);
+                return 0;
+            }
+        } else {
+            fprintf(stderr, "Invalid option: %s %s\n", arg, value);
+            return 0;
+        }
+    }
+
+    if (!any_scenario) {
+        for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+            options->scenarios[scenario] = EASYAV1_TRUE;
+        }
+    }
+
+    return options->filename != NULL;
+}
+
+static void drain_audio(easyav1_t *easyav1)
 {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
+    if (easyav1_has_audio_track(easyav1)) {
+        easyav1_get_audio_frame(easyav1);
+    }
+}
+
+// Measures the time between frames when decoding the whole file as fast as possible
+static int run_decode(easyav1_t *easyav1, easyav1_bool with_audio, sample_list *samples)
+{
+    benchmark_clock clock;
+    benchmark_clock_start(&clock);
+
+    while (easyav1_decode_next(easyav1) == EASYAV1_STATUS_OK) {
+
+        if (with_audio) {
+            drain_audio(easyav1);
+        }
+
+        if (easyav1_has_video_frame(easyav1) == EASYAV1_FALSE) {
+            continue;
+        }
+
+        if (!add_sample(samples, benchmark_clock_get_elapsed_time(&clock))) {
+            return 0;
+        }
+
+        // Mark the frame as displayed.
+        easyav1_get_video_frame(easyav1);
+
+        benchmark_clock_reset_timer(&clock);
+    }
+
+    return easyav1_is_finished(easyav1) == EASYAV1_TRUE;
+}
+
+// Measures how long it takes from a seek request until the frame at the new position is available
+static int run_seeks(easyav1_t *easyav1, unsigned int seeks, uint64_t seed, sample_list *samples)
+{
+    easyav1_timestamp duration = easyav1_get_duration(easyav1);
+    uint64_t state = seed ? seed : DEFAULT_SEED;
+
+    if (duration == 0) {
         return 1;
     }
 
+    for (unsigned int seek = 0; seek < seeks; seek++) {
+        easyav1_timestamp timestamp = next_random(&state) % duration;
+
+        benchmark_clock clock;
+        benchmark_clock_start(&clock);
+
+        if (easyav1_seek_to_timestamp(easyav1, timestamp) != EASYAV1_STATUS_OK) {
+            return 0;
+        }
+
+        easyav1_status status = EASYAV1_STATUS_OK;
+
+        while (easyav1_has_video_frame(easyav1) == EASYAV1_FALSE && status == EASYAV1_STATUS_OK) {
+            status = easyav1_decode_next(easyav1);
+        }
+
+        // Seeking close to the end may finish the stream before another frame shows up
+        if (status != EASYAV1_STATUS_OK && status != EASYAV1_STATUS_FINISHED) {
+            return 0;
+        }
+
+        if (!add_sample(samples, benchmark_clock_get_elapsed_time(&clock))) {
+            return 0;
+        }
+
+        easyav1_get_video_frame(easyav1);
+    }
+
+    return 1;
+}
+
+// Advances one frame interval at a time with `easyav1_decode_until`, the way a player would on each display refresh
+static int run_playback(easyav1_t *easyav1, sample_list *samples, size_t *late)
+{
+    unsigned int fps = easyav1_get_video_fps(easyav1);
+    easyav1_timestamp step = fps ? 1000 / fps : 16;
+    int64_t budget = (int64_t) (fps ? 1000000 / fps : 16000);
+    easyav1_timestamp timestamp = 0;
+
+    if (step == 0) {
+        step = 1;
+    }
+
+    while (easyav1_is_finished(easyav1) == EASYAV1_FALSE) {
+        timestamp += step;
+
+        benchmark_clock clock;
+        benchmark_clock_start(&clock);
+
+        if (easyav1_decode_until(easyav1, timestamp) == EASYAV1_STATUS_ERROR) {
+            return 0;
+        }
+
+        drain_audio(easyav1);
+
+        if (easyav1_has_video_frame(easyav1)) {
+            easyav1_get_video_frame(easyav1);
+        }
+
+        int64_t elapsed = benchmark_clock_get_elapsed_time(&clock);
+
+        if (elapsed > budget) {
+            (*late)++;
+        }
+
+        if (!add_sample(samples, elapsed)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Decodes only the audio with the regular decoding functions, fetching the samples after each packet
+static int run_audio_only(easyav1_t *easyav1, sample_list *samples, uint64_t *audio_samples)
+{
+    benchmark_clock clock;
+    benchmark_clock_start(&clock);
+
+    while (easyav1_decode_next(easyav1) == EASYAV1_STATUS_OK) {
+        const easyav1_audio_frame *frame = easyav1_get_audio_frame(easyav1);
+
+        if (!frame) {
+            continue;
+        }
+
+        *audio_samples += frame->samples + frame->wrapped_samples;
+
+        if (!add_sample(samples, benchmark_clock_get_elapsed_time(&clock))) {
+            return 0;
+        }
+
+        benchmark_clock_reset_timer(&clock);
+    }
+
+    return easyav1_is_finished(easyav1) == EASYAV1_TRUE;
+}
+
+// Decodes only the audio straight into a buffer, one block at a time
+static int run_audio_direct(easyav1_t *easyav1, sample_list *samples, uint64_t *audio_samples)
+{
+    float *buffer = malloc(AUDIO_BLOCK_SAMPLES * easyav1_get_audio_channels(easyav1) * sizeof(float));
+
+    if (!buffer) {
+        return 0;
+    }
+
+    benchmark_clock clock;
+    benchmark_clock_start(&clock);
+
+    easyav1_status status;
+    size_t decoded;
+
+    while ((status = easyav1_decode_audio_samples(easyav1, buffer, AUDIO_BLOCK_SAMPLES, &decoded)) ==
+        EASYAV1_STATUS_OK) {
+        *audio_samples += decoded;
+
+        if (!add_sample(samples, benchmark_clock_get_elapsed_time(&clock))) {
+            free(buffer);
+            return 0;
+        }
+
+        benchmark_clock_reset_timer(&clock);
+    }
+
+    free(buffer);
+
+    return status == EASYAV1_STATUS_FINISHED;
+}
+
+typedef struct {
+    benchmark_clock clock;
+    sample_list *samples;
+    int failed;
+} segment_run;
+
+static void on_segment_frame(const easyav1_video_frame *frame, size_t segment, void *userdata)
+{
+    segment_run *run = (segment_run *) userdata;
+
+    (void) frame;
+    (void) segment;
+
+    // The frames are ordered, so this is never called from two threads at once
+    if (!add_sample(run->samples, benchmark_clock_get_elapsed_time(&run->clock))) {
+        run->failed = 1;
+    }
+
+    benchmark_clock_reset_timer(&run->clock);
+}
+
+// Decodes the whole video with one decoder per segment on all the logical processors, getting the frames in order
+static int run_segments(easyav1_t *easyav1, sample_list *samples)
+{
+    segment_run run = { .samples = samples, .failed = 0 };
+
+    benchmark_clock_start(&run.clock);
+
+    if (easyav1_decode_segments(easyav1, 0, EASYAV1_TRUE, on_segment_frame, &run) != EASYAV1_STATUS_OK) {
+        return 0;
+    }
+
+    return !run.failed;
+}
+
+static int read_file(void *buffer, size_t size, void *userdata)
+{
+    FILE *file = (FILE *) userdata;
+
+    if (fread(buffer, 1, size, file) == size) {
+        return 1;
+    }
+
+    return ferror(file) ? -1 : 0;
+}
+
+static int seek_file(int64_t offset, int origin, void *userdata)
+{
+    return fseek((FILE *) userdata, (long) offset, origin);
+}
+
+static int64_t tell_file(void *userdata)
+{
+    return ftell((FILE *) userdata);
+}
+
+// Initializes from a custom stream and decodes the first packet, keeping the time spent in each startup phase
+static int run_startup(const benchmark_options *options, easyav1_stats *stats, int64_t *total_time)
+{
     easyav1_settings settings = easyav1_default_settings();
-    settings.enable_audio = 0;
-    settings.skip_unprocessed_frames = 0;
     settings.log_level = EASYAV1_LOG_LEVEL_ERROR;
 
-    easyav1_t *easyav1 = easyav1_init_from_filename(argv[1], &settings);
+    benchmark_clock clock;
+    benchmark_clock_start(&clock);
+
+    FILE *file = fopen(options->filename, "rb");
+
+    if (!file) {
+        fprintf(stderr, "Failed to open %s.\n", options->filename);
+        return 0;
+    }
+
+    easyav1_stream stream = {
+        .read_func = read_file,
+        .seek_func = seek_file,
+        .tell_func = tell_file,
+        .userdata = file
+    };
+
+    easyav1_t *easyav1 = easyav1_init_from_custom_stream(&stream, &settings);
 
     if (!easyav1) {
-        printf("Failed to initialize easyav1.\n");
-        return 2;
+        fprintf(stderr, "Failed to initialize easyav1.\n");
+        fclose(file);
+        return 0;
     }
 
-    if (!easyav1_has_video_track(easyav1)) {
-        printf("The video does not contain a video track.\n");
-        easyav1_destroy(&easyav1);
-        return 3;
+    easyav1_status status = easyav1_decode_next(easyav1);
+
+    // Wait for the first picture, which the video decoder thread may still be working on
+    while (status == EASYAV1_STATUS_OK && easyav1_has_video_track(easyav1) &&
+        easyav1_has_video_frame(easyav1) == EASYAV1_FALSE) {
+        status = easyav1_decode_next(easyav1);
+    }
+
+    *total_time = benchmark_clock_get_elapsed_time(&clock);
+    *stats = easyav1_get_stats(easyav1);
+
+    easyav1_destroy(&easyav1);
+    fclose(file);
+
+    return status != EASYAV1_STATUS_ERROR;
+}
+
+static void print_startup_result(const benchmark_options *options, unsigned int run, const easyav1_stats *stats,
+    int64_t total_time, int first)
+{
+    if (options->format == OUTPUT_TEXT) {
+        printf("%-12s run %u: %" PRId64 " us until the first frame, init %" PRIu64 " us, first decode %" PRIu64
+            " us, first picture after %" PRIu64 " us\n", "startup", run + 1, total_time, stats->startup.init_us,
+            stats->startup.first_decode_us, stats->startup.first_frame_us);
+        printf("%-12s        demuxer %" PRIu64 " us, tracks %" PRIu64 " us (audio headers %" PRIu64
+            " us, video decoder %" PRIu64 " us), threads %" PRIu64 " us, cues %" PRIu64 " us, first packet %"
+            PRIu64 " us\n", "", stats->startup.demuxer_us, stats->startup.tracks_us,
+            stats->startup.audio_headers_us, stats->startup.video_decoder_us, stats->startup.threads_us,
+            stats->startup.cues_us, stats->startup.first_packet_us);
+    } else if (options->format == OUTPUT_JSON) {
+        printf("%s\n    { \"scenario\": \"startup\", \"run\": %u, \"total_us\": %" PRId64 ", \"init_us\": %"
+            PRIu64 ", \"demuxer_us\": %" PRIu64 ", \"tracks_us\": %" PRIu64 ", \"audio_headers_us\": %" PRIu64
+            ", \"video_decoder_us\": %" PRIu64 ", \"threads_us\": %" PRIu64 ", \"cues_us\": %" PRIu64
+            ", \"first_packet_us\": %" PRIu64 ", \"first_decode_us\": %" PRIu64 ", \"first_frame_us\": %" PRIu64
+            " }", first ? "" : ",", run + 1, total_time, stats->startup.init_us, stats->startup.demuxer_us,
+            stats->startup.tracks_us, stats->startup.audio_headers_us, stats->startup.video_decoder_us,
+            stats->startup.threads_us, stats->startup.cues_us, stats->startup.first_packet_us,
+            stats->startup.first_decode_us, stats->startup.first_frame_us);
+    } else {
+        printf("%u,%" PRId64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+            ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", run + 1, total_time, stats->startup.init_us,
+            stats->startup.demuxer_us, stats->startup.tracks_us, stats->startup.audio_headers_us,
+            stats->startup.video_decoder_us, stats->startup.threads_us, stats->startup.cues_us,
+            stats->startup.first_packet_us, stats->startup.first_decode_us, stats->startup.first_frame_us);
     }
 
-    printf("Video duration: %" PRIu64 ":%02" PRIu64 " (%" PRIu64 " ms).\n",
-        easyav1_get_duration(easyav1) / 60000, (easyav1_get_duration(easyav1) / 1000) % 60,
-        easyav1_get_duration(easyav1));
-    printf("Video size: %ux%u, %u FPS.\n", easyav1_get_video_width(easyav1), easyav1_get_video_height(easyav1),
-        easyav1_get_video_fps(easyav1));
     fflush(stdout);
+}
+
+static int is_audio_scenario(benchmark_scenario scenario)
+{
+    return scenario == SCENARIO_AUDIO_ONLY || scenario == SCENARIO_AUDIO_DIRECT;
+}
+
+static int run_scenario(const benchmark_options *options, benchmark_scenario scenario, unsigned int run,
+    run_result *result)
+{
+    easyav1_settings settings = easyav1_default_settings();
+    settings.enable_video = !is_audio_scenario(scenario);
+    settings.enable_audio = scenario != SCENARIO_DECODE && scenario != SCENARIO_SEGMENTS;
+    settings.skip_unprocessed_frames = scenario == SCENARIO_PLAYBACK;
+    settings.use_fast_seeking = scenario == SCENARIO_FAST_SEEK;
+    settings.log_level = EASYAV1_LOG_LEVEL_ERROR;
 
     benchmark_clock clock;
     benchmark_clock_start(&clock);
-    int64_t total_time = 0;
-    int64_t largest_frame_time = 0;
-    easyav1_timestamp slowest_frame_timestamp = 0;
-    uint64_t slowest_frame = 0;
 
-    benchmark_clock printf_clock;
-    benchmark_clock_start(&printf_clock);
+    easyav1_t *easyav1 = easyav1_init_from_filename(options->filename, &settings);
 
-    int printed_chars = 0;
+    if (!easyav1) {
+        fprintf(stderr, "Failed to initialize easyav1.\n");
+        return 0;
+    }
 
-    while (easyav1_decode_next(easyav1) == EASYAV1_STATUS_OK) {
+    int64_t init_time = benchmark_clock_get_elapsed_time(&clock);
+
+    sample_list samples = { 0 };
+    size_t late = 0;
+    uint64_t audio_samples = 0;
+    int success = 0;
+
+    benchmark_clock_reset_timer(&clock);
+
+    switch (scenario) {
+        case SCENARIO_DECODE:
+        case SCENARIO_DECODE_AUDIO:
+            success = run_decode(easyav1, scenario == SCENARIO_DECODE_AUDIO, &samples);
+            break;
+        case SCENARIO_SEEK:
+        case SCENARIO_FAST_SEEK:
+            success = run_seeks(easyav1, options->seeks, options->seed, &samples);
+            break;
+        case SCENARIO_PLAYBACK:
+            success = run_playback(easyav1, &samples, &late);
+            break;
+        case SCENARIO_AUDIO_ONLY:
+            success = run_audio_only(easyav1, &samples, &audio_samples);
+            break;
+        case SCENARIO_AUDIO_DIRECT:
+            success = run_audio_direct(easyav1, &samples, &audio_samples);
+            break;
+        case SCENARIO_SEGMENTS:
+            success = run_segments(easyav1, &samples);
+            break;
+        default:
+            break;
+    }
 
-        // Check if we have a video frame.
-        if (easyav1_has_video_frame(easyav1) == EASYAV1_FALSE) {
-            continue;
-        }
+    int64_t total_time = benchmark_clock_get_elapsed_time(&clock);
+
+    if (success) {
+        qsort(samples.values, samples.count, sizeof(int64_t), compare_samples);
+
+        result->scenario = scenario;
+        result->run = run;
+        result->init_time = init_time;
+        result->total_time = total_time;
+        result->frames = easyav1_get_total_video_frames_processed(easyav1);
+        result->samples = samples.count;
+        result->audio_samples = audio_samples;
+        result->p50 = get_percentile(&samples, 50);
+        result->p95 = get_percentile(&samples, 95);
+        result->p99 = get_percentile(&samples, 99);
+        result->max = samples.count ? samples.values[samples.count - 1] : 0;
+        result->late = late;
+    } else {
+        fprintf(stderr, "Failed to run the %s scenario.\n", SCENARIO_NAMES[scenario]);
+    }
+
+    free(samples.values);
+    easyav1_destroy(&easyav1);
+
+    return success;
+}
+
+static double get_fps(const run_result *result)
+{
+    return result->total_time > 0 ? result->frames / (result->total_time / 1000000.0) : 0;
+}
+
+static double get_audio_rate(const run_result *result)
+{
+    return result->total_time > 0 ? result->audio_samples / (result->total_time / 1000000.0) : 0;
+}
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
 
-        // Get the elapsed time.
-        int64_t elapsed_time = benchmark_clock_get_elapsed_time(&clock);
-        total_time += elapsed_time;
+    for (; *text; text++) {
+        unsigned char c = (unsigned char) *text;
 
-        // Check if this frame is the slowest one.
-        if (elapsed_time > largest_frame_time) {
-            largest_frame_time = elapsed_time;
-            slowest_frame = easyav1_get_total_video_frames_processed(easyav1);
-            slowest_frame_timestamp = easyav1_get_current_timestamp(easyav1);
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
         }
+    }
 
-        // Update the progress every second.
-        if (benchmark_clock_get_elapsed_time(&printf_clock) > 1000) {
-            easyav1_timestamp current_timestamp = easyav1_get_current_timestamp(easyav1);
-            uint64_t total_frames = easyav1_get_total_video_frames_processed(easyav1);
-            double fps = total_frames / (total_time / 1000.0);
-            double speed = current_timestamp / (double) (total_time == 0 ? 1 : total_time);
+    putchar('"');
+}
 
+static void print_header(const benchmark_options *options, easyav1_t *easyav1)
+{
+    easyav1_timestamp duration = easyav1_get_duration(easyav1);
 
-            int printed = printf("\rDecoding (%" PRIu64 ":%02" PRIu64 "): Decoded %" PRIu64 " frames in %" PRIu64 " ms (%lf fps average, %.3lfx).",
-                current_timestamp / 60000, (current_timestamp / 1000) % 60, total_frames, total_time, fps, speed);
+    if (options->format == OUTPUT_TEXT) {
+        printf("Video duration: %" PRIu64 ":%02" PRIu64 " (%" PRIu64 " ms).\n",
+            duration / 60000, (duration / 1000) % 60, duration);
 
-            while (printed_chars > printed) {
-                printf(" ");
-                printed_chars--;
-            }
+        if (easyav1_has_video_track(easyav1)) {
+            printf("Video size: %ux%u, %u FPS.\n", easyav1_get_video_width(easyav1),
+                easyav1_get_video_height(easyav1), easyav1_get_video_fps(easyav1));
+        }
 
-            printed_chars = printed;
+        if (easyav1_has_audio_track(easyav1)) {
+            printf("Audio: %u channels, %u Hz.\n", easyav1_get_audio_channels(easyav1),
+                easyav1_get_audio_sample_rate(easyav1));
+        }
+    } else if (options->format == OUTPUT_JSON) {
+        printf("{\n  \"file\": ");
+        print_json_string(options->filename);
+        printf(",\n  \"duration_ms\": %" PRIu64 ",\n  \"width\": %u,\n  \"height\": %u,\n  \"fps\": %u,\n",
+            duration, easyav1_get_video_width(easyav1), easyav1_get_video_height(easyav1),
+            easyav1_get_video_fps(easyav1));
+        printf("  \"warmup_runs\": %u,\n  \"results\": [", options->warmup_runs);
+    } else if (options->startup) {
+        printf("run,total_us,init_us,demuxer_us,tracks_us,audio_headers_us,video_decoder_us,threads_us,cues_us,"
+            "first_packet_us,first_decode_us,first_frame_us\n");
+    } else {
+        printf("scenario,run,init_us,total_us,frames,fps,samples,p50_us,p95_us,p99_us,max_us,late,audio_samples,"
+            "audio_samples_per_s\n");
+    }
 
-            fflush(stdout);
+    fflush(stdout);
+}
 
-            benchmark_clock_reset_timer(&printf_clock);
+static void print_result(const benchmark_options *options, const run_result *result, int first)
+{
+    const char *name = SCENARIO_NAMES[result->scenario];
+
+    if (options->format == OUTPUT_TEXT && is_audio_scenario(result->scenario)) {
+        printf("%-12s run %u: %zu samples in %" PRId64 " us (%" PRIu64 " audio samples, %.0lf per second), init %"
+            PRId64 " us\n", name, result->run + 1, result->samples, result->total_time, result->audio_samples,
+            get_audio_rate(result), result->init_time);
+        printf("%-12s        p50 %" PRId64 " us, p95 %" PRId64 " us, p99 %" PRId64 " us, max %" PRId64 " us\n",
+            "", result->p50, result->p95, result->p99, result->max);
+    } else if (options->format == OUTPUT_TEXT) {
+        printf("%-12s run %u: %zu samples in %" PRId64 " us (%" PRIu64 " frames, %.2lf fps), init %" PRId64 " us\n",
+            name, result->run + 1, result->samples, result->total_time, result->frames, get_fps(result),
+            result->init_time);
+        printf("%-12s        p50 %" PRId64 " us, p95 %" PRId64 " us, p99 %" PRId64 " us, max %" PRId64 " us",
+            "", result->p50, result->p95, result->p99, result->max);
+
+        if (result->scenario == SCENARIO_PLAYBACK) {
+            printf(", %zu steps over the frame interval", result->late);
         }
 
-        // Mark the frame as displayed.
-        easyav1_get_video_frame(easyav1);
+        printf("\n");
+    } else if (options->format == OUTPUT_JSON) {
+        printf("%s\n    { \"scenario\": \"%s\", \"run\": %u, \"init_us\": %" PRId64 ", \"total_us\": %" PRId64
+            ", \"frames\": %" PRIu64 ", \"fps\": %.3lf, \"samples\": %zu, \"p50_us\": %" PRId64 ", \"p95_us\": %"
+            PRId64 ", \"p99_us\": %" PRId64 ", \"max_us\": %" PRId64 ", \"late\": %zu, \"audio_samples\": %" PRIu64
+            ", \"audio_samples_per_s\": %.0lf }", first ? "" : ",", name, result->run + 1, result->init_time,
+            result->total_time, result->frames, get_fps(result), result->samples, result->p50, result->p95,
+            result->p99, result->max, result->late, result->audio_samples, get_audio_rate(result));
+    } else {
+        printf("%s,%u,%" PRId64 ",%" PRId64 ",%" PRIu64 ",%.3lf,%zu,%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+            ",%zu,%" PRIu64 ",%.0lf\n", name, result->run + 1, result->init_time, result->total_time, result->frames,
+            get_fps(result), result->samples, result->p50, result->p95, result->p99, result->max, result->late,
+            result->audio_samples, get_audio_rate(result));
+    }
 
-        // Restart the timer.
-        benchmark_clock_reset_timer(&clock);
+    fflush(stdout);
+}
+
+int main(int argc, const char **argv)
+{
+    benchmark_options options;
+
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
     }
 
-    if (!easyav1_is_finished(easyav1)) {
-        printf("\nFailed to decode the video.\n");
-        easyav1_destroy(&easyav1);
-        return 4;
+    easyav1_settings settings = easyav1_default_settings();
+    settings.log_level = EASYAV1_LOG_LEVEL_ERROR;
+
+    easyav1_t *easyav1 = easyav1_init_from_filename(options.filename, &settings);
+
+    if (!easyav1) {
+        printf("Failed to initialize easyav1.\n");
+        return 2;
     }
 
-    uint64_t total_frames = easyav1_get_total_video_frames_processed(easyav1);
-    easyav1_timestamp video_length = easyav1_get_duration(easyav1);
-    double fps = total_frames / (total_time / 1000.0);
-    double speed = video_length / (double) (total_time == 0 ? 1 : total_time);
+    easyav1_bool has_video = easyav1_has_video_track(easyav1);
+    easyav1_bool has_audio = easyav1_has_audio_track(easyav1);
 
-    // Print the final result.
-    int printed = printf("\rDecoded %" PRIu64 " frames in %" PRId64 " milliseconds (%lf fps average, %.3lfx).",
-        total_frames, total_time, fps, speed);
-    while (printed_chars > printed) {
-        printf(" ");
-        printed_chars--;
+    if (!has_video && !has_audio) {
+        printf("The video does not contain a video or an audio track.\n");
+        easyav1_destroy(&easyav1);
+        return 3;
     }
 
-    printf("\nSlowest frame: #%" PRIu64 " (at %" PRIu64 ":%02" PRIu64 ") - %" PRId64 " milliseconds (%lf fps).\n", slowest_frame,
-        slowest_frame_timestamp / 60000, (slowest_frame_timestamp / 1000) % 60,
-        largest_frame_time, 1000 / (double) largest_frame_time);
+    print_header(&options, easyav1);
 
     easyav1_destroy(&easyav1);
 
-    return 0;
+    int first = 1;
+    int failed = 0;
+
+    for (unsigned int run = 0; options.startup && run < options.warmup_runs + options.runs; run++) {
+        easyav1_stats stats;
+        int64_t total_time;
+        easyav1_bool warmup = run < options.warmup_runs;
+
+        fprintf(stderr, "Running startup, %s %u of %u...\n", warmup ? "warm-up" : "run",
+            warmup ? run + 1 : run - options.warmup_runs + 1, warmup ? options.warmup_runs : options.runs);
+
+        if (!run_startup(&options, &stats, &total_time)) {
+            failed = 1;
+            break;
+        }
+
+        if (!warmup) {
+            print_startup_result(&options, run - options.warmup_runs, &stats, total_time, first);
+            first = 0;
+        }
+    }
+
+    for (int scenario = 0; scenario < SCENARIO_COUNT && !options.startup && !failed; scenario++) {
+        if (!options.scenarios[scenario]) {
+            continue;
+        }
+
+        if (is_audio_scenario((benchmark_scenario) scenario) ? !has_audio : !has_video) {
+            fprintf(stderr, "Skipping %s, the file has no %s track.\n", SCENARIO_NAMES[scenario],
+                has_audio ? "video" : "audio");
+            continue;
+        }
+
+        for (unsigned int run = 0; run < options.warmup_runs + options.runs; run++) {
+            run_result result;
+            easyav1_bool warmup = run < options.warmup_runs;
+
+            fprintf(stderr, "Running %s, %s %u of %u...\n", SCENARIO_NAMES[scenario], warmup ? "warm-up" : "run",
+                warmup ? run + 1 : run - options.warmup_runs + 1, warmup ? options.warmup_runs : options.runs);
+
+            if (!run_scenario(&options, (benchmark_scenario) scenario, run - (warmup ? 0 : options.warmup_runs),
+                &result)) {
+                failed = 1;
+                break;
+            }
+
+            if (!warmup) {
+                print_result(&options, &result, first);
+                first = 0;
+            }
+        }
+    }
+
+    if (options.format == OUTPUT_JSON) {
+        printf("\n  ]\n}\n");
+    }
+
+    return failed ? 4 : 0;
 }
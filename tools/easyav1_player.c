@@ -111,6 +111,7 @@ static struct {
     struct {
         seek_mode mode;
         easyav1_timestamp timestamp;
+        int previewing;
     } seek;
     float aspect_ratio;
     int quit;
@@ -343,6 +344,10 @@ static int init_easyav1(const char *filename)
     settings.enable_audio = !data.options.disable_audio;
     settings.enable_video = !data.options.disable_video;
     settings.use_fast_seeking = data.options.use_fast_seek;
+
+    // The video texture is 8-bit, so higher bit depths are dithered on the decoder thread
+    settings.video_decoder.plane_format = EASYAV1_PLANE_FORMAT_8BIT;
+
     if (data.options.log_level > 0) {
         if (data.options.log_level > 4) {
             data.options.log_level = 4;
@@ -838,6 +843,30 @@ static int is_inside_time_bar(int x_offset, int x, int y)
     return x > x_offset && x < width - TIME_BAR_SIDE_PADDING - 2 && y > height - TIME_BAR_HEIGHT && y < height - 1;
 }
 
+// Decodes at preview quality while the time bar is dragged, as the frames are only shown for an instant
+static void set_preview_quality(int preview)
+{
+    if (data.seek.previewing == preview) {
+        return;
+    }
+
+    data.seek.previewing = preview;
+
+    easyav1_settings settings = easyav1_get_current_settings(data.easyav1);
+    settings.video_decoder.quality = preview ? EASYAV1_VIDEO_QUALITY_PREVIEW : EASYAV1_VIDEO_QUALITY_FULL;
+
+    // Changing the quality restarts the video decoder, which can't happen while the playback thread runs
+    if (!data.playback.paused) {
+        easyav1_stop(data.easyav1);
+    }
+
+    easyav1_update_settings(data.easyav1, &settings);
+
+    if (!data.playback.paused) {
+        easyav1_play(data.easyav1);
+    }
+}
+
 static void handle_input(void)
 {
     handle_events();
@@ -898,7 +927,13 @@ static void handle_input(void)
         int mouse_was_pressed_on_time_bar = is_inside_time_bar(x_offset,
                                                                data.mouse.pressed.start_x, data.mouse.pressed.start_y);
 
-        if (mouse_is_hovering_timestamp || (mouse_was_pressed && mouse_moved && mouse_was_pressed_on_time_bar)) {
+        int mouse_is_dragging_on_time_bar = mouse_was_pressed && mouse_moved && mouse_was_pressed_on_time_bar;
+
+        if (mouse_is_dragging_on_time_bar) {
+            set_preview_quality(1);
+        }
+
+        if (mouse_is_hovering_timestamp || mouse_is_dragging_on_time_bar) {
             easyav1_seek_to_timestamp(data.easyav1, hovered_timestamp);
         }
 
@@ -916,6 +951,10 @@ static void handle_input(void)
         }
     }
 
+    if (!data.mouse.pressed.active) {
+        set_preview_quality(0);
+    }
+
     data.hovered_timestamp = mouse_is_hovering_timestamp ? hovered_timestamp : 0;
 }
 